@@ -0,0 +1,449 @@
+/**
+  ******************************************************************************
+  * @file bench.c
+  * @brief Cycle count benchmark of the ISR and control task paths
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * Replaces main() of the firmware (see the 'bench' target of the makefile)
+  * and is intended to be run in the ucsim STM8 simulator, or on the S105 Dev
+  * board. The firmware modules are linked unchanged: the functions under test
+  * are invoked directly from here with all interrupt sources disabled, and
+  * the ADC input is synthetic - the conversion results are written to the ADC
+  * data buffer registers, which the simulator treats as memory.
+  *
+  * TIM2 (the servo input capture timer, unused here) is free-running at
+  * fMASTER = fCPU, so the counts read around a call are CPU cycles. The cost
+  * of the two reads of the counter is measured first and subtracted.
+  *
+  * The results are kept until all cases have run and are then printed on the
+  * terminal UART, with interrupts enabled for the transmit ISR only: a line
+  * per function and case with the minimum, maximum and mean cycles, ending
+  * with "END". As with main(), the interrupt vectors are linked from here
+  * (stm8s_it.c). On the board, the power stage must not be connected.
+  *
+  ******************************************************************************
+  */
+/**
+ * \defgroup bench Benchmark
+ * @brief Cycle count benchmark under the STM8 simulator
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include "mcu_stm8s.h"
+#include "term.h"
+#include "bldc_sm.h"
+#include "sequence.h"
+#include "driver.h"
+#include "mdata.h"
+#include "mparam.h"
+#include "faultm.h"
+#include "pwm_stm8s.h"
+#include "current.h"
+
+#ifdef _SDCC_
+/*
+ The interrupt vectors are in the file that implements main() (see main.c),
+ the ISR of the terminal UART transmit is needed for the report.
+*/
+#include "src/stm8s_it.c"
+#endif
+
+/* Private defines -----------------------------------------------------------*/
+
+#if !defined( S105_DEV )
+  #error "bench: the cycle counter (TIM2) is only free on S105_DEV"
+#endif
+
+// number of calls per case, and of result lines
+#define BENCH_RUNS           16u
+#define BENCH_N_RESULTS      32u
+
+// PWM samples (ADC scans) per commutation sector of the synthetic back-EMF
+#define BENCH_SECT_SAMPLES   8u
+
+// synthetic system voltage, and back-EMF ramp per sample (ADC counts)
+#define BENCH_VSYS           BL_VSYS_NOMINAL
+#define BENCH_BEMF_STEP      ( BENCH_VSYS / (2u * BENCH_SECT_SAMPLES) )
+
+// operating point of the closed loop cases
+#define BENCH_DUTY           PWM_GET_PULSE_COUNTS( 25 )
+#define BENCH_COMM_PERIOD    ( (uint16_t)BENCH_SECT_SAMPLES * 1024u )
+
+/* Private types -------------------------------------------------------------*/
+
+/**
+ * @brief Cycle counts of a benchmark case
+ */
+typedef struct
+{
+  uint16_t min;
+  uint16_t max;
+  uint32_t sum;
+  uint16_t n;
+}
+bench_result_t;
+
+/**
+ * @brief Result line of the report
+ */
+typedef struct
+{
+  const char *func;
+  const char *label;
+  bench_result_t res;
+}
+bench_line_t;
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint16_t Bench_overhead; // cycles of the counter reads
+
+static bench_line_t Bench_lines[ BENCH_N_RESULTS ];
+static uint8_t Bench_n_lines;
+
+static const char * const Bench_state_name[] =
+{
+  "NONE", "ARMING", "STOPPED", "ALIGN", "RAMPUP",
+  "OPN_LOOP", "CLS_LOOP", "MANUAL", "RESYNC", "BRAKING"
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Read the cycle counter - the high byte is read first, which latches the
+ * low byte.
+ */
+static uint16_t bench_count(void)
+{
+  uint8_t high = TIM2->CNTRH;
+
+  return (uint16_t)( ((uint16_t)high << 8) | TIM2->CNTRL );
+}
+
+/*
+ * Stop the interrupt sources that MCU_Init() has enabled: some functions under
+ * test enable interrupts on exit from their critical sections, and none of the
+ * ISRs must run during a measurement. The PWM timer is stopped, so there are
+ * no triggered ADC scans to overwrite the synthetic input.
+ */
+static void bench_quiesce(void)
+{
+  TIM1->CR1 &= (uint8_t)~TIM1_CR1_CEN;
+  TIM1->IER = 0;
+  TIM2->IER = 0;
+  TIM3->IER = 0;
+  TIM4->IER = 0;
+  ADC1->CR2 &= (uint8_t)~ADC1_CR2_EXTTRIG;
+  ADC1->CSR &= (uint8_t)~ADC1_CSR_EOCIE;
+  UART2->CR2 &= (uint8_t)~(UART2_CR2_RIEN | UART2_CR2_TIEN);
+}
+
+/*
+ * Free-running TIM2 at fMASTER (prescaler 1, full 16-bit period).
+ */
+static void bench_timer_init(void)
+{
+  TIM2->CR1 = 0;
+  TIM2->PSCR = 0;
+  TIM2->ARRH = 0xFF;
+  TIM2->ARRL = 0xFF;
+  TIM2->EGR = TIM2_EGR_UG; // load the prescaler
+  TIM2->CR1 = TIM2_CR1_CEN;
+}
+
+/*
+ * Synthetic conversion result of an ADC channel (right aligned)
+ */
+static void bench_adc_stim(uint8_t channel, uint16_t counts)
+{
+  volatile uint8_t *p_buf = &ADC1->DB0RH + (uint8_t)(channel << 1);
+
+  p_buf[0] = (uint8_t)(counts >> 8);
+  p_buf[1] = (uint8_t)counts;
+}
+
+/*
+ * Synthetic scan of the phase inputs: all phases are set to the same level so
+ * that the floating phase sees it whatever the sector. The shunt reads 1/2 of
+ * the current limit.
+ */
+static void bench_adc_phases(uint16_t counts)
+{
+  bench_adc_stim(PH0_BEMF_IN_CH, counts);
+  bench_adc_stim(PH1_BEMF_IN_CH, counts);
+  bench_adc_stim(PH2_BEMF_IN_CH, counts);
+  bench_adc_stim(ISHUNT_IN_CH, CURRENT_COUNTS( CURRENT_LIMIT_MA ) / 2u);
+}
+
+/*
+ * Back-EMF of the floating phase at a sample of the sector: a ramp crossing
+ * 1/2 Vsys at the middle of the sector, rising in the odd sectors (see the
+ * 6-step sequence in sequence.c).
+ */
+static uint16_t bench_bemf(uint8_t sector, uint8_t sample)
+{
+  uint16_t ofs = (uint16_t)sample * BENCH_BEMF_STEP;
+
+  if (0 != (sector & 1u))
+  {
+    return (uint16_t)( BENCH_BEMF_STEP + ofs );
+  }
+  return (uint16_t)( BENCH_VSYS - BENCH_BEMF_STEP - ofs );
+}
+
+static void bench_reset(bench_result_t *p_res)
+{
+  p_res->min = U16_MAX;
+  p_res->max = 0;
+  p_res->sum = 0;
+  p_res->n = 0;
+}
+
+static void bench_add(bench_result_t *p_res, uint16_t t0, uint16_t t1)
+{
+  uint16_t cycles = (uint16_t)(t1 - t0) - Bench_overhead; // overflow is ok
+
+  if (cycles < p_res->min)
+  {
+    p_res->min = cycles;
+  }
+  if (cycles > p_res->max)
+  {
+    p_res->max = cycles;
+  }
+  p_res->sum += cycles;
+  p_res->n += 1;
+}
+
+/*
+ * Keep a result line for the report
+ */
+static void bench_log(const char *func, const char *label,
+                      const bench_result_t *p_res)
+{
+  if (Bench_n_lines < BENCH_N_RESULTS)
+  {
+    bench_line_t *p_line = &Bench_lines[ Bench_n_lines ];
+
+    p_line->func = func;
+    p_line->label = label;
+    p_line->res = *p_res;
+    Bench_n_lines += 1;
+  }
+}
+
+/*
+ * Print the result lines: function, case, min, max, mean
+ */
+static void bench_report(void)
+{
+  uint8_t n;
+
+  Term_puts("\n\rBench (");
+  Term_dec(BL_SW_VERSION, 0);
+  Term_puts(") function case min max mean\n\r");
+
+  for (n = 0; n < Bench_n_lines; n++)
+  {
+    const bench_result_t *p_res = &Bench_lines[ n ].res;
+    uint16_t mean = 0;
+
+    if (p_res->n > 0)
+    {
+      mean = (uint16_t)( p_res->sum / p_res->n );
+    }
+    Term_puts(Bench_lines[ n ].func);
+    Term_putc(' ');
+    Term_puts(Bench_lines[ n ].label);
+    Term_dec(p_res->min, 7);
+    Term_dec(p_res->max, 7);
+    Term_dec(mean, 7);
+    Term_puts("\n\r");
+  }
+  Term_puts("END\n\r");
+}
+
+/*
+ * Put the state machine in the given state at the closed-loop operating point
+ */
+static void bench_set_state(BL_state_t state)
+{
+  Faultm_init();
+  BL_set_speed(BENCH_DUTY);
+  BL_set_timing(BENCH_COMM_PERIOD);
+  BL_set_opstate(state);
+}
+
+static void bench_calibrate(void)
+{
+  bench_result_t res;
+  uint8_t n;
+
+  Bench_overhead = 0;
+  bench_reset(&res);
+
+  for (n = 0; n < BENCH_RUNS; n++)
+  {
+    uint16_t t0 = bench_count();
+    bench_add(&res, t0, bench_count());
+  }
+  Bench_overhead = res.min;
+
+  bench_log("overhead", "-", &res);
+}
+
+/*
+ * Sequence_Step() of each sector and Driver_on_ADC_conv() over the synthetic
+ * back-EMF of the sector, in the closed loop.
+ */
+static void bench_sequence(void)
+{
+  static const char * const sector_name[ SEQ_N_CSTEPS ] =
+  {
+    "0", "1", "2", "3", "4", "5"
+  };
+  bench_result_t res_step[ SEQ_N_CSTEPS ];
+  bench_result_t res_adc;
+  uint8_t sector;
+  uint8_t n;
+
+  bench_reset(&res_adc);
+
+  for (sector = 0; sector < SEQ_N_CSTEPS; sector++)
+  {
+    bench_reset(&res_step[ sector ]);
+  }
+
+  bench_set_state(BL_CLS_LOOP);
+
+  for (n = 0; n < BENCH_RUNS; n++)
+  {
+    for (sector = 0; sector < SEQ_N_CSTEPS; sector++)
+    {
+      uint16_t t0;
+      uint8_t sample;
+
+      // Vsys latched at the sector step
+      bench_adc_phases(BENCH_VSYS);
+      Driver_on_ADC_conv();
+
+      t0 = bench_count();
+      Sequence_Step(sector);
+      bench_add(&res_step[ sector ], t0, bench_count());
+
+      for (sample = 0; sample < BENCH_SECT_SAMPLES; sample++)
+      {
+        bench_adc_phases( bench_bemf(sector, sample) );
+
+        t0 = bench_count();
+        Driver_on_ADC_conv();
+        bench_add(&res_adc, t0, bench_count());
+      }
+    }
+  }
+
+  for (sector = 0; sector < SEQ_N_CSTEPS; sector++)
+  {
+    bench_log("Sequence_Step", sector_name[ sector ], &res_step[ sector ]);
+  }
+  bench_log("Driver_on_ADC_conv", "CLS_LOOP", &res_adc);
+}
+
+/*
+ * BL_commutation_step() and BL_state_control() in each state. The state is
+ * set before each call as the state machine may make a transition.
+ */
+static void bench_states(void)
+{
+  bench_result_t res_comm;
+  bench_result_t res_ctrl;
+  uint8_t state;
+  uint8_t n;
+
+  for (state = BL_NONE; state < BL_INVALID; state++)
+  {
+    bench_reset(&res_comm);
+    bench_reset(&res_ctrl);
+
+    for (n = 0; n < BENCH_RUNS; n++)
+    {
+      uint16_t t0;
+
+      bench_adc_phases(BENCH_VSYS);
+      Driver_on_ADC_conv();
+
+      bench_set_state(state);
+      t0 = bench_count();
+      BL_commutation_step();
+      bench_add(&res_comm, t0, bench_count());
+
+      bench_set_state(state);
+      t0 = bench_count();
+      BL_state_control();
+      bench_add(&res_ctrl, t0, bench_count());
+    }
+
+    bench_log("BL_commutation_step", Bench_state_name[ state ], &res_comm);
+    bench_log("BL_state_control", Bench_state_name[ state ], &res_ctrl);
+  }
+
+  BL_reset();
+}
+
+/*
+ * Get_OL_Timing() over the range of the duty-cycle
+ */
+static void bench_ol_timing(void)
+{
+  bench_result_t res;
+  uint16_t duty;
+
+  bench_reset(&res);
+
+  for (duty = 0; duty <= PWM_PERIOD_COUNTS; duty += PWM_PERIOD_COUNTS / 32u)
+  {
+    uint16_t t0 = bench_count();
+    (void)Get_OL_Timing(duty);
+    bench_add(&res, t0, bench_count());
+  }
+
+  bench_log("Get_OL_Timing", "0..100%", &res);
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Run the benchmark and halt.
+  */
+void main(void)
+{
+  MCU_Init();
+
+  bench_quiesce();
+  bench_timer_init();
+
+  Mparam_init(); // motor profile selected in EEPROM
+  (void)Mdata_load(); // learned open-loop timing table, if any
+  BL_reset();
+
+  bench_calibrate();
+  bench_sequence();
+  bench_states();
+  bench_ol_timing();
+
+  // only the UART transmit ISR is enabled from here
+  enableInterrupts();  ///////////////// EI
+
+  bench_report();
+
+  while ( FALSE != Serial_tx_busy() )
+  {
+    // drain the transmit FIFO
+  }
+  halt();
+}
+
+/**@}*/ // defgroup
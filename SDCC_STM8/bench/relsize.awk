@@ -0,0 +1,35 @@
+# Code and data size of an SDCC object module (.rel), from the area records:
+#   A _CODE size 1F4 flags 0 addr 0
+# The sizes are hex (radix 'X' in the header line of the .rel).
+# Flash: code, constants and the initializer values; RAM: data and initialized.
+
+function hex(s,    n, i, c)
+{
+  n = 0
+  s = toupper(s)
+  for (i = 1; i <= length(s); i++)
+  {
+    c = index("0123456789ABCDEF", substr(s, i, 1)) - 1
+    n = n * 16 + c
+  }
+  return n
+}
+
+$1 == "A" && $3 == "size" {
+  if ($2 == "_CODE" || $2 == "_CONST" || $2 == "_INITIALIZER" || \
+      $2 == "HOME" || $2 == "GSINIT" || $2 == "GSFINAL")
+  {
+    flash += hex($4)
+  }
+  else if ($2 == "DATA" || $2 == "INITIALIZED")
+  {
+    ram += hex($4)
+  }
+}
+
+END {
+  m = FILENAME
+  sub(/.*\//, "", m)
+  sub(/\.rel$/, "", m)
+  printf "%-16s %6d %6d\n", m, flash, ram
+}
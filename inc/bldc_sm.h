@@ -23,6 +23,62 @@
 // Battery volts measurement out-of-range threshold - half of 10-bit ADC range?
 #define BL_VSYS_OOR_THRSH  0x0200
 
+/*
+ * Nominal supply voltage of the duty-cycle command (1100kv motor @ 12.5v, see
+ * V_SHUTDOWN_THR). The applied duty-cycle is compensated by the ratio of the
+ * nominal to the measured supply voltage.
+ */
+#define BL_VSYS_NOMINAL    0x0384
+
+/*
+ * Pole pairs of the motor, for the mechanical speed (RPM) from the commutation
+ * period e.g. 6 for a 12N12P motor, 7 for 12N14P. Can be set at build time
+ * e.g. -DBL_MOTOR_POLE_PAIRS=7, the default of the motor parameters until a
+ * motor profile is selected (see BL_set_motor).
+ */
+#if !defined( BL_MOTOR_POLE_PAIRS )
+  #define BL_MOTOR_POLE_PAIRS  6
+#endif
+
+/*
+ * Speed of the governor at the full-scale speed command, also the scale of
+ * the governor gains: no-load speed at 100% duty-cycle of the nominal supply
+ * (1100kv @ 12.5v).
+ */
+#define BL_GOV_RPM_FS      13750UL
+
+/*
+ * Commutation timing is the duration of the 60 (electrical) degree sector.
+ * Timing values at ramp end-points originated from a fixed
+ * closed-loop timing table, hard-coded for 1100kv motor @ 12.v.
+ * The values are in units of the former software-divided timer period (4
+ * timer events per sector), CTIME_SCALAR rescales them to commutation timer
+ * counts. Convert to seconds by multiplying the timer tick e.g.
+ *   1866 * CTIME_SCALAR * (1/16 Mhz) * 2 = ~0.93 mS
+ */
+// commutation period at start of ramp
+#define BL_CT_RAMP_START  (5632.0 * CTIME_SCALAR) // $1600
+
+// commutation period at end of ramp
+#define BL_CT_RAMP_END    (1760.0 * CTIME_SCALAR) // $06E0
+
+// for some reason this little slowdown at ramp end aids in getting sync (experimental/TBD)
+#define BL_CT_STARTUP     (1866.0 * CTIME_SCALAR) // $074A
+
+/*
+ * Error limit used in BL_cl_control -
+ * needs to be small enough to be stable upon transition from to closed-loop.
+ * The timing error is in counts of commutation period, where the period spans
+ * the 60 degree sector, so the limit is about 15 degrees at the startup timing.
+ */
+#define BL_ERROR_LIMIT    (uint16_t)( BL_CT_STARTUP / 4 )
+
+// length of alignment step (experimentally determined w/ 1100kv @12.5v)
+#define BL_TIME_ALIGN     (200u * 1) // N frames @ 1 ms / frame
+
+// duration of the constant acceleration ramp (BL_CT_RAMP_START:BL_CT_RAMP_END)
+#define BL_TIME_RAMP      (400u) // N frames @ 1 ms / frame
+
 /*
  * Percent PWM must be converted to PWM Percent-duty-cycle expressed in counts.
  */
@@ -55,10 +111,87 @@ typedef enum
   BL_OPN_LOOP,
   BL_CLS_LOOP,
   BL_MANUAL,
+  BL_RESYNC,  // flying restart i.e. resync to the coasting rotor
+  BL_BRAKING, // low-side short brake of the stopping rotor
   BL_INVALID
 }
 BL_state_t;
 
+/**
+ * @brief Startup profile parameters.
+ * @details The rotor is aligned to sector 0, then the commutation is ramped at
+ *   constant acceleration (the period shrinking as 1/t) from the start to the
+ *   end period in the ramp time.
+ */
+typedef struct
+{
+  uint16_t align_time;  // alignment duration, control frames (~1 ms)
+  uint16_t align_duty;  // alignment PWM duty-cycle counts i.e. current
+  uint16_t ramp_duty;   // PWM duty-cycle counts during the ramp
+  uint16_t ramp_start;  // commutation period at start of ramp
+  uint16_t ramp_end;    // commutation period at end of ramp
+  uint16_t ramp_time;   // ramp duration, control frames (~1 ms)
+}
+BL_startup_t;
+
+/**
+ * @brief Motor parameters.
+ * @details Constants of the motor for the control, set from the selected
+ *   motor profile (mparam.h). The startup profile and the open-loop timing
+ *   curve are set separately (BL_set_startup, Get_OL_Timing).
+ */
+typedef struct
+{
+  uint16_t gov_rpm_fs;   // governor speed at full-scale (no-load at 100% of the nominal supply)
+  uint16_t ct_startup;   // commutation period of the transition to closed-loop
+  uint16_t duty_startup; // PWM duty-cycle counts, lowest of the closed-loop
+  uint16_t duty_shutoff; // PWM duty-cycle counts, the motor is stopped below
+  uint8_t pole_pairs;    // for the mechanical speed (RPM)
+  uint8_t pi_kp_q8;      // closed-loop timing controller gains, Q8
+  uint8_t pi_ki_q8;
+}
+BL_motor_t;
+
+/**
+ * @brief Slew rate limits of the duty-cycle command.
+ * @details PWM counts per control frame (~1 ms) in 8-bit fixed-point, the
+ *   limit at full sync margin of the closed-loop.
+ */
+typedef struct
+{
+  uint16_t accel_q8;    // increasing duty-cycle
+  uint16_t decel_q8;    // decreasing duty-cycle
+}
+BL_slew_t;
+
+/**
+ * @brief Brake modes
+ */
+typedef enum
+{
+  BL_BRAKE_OFF = 0, // decelerate at the slew rate, float the phases at stop
+  BL_BRAKE_REGEN,   // regenerative brake in closed-loop, float at stop
+  BL_BRAKE_FULL,    // regenerative brake, then low-side short brake at stop
+  BL_BRAKE_N_MODES
+}
+BL_brake_mode_t;
+
+/**
+ * @brief Brake parameters.
+ * @details The regenerative brake is the duty-cycle command lowered at the
+ *   brake rate i.e. the phase voltage below the back-EMF, the synchronous
+ *   PWM (low-side on in the off-time) returns the current to the supply. The
+ *   duty-cycle is held while the supply voltage is above the overshoot limit.
+ */
+typedef struct
+{
+  uint8_t mode;         // BL_brake_mode_t
+  uint16_t decel_q8;    // slew rate of the regenerative brake (see BL_slew_t)
+  uint16_t short_time;  // duration of the short brake, control frames (~1 ms)
+  uint16_t vbatt_ovs;   // supply voltage overshoot limit above rest, ADC counts
+}
+BL_brake_t;
+
 /**
  * @brief Accessor for state variable.
  *
@@ -70,6 +203,9 @@ typedef struct
   uint16_t bl_sys_voltage;
   uint16_t bl_motor_speed;
   uint16_t bl_comm_period;
+  uint16_t bl_motor_current; // on-time shunt current, ADC counts (current.h)
+  uint16_t bl_motor_rpm; // mechanical speed from the commutation period
+  uint8_t bl_cpu_load; // CPU load percent (sched.h)
 }
 BL_status_t;
 
@@ -87,6 +223,11 @@ void BL_set_timing( uint16_t u16);
 void BL_set_opstate(uint8_t opstate);
 uint8_t BL_get_opstate(void);
 
+#if defined( TRACE_ENABLED )
+int32_t BL_get_pi_integ(void);
+void BL_set_pi_integ(int32_t integ);
+#endif
+
 void BL_timing_step_slower(void);
 void BL_timing_step_faster(void);
 
@@ -95,7 +236,26 @@ uint16_t BL_get_speed(void);
 
 void BL_reset(void);
 
-BL_status_t *BL_get_status(void);
+void BL_get_status(BL_status_t *p_status);
+
+void BL_set_startup(const BL_startup_t *p_startup);
+void BL_get_startup(BL_startup_t *p_startup);
+
+uint16_t BL_get_startup_time(void);
+
+void BL_set_motor(const BL_motor_t *p_motor);
+void BL_get_motor(BL_motor_t *p_motor);
+
+void BL_set_slew(const BL_slew_t *p_slew);
+void BL_get_slew(BL_slew_t *p_slew);
+
+void BL_set_brake(const BL_brake_t *p_brake);
+void BL_get_brake(BL_brake_t *p_brake);
+
+uint16_t BL_get_vbatt_rest(void);
+
+void BL_set_governor(bool enable);
+bool BL_get_governor(void);
 
 uint8_t BL_get_ct_mode(void);
 
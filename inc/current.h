@@ -0,0 +1,39 @@
+/**
+  ******************************************************************************
+  * @file current.h
+  * @brief Shunt current measurement and cycle-by-cycle current limit
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef CURRENT_H
+#define CURRENT_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* Public defines -----------------------------------------------------------*/
+/*
+ * Scale of the shunt current measurement: 10 mOhm low-side shunt, amplifier
+ * gain 20 i.e. 0.2 V/A, 5 V / 1024 counts = 4.9 mV/count -> ~24 mA/count
+ */
+#define CURRENT_MA_PER_COUNT   24u
+
+// convert milli-amps to ADC counts
+#define CURRENT_COUNTS( _MA_ )  (uint16_t)( (_MA_) / CURRENT_MA_PER_COUNT )
+
+// default limit of the motor (on-time shunt) current
+#define CURRENT_LIMIT_MA       12000u
+
+/* Public function prototypes -----------------------------------------------*/
+
+void Current_sample(uint16_t counts);
+
+uint16_t Current_get(void);
+
+void Current_set_limit(uint16_t counts);
+
+uint16_t Current_get_limit_cycles(void);
+
+#endif // CURRENT_H
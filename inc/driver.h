@@ -21,16 +21,31 @@
 #include "mdata.h"
 
 /* defines -------------------------------------------------------------------*/
-#define RX_BUFFER_SIZE  16  //how big should this be?
+#define RX_BUFFER_SIZE  32  // power of 2, holds at least two PDU frames (multi-ESC bus)
 
 /* types --------------------------------------------------------------------*/
 
+/**
+ * @brief Throttle protocol detected at the servo capture input
+ */
+typedef enum
+{
+  THR_PROTO_SERVO = 0, // analog servo pulse (default)
+  THR_PROTO_ONESHOT125,
+  THR_PROTO_MULTISHOT,
+  THR_PROTO_DSHOT      // DShot150/300 digital throttle
+}
+Driver_thr_proto_t;
+
 /* prototypes ---------------------------------------------------------------*/
 
 void Driver_Step(void);
 void Driver_Update(void);
 
 uint16_t Driver_Get_ADC(void);
+uint16_t Driver_Get_ADC_Phase(uint8_t phase);
+
+void Driver_set_comm_delay(uint16_t delay);
 
 void Driver_on_PWM_edge(void);
 void Driver_on_ADC_conv(void);
@@ -44,8 +59,11 @@ uint16_t Driver_get_pulse_dur(void);
 uint16_t Driver_get_pulse_perd(void);
 uint16_t Driver_get_servo_position_counts(void);
 
+Driver_thr_proto_t Driver_get_throttle_proto(void);
+void Driver_thr_isr_enable(bool enable);
+uint16_t Driver_get_thr_frames(void);
+
 void Driver_Get_Rx_It(void);
-uint8_t Driver_Return_Rx_Buffer(void);
-void Driver_Clear_Rx_Buffer_Element(uint8_t Location);
+bool Driver_Get_Rx_Byte(uint8_t *p_byte);
 
 #endif // DRIVER_H
@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file eeprom_stm8s.h
+  * @brief Non-blocking write of the data EEPROM
+  * @author Neidermeier
+  * @version
+  * @date June-2022
+  ******************************************************************************
+  */
+#ifndef EEPROM_STM8S_H
+#define EEPROM_STM8S_H
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "system.h" // platform specific delarations
+
+/* Defines -------------------------------------------------------------------*/
+
+// size of the data EEPROM
+#if defined( S003_DEV )
+  #define EEPROM_SIZE         128u
+#else
+  #define EEPROM_SIZE         1024u
+#endif
+
+// allocation of the data EEPROM (offsets from start of data EEPROM)
+#define EEPROM_OFS_MDATA      0x0000 // learned open-loop timing table (mdata.c)
+#define EEPROM_OFS_PDU_NODE   0x0070 // node address on the multi-ESC bus (pdu_manager.c)
+#define EEPROM_OFS_MPARAM_SEL 0x0072 // selected motor profile (mparam.c)
+#define EEPROM_OFS_MPARAM     0x0080 // motor profile slots (mparam.c), not on the S003
+
+/* Function prototypes -------------------------------------------------------*/
+
+void EEPROM_read(uint16_t offset, uint8_t *buf, uint8_t len);
+
+bool EEPROM_write(uint16_t offset, const uint8_t *buf, uint8_t len);
+
+bool EEPROM_busy(void);
+
+void EEPROM_on_eop(void);
+
+
+#endif // EEPROM_STM8S_H
@@ -30,15 +30,18 @@ typedef char faultm_assert_t;
 /**
  * @brief integer enumeration of all defined system faults
  *
- * Relies on assigning explicit integer values to use bit-positions in the
- * system-error word - the system word is expected to fit in 8-bits.
+ * The ID is the bit-position of the fault in the system-error word and the
+ * index of its descriptor (faultm.c) - the system word is expected to fit in
+ * 8-bits.
  */
 typedef enum
 {
-    FAULT_0 = 1,
-    FAULT_1 = 2,
-    VOLTAGE_NG = 4,
-    THROTTLE_HI = 8
+    FAULT_0 = 0,
+    FAULT_1,      // closed-loop sync lost and resync failed
+    VOLTAGE_NG,   // system voltage below stall threshold
+    THROTTLE_HI,
+    OVER_CURRENT, // hardware over-current break (BKIN)
+    NR_DEFINED_FAULTS
 } faultm_ID_t;
 
 /**
@@ -46,6 +49,35 @@ typedef enum
  */
 typedef uint8_t fault_status_reg_t; // fault status bitmap
 
+/**
+ * @brief Bit of a fault in the status word
+ */
+#define FAULTM_MASK( _ID_ )  ( (fault_status_reg_t)( 1u << (_ID_) ) )
+
+/**
+ * @brief Entry of the fault event log
+ *
+ * @details  Snapshot of the controller state at the control task tick where
+ *  the fault was set or cleared.
+ */
+typedef struct
+{
+    uint16_t tick;      // control task tick (~1 ms, wraps at 65.5 s)
+    uint8_t event;      // fault ID, FAULTM_EV_CLR if cleared
+    uint8_t opstate;    // BL_state_t
+    uint16_t duty;      // PWM duty-cycle counts
+    uint16_t period;    // commutation period
+    uint16_t vsys;      // system voltage, ADC counts
+} faultm_event_t;
+
+#define FAULTM_EV_CLR    0x80 // event flag: fault cleared
+#define FAULTM_EV_ID     0x7F
+
+/**
+ * @brief Number of entries of the fault event log, the oldest is overwritten
+ */
+#define FAULTM_LOG_SZ  8
+
 
 /*
  * prototypes
@@ -53,11 +85,17 @@ typedef uint8_t fault_status_reg_t; // fault status bitmap
 
 void Faultm_init(void);
 
+void Faultm_tick(void);
+
 void Faultm_upd(faultm_ID_t faultm_ID, faultm_assert_t tcondition);
 void Faultm_set(faultm_ID_t faultm_ID);
-//void Faultm_clr(faultm_ID_t faultm_ID); // unimplemented
+void Faultm_enable(faultm_ID_t faultm_ID, int enable_b);
 
 fault_status_reg_t Faultm_get_status(void);
 
+uint8_t Faultm_log_count(void);
+bool Faultm_log_get(uint8_t n, faultm_event_t *p_event);
+void Faultm_log_clear(void);
+
 
 #endif // FAULTM_H
@@ -0,0 +1,184 @@
+/**
+  ******************************************************************************
+  * @file hal_stm8s.h
+  * @brief Board mapping and direct register access of the interrupt paths
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * The peripheral accesses of the interrupt handlers and of the driver
+  * functions they invoke (flag test and clear, ADC start and buffer read, timer
+  * compare and capture registers, UART data) are macros expanding to register
+  * operations, in place of the StdPeriph library calls i.e. without the call,
+  * the return and the assert_param() of the library. The timer and UART
+  * assignments of each board are resolved here. The library is still used for
+  * the peripheral initialization.
+  *
+  * The timer status flags (TIMx_SR1) are rc_w0 and are cleared by writing 0
+  * to the flag and 1 to all other bits (no effect) rather than by
+  * read-modify-write, which would also clear a flag set between the read and
+  * the write.
+  *
+  ******************************************************************************
+  */
+#ifndef HAL_STM8S_H
+#define HAL_STM8S_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* Public defines -----------------------------------------------------------*/
+
+/*
+ * Timer assignments of the board: PWM (and PWM-synchronous tasks),
+ * commutation and servo pulse input capture
+ */
+#if defined( S105_DEV )
+// TIM2 CH1/CH2 pins are left for the servo input, so the PWM is on TIM1
+  #define HAL_PWM_TIM1
+  #define HAL_COMM_TIM3
+  #define HAL_SERVO_TIM2
+
+#elif defined( S105_DISCOVERY )
+  #define HAL_PWM_TIM2
+  #define HAL_COMM_TIM3
+  #define HAL_SERVO_TIM1
+
+#elif defined( S003_DEV )
+// no TIM3 on the S003, no servo input
+  #define HAL_PWM_TIM2
+  #define HAL_COMM_TIM1
+#endif
+
+#if defined( HAL_PWM_TIM1 )
+  #define HAL_PWM_TIMER      TIM1
+  #define HAL_PWM_SR1_UIF    TIM1_SR1_UIF
+#elif defined( HAL_PWM_TIM2 )
+  #define HAL_PWM_TIMER      TIM2
+  #define HAL_PWM_SR1_UIF    TIM2_SR1_UIF
+#endif
+
+#if defined( HAL_COMM_TIM3 )
+  #define HAL_COMM_TIMER     TIM3
+  #define HAL_COMM_SR1_UIF   TIM3_SR1_UIF
+  #define HAL_COMM_EGR_UG    TIM3_EGR_UG
+#elif defined( HAL_COMM_TIM1 )
+  #define HAL_COMM_TIMER     TIM1
+  #define HAL_COMM_SR1_UIF   TIM1_SR1_UIF
+  #define HAL_COMM_EGR_UG    TIM1_EGR_UG
+#endif
+
+// capture channels of the rising and falling edge of the servo pulse
+#if defined( HAL_SERVO_TIM2 )
+  #define HAL_SERVO_TIMER      TIM2
+  #define HAL_SERVO_SR1_RISE   TIM2_SR1_CC1IF
+  #define HAL_SERVO_SR1_FALL   TIM2_SR1_CC2IF
+  #define HAL_SERVO_CCR_RISE   ( &TIM2->CCR1H )
+  #define HAL_SERVO_CCR_FALL   ( &TIM2->CCR2H )
+#elif defined( HAL_SERVO_TIM1 )
+  #define HAL_SERVO_TIMER      TIM1
+  #define HAL_SERVO_SR1_RISE   TIM1_SR1_CC4IF
+  #define HAL_SERVO_SR1_FALL   TIM1_SR1_CC3IF
+  #define HAL_SERVO_CCR_RISE   ( &TIM1->CCR4H )
+  #define HAL_SERVO_CCR_FALL   ( &TIM1->CCR3H )
+#endif
+
+/*
+ * UART of the serial terminal and PDU
+ */
+#if defined( STM8S105 ) // S105 Dev board or DISCOVERY
+  #define HAL_UART           UART2
+  #define HAL_UART_SR_TXE    UART2_SR_TXE
+  #define HAL_UART_SR_RXNE   UART2_SR_RXNE
+  #define HAL_UART_CR2_TIEN  UART2_CR2_TIEN
+#else // stm8s003
+  #define HAL_UART           UART1
+  #define HAL_UART_SR_TXE    UART1_SR_TXE
+  #define HAL_UART_SR_RXNE   UART1_SR_RXNE
+  #define HAL_UART_CR2_TIEN  UART1_CR2_TIEN
+#endif
+
+/* Public macros ------------------------------------------------------------*/
+
+/**
+ * @brief Test an interrupt flag of a timer (TIMx_SR1)
+ */
+#define HAL_TIM_FLAG( _TIM_, _FLAG_ ) \
+  ( 0 != ( (_TIM_)->SR1 & (uint8_t)(_FLAG_) ) )
+
+/**
+ * @brief Clear interrupt flag(s) of a timer (TIMx_SR1), the other flags are
+ *   unchanged
+ */
+#define HAL_TIM_CLR_FLAG( _TIM_, _FLAG_ ) \
+  ( (_TIM_)->SR1 = (uint8_t)( ~(uint8_t)(_FLAG_) ) )
+
+/**
+ * @brief Write a 16-bit compare register given its MSB register, the MSB is
+ *   written first (preload of the 16-bit value)
+ */
+#define HAL_TIM_SET_CCR( _P_HI_, _VAL_ )             \
+  do {                                               \
+    (_P_HI_)[ 0 ] = (uint8_t)( (uint16_t)(_VAL_) >> 8 ); \
+    (_P_HI_)[ 1 ] = (uint8_t)(_VAL_);                \
+  } while (0)
+
+/**
+ * @brief Read a 16-bit capture register given its MSB register, the MSB is
+ *   read first (latches the LSB)
+ */
+#define HAL_TIM_GET_CCR( _P_HI_, _VAL_ )             \
+  do {                                               \
+    uint8_t hal_hi_ = (_P_HI_)[ 0 ];                 \
+    (_VAL_) = (uint16_t)( ((uint16_t)hal_hi_ << 8) | (_P_HI_)[ 1 ] ); \
+  } while (0)
+
+/**
+ * @brief Start the ADC conversion (scan) from software
+ * @details The first write of ADON wakes up the ADC if it is powered down,
+ *   the second write starts the conversion (ADC1_Cmd(), ADC1_StartConversion()).
+ */
+#define HAL_ADC_START( )                   \
+  do {                                     \
+    ADC1->CR1 |= ADC1_CR1_ADON;            \
+    ADC1->CR1 |= ADC1_CR1_ADON;            \
+  } while (0)
+
+/**
+ * @brief Clear the end of conversion flag
+ * @details CSR also holds the channel selection and interrupt enables, so
+ *   read-modify-write.
+ */
+#define HAL_ADC_CLR_EOC( ) \
+  ( ADC1->CSR &= (uint8_t)( ~ADC1_CSR_EOC ) )
+
+/**
+ * @brief Read the data buffer register of a channel of the ADC scan
+ * @details The conversion is right aligned (ADC1_setup()), the LSB is read
+ *   first.
+ */
+#define HAL_ADC_GET_BUFFER( _CH_, _VAL_ )                              \
+  do {                                                                 \
+    uint8_t hal_ofs_ = (uint8_t)( (uint8_t)(_CH_) << 1 );              \
+    uint8_t hal_lo_ = (&ADC1->DB0RL)[ hal_ofs_ ];                      \
+    (_VAL_) = (uint16_t)( ((uint16_t)(&ADC1->DB0RH)[ hal_ofs_ ] << 8) | hal_lo_ ); \
+  } while (0)
+
+/**
+ * @brief Read the received byte of the UART
+ * @details Reading SR and then DR clears RXNE and the overrun flag.
+ */
+#define HAL_UART_GET_RX( _VAL_ )           \
+  do {                                     \
+    (void)HAL_UART->SR;                    \
+    (_VAL_) = (uint8_t)HAL_UART->DR;       \
+  } while (0)
+
+/**
+ * @brief Test for a byte received by the UART
+ */
+#define HAL_UART_RX_READY( ) \
+  ( 0 != ( HAL_UART->SR & HAL_UART_SR_RXNE ) )
+
+#endif // HAL_STM8S_H
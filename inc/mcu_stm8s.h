@@ -15,13 +15,40 @@
 // app headers
 #include "system.h" // platform specific delarations
 
+/* defines -------------------------------------------------------------------*/
+
+// commutation timer (TIM3, or TIM1 on S003) is clocked at fMASTER / 2
+#define MCU_COMM_CT_PER_US  8u
+
 /* function prototypes -------------------------------------------------------*/
 
 uint8_t SerialKeyPressed(char *key);
 
+void Serial_putc(uint8_t c);
+
+uint8_t Serial_write(const uint8_t *buf, uint8_t len);
+
+bool Serial_tx_busy(void);
+
+uint8_t Serial_tx_free(void);
+
+uint16_t Serial_get_tx_dropped(void);
+
+void Serial_Tx_It(void);
+
 void MCU_Init(void);
 
 void MCU_set_comm_timer(uint16_t period);
 
+void MCU_set_comm_period(uint16_t period);
+
+void MCU_set_comm_delay(uint16_t delay);
+
+uint16_t MCU_get_comm_count(void);
+
+void MCU_servo_fast_mode(void);
+
+void MCU_servo_dshot_mode(void);
+
 
 #endif // MCU_STM8S
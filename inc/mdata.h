@@ -31,5 +31,17 @@
  */
 uint16_t Get_OL_Timing(uint16_t table_index);
 
+uint16_t Mdata_get_dutycycle(uint16_t period);
+
+void Mdata_learn(uint16_t dutycycle, uint16_t period);
+
+void Mdata_set_learn(bool enable);
+
+bool Mdata_get_learn(void);
+
+bool Mdata_load(void);
+
+bool Mdata_save(void);
+
 
 #endif // MDATA_H
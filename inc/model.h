@@ -1,128 +0,0 @@
-3400, //   0, 0, 0, D48
-3333, //   1, 1, 1, D05
-3267, //   2, 2, 2, CC3
-3202, //   3, 2, 3, C82
-3139, //   4, 3, 4, C43
-3076, //   5, 4, 5, C04
-3016, //   6, 5, 6, BC8
-2956, //   7, 6, 7, B8C
-2897, //   8, 6, 8, B51
-2840, //   9, 7, 9, B18
-2784, //   10, 8, A, AE0
-2729, //   11, 9, B, AA9
-2675, //   12, 10, C, A73
-2622, //   13, 10, D, A3E
-2570, //   14, 11, E, A0A
-2519, //   15, 12, F, 9D7
-2469, //   16, 13, 10, 9A5
-2420, //   17, 14, 11, 974
-2372, //   18, 14, 12, 944
-2325, //   19, 15, 13, 915
-2279, //   20, 16, 14, 8E7
-2234, //   21, 17, 15, 8BA
-2190, //   22, 18, 16, 88E
-2146, //   23, 18, 17, 862
-2104, //   24, 19, 18, 838
-2062, //   25, 20, 19, 80E
-2021, //   26, 21, 1A, 7E5
-1981, //   27, 22, 1B, 7BD
-1942, //   28, 22, 1C, 796
-1904, //   29, 23, 1D, 770
-1866, //   30, 24, 1E, 74A
-1829, //   31, 25, 1F, 725
-1793, //   32, 26, 20, 701
-1757, //   33, 26, 21, 6DD
-1722, //   34, 27, 22, 6BA
-1688, //   35, 28, 23, 698
-1655, //   36, 29, 24, 677
-1622, //   37, 30, 25, 656
-1590, //   38, 30, 26, 636
-1559, //   39, 31, 27, 617
-1528, //   40, 32, 28, 5F8
-1497, //   41, 33, 29, 5D9
-1468, //   42, 34, 2A, 5BC
-1439, //   43, 34, 2B, 59F
-1410, //   44, 35, 2C, 582
-1382, //   45, 36, 2D, 566
-1355, //   46, 37, 2E, 54B
-1328, //   47, 38, 2F, 530
-1302, //   48, 38, 30, 516
-1276, //   49, 39, 31, 4FC
-1251, //   50, 40, 32, 4E3
-1226, //   51, 41, 33, 4CA
-1202, //   52, 42, 34, 4B2
-1178, //   53, 42, 35, 49A
-1155, //   54, 43, 36, 483
-1132, //   55, 44, 37, 46C
-1109, //   56, 45, 38, 455
-1087, //   57, 46, 39, 43F
-1066, //   58, 46, 3A, 42A
-1045, //   59, 47, 3B, 415
-1024, //   60, 48, 3C, 400
-1004, //   61, 49, 3D, 3EC
-984, //   62, 50, 3E, 3D8
-964, //   63, 50, 3F, 3C4
-945, //   64, 51, 40, 3B1
-927, //   65, 52, 41, 39F
-908, //   66, 53, 42, 38C
-890, //   67, 54, 43, 37A
-873, //   68, 54, 44, 369
-855, //   69, 55, 45, 357
-838, //   70, 56, 46, 346
-822, //   71, 57, 47, 336
-806, //   72, 58, 48, 326
-790, //   73, 58, 49, 316
-789, //   74, 59, 4A, 315
-786, //   75, 60, 4B, 312
-783, //   76, 61, 4C, 30F
-780, //   77, 62, 4D, 30C
-777, //   78, 62, 4E, 309
-774, //   79, 63, 4F, 306
-771, //   80, 64, 50, 303
-768, //   81, 65, 51, 300
-765, //   82, 66, 52, 2FD
-762, //   83, 66, 53, 2FA
-759, //   84, 67, 54, 2F7
-756, //   85, 68, 55, 2F4
-753, //   86, 69, 56, 2F1
-750, //   87, 70, 57, 2EE
-747, //   88, 70, 58, 2EB
-744, //   89, 71, 59, 2E8
-741, //   90, 72, 5A, 2E5
-738, //   91, 73, 5B, 2E2
-735, //   92, 74, 5C, 2DF
-732, //   93, 74, 5D, 2DC
-729, //   94, 75, 5E, 2D9
-726, //   95, 76, 5F, 2D6
-723, //   96, 77, 60, 2D3
-720, //   97, 78, 61, 2D0
-717, //   98, 78, 62, 2CD
-714, //   99, 79, 63, 2CA
-711, //   100, 80, 64, 2C7
-708, //   101, 81, 65, 2C4
-705, //   102, 82, 66, 2C1
-702, //   103, 82, 67, 2BE
-699, //   104, 83, 68, 2BB
-696, //   105, 84, 69, 2B8
-693, //   106, 85, 6A, 2B5
-690, //   107, 86, 6B, 2B2
-687, //   108, 86, 6C, 2AF
-684, //   109, 87, 6D, 2AC
-681, //   110, 88, 6E, 2A9
-678, //   111, 89, 6F, 2A6
-675, //   112, 90, 70, 2A3
-672, //   113, 90, 71, 2A0
-669, //   114, 91, 72, 29D
-666, //   115, 92, 73, 29A
-663, //   116, 93, 74, 297
-660, //   117, 94, 75, 294
-657, //   118, 94, 76, 291
-654, //   119, 95, 77, 28E
-651, //   120, 96, 78, 28B
-648, //   121, 97, 79, 288
-645, //   122, 98, 7A, 285
-642, //   123, 98, 7B, 282
-639, //   124, 99, 7C, 27F
-// [1:74]  f(x) = 1500 * e ^ -x/50
-// [75:TBLSZ]  f(x) = 3x + 565
-// 10.0 * (   dtable(:, //   2)  +60 )  + 1700
@@ -0,0 +1,88 @@
+/**
+  ******************************************************************************
+  * @file mparam.h
+  * @brief Motor parameter profiles
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef MPARAM_H
+#define MPARAM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "bldc_sm.h"
+
+/* Public defines -----------------------------------------------------------*/
+
+// length of the profile name incl. the terminating NUL
+#define MPARAM_NAME_LEN   8
+
+/*
+ * Nodes of the open-loop timing curve, the node k is at the duty-cycle
+ * k / MPARAM_OL_N_PTS of the PWM period (i.e. the nodes of the learned table,
+ * see mdata.c)
+ */
+#define MPARAM_OL_N_PTS   32
+
+/*
+ * Scale of the PWM duty-cycles of a profile i.e. in 1/1024 of the PWM period,
+ * independent of the PWM profile (PWM_PERIOD_COUNTS)
+ */
+#define MPARAM_DUTY_FS    1024
+
+/*
+ * Profile slots in the data EEPROM, following the built-in profiles in the
+ * profile index. The S003 has no room for them.
+ */
+#if defined( S003_DEV )
+  #define MPARAM_N_SLOTS  0
+#else
+  #define MPARAM_N_SLOTS  4
+#endif
+
+/* Public types -------------------------------------------------------------*/
+
+/**
+ * @brief Motor profile
+ * @details The startup profile and the motor parameters in the units of
+ *   BL_set_startup and BL_set_motor, except the PWM duty-cycles which are in
+ *   1/MPARAM_DUTY_FS of the PWM period. The open-loop timing curve is the
+ *   commutation period (timer counts) at each node, decreasing with the
+ *   duty-cycle, 0 above the range of the curve.
+ *
+ *   The built-in profiles are generated from the motor constants by
+ *   tools/mparam_gen (mparam_tbl.h). A profile written to an EEPROM slot over
+ *   the PDU (Mparam_load, Mparam_save) is the memory image of this type on the
+ *   target i.e. 16-bit fields MSB first, no padding.
+ */
+typedef struct
+{
+  char name[ MPARAM_NAME_LEN ];
+  uint16_t kv;                          // RPM/V
+  BL_startup_t startup;
+  BL_motor_t motor;
+  uint16_t ol_timing[ MPARAM_OL_N_PTS ];
+}
+mparam_t;
+
+/* Public function prototypes -----------------------------------------------*/
+
+void Mparam_init(void);
+
+bool Mparam_select(uint8_t index);
+
+uint8_t Mparam_get_index(void);
+
+uint8_t Mparam_get_count(void);
+
+const mparam_t *Mparam_get(void);
+
+#if ( MPARAM_N_SLOTS > 0 )
+bool Mparam_load(uint8_t offset, const uint8_t *buf, uint8_t len);
+
+bool Mparam_save(uint8_t slot);
+#endif
+
+#endif // MPARAM_H
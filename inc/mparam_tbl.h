@@ -0,0 +1,55 @@
+/*
+ * Built-in motor profiles (mparam_t initializers, see mparam.h)
+ * Generated by tools/mparam_gen from tools/mparam_gen/motors.txt, do not edit:
+ *   make -C SDCC_STM8 tables
+ */
+#ifndef MPARAM_TBL_H
+#define MPARAM_TBL_H
+
+#if ( MPARAM_OL_N_PTS != 32 ) || ( MPARAM_DUTY_FS != 1024 ) || ( MPARAM_NAME_LEN != 8 )
+  #error "mparam_tbl.h does not match mparam.h, regenerate"
+#endif
+
+// D1100: 1100 kv, 6 pole-pairs @ 12.5 v, curve fit A=3400 TAU=50 [74:125] 1011 - 3 x
+#define MPARAM_PROFILE_D1100 \
+{ \
+  "D1100", 1100, \
+  { 200, 256, 143, 22528, 7040, 400 }, \
+  { 13750, 7464, 122, 30, 6, 26, 4 }, \
+  { \
+    13600, 11633,  9950,  8511,  7280,  6227,  5326,  4555, \
+     3896,  3333,  3107,  3013,  2919,  2825,  2732,  2638, \
+     2544,     0,     0,     0,     0,     0,     0,     0, \
+        0,     0,     0,     0,     0,     0,     0,     0, \
+  } \
+}
+
+// S003: 1100 kv, 6 pole-pairs @ 12.5 v, curve fit A=1500 TAU=50 [64:63] 425 - 0 x
+#define MPARAM_PROFILE_S003 \
+{ \
+  "S003", 1100, \
+  { 200, 256, 143, 22528, 7040, 400 }, \
+  { 13750, 7464, 122, 30, 6, 26, 4 }, \
+  { \
+     6000,  5132,  4390,  3755,  3212,  2747,  2350,  2010, \
+     1719,     0,     0,     0,     0,     0,     0,     0, \
+        0,     0,     0,     0,     0,     0,     0,     0, \
+        0,     0,     0,     0,     0,     0,     0,     0, \
+  } \
+}
+
+// K1400P7: 1400 kv, 7 pole-pairs @ 12.5 v, load 0.8 above 1% to 60%
+#define MPARAM_PROFILE_K1400P7 \
+{ \
+  "K1400P7", 1400, \
+  { 150, 204, 143, 28571, 8466, 350 }, \
+  { 17500, 9070, 102, 30, 7, 26, 4 }, \
+  { \
+    28571, 28571, 15549,  9747,  7098,  5582,  4599,  3911, \
+     3401,  3009,  2699,  2446,  2237,  2060,  1910,  1779, \
+     1666,  1566,  1478,  1398,     0,     0,     0,     0, \
+        0,     0,     0,     0,     0,     0,     0,     0, \
+  } \
+}
+
+#endif // MPARAM_TBL_H
@@ -16,6 +16,7 @@
 #define PDU_MANAGER_H
 
 /* Includes ------------------------------------------------------------------*/
+#include "system.h"
 
 /* Private defines -----------------------------------------------------------*/
 
@@ -25,6 +26,51 @@
  * defines
  */
 
+/*
+ * Frames (see pdu_manager.c):
+ *   point-to-point: SOF, size, command, data[size], checksum
+ *   addressed:      SOF_NODE, node, size, command, data[size], checksum
+ * The checksum is the 8-bit sum of the bytes following the SOF. An addressed
+ * frame is handled by the node of the address or by all nodes if broadcast,
+ * so that several controllers share a single half-duplex line (multi-ESC
+ * bus). The node address is stored in the data EEPROM; a node having received
+ * an addressed frame mutes its terminal output.
+ */
+#define PDU_NODE_BROADCAST  0xFF
+#define PDU_NODE_DFLT       0     // node address of a unit not yet configured
+
+// number of throttle slots of PDU_CMD_THROTTLE_ALL, the nodes 0 : N-1
+#define PDU_BUS_N_NODES     4
+
+// commands
+#define PDU_CMD_SET_SPEED   0x01  // data: speed, PWM duty-cycle counts (MSB first)
+                                  // i.e. fraction of BL_GOV_RPM_FS w/ governor
+#define PDU_CMD_SET_MODE    0x02  // data: mode
+#define PDU_CMD_TELEM_RATE  0x03  // data: telemetry rate divider (0 is off)
+#define PDU_CMD_FAULT_LOG   0x04  // data: fault log operation
+#define PDU_CMD_THROTTLE_ALL 0x05 // data: speed[PDU_BUS_N_NODES] (MSB first), reply node
+                                  // (broadcast, the reply node sends a telemetry frame)
+#define PDU_CMD_SET_NODE    0x06  // data: node address, saved to EEPROM (not broadcast)
+#define PDU_CMD_MOTOR_SEL   0x07  // data: motor profile index, saved to EEPROM (stopped only)
+#define PDU_CMD_MOTOR_LOAD  0x08  // data: offset, profile[PDU_MOTOR_LOAD_LEN] (mparam_t image)
+#define PDU_CMD_MOTOR_SAVE  0x09  // data: EEPROM slot of the loaded profile
+
+// bytes of the motor profile in each PDU_CMD_MOTOR_LOAD
+#define PDU_MOTOR_LOAD_LEN  8
+
+// modes of PDU_CMD_SET_MODE
+#define PDU_MODE_STOP    0
+#define PDU_MODE_AUTO    1
+#define PDU_MODE_MANUAL  2
+#define PDU_MODE_GOV_ON  3  // speed governor, the speed is the target RPM
+#define PDU_MODE_GOV_OFF 4
+#define PDU_MODE_BRAKE_OFF   5  // brake modes (BL_brake_mode_t)
+#define PDU_MODE_BRAKE_REGEN 6
+#define PDU_MODE_BRAKE_FULL  7  // regenerative, then short brake at stop
+
+// operations of PDU_CMD_FAULT_LOG
+#define PDU_FLOG_DUMP    0  // send the log as telemetry frames
+#define PDU_FLOG_CLEAR   1
 
 /*
  * types
@@ -40,7 +86,13 @@
  * prototypes
  */
  
+ void Pdu_Manager_Init(void);
+
  void Pdu_Manager_Handle_Rx(void);
 
+ bool Pdu_Manager_Get_Key(char *key);
+
+ uint8_t Pdu_get_node(void);
+
 
 #endif // PDU_MANAGER_H
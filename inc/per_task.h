@@ -18,12 +18,12 @@
 
 /* Public function prototypes -----------------------------------------------*/
 
-void Periodic_Task_Wake(void);
-
 uint8_t Task_Ready(void);
 
 void UI_Stop(void);
 
+void UI_set_speed(uint16_t speed);
+
 void Print_banner(void);
 
 #endif // PER_TASK_H
@@ -0,0 +1,79 @@
+/**
+  ******************************************************************************
+  * @file profile.h
+  * @brief Execution time profiling of ISRs and background task
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* Public types -------------------------------------------------------------*/
+
+/**
+ * @brief Profiled execution contexts.
+ */
+typedef enum
+{
+  PROF_COMM_ISR = 0, /**< commutation timer ISR (Driver_Step) */
+  PROF_COMM_LAT,     /**< latency of the commutation ISR from the timer update event */
+  PROF_PWM_ISR,      /**< PWM timer update ISR (Sched_tick) - includes time preempted by ISRs */
+  PROF_ADC_ISR,      /**< ADC end of conversion ISR */
+  PROF_CTRL_TASK,    /**< control task (Driver_Update) - includes time preempted by ISRs */
+  PROF_PER_TASK,     /**< Periodic_task() - includes time preempted by ISRs */
+  PROF_N_ITEMS
+}
+prof_item_t;
+
+/**
+ * @brief Execution time statistics of one item in microseconds.
+ */
+typedef struct
+{
+  uint16_t t_min;     /**< minimum elapsed time */
+  uint16_t t_max;     /**< maximum elapsed time */
+  uint32_t t_sum;     /**< sum of elapsed time for computing the average */
+  uint16_t count;     /**< number of samples in t_sum */
+  uint16_t overruns;  /**< number of times elapsed time exceeded the budget */
+}
+prof_stats_t;
+
+/* Public defines -----------------------------------------------------------*/
+/*
+ * Instrumentation macros compile out entirely when profiling is not enabled.
+ * Only use PROF_BEGIN/PROF_END with interrupts masked (i.e. in ISR context, or
+ * inside a critical section).
+ */
+#if defined( PROFILE_ENABLED )
+  #define PROF_BEGIN( _ID_ )   Prof_begin( _ID_ )
+  #define PROF_END( _ID_ )     Prof_end( _ID_ )
+#else
+  #define PROF_BEGIN( _ID_ )
+  #define PROF_END( _ID_ )
+#endif
+
+/* Public function prototypes -----------------------------------------------*/
+#if defined( PROFILE_ENABLED )
+
+void Prof_begin(prof_item_t item);
+
+void Prof_end(prof_item_t item);
+
+void Prof_sample(prof_item_t item, uint16_t dt);
+
+void Prof_timer_ovf(void);
+
+void Prof_get_stats(prof_item_t item, prof_stats_t *p_stats);
+
+uint16_t Prof_get_budget(prof_item_t item);
+
+void Prof_reset(void);
+
+#endif // PROFILE_ENABLED
+
+#endif // PROFILE_H
@@ -19,13 +19,58 @@
 /* Public defines -----------------------------------------------------------*/
 
 /*
+ * PWM timer prescaler and period of the selected profile (PWM_PROFILE)
+ *
  *  1/16 Mhz = 0.0000000625 sec
  *  1/16 Mhz * 1024 = 0.000064 sec
  * w/ PS=2
  *  0.000064 sec * PS = 0.000128
  * 1 / 0.000128 = 7812.5 i.e 7.8 kHz
  */
-#define PWM_PERIOD_COUNTS  1024
+#if ( PWM_PROFILE == PWM_PROFILE_8K )
+  #define PWM_TIMER_PSC      2
+  #define PWM_PERIOD_COUNTS  1024
+#elif ( PWM_PROFILE == PWM_PROFILE_8K_HR )
+  #define PWM_TIMER_PSC      1
+  #define PWM_PERIOD_COUNTS  2048
+#elif ( PWM_PROFILE == PWM_PROFILE_16K )
+  #define PWM_TIMER_PSC      1
+  #define PWM_PERIOD_COUNTS  1024
+#elif ( PWM_PROFILE == PWM_PROFILE_24K )
+  #define PWM_TIMER_PSC      1
+  #define PWM_PERIOD_COUNTS  667
+#elif ( PWM_PROFILE == PWM_PROFILE_32K )
+  #define PWM_TIMER_PSC      1
+  #define PWM_PERIOD_COUNTS  512
+#else
+  #error "PWM_PROFILE not supported"
+#endif
+
+/*
+ * PWM period in fMASTER cycles (i.e. 1/16 Mhz), relates the PWM rate to the
+ * task timing and to the commutation timer (fMASTER / 2).
+ */
+#define PWM_PERIOD_FMASTER  ( (uint16_t)PWM_PERIOD_COUNTS * PWM_TIMER_PSC )
+
+/*
+ * Number of PWM ISRs per frame, keeps the frame at ~0.5 ms so that the task
+ * rate groups (sched.h) are the same with any profile e.g. the control task
+ * (alternate frames) runs at ~1 kHz:
+ *   8192 * 1/16 Mhz = 0.000512 sec
+ * The count is rounded to the nearest. The period of the 24 kHz profile (667)
+ * is not a divisor of 8192, its frame is 12 cycles i.e. 0.500 ms, so that the
+ * task rates and the timings in control frames are ~2% faster.
+ */
+#define PWM_FRAME_COUNT  ( ( 8192u + PWM_PERIOD_FMASTER / 2 ) / PWM_PERIOD_FMASTER )
+
+/*
+ * ADC trigger point (ADC_HW_TRIGGER) in PWM timer counts from the start of the
+ * PWM on-time. Delays the sample to allow the phase voltage to settle following
+ * the switching edge - the conversion would be started at about 2 us into the
+ * PWM pulse: 32 * 1/16 Mhz = 0.000002 sec. Must be less than the minimum
+ * PWM duty-cycle (PWM_PD_SHUTOFF).
+ */
+#define PWM_ADC_TRIG_OFFSET  ( 32 / PWM_TIMER_PSC )
 
 /**
  * @brief Compute PWM timer counts from percent duty-cycle
@@ -90,6 +135,32 @@
 #define TCC_FULL_STIK      TCC_TIME_MAX_THRUST
 #define TCC_THRTTLE_RANGE  (TCC_FULL_STIK - TCC_LOW_STIK)
 
+/*
+ * Fast throttle protocols are detected at the servo input:
+ *
+ *  DShot150/300 by the period of the pulses, a DShot bit (6.7 us / 3.3 us) is
+ *  far shorter than the pulse period of any analog protocol.
+ *  Multishot (5:25 us) and OneShot125 (125:250 us) by the pulse width.
+ *
+ * Once detected, the capture timer is switched to prescaler 1 i.e.
+ * 1/16Mhz = 0.0625 uS/tick. The OneShot125 pulse is 1/8 of the servo pulse so
+ * its count at 0.0625 uS/tick equals the count of the servo pulse at 0.5 uS/tick.
+ * The Multishot pulse is converted to the equivalent servo pulse count:
+ *
+ *   servo = 1000 us + (multishot - 5 us) * 50  =>  (counts - 80) * 25 / 4 + 2000
+ */
+#define TCC_TIME_DSHOT_DETECT      (uint16_t)(20.0 * (1.0 / TCC_TICK_TIME_MSEC))
+#define TCC_TIME_MULTISHOT_DETECT  (uint16_t)(40.0 * (1.0 / TCC_TICK_TIME_MSEC))
+#define TCC_TIME_ONESHOT_DETECT    (uint16_t)(500.0 * (1.0 / TCC_TICK_TIME_MSEC))
+
+#define TCC_FAST_TICKS_PER_US  16
+
+#define TCC_MULTISHOT_MIN  (uint16_t)(5 * TCC_FAST_TICKS_PER_US)
+#define TCC_MULTISHOT_MAX  (uint16_t)(25 * TCC_FAST_TICKS_PER_US)
+
+#define TCC_MULTISHOT_TO_SERVO( _CT_ ) \
+  (uint16_t)( ( ( ( _CT_ ) - TCC_MULTISHOT_MIN ) * 25u ) / 4u + TCC_TIME_DETECT )
+
 
 
 
@@ -141,6 +212,39 @@
   #define SDb_PWM_PORT  GPIOD
   #define SDc_PWM_PORT  GPIOA
 
+#elif defined( S105_DEV ) && defined( PWM_COMPLEMENTARY )
+/**
+ * Complementary drive: TIM1 CH1:CH3 to the high-side inputs (HIN) and CH1N:CH3N
+ * (alternate function remap AFR5) to the low-side inputs (LIN) of the gate
+ * driver. The IR2104 generates LO from its IN pin internally, so this mode is
+ * for a driver having separate HIN/LIN, where the low-side FET would otherwise
+ * be off during the PWM off-time and the body diode conducts. Note that the
+ * CHxN pins are shared with the default back-EMF inputs (AIN0:AIN2).
+ */
+  #define SDa_PWM_PIN  GPIO_PIN_1 // C1
+  #define SDb_PWM_PIN  GPIO_PIN_2 // C2
+  #define SDc_PWM_PIN  GPIO_PIN_3 // C3
+
+  #define SDa_PWM_PORT  GPIOC
+  #define SDb_PWM_PORT  GPIOC
+  #define SDc_PWM_PORT  GPIOC
+
+  #define SDa_PWMN_PIN  GPIO_PIN_0 // B0
+  #define SDb_PWMN_PIN  GPIO_PIN_1 // B1
+  #define SDc_PWMN_PIN  GPIO_PIN_2 // B2
+
+  #define SDa_PWMN_PORT  GPIOB
+  #define SDb_PWMN_PORT  GPIOB
+  #define SDc_PWMN_PORT  GPIOB
+
+/*
+ * Dead-time inserted by TIM1 at each switching edge of the complementary
+ * outputs, in units of tDTS = 1/16 Mhz (DTG[7] = 0 i.e. up to 127 counts):
+ *   8 * 1/16 Mhz = 0.0000005 sec
+ */
+  #define PWM_DEAD_TIME_NS   500
+  #define PWM_DEAD_TIME_DTG  (uint8_t)( ( PWM_DEAD_TIME_NS * 16UL ) / 1000 )
+
 #elif defined( S105_DEV )
 /**
  * TIM2 not available, uses TIM1
@@ -154,6 +258,15 @@
   #define SDc_PWM_PORT  GPIOC
 #endif
 
+#if defined( PWM_COMPLEMENTARY ) && \
+    !( defined( S105_DEV ) && defined( SEQ_REG_TABLE ) )
+  #error "PWM_COMPLEMENTARY requires TIM1 PWM (S105_DEV) and SEQ_REG_TABLE"
+#endif
+
+#if defined( CURRENT_BKIN_ENABLED ) && !defined( S105_DEV )
+  #error "CURRENT_BKIN_ENABLED requires TIM1 PWM (S105_DEV)"
+#endif
+
 // PD4 set LO
 #define PWM_PhA_OUTP_LO( )                              \
     SDc_PWM_PORT->ODR &= (uint8_t) ( ~SDa_PWM_PIN );    \
@@ -212,6 +325,10 @@ typedef  TIM2_Channel_TypeDef PWM_Channel_Typedef ;
 
 void All_phase_stop(void);
 
+void PWM_brake_short(void);
+
+void PWM_align_drive(void);
+
 void PWM_PhA_Disable(void);
 void PWM_PhB_Disable(void);
 void PWM_PhC_Disable(void);
@@ -220,9 +337,22 @@ void PWM_PhA_Enable(void);
 void PWM_PhB_Enable(void);
 void PWM_PhC_Enable(void);
 
+#if defined( SEQ_REG_TABLE )
+void PWM_set_sector(uint8_t sector);
+#endif
+
 void PWM_set_dutycycle(uint16_t global_dutycycle);
 uint16_t PWM_get_dutycycle(void);
 
+uint16_t PWM_get_pulse(void);
+void PWM_set_pulse_limit(uint16_t limit);
+uint16_t PWM_get_pulse_limit(void);
+
+#if defined( CURRENT_BKIN_ENABLED )
+bool PWM_get_break(void);
+void PWM_clear_break(void);
+#endif
+
 void PWM_setup(void);
 
 uint16_t PWM_get_motor_spd_pcnt(uint16_t pulse_period_counts, uint16_t pulse_duration_counts);
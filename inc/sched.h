@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file sched.h
+  * @brief Rate group scheduler
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef SCHED_H
+#define SCHED_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "pwm_stm8s.h"
+
+/* Public defines -----------------------------------------------------------*/
+/*
+ * The scheduler tick is the PWM timer update ISR, which is also the sampling
+ * rate (ADC scan of the phase inputs) e.g. 7.8 kHz with the default PWM
+ * profile. The rate dividers are in PWM ISRs, scaled by PWM_FRAME_COUNT so
+ * that the task rates are the same with any PWM profile.
+ */
+#define SCHED_DIV_CONTROL  ( 2u * PWM_FRAME_COUNT )  // ~1 kHz (1.024 ms)
+#define SCHED_DIV_UI       ( 32u * PWM_FRAME_COUNT ) // ~60 Hz (16.4 ms)
+
+/*
+ * Window of the CPU load measurement, PWM ISRs i.e. the UI rate (~16.4 ms)
+ */
+#define SCHED_LOAD_WINDOW  SCHED_DIV_UI
+
+/* Public types -------------------------------------------------------------*/
+
+/**
+ * @brief Rate groups in order of priority, highest first.
+ */
+typedef enum
+{
+  SCHED_RG_CONTROL = 0, /**< BL control task, deferred from the PWM ISR */
+  SCHED_RG_UI,          /**< Periodic task, polled by the background task */
+  SCHED_N_GROUPS
+}
+sched_group_t;
+
+/* Public function prototypes -----------------------------------------------*/
+
+void Sched_tick(void);
+
+void Sched_dispatch(void);
+
+bool Sched_bg_ready(sched_group_t group);
+
+uint16_t Sched_get_overruns(sched_group_t group);
+
+void Sched_wake(void);
+
+void Sched_idle(void);
+
+uint8_t Sched_get_cpu_load(void);
+
+#endif // SCHED_H
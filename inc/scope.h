@@ -0,0 +1,109 @@
+/**
+  ******************************************************************************
+  * @file scope.h
+  * @brief Triggered capture of the raw back-EMF samples
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef SCOPE_H
+#define SCOPE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "bldc_sm.h"
+
+/* Public defines -----------------------------------------------------------*/
+/*
+ * Number of samples of the capture buffer (6 bytes each) i.e. one each PWM
+ * cycle, 64 samples span ~8 ms at 7.8 kHz PWM, ~1.6 electrical cycles at
+ * 2000 RPM (6 pole-pairs).
+ */
+#if !defined( SCOPE_N_SAMPLES )
+  #define SCOPE_N_SAMPLES  64u
+#endif
+
+// default pre-trigger depth, samples
+#define SCOPE_PRE_DFLT  (uint8_t)( SCOPE_N_SAMPLES / 4 )
+
+/*
+ * Default timing error threshold of SCOPE_TRIG_TERROR, commutation timer
+ * counts i.e. half of the error limit of the closed-loop controller.
+ */
+#define SCOPE_TERR_THR_DFLT  (uint16_t)( BL_ERROR_LIMIT / 2 )
+
+/*
+ * Dump line of a sample (see Scope_get()), ADC counts of phase A, B, C and
+ * the sector, in hex:
+ *   "S a b c sector" e.g. "S 1A0 099 386 3"
+ */
+#define SCOPE_DUMP_KEY  'S'
+
+// length of a dump line incl. CR/LF
+#define SCOPE_LINE_LEN  17
+
+/* Public types -------------------------------------------------------------*/
+
+/**
+ * @brief Trigger sources
+ */
+typedef enum
+{
+  SCOPE_TRIG_OFF = 0,  /**< capture stopped */
+  SCOPE_TRIG_CLS_LOOP, /**< entry to closed-loop (BL_CLS_LOOP) */
+  SCOPE_TRIG_TERROR,   /**< closed-loop timing error beyond the threshold */
+  SCOPE_TRIG_FAULT,    /**< fault set (Faultm_set()) */
+  SCOPE_TRIG_NOW,      /**< immediately i.e. once the pre-trigger is filled */
+  SCOPE_N_TRIGS
+}
+scope_trig_t;
+
+/**
+ * @brief Capture configuration
+ */
+typedef struct
+{
+  uint8_t trig;     /**< trigger source, scope_trig_t */
+  uint8_t pre;      /**< pre-trigger depth, samples (< SCOPE_N_SAMPLES) */
+  uint16_t terr_thr; /**< |timing error| threshold of SCOPE_TRIG_TERROR */
+}
+scope_cfg_t;
+
+/**
+ * @brief Captured sample
+ */
+typedef struct
+{
+  uint16_t ph[ 3 ]; /**< ADC counts of phase A, B, C, the sector in the upper bits of A */
+}
+scope_sample_t;
+
+// sector of the captured sample
+#define SCOPE_SAMPLE_SECTOR( _S_ )  (uint8_t)( (_S_).ph[ 0 ] >> 12 )
+#define SCOPE_SAMPLE_ADC( _S_, _PH_ )  (uint16_t)( (_S_).ph[ _PH_ ] & 0x03FFu )
+
+/* Public function prototypes -----------------------------------------------*/
+#if defined( SCOPE_ENABLED )
+
+void Scope_arm(const scope_cfg_t *p_cfg);
+
+void Scope_get_cfg(scope_cfg_t *p_cfg);
+
+void Scope_stop(void);
+
+void Scope_sample(uint8_t sector);
+
+void Scope_trigger(scope_trig_t source);
+
+void Scope_timing_error(int16_t error);
+
+bool Scope_is_done(void);
+
+uint8_t Scope_get_trigger_index(void);
+
+bool Scope_get(uint8_t index, scope_sample_t *p_sample);
+
+#endif // SCOPE_ENABLED
+
+#endif // SCOPE_H
@@ -20,21 +20,73 @@
 
 /* types -----------------------------------------------------------------*/
 
+/**
+ * @brief Enum typedef for setting the 6-step sequence pointer
+ */
+typedef enum
+{
+  SECTOR_0 = 0,
+  SECTOR_1,
+  SECTOR_2,
+  SECTOR_3,
+  SECTOR_4,
+  SECTOR_5,
+  SECTOR_INVALID = -1
+}
+Seq_sector_t;
+
 /* declarations ---------------------------------------------------------*/
 
 /* macros ---------------------------------------------------------------*/
 
 #define SEQ_N_CSTEPS    6
 
+#define SEQ_N_PHASES    3
+
+/**
+ * @brief Commutation delay following the back-EMF zero-crossing
+ * @details Electrical degrees from the detected zero-crossing of the floating
+ *   phase to the next commutation switching step. The ideal value is 30
+ *   degrees i.e. the zero-crossing is expected at the middle of the sector.
+ *   Smaller values give the motor timing advance.
+ */
+#define SEQ_ZC_DELAY_DEG    30
+
+/**
+ * @brief Default blanking window following the commutation switching
+ * @details Fraction of the sector period (8-bit fraction) in which the
+ *   back-EMF samples are discarded for the demagnetization of the winding
+ *   (see Seq_set_blanking()).
+ */
+#define SEQ_BLANK_Q8        32
+
 
 /* prototypes -----------------------------------------------------------*/
 
 uint16_t Seq_Get_bemfR(void);
 uint16_t Seq_Get_bemfF(void);
+uint16_t Seq_Get_bemfR_Ph(uint8_t phase);
+uint16_t Seq_Get_bemfF_Ph(uint8_t phase);
 
 uint16_t Seq_Get_Vbatt(void);
+#if defined( TRACE_ENABLED )
+void Seq_set_vbatt_filt(uint16_t filt);
+#endif
 int16_t Seq_get_timing_error(void);
 bool Seq_get_timing_error_p(void);
+uint16_t Seq_get_zc_interval(void);
+uint16_t Seq_get_sector_period(void);
+uint8_t Seq_get_sector(void);
+void Seq_set_timing_advance(uint8_t advance_deg);
+void Seq_set_blanking(uint8_t blank_q8);
+void Seq_set_zc_commutation(bool enable);
+
+void Seq_coast_start(void);
+bool Seq_get_coast_bemf(void);
+uint16_t Seq_get_coast_period(void);
+uint8_t Seq_get_coast_sector(uint16_t *p_elapsed);
+
+void Seq_Bemf_Sample(void);
 
 void Sequence_Step(uint8_t step);
 
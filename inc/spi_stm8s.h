@@ -12,16 +12,33 @@
 
 /* Includes ------------------------------------------------------------------*/
 
+#include "bldc_sm.h" // BL_status_t
 
 /* Defines -------------------------------------------------------------------*/
 
-
 /*
- *  timer1 free running, time between periodic task is 0x2080
+ * The host and the ESC exchange a fixed size frame (full-duplex), which starts
+ * with SOF and ends with the checksum (sum of the bytes following SOF).
+ *
+ *  host -> ESC:  SOF, throttle (PWM duty-cycle counts, MSB first), 0 ...
+ *  ESC -> host:  SOF, opstate, Vsys, speed, commutation period (MSB first)
  */
-#define TIME_OUT_0 0x1000
+#define SPI_SOF         0xA5
+#define SPI_FRAME_SZ    9
+
+#define SPI_SOF_IDX     0
+#define SPI_FCS         (SPI_FRAME_SZ - 1)
+
+#define SPI_RX_THR_H    1
+#define SPI_RX_THR_L    2
 
-#define RX_BUF_SZ 16
+#define SPI_TX_STATE    1
+#define SPI_TX_VSYS_H   2
+#define SPI_TX_VSYS_L   3
+#define SPI_TX_SPEED_H  4
+#define SPI_TX_SPEED_L  5
+#define SPI_TX_PERD_H   6
+#define SPI_TX_PERD_L   7
 
 
 /* Declarations --------------------------------------------------------------*/
@@ -29,5 +46,11 @@
 /* Function prototypes -------------------------------------------------------*/
 void SPI_controld(void);
 
+void SPI_set_status(const BL_status_t *p_status);
+
+bool SPI_get_throttle(uint16_t *p_throttle);
+
+void SPI_on_transfer(void);
+
 
 #endif
@@ -31,6 +31,13 @@
 #define SPI_STM8_MASTER         1
 #define SPI_STM8_SLAVE          2
 
+// List of supported PWM frequency/resolution profiles (see pwm_stm8s.h)
+#define PWM_PROFILE_8K          0 //  7.8 kHz, 1024 counts
+#define PWM_PROFILE_8K_HR       1 //  7.8 kHz, 2048 counts
+#define PWM_PROFILE_16K         2 // 15.6 kHz, 1024 counts
+#define PWM_PROFILE_24K         3 // 24.0 kHz,  667 counts
+#define PWM_PROFILE_32K         4 // 31.3 kHz,  512 counts
+
 
 #if defined ( __SDCC )
 //  #define  S105_DEV 1 // TODO: needs improved and coordiated w/ makefile
@@ -51,6 +58,21 @@
   #define PH0_BEMF_IN_PORT   GPIOB
   #define PH0_BEMF_IN_PIN    GPIO_PIN_0
   #define PH0_BEMF_IN_CH     ADC1_CHANNEL_0
+// AIN1, B1
+  #define PH1_BEMF_IN_PORT   GPIOB
+  #define PH1_BEMF_IN_PIN    GPIO_PIN_1
+  #define PH1_BEMF_IN_CH     ADC1_CHANNEL_1
+// AIN2, B2
+  #define PH2_BEMF_IN_PORT   GPIOB
+  #define PH2_BEMF_IN_PIN    GPIO_PIN_2
+  #define PH2_BEMF_IN_CH     ADC1_CHANNEL_2
+
+  #define ZC_CLOSED_LOOP_ENABLED  // closed-loop from the back-EMF of each phase
+
+// AIN3, B3: low-side shunt current amplifier
+  #define ISHUNT_IN_PORT     GPIOB
+  #define ISHUNT_IN_PIN      GPIO_PIN_3
+  #define ISHUNT_IN_CH       ADC1_CHANNEL_3
 
   #define LED_GPIO_PORT      GPIOE
   #define LED_GPIO_PIN       GPIO_PIN_5
@@ -63,17 +85,56 @@
 
   #define UNDERVOLTAGE_FAULT_ENABLED
 
+  #define CURRENT_SENSE_ENABLED   // cycle-by-cycle current limit (current.c)
+  #define TRACE_ENABLED           // event trace recorder (trace.c)
+  #define SCOPE_ENABLED           // back-EMF scope capture (scope.c)
+  #define UART_IT_RXNE_ENABLE     // PDU receiver on the UART RX interrupt (pdu_manager.c)
+
+// TIM1 BKIN (E3) driven by an over-current comparator (active low) disables
+// the PWM outputs in hardware, as a backstop to the current limit
+//  #define CURRENT_BKIN_ENABLED
+
+// ADC conversion is started by TIM1 TRGO (TIM1 is the PWM timer on this board)
+  #define ADC_HW_TRIGGER
+
+  #define SEQ_REG_TABLE      // commutation by precomputed register table
+
+// UART TX open-drain for the shared line of the multi-ESC bus, with the PDU
+// receiver (UART_IT_RXNE_ENABLE) and a pull-up on the line (see pdu_manager.h)
+//  #define PDU_BUS_OPEN_DRAIN
+
+// complementary PWM w/ dead-time on TIM1 CHx/CHxN, for a gate driver having
+// separate HIN/LIN inputs (requires SEQ_REG_TABLE, see pwm_stm8s.h)
+//  #define PWM_COMPLEMENTARY
+
 #elif defined ( S105_DISCOVERY )
 /*
  * S105 Discovery board can't use TIM1 for PWM (unless solder bridges connecting the
  * touch sensor are removed). Therefore, TIM2 drives PWM/controller, and TIM3 to
  * drive the commutation step, leaving TIM1 unnused (TIM1 input capture/compare 
  * might be used capture servo signal from R/C radio or flight controller).
+ * The ADC external trigger is only available from TIM1 TRGO, so the ADC is
+ * started in software from the TIM2 update ISR.
  */
 // AIN0, B0
   #define PH0_BEMF_IN_PORT   GPIOB
   #define PH0_BEMF_IN_PIN    GPIO_PIN_0
   #define PH0_BEMF_IN_CH     ADC1_CHANNEL_0
+// AIN1, B1
+  #define PH1_BEMF_IN_PORT   GPIOB
+  #define PH1_BEMF_IN_PIN    GPIO_PIN_1
+  #define PH1_BEMF_IN_CH     ADC1_CHANNEL_1
+// AIN2, B2
+  #define PH2_BEMF_IN_PORT   GPIOB
+  #define PH2_BEMF_IN_PIN    GPIO_PIN_2
+  #define PH2_BEMF_IN_CH     ADC1_CHANNEL_2
+
+  #define ZC_CLOSED_LOOP_ENABLED  // closed-loop from the back-EMF of each phase
+
+// AIN3, B3: low-side shunt current amplifier
+  #define ISHUNT_IN_PORT     GPIOB
+  #define ISHUNT_IN_PIN      GPIO_PIN_3
+  #define ISHUNT_IN_CH       ADC1_CHANNEL_3
 
   #define LED_GPIO_PORT      GPIOD
   #define LED_GPIO_PIN       GPIO_PIN_0
@@ -86,6 +147,13 @@
 
   #define UNDERVOLTAGE_FAULT_ENABLED
 
+  #define CURRENT_SENSE_ENABLED   // cycle-by-cycle current limit (current.c)
+  #define TRACE_ENABLED           // event trace recorder (trace.c)
+  #define SCOPE_ENABLED           // back-EMF scope capture (scope.c)
+  #define UART_IT_RXNE_ENABLE     // PDU receiver on the UART RX interrupt (pdu_manager.c)
+
+//  #define SEQ_REG_TABLE    // commutation by precomputed register table
+
 #elif defined ( S003_DEV )
 /*
  * s003 does not have TIM3. TIM2 drives PWM/control, TIM1 drives commutation step.
@@ -95,6 +163,12 @@
   #define PH0_BEMF_IN_PORT   GPIOD
   #define PH0_BEMF_IN_PIN    GPIO_PIN_2
   #define PH0_BEMF_IN_CH     ADC1_CHANNEL_3
+/*
+ * No analog inputs left for the back-EMF of phase B and C (D3 is PWM, D5/D6
+ * are UART), so ZC_CLOSED_LOOP_ENABLED is not defined: the start is from the
+ * alignment and the drive remains open-loop, the commutation period is
+ * the open-loop timing (Get_OL_Timing) of the duty-cycle.
+ */
 
   #define LED_GPIO_PORT      GPIOB
   #define LED_GPIO_PIN       GPIO_PIN_5
@@ -108,18 +182,39 @@
 //  #define SPI_ENABLED     // can't fit SPI in 8k
 
 //  #define UNDERVOLTAGE_FAULT_ENABLED
+
+//  #define UART_IT_RXNE_ENABLE // can't fit the PDU manager in 8k
+
+  #define SEQ_REG_TABLE      // commutation by precomputed register table
 #endif
 
 #ifndef SPI_ENABLED
 #define SPI_ENABLED SPI_NONE
 #endif
 
-#define SPI_RX_BUF_SZ  16 // 256 // tmp
+/*
+ * PWM frequency and duty-cycle resolution. Low-inductance motors need higher
+ * PWM frequency to reduce the current ripple, larger motors benefit from the
+ * finer duty-cycle step.
+ */
+#ifndef PWM_PROFILE
+#define PWM_PROFILE  PWM_PROFILE_8K
+#endif
+
+/*
+ * Execution time profiling of ISRs and the background task (TIM4 time base).
+ * Opt-in for development builds, define it here or on the compiler command line
+ * (e.g. -DPROFILE_ENABLED), otherwise the instrumentation compiles out
+ * completely.
+ */
+//#define PROFILE_ENABLED
 
 
 /**
  * @brief Scale factor in commutation-timing related constants
+ * @details The commutation timer update is one sector, the timing tables and
+ *   constants originated from a timer period of 1/4 sector.
  */
-#define CTIME_SCALAR 1
+#define CTIME_SCALAR 4
 
 #endif // SYSTEM_H
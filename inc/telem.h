@@ -0,0 +1,97 @@
+/**
+  ******************************************************************************
+  * @file telem.h
+  * @brief Binary telemetry stream
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef TELEM_H
+#define TELEM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* Public defines -----------------------------------------------------------*/
+/*
+ * Telemetry frame layout - byte offsets into the frame. 16-bit fields are
+ * sent MSB first (STM8 native byte order). Also used by the host decoder, so
+ * changes to the layout must bump TELEM_VERSION.
+ */
+#define TELEM_SYNC         0xA5
+#define TELEM_VERSION      5
+
+#define TELEM_OFS_SYNC     0  // sync byte
+#define TELEM_OFS_SEQ      1  // sequence counter, increments at each sample
+#define TELEM_OFS_OPSTATE  2  // BL_status_t.bL_opstate
+#define TELEM_OFS_FAULT    3  // fault status word
+#define TELEM_OFS_VSYS     4  // BL_status_t.bl_sys_voltage
+#define TELEM_OFS_SPEED    6  // BL_status_t.bl_motor_speed
+#define TELEM_OFS_PERIOD   8  // BL_status_t.bl_comm_period
+#define TELEM_OFS_DUTY     10 // PWM duty-cycle counts
+#define TELEM_OFS_TM_ERR   12 // commutation timing error (signed)
+#define TELEM_OFS_BEMF_R   14 // back-EMF rising (phase A)
+#define TELEM_OFS_BEMF_F   16 // back-EMF falling (phase A)
+#define TELEM_OFS_RPM      18 // BL_status_t.bl_motor_rpm
+#define TELEM_OFS_NODE     20 // node address on the multi-ESC bus (pdu_manager.h)
+#define TELEM_OFS_LOAD     21 // BL_status_t.bl_cpu_load
+#define TELEM_OFS_CRC      22 // CRC-8 of bytes [SYNC : CRC)
+#define TELEM_FRAME_SZ     23
+
+/*
+ * Fault log frame layout - one frame per entry of the fault event log
+ * (faultm.h), sent on request interleaved with the telemetry frames. An empty
+ * log is indicated by a single frame with entry count 0.
+ */
+#define TELEM_SYNC_FLOG       0x5A
+
+#define TELEM_FLOG_OFS_SYNC    0  // sync byte
+#define TELEM_FLOG_OFS_INDEX   1  // index of the entry, 0 is the oldest
+#define TELEM_FLOG_OFS_COUNT   2  // number of entries in the log
+#define TELEM_FLOG_OFS_EVENT   3  // fault ID, bit 7 set if cleared
+#define TELEM_FLOG_OFS_OPSTATE 4  // BL_status_t.bL_opstate
+#define TELEM_FLOG_OFS_TICK    5  // control task tick (~1 ms)
+#define TELEM_FLOG_OFS_DUTY    7  // PWM duty-cycle counts
+#define TELEM_FLOG_OFS_PERIOD  9  // commutation period
+#define TELEM_FLOG_OFS_VSYS    11 // system voltage
+#define TELEM_FLOG_OFS_CRC     13 // CRC-8 of bytes [SYNC : CRC)
+#define TELEM_FLOG_FRAME_SZ    14
+
+/**
+ * @brief CRC-8 polynomial (x^8 + x^2 + x + 1), initial value 0
+ */
+#define TELEM_CRC_POLY     0x07
+
+/*
+ * Rate divider of the control task rate (~1 kHz), 0 is off. A frame uses
+ * 23 * 10 bits = 230 bits, so the full control rate needs 230400 baud, at
+ * 115200 baud the sample of a frame not fitting in the TX FIFO is dropped
+ * (detected by a gap in the sequence counter).
+ */
+#define TELEM_RATE_OFF     0
+#define TELEM_RATE_MAX_DIV 64
+
+
+/* Public function prototypes -----------------------------------------------*/
+#ifndef TELEM_HOST
+
+void Telem_Sample(void);
+
+void Telem_Task(void);
+
+void Telem_set_rate(uint8_t rate_div);
+
+uint8_t Telem_get_rate(void);
+
+uint16_t Telem_get_dropped(void);
+
+void Telem_dump_faults(void);
+
+void Telem_poll(void);
+
+void Telem_set_node(uint8_t node);
+
+#endif // TELEM_HOST
+
+#endif // TELEM_H
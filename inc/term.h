@@ -0,0 +1,33 @@
+/**
+  ******************************************************************************
+  * @file term.h
+  * @brief Minimal formatted output to the serial terminal
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef TERM_H
+#define TERM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* Public defines -----------------------------------------------------------*/
+
+// flag of the field width of Term_dec(): pad with '0' instead of ' '
+#define TERM_PAD_ZERO  0x80
+
+/* Public function prototypes -----------------------------------------------*/
+
+void Term_putc(char c);
+
+void Term_puts(const char *s);
+
+void Term_hex(uint16_t val, uint8_t digits);
+
+void Term_dec(uint16_t val, uint8_t width);
+
+void Term_set_mute(bool mute);
+
+#endif // TERM_H
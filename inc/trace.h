@@ -0,0 +1,129 @@
+/**
+  ******************************************************************************
+  * @file trace.h
+  * @brief Event trace recorder of the ISR paths
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* Public defines -----------------------------------------------------------*/
+/*
+ * Number of events of the trace buffer (4 bytes each), power of 2. The buffer
+ * holds the latest events leading up to the freeze, mostly samples as there is
+ * one each PWM cycle e.g. 128 events span ~14 ms at 7.8 kHz PWM, ~15 sectors
+ * at 2000 RPM (6 pole-pairs).
+ */
+#if !defined( TRACE_N_EVENTS )
+  #define TRACE_N_EVENTS  128u
+#endif
+
+/*
+ * Event tag: event type (trace_ev_t) in the upper nibble, parameter of the
+ * event in the lower nibble.
+ */
+#define TRACE_TAG( _TYPE_, _PARAM_ ) \
+  (uint8_t)( ((uint8_t)(_TYPE_) << 4) | ((uint8_t)(_PARAM_) & 0x0Fu) )
+
+#define TRACE_TAG_TYPE( _TAG_ )   (uint8_t)( (_TAG_) >> 4 )
+#define TRACE_TAG_PARAM( _TAG_ )  (uint8_t)( (_TAG_) & 0x0Fu )
+
+// parameter of TRACE_EV_FREEZE if frozen by the dump instead of a fault
+#define TRACE_FREEZE_DUMP  0x0Fu
+
+/*
+ * Dump line of an event (see Trace_get()), the fields in hex:
+ *   "T tag tick val" e.g. "T 12 A7 01C3"
+ */
+#define TRACE_DUMP_KEY  'T'
+
+/* Public types -------------------------------------------------------------*/
+
+/**
+ * @brief Event types
+ */
+typedef enum
+{
+  TRACE_EV_NONE = 0, /**< empty entry */
+  TRACE_EV_ADC,     /**< back-EMF sample, param: phase, val: ADC counts */
+  TRACE_EV_SECTOR,  /**< sequence step, param: sector, val: Vsys (zero-crossing reference) */
+  TRACE_EV_COMM,    /**< commutation ISR, param: opstate, val: PWM duty-cycle */
+  TRACE_EV_PERIOD,  /**< commutation timer period, val: timer counts */
+  TRACE_EV_OPSTATE, /**< opstate transition, param: new, val: previous */
+  TRACE_EV_CTRL,    /**< control task, param: opstate, val: speed command */
+  TRACE_EV_VBATT,   /**< supply voltage filter output changed, val: filter state */
+  TRACE_EV_PI,      /**< PI integrator at the step to sector 0, param: word (0 low, 1 high), val: word */
+  TRACE_EV_FREEZE   /**< last event, param: fault ID or TRACE_FREEZE_DUMP */
+}
+trace_ev_t;
+
+/**
+ * @brief Trace event
+ * @details The time stamp is the count of PWM cycles (ADC samples) modulo 256,
+ *  events of the same cycle are in the order of occurrence.
+ */
+typedef struct
+{
+  uint8_t tag;   /**< TRACE_TAG() */
+  uint8_t tick;  /**< time stamp, PWM cycles */
+  uint16_t val;  /**< value of the event */
+}
+trace_event_t;
+
+/* Public variables ----------------------------------------------------------*/
+#if defined( TRACE_ENABLED )
+
+extern trace_event_t Trace_buf[ TRACE_N_EVENTS ];
+extern uint16_t Trace_head;
+extern uint8_t Trace_tick;
+extern volatile bool Trace_frozen;
+
+#endif // TRACE_ENABLED
+
+/* Public macros ------------------------------------------------------------*/
+/*
+ * Recording is inline i.e. a test of the freeze flag and 4 stores, and
+ * compiles out when the trace is not enabled. Only use TRACE_EVENT with
+ * interrupts masked (i.e. in ISR context at the level of the commutation and
+ * ADC ISRs, or inside a critical section), see Trace_task_event().
+ * TRACE_TICK advances the time stamp, at each ADC sample.
+ */
+#if defined( TRACE_ENABLED )
+  #define TRACE_EVENT( _TYPE_, _PARAM_, _VAL_ ) \
+    if (FALSE == Trace_frozen) \
+    { \
+      trace_event_t *p_ev_ = &Trace_buf[ Trace_head ]; \
+      p_ev_->tag = TRACE_TAG( _TYPE_, _PARAM_ ); \
+      p_ev_->tick = Trace_tick; \
+      p_ev_->val = (uint16_t)(_VAL_); \
+      Trace_head = (uint16_t)( (Trace_head + 1u) & (TRACE_N_EVENTS - 1u) ); \
+    }
+
+  #define TRACE_TICK()  Trace_tick += 1
+#else
+  #define TRACE_EVENT( _TYPE_, _PARAM_, _VAL_ )
+  #define TRACE_TICK()
+#endif
+
+/* Public function prototypes -----------------------------------------------*/
+#if defined( TRACE_ENABLED )
+
+void Trace_arm(void);
+
+void Trace_freeze(uint8_t cause);
+
+bool Trace_is_frozen(void);
+
+void Trace_task_event(trace_ev_t type, uint8_t param, uint16_t val);
+
+bool Trace_get(uint16_t index, trace_event_t *p_event);
+
+#endif // TRACE_ENABLED
+
+#endif // TRACE_H
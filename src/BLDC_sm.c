@@ -18,31 +18,47 @@
 #include "pwm_stm8s.h" // motor phase control
 #include "faultm.h"
 #include "sequence.h"
+#include "current.h"
+#include "trace.h"
+#include "scope.h"
+#include "sched.h"
 
 /* Private defines -----------------------------------------------------------*/
+// commutation period limits of the closed-loop controller output
+#define BL_CT_CL_MIN      (256.0 * CTIME_SCALAR)
+#define BL_CT_CL_MAX      BL_CT_RAMP_START
+
 /*
- * Commutation timing is the duration of 120 (electrical) degrees.
- * Timing values at ramp end-points originated from a fixed
- * closed-loop timing table, hard-coded for 1100kv motor @ 12.v.
- * CTIME SCALAR is a vestige of rescaling the integer tables values which all
- * a common factor that being the system clock.
- * Convert to seconds by multiplying the system tick e.g.
- *   1866 * (1/16 Mhz) * 2 = ~230mS
+ * PI controller gains in Q8 fixed-point (256 == 1.0). The timing error and
+ * commutation period are both in counts, and the controller is invoked at
+ * each commutation step. Kp of ~0.1 is equivalent to the former proportional
+ * gain (error / 10). Defaults of the motor parameters (BL_set_motor).
  */
-// commutation period at start of ramp
-#define BL_CT_RAMP_START  (5632.0 * CTIME_SCALAR) // $1600
+#define PI_KP_Q8          26 // 0.1
+#define PI_KI_Q8          4  // 0.016
 
-// commutation period at end of ramp
-#define BL_CT_RAMP_END    (1760.0 * CTIME_SCALAR) // $06E0
+/*
+ * Limit of the integrator (anti-windup) in counts of commutation period. The
+ * measured sector period (or the open-loop timing table) provides the
+ * feed-forward so that the integrator only has to account for the remainder.
+ */
+#define PI_INTEG_LIMIT    (BL_CT_STARTUP / 2)
 
-// for some reason this little slowdown at ramp end aids in getting sync (experimental/TBD)
-#define BL_CT_STARTUP     (1866.0 * CTIME_SCALAR) // $074A
+/*
+ * In closed-loop the commutation is scheduled from the zero-crossing, the PI
+ * output is only the fall-back period of a sector without a crossing. Its trim
+ * of the measured sector period is limited to 0 .. 1/4 of the sector (15
+ * degrees): the fall-back must not cut short a sector having a late crossing.
+ */
+#define PI_TRIM_SHIFT     2
 
 /*
- * Error limit used in BL_cl_control -
- * needs to be small enough to be stable upon transition from to closed-loop
+ * Timing advance curve: the speed index of the advance table is the ratio of
+ * the startup commutation period of the motor (BL_motor_t) to the measured
+ * sector period, i.e. index 1 is the speed at the closed-loop transition, and
+ * the table is held at the last entry above the top of its range.
  */
-#define ERROR_LIMIT	50
+#define BL_ADV_N_SPEEDS   8
 
 /**
  * @brief Control rate scalar
@@ -54,11 +70,102 @@
 // The control-frame rate becomes factored into the integer ramp-step
 #define BL_ONE_RAMP_UNIT      (1.125 * CTRL_RATEM * CTIME_SCALAR)
 
-// length of alignment step (experimentally determined w/ 1100kv @12.5v)
-#define BL_TIME_ALIGN         (200u * 1) // N frames @ 1 ms / frame
+/*
+ * Alignment from rest: the rotor left swinging or coasting backwards (e.g. by
+ * the arming tones) is first stopped by the short brake, then the align
+ * duty-cycle is raised over the first half of the alignment. The floating
+ * phase of sector 0 is also switched to the low-side (PWM_align_drive) to damp
+ * the swing about the alignment, so that the ramp starts from a rotor at rest.
+ */
+#define BL_TIME_ALIGN_BRAKE   (100u) // N frames @ 1 ms / frame
+
+/*
+ * Constant acceleration ramp: the speed (1/period) increases by a fixed
+ * amount at each control frame i.e. 1/T[n+1] = 1/T[n] + 1/K, from which the
+ * ramp constant for N frames between the start and end periods Ts, Te is
+ *   K = N * Ts * Te / (Ts - Te)
+ */
+#define BL_RAMP_ACCEL_K( _TS_, _TE_, _N_ ) \
+  ( ( (uint32_t)( _TS_ ) * ( _TE_ ) / ( ( _TS_ ) - ( _TE_ ) ) ) * ( _N_ ) )
+
+/*
+ * Slew rate limits of the duty-cycle command, PWM counts per control frame
+ * (8-bit fraction) scaled to the PWM profile. The default rates slew the full
+ * range in 80 ms accelerating and 100 ms decelerating. Above 1/8 of the error
+ * limit the rate is reduced in proportion to the closed-loop timing error,
+ * down to the minimum rate (full range in ~1 s, ~0.1% duty-cycle / ms) at 1/2
+ * of the error limit, and outside of closed-loop sync.
+ */
+#define BL_SLEW_RATE_Q8( _MS_ )  (uint16_t)( ( PWM_PERIOD_COUNTS * 256UL ) / ( _MS_ ) )
+#define BL_SLEW_ACCEL_Q8      BL_SLEW_RATE_Q8( 80 )
+#define BL_SLEW_DECEL_Q8      BL_SLEW_RATE_Q8( 100 )
+#define BL_SLEW_MIN_Q8        BL_SLEW_RATE_Q8( 1024 )
+#define BL_SLEW_ERR_MIN       (uint16_t)( BL_ERROR_LIMIT / 8 ) // full rate below
+#define BL_SLEW_ERR_MAX       (uint16_t)( BL_ERROR_LIMIT / 2 ) // minimum rate above
+
+/*
+ * Brake (BL_set_brake): the regenerative brake slews the full range in 20 ms
+ * and is held while the supply voltage is more than ~1 V (at the nominal
+ * supply) above the voltage measured in arming. At the stop command the
+ * duty-cycle is braked down to the startup duty-cycle of the motor, the lowest
+ * at which closed-loop sync is held, and the phases are then shorted for
+ * BL_TIME_BRAKE_SHORT.
+ */
+#define BL_BRAKE_DECEL_Q8     BL_SLEW_RATE_Q8( 20 )
+#define BL_BRAKE_VOVS         (uint16_t)( BL_VSYS_NOMINAL / 12 )
+#define BL_TIME_BRAKE_SHORT   (500u) // N frames @ 1 ms / frame
+
+/*
+ * Flying restart: the speed of the coasting rotor must be detected within
+ * BL_TIME_COAST_DETECT (3 transitions of 120 degrees at the slowest speed the
+ * closed-loop can sync to), or BL_TIME_COAST_BEMF if there is no back-EMF at
+ * all, and the resync done within BL_TIME_RESYNC, or the motor is started
+ * from alignment. Resync is attempted after the closed-loop
+ * sync has been lost for BL_TIME_CL_SYNC_LOSS, and the fault is latched if
+ * the resync fails, or if the sync is lost again BL_RESYNC_TRIES times without
+ * having held sync for BL_TIME_RESYNC_HOLD in between. In the handoff to
+ * closed-loop, until the sync has first been held for BL_TIME_RESYNC_HOLD, the
+ * sync is lost at once if there is no zero-crossing in BL_CL_HANDOFF_MISS
+ * consecutive sectors (a stalled rotor is not driven for BL_TIME_CL_SYNC_LOSS).
+ * A rotor held in step by the open-loop drive but lagging it too far for the
+ * zero-crossing to be seen is restarted by the resync after BL_TIME_OL_SYNC.
+ */
+#define BL_TIME_RESYNC        (40u) // N frames @ 1 ms / frame
+#define BL_TIME_COAST_DETECT  (20u)
+#define BL_TIME_COAST_BEMF    (2u) // no back-EMF i.e. stopped
+#define BL_TIME_CL_SYNC_LOSS  (2000u)
+#define BL_TIME_RESYNC_HOLD   (500u)
+#define BL_TIME_CL_HANDOFF    (50u) // duty-cycle held at the ramp level
+#define BL_RESYNC_TRIES       3
+#define BL_CL_HANDOFF_MISS    12 // sectors i.e. 2 electrical revolutions
+#define BL_TIME_OL_SYNC       (500u) // N frames @ 1 ms / frame
+
+/*
+ * Supply voltage compensation: the supply voltage filtered by the sequencer at
+ * each PWM cycle (Seq_Get_Vbatt) scales the duty-cycle command by
+ * BL_VSYS_NOMINAL / Vsys. The scale is limited so that a collapsing supply
+ * can't drive the duty-cycle (and the current) up without bound.
+ */
+#define BL_VCOMP_MAX_Q8       384 // 1.5
+
+/*
+ * Mechanical speed from the commutation period: commutation timer counts
+ * (fMASTER / 2) per minute over 6 sectors per electrical cycle.
+ */
+#define BL_RPM_K( _PERIOD_, _POLE_PAIRS_ ) \
+  (uint16_t)( ( 60UL * 8000000UL / 6 ) / ( (uint32_t)( _PERIOD_ ) * ( _POLE_PAIRS_ ) ) )
 
-// sets the rate of change of the commanded motor speed
-#define BL_SPEED_RAMP_STEP    (PWM_PERIOD_COUNTS / 250)
+/*
+ * Speed governor: PI controller of the duty-cycle (Q16), the speed error in
+ * RPM. The proportional gain is a loop gain of 1/2 at the no-load speed per
+ * duty-cycle count, the integral time is of the order of the mechanical time
+ * constant of a propeller. The duty-cycle is held above the startup duty-cycle
+ * at which closed-loop is entered. The gains are scaled to the full-scale
+ * speed of the motor (BL_set_motor).
+ */
+#define BL_GOV_KP_Q16( _RPM_FS_ ) \
+  (uint16_t)( ( PWM_PERIOD_COUNTS * 65536UL / 2 ) / ( _RPM_FS_ ) )
+#define BL_GOV_TI       100 // N frames @ 1 ms / frame
 
 // timing scale is ~1ms per count
 #define BL_TIME_ARMING_HOLD   (800u) // 800 msec
@@ -67,20 +174,189 @@
 
 /* Private types -----------------------------------------------------------*/
 
+/**
+ * @brief Stage of the handoff from the coasting rotor to closed-loop
+ */
+typedef enum
+{
+  BL_RESYNC_DETECT, // waiting for speed of the coasting rotor
+  BL_RESYNC_ARMED,  // commutation timer period set to the poll rate
+  BL_RESYNC_POLL,   // commutation timer polls for the start of a sector
+  BL_RESYNC_SKIP    // first sector is driven, remainder of sector is scheduled
+}
+BL_resync_stage_t;
+
 /* Public variables  ---------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
-static BL_status_t bl_status; // aggregation of various status data
-static uint16_t BL_vbatt_measure; // use ADC input to guage the power supply voltage
+// timing advance (electrical degrees) vs. speed index (see BL_ADV_SPEED_REF)
+static const uint8_t BL_advance_tbl[ BL_ADV_N_SPEEDS ] =
+{
+  0, 0, 2, 4, 6, 8, 10, 12
+};
+
+// aggregation of various status data, published by the control task ISR
+static volatile BL_status_t bl_status;
+static volatile uint8_t bl_status_seq; // sequence count, odd while update in progress
+static uint16_t BL_vbatt_measure; // filtered power supply voltage, ADC counts
+static uint16_t BL_vbatt_rest; // supply voltage measured in arming i.e. unloaded
+static uint16_t BL_vcomp_q8 = 256; // supply voltage compensation (Q8)
+static uint16_t BL_duty_cmd; // duty-cycle command before voltage compensation
+static uint16_t BL_motor_rpm; // mechanical speed from the commutation period
+static bool BL_gov_enabled; // speed command is a target speed (governor)
+static int32_t BL_gov_integ; // governor integrator i.e. duty-cycle (Q16)
 static uint16_t BL_comm_period; // persistent value of ramp timing
 static uint16_t BL_motor_speed; // persistent value of motor speed
 static uint16_t BL_optimer; // allows for timed op state (e.g. alignment)
+static uint16_t BL_align_brake; // short brake time left ahead of the alignment
 static BL_state_t BL_opstate; // BL operation state
+static bool BL_cl_sync; // result of closed-loop control at latest commutation step
+static int32_t BL_pi_integ; // PI controller integrator (Q8)
+static uint16_t BL_pi_ffwd; // PI controller feed-forward i.e. measured or table timing
+
+// motor parameters, and the governor gain of the full-scale speed (see BL_set_motor)
+static BL_motor_t BL_motor =
+{
+  (uint16_t)BL_GOV_RPM_FS,
+  (uint16_t)BL_CT_STARTUP,
+  PWM_PD_STARTUP,
+  PWM_PD_SHUTOFF,
+  BL_MOTOR_POLE_PAIRS,
+  PI_KP_Q8,
+  PI_KI_Q8
+};
+static uint16_t BL_gov_kp_q16 = BL_GOV_KP_Q16( BL_GOV_RPM_FS );
+
+// startup profile, and the constant of the ramp acceleration (see BL_set_startup)
+static BL_startup_t BL_startup =
+{
+  BL_TIME_ALIGN,
+  PWM_PD_ALIGN,
+  PWM_PD_RAMPUP,
+  (uint16_t)BL_CT_RAMP_START,
+  (uint16_t)BL_CT_RAMP_END,
+  BL_TIME_RAMP
+};
+static uint32_t BL_ramp_accel_k =
+  BL_RAMP_ACCEL_K( BL_CT_RAMP_START, BL_CT_RAMP_END, BL_TIME_RAMP );
+static uint16_t BL_ramp_accum; // fraction of period step carried to the next frame
+static BL_slew_t BL_slew =
+{
+  BL_SLEW_ACCEL_Q8,
+  BL_SLEW_DECEL_Q8
+};
+static BL_brake_t BL_brake =
+{
+  BL_BRAKE_OFF,
+  BL_BRAKE_DECEL_Q8,
+  BL_TIME_BRAKE_SHORT,
+  BL_BRAKE_VOVS
+};
+static bool BL_brake_stop; // stop command, braking down to the short brake
+static bool BL_vbatt_ovs; // supply voltage above the overshoot limit of the brake
+static uint16_t BL_startup_timer; // control frames since the start command
+static uint16_t BL_startup_time; // time to closed-loop of the latest start
+
+static volatile BL_resync_stage_t BL_resync_stage;
+static uint16_t BL_resync_period; // sector period of the coasting rotor
+static uint16_t BL_resync_duty; // PWM duty-cycle matching the coasting speed
+static bool BL_resync_from_cl; // resync following loss of closed-loop sync
+static uint8_t BL_resync_tries; // consecutive resync attempts
+static uint16_t BL_cl_sync_timer; // frames in closed-loop since sync was lost
+static uint16_t BL_cl_hold_timer; // frames in closed-loop sync since the entry or resync
+static volatile uint8_t BL_cl_miss_count; // consecutive sectors without zero-crossing
+static bool BL_cl_handoff; // closed-loop sync not yet held since the entry or resync
 
 /* Private function prototypes -----------------------------------------------*/
 
 /* Private functions ---------------------------------------------------------*/
 
+/**
+ * @brief Publish the status snapshot.
+ *
+ * @details Invoked from ISR (control task) - the sequence count is odd while
+ *  the update is in progress so that the background task reader can retry
+ *  instead of disabling interrupts.
+ */
+static void bl_status_publish(void)
+{
+  bl_status_seq += 1;
+
+  bl_status.bL_opstate = BL_opstate;
+  bl_status.bl_sys_voltage = BL_vbatt_measure;
+  bl_status.bl_motor_speed = BL_motor_speed;
+  bl_status.bl_comm_period = BL_comm_period;
+  bl_status.bl_motor_current = Current_get();
+  bl_status.bl_motor_rpm = BL_motor_rpm;
+
+  bl_status_seq += 1;
+}
+
+/**
+ * @brief Update the supply voltage estimate.
+ *
+ * @details The supply voltage is sampled by the sequencer in the PWM on-time
+ *  of the driven phase and filtered at each PWM cycle while running, and held
+ *  while the motor is stopped. Implausible measurements are ignored.
+ */
+static void BL_vbatt_update(void)
+{
+  uint16_t vbat = Seq_Get_Vbatt();
+
+  if (vbat > BL_VSYS_OOR_THRSH)
+  {
+    BL_vbatt_measure = vbat;
+
+    // the compensation would lower the duty-cycle i.e. brake harder as the
+    // supply voltage is pumped up by the brake, so it is held
+    if (FALSE == BL_vbatt_ovs)
+    {
+      BL_vcomp_q8 = (uint16_t)( ((uint32_t)BL_VSYS_NOMINAL << 8) / BL_vbatt_measure );
+
+      if (BL_vcomp_q8 > BL_VCOMP_MAX_Q8)
+      {
+        BL_vcomp_q8 = BL_VCOMP_MAX_Q8;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Supply voltage overshoot of the brake.
+ *
+ * @details The current of the regenerative brake charges the supply, which
+ *  may not absorb it (e.g. a battery protection cutoff, or a bench supply).
+ *  The measurement is tested against the voltage measured in arming (or the
+ *  nominal if not measured) at each control frame, the filter of the
+ *  sequencer responds within a few ms.
+ */
+static void BL_vbatt_ovs_update(void)
+{
+  uint16_t vref = (0 != BL_vbatt_rest) ? BL_vbatt_rest : BL_VSYS_NOMINAL;
+  uint16_t vbat = Seq_Get_Vbatt();
+
+  BL_vbatt_ovs = (bool)( (BL_BRAKE_OFF != BL_brake.mode) &&
+                         (vbat > BL_VSYS_OOR_THRSH) &&
+                         (vbat > (vref + BL_brake.vbatt_ovs)) );
+}
+
+/**
+ * @brief Supply voltage compensation of the duty-cycle.
+ *
+ * @details The duty-cycle command is the phase voltage as a fraction of
+ *  BL_VSYS_NOMINAL, so the applied duty-cycle gives the same phase voltage
+ *  (and speed) at any supply voltage within the range of the compensation.
+ *
+ * @param duty  Duty-cycle command, PWM counts
+ * @return  Applied duty-cycle, PWM counts
+ */
+static uint16_t BL_vcomp(uint16_t duty)
+{
+  uint32_t comp = ( (uint32_t)duty * BL_vcomp_q8 ) >> 8;
+
+  return (comp < PWM_PERIOD_COUNTS) ? (uint16_t)comp : PWM_PERIOD_COUNTS;
+}
+
 /**
  * @Brief common sub for stopping and fault states
  *
@@ -97,6 +373,7 @@ static void BL_stop(void)
 
   // have to clear the local UI_speed since that is the transition OFF->RAMP condition
   BL_motor_speed = 0;
+  BL_brake_stop = FALSE;
 }
 
 /* Public functions ---------------------------------------------------------*/
@@ -122,6 +399,10 @@ void BL_reset(void)
 
   Faultm_init();
 
+#if defined( CURRENT_BKIN_ENABLED )
+  PWM_clear_break();
+#endif
+
   BL_set_opstate( BL_STOPPED ); // set the initial control-state
 }
 
@@ -138,12 +419,13 @@ void BL_reset(void)
  */
 void BL_set_speed(uint16_t ui_mspeed_counts)
 {
-  if (ui_mspeed_counts > PWM_PD_SHUTOFF)
+  if (ui_mspeed_counts > BL_motor.duty_shutoff)
   {
     // Update the dc if speed input greater than ramp start, OR if system already running
-    if ((ui_mspeed_counts > PWM_PD_STARTUP) || (0 != BL_motor_speed))
+    if ((ui_mspeed_counts > BL_motor.duty_startup) || (0 != BL_motor_speed))
     {
       BL_motor_speed = ui_mspeed_counts;
+      BL_brake_stop = FALSE;
     }
   }
   else // if (ui_mspeed_counts <= PD_SHUTOFF)
@@ -153,7 +435,16 @@ void BL_set_speed(uint16_t ui_mspeed_counts)
     // stay in Arming state long enough to get a system voltage measurement
     if (0 != BL_motor_speed)
     {
-      BL_reset();
+      if ( (BL_BRAKE_FULL == BL_brake.mode) && (BL_CLS_LOOP == BL_opstate) )
+      {
+        // braked in closed-loop down to the short brake (BL_state_control)
+        BL_motor_speed = BL_motor.duty_startup;
+        BL_brake_stop = TRUE;
+      }
+      else
+      {
+        BL_reset();
+      }
     }
   }
 }
@@ -204,160 +495,925 @@ void BL_set_timing(uint16_t u16)
 /**
  * @brief Accessor for state variable.
  *
- * @return pointer to struct
+ * @details Lock-free read of the status snapshot published by the control
+ *  task. The copy is retried if the control task ISR is updating the snapshot
+ *  (odd sequence count) or has updated it during the copy, so it is safe to
+ *  call from the background task without a critical section.
+ *
+ * @param [out] p_status Pointer to destination struct
  */
-BL_status_t *BL_get_status(void)
+void BL_get_status(BL_status_t *p_status)
 {
-  bl_status.bL_opstate = BL_opstate;
-  bl_status.bl_sys_voltage = BL_vbatt_measure;
-  bl_status.bl_motor_speed = BL_motor_speed;
-  bl_status.bl_comm_period = BL_comm_period;
+  uint8_t seq;
 
-  return &bl_status;
+  do
+  {
+    seq = bl_status_seq;
+
+    p_status->bL_opstate = bl_status.bL_opstate;
+    p_status->bl_sys_voltage = bl_status.bl_sys_voltage;
+    p_status->bl_motor_speed = bl_status.bl_motor_speed;
+    p_status->bl_comm_period = bl_status.bl_comm_period;
+    p_status->bl_motor_current = bl_status.bl_motor_current;
+    p_status->bl_motor_rpm = bl_status.bl_motor_rpm;
+  }
+  while ( (0 != (seq & 1)) || (seq != bl_status_seq) );
+
+  // measured by the background task, not part of the control task snapshot
+  p_status->bl_cpu_load = Sched_get_cpu_load();
 }
 
 /**
- * @brief  Accessor for state variable
+ * @brief Set the startup profile.
+ *
+ * @details  Expect to be called from non-ISR/CS context with the motor stopped.
+ *   A ramp end period not less than the start period disables the ramp. A
+ *   profile with a ramp end period of 0 is invalid and is not set.
  */
-void BL_set_opstate(uint8_t opstate)
+void BL_set_startup(const BL_startup_t *p_startup)
 {
-  BL_opstate = opstate;
+  uint16_t ramp_time = (p_startup->ramp_time > 0) ? p_startup->ramp_time : 1;
+
+  if (0 == p_startup->ramp_end)
+  {
+    return;
+  }
+  BL_startup = *p_startup;
+
+  if (p_startup->ramp_start > p_startup->ramp_end)
+  {
+    BL_ramp_accel_k = BL_RAMP_ACCEL_K(
+                        p_startup->ramp_start, p_startup->ramp_end, ramp_time );
+  }
 }
 
 /**
- * @brief  Accessor for state variable
- *
- * @return  operation state
+ * @brief Get the startup profile.
  */
-uint8_t BL_get_opstate(void)
+void BL_get_startup(BL_startup_t *p_startup)
 {
-  return BL_opstate;
+  *p_startup = BL_startup;
 }
 
 /**
- * @ brief closed loop controller
- * @ return boolean true (success) false (fail)
+ * @brief Set the slew rate limits of the duty-cycle command.
+ *
+ * @details  Rates below the minimum (BL_SLEW_MIN_Q8) are raised to the
+ *  minimum.
  */
+void BL_set_slew(const BL_slew_t *p_slew)
+{
+  BL_slew.accel_q8 = (p_slew->accel_q8 > BL_SLEW_MIN_Q8) ? p_slew->accel_q8 : BL_SLEW_MIN_Q8;
+  BL_slew.decel_q8 = (p_slew->decel_q8 > BL_SLEW_MIN_Q8) ? p_slew->decel_q8 : BL_SLEW_MIN_Q8;
+}
+
 /**
- * @brief closed loop control function
- * @param current_setpoint commutation period
- * @return TRUE: within control limits, FALSE: not within control limits
+ * @brief Get the slew rate limits of the duty-cycle command.
  */
-static bool BL_cl_control(uint16_t current_setpoint)
+void BL_get_slew(BL_slew_t *p_slew)
 {
-  // returns true if plausible conditions for transition to closed-loop
-  if (FALSE != Seq_get_timing_error_p())
-  {
-    // needs to be small enough to be stable upon transition from to closed-loop
-    static const int16_t ERROR_MAX = ERROR_LIMIT;
-    static const int16_t ERROR_MIN = -1 * ERROR_LIMIT;
-    int16_t timing_error = Seq_get_timing_error();
-
-    if ((timing_error > ERROR_MIN) && (timing_error < ERROR_MAX))
-    {
-      static const int16_t PROP_GAIN = 10; // inverse of kP
-      int16_t correction = timing_error / PROP_GAIN ;
+  *p_slew = BL_slew;
+}
 
-      BL_set_timing(current_setpoint + correction);
+/**
+ * @brief Set the brake parameters.
+ *
+ * @details  An invalid mode turns the brake off, a rate below the minimum
+ *  (BL_SLEW_MIN_Q8) is raised to the minimum.
+ */
+void BL_set_brake(const BL_brake_t *p_brake)
+{
+  BL_brake = *p_brake;
 
-      return TRUE;
-    }
+  if (p_brake->mode >= BL_BRAKE_N_MODES)
+  {
+    BL_brake.mode = BL_BRAKE_OFF;
+  }
+  if (p_brake->decel_q8 < BL_SLEW_MIN_Q8)
+  {
+    BL_brake.decel_q8 = BL_SLEW_MIN_Q8;
   }
-  return FALSE;
 }
 
 /**
- * @brief  Commutation timing ramp control.
+ * @brief Get the brake parameters.
+ */
+void BL_get_brake(BL_brake_t *p_brake)
+{
+  *p_brake = BL_brake;
+}
+
+/**
+ * @brief Time to closed-loop of the latest start
  *
- * At each iteration the commutation time period is ramped to the target value
- * stepped in increment of +/- step depending on the sign of the error.
+ * @return  Control frames (~1 ms) from the start command to BL_CLS_LOOP, 0 if
+ *   closed-loop not (yet) reached
+ */
+uint16_t BL_get_startup_time(void)
+{
+  return BL_startup_time;
+}
+
+/**
+ * @brief Set the motor parameters.
  *
- * @param setpoint Target value to track.
- * @param target Target value to track.
+ * @details  To be set with the motor stopped, along with the startup profile
+ *  (see Mparam_select). The governor gains are scaled to the full-scale
+ *  speed. Pole pairs of 0 are raised to 1, the full-scale speed to at least
+ *  PWM_PERIOD_COUNTS, and the shutoff duty-cycle is held below the startup
+ *  duty-cycle.
  */
-static void timing_ramp_control(uint16_t current_setpoint, uint16_t target_setpoint)
+void BL_set_motor(const BL_motor_t *p_motor)
 {
-  uint16_t u16 = current_setpoint;
+  BL_motor = *p_motor;
 
-  // determine signage of error i.e. step increment
-  if (u16 > target_setpoint)
+  if (0 == BL_motor.pole_pairs)
   {
-    u16 -= (uint16_t)BL_ONE_RAMP_UNIT;
-    if (u16 < target_setpoint)
-    {
-      u16 = target_setpoint;
-    }
+    BL_motor.pole_pairs = 1;
   }
-  else if (u16 < target_setpoint)
+  if (BL_motor.gov_rpm_fs < PWM_PERIOD_COUNTS)
   {
-    u16 += (uint16_t)BL_ONE_RAMP_UNIT;
-    if (u16 > target_setpoint)
-    {
-      u16 = target_setpoint;
-    }
+    BL_motor.gov_rpm_fs = PWM_PERIOD_COUNTS; // gain within 16 bits
   }
-  BL_set_timing(u16);
+  if (BL_motor.duty_shutoff >= BL_motor.duty_startup)
+  {
+    BL_motor.duty_shutoff = BL_motor.duty_startup / 2;
+  }
+  BL_gov_kp_q16 = BL_GOV_KP_Q16( BL_motor.gov_rpm_fs );
 }
 
 /**
- * @brief step the motor speed from the present operation point toward the input speed setpoint
+ * @brief Get the motor parameters.
  */
-uint16_t get_ramped_speed(uint16_t input_speed)
+void BL_get_motor(BL_motor_t *p_motor)
 {
-  // get the presently set speed/duty-cycle as default
-  uint16_t ramped_speed = PWM_get_dutycycle();
+  *p_motor = BL_motor;
+}
 
-  if (ramped_speed < input_speed)
+/**
+ * @brief Supply voltage measured in arming
+ *
+ * @return  Unloaded supply voltage, ADC counts, 0 if not (yet) measured
+ */
+uint16_t BL_get_vbatt_rest(void)
+{
+  return BL_vbatt_rest;
+}
+
+/**
+ * @brief Enable the speed governor
+ *
+ * @details With the governor the speed command (BL_set_speed) is the target
+ *  speed as a fraction of the full-scale speed of the motor (BL_set_motor),
+ *  and the duty-cycle is controlled in closed-loop to hold the speed. The
+ *  startup is not changed.
+ */
+void BL_set_governor(bool enable)
+{
+  BL_gov_enabled = enable;
+}
+
+/**
+ * @brief Accessor for the speed governor enable
+ */
+bool BL_get_governor(void)
+{
+  return BL_gov_enabled;
+}
+
+/**
+ * @brief  Accessor for state variable
+ */
+void BL_set_opstate(uint8_t opstate)
+{
+#if defined( SCOPE_ENABLED )
+  if ( (BL_CLS_LOOP == opstate) && (BL_CLS_LOOP != BL_opstate) )
   {
-    ramped_speed += 1u; // +BL_SPEED_RAMP_STEP ... TODO? use fixed-point macro and make range-check robust
+    Scope_trigger( SCOPE_TRIG_CLS_LOOP );
   }
-  else if (ramped_speed > input_speed)
+#endif
+  // the commutation is scheduled from the zero-crossing in closed-loop only
+  Seq_set_zc_commutation( (bool)(BL_CLS_LOOP == opstate) );
+
+  // each startup ramp begins with no fraction carried from the previous one
+  if (BL_RAMPUP == opstate)
   {
-    ramped_speed -= 1u; // -BL_SPEED_RAMP_STEP ... TODO? use fixed-point macro and make range-check robust
+    BL_ramp_accum = 0;
   }
-  return ramped_speed;
+
+  BL_opstate = opstate;
 }
 
 /**
- * @brief  Implement control task (fixed exec rate of ~1ms).
+ * @brief  Accessor for state variable
+ *
+ * @return  operation state
  */
-void BL_state_control(void)
+uint8_t BL_get_opstate(void)
 {
-  uint16_t inp_dutycycle = 0; // in case of error, PWM output remains 0
+  return BL_opstate;
+}
+
+#if defined( TRACE_ENABLED )
+/**
+ * @brief  Accessor for the PI controller integrator, for the replay of a trace
+ *
+ * @details  The integrator is traced once per electrical cycle (TRACE_EV_PI).
+ */
+int32_t BL_get_pi_integ(void)
+{
+  return BL_pi_integ;
+}
+
+/**
+ * @brief  Load the PI controller integrator of a trace event
+ */
+void BL_set_pi_integ(int32_t integ)
+{
+  BL_pi_integ = integ;
+}
+#endif // TRACE_ENABLED
 
-BL_vbatt_measure = Seq_Get_Vbatt();
+/**
+ * @brief Update feed-forward term of the closed-loop controller
+ * @details  The next commutation period is scheduled from the measured
+ *   duration of the latest sector. If the sector period was not measured, the
+ *   open-loop timing table is looked up by the present PWM duty-cycle. Beyond
+ *   the range of the table, the latest valid value is held and the integrator
+ *   has to account for the difference.
+ */
+static void BL_pi_ffwd_update(void)
+{
+  uint16_t ffwd = Seq_get_sector_period();
 
-  if ( 0 != Faultm_get_status() )
+  if (0 == ffwd)
   {
-    // sets PWM period to 0 and disables timer PWM channels but doesn't
-    // re-init the system state
-    BL_stop();
+    ffwd = Get_OL_Timing( BL_duty_cmd );
   }
-  else
+
+  if (U16_MAX != ffwd)
   {
-    BL_state_t bl_opstate = BL_get_opstate();
+    BL_pi_ffwd = ffwd;
+  }
+}
 
-    if (BL_MANUAL == bl_opstate)
+/**
+ * @brief Update the timing advance from the measured speed
+ * @details  Applied to the ideal zero-crossing position of the next sector,
+ *   so the PI controller tracks the advanced commutation timing.
+ */
+static void BL_advance_update(void)
+{
+  uint16_t period = Seq_get_sector_period();
+  uint16_t index = BL_ADV_N_SPEEDS - 1;
+
+  // the advance is held if the sector period was not measured
+  if (0 != period)
+  {
+    if (period > (BL_motor.ct_startup / (BL_ADV_N_SPEEDS - 1)))
     {
-      // allow motor-speed/PWM-duty-cycle set to UI input (no ramping)
-      inp_dutycycle = BL_get_speed();
+      index = BL_motor.ct_startup / period;
     }
+    Seq_set_timing_advance( BL_advance_tbl[ index ] );
+  }
+}
 
-    else if (BL_ARMING == bl_opstate)
-    {
-      // bl state is only set to ARMING at power-on/reset
+/**
+ * @brief Initialize the closed-loop controller
+ * @details  Integrator is preset to the difference between the present
+ *   commutation period and the feed-forward for bumpless transfer into
+ *   closed-loop control.
+ * @param current_setpoint commutation period
+ */
+static void BL_pi_reset(uint16_t current_setpoint)
+{
+  int16_t integ;
 
-      static const uint16_t ARMING_TIME_MASK  = 0x01C0u;
-      // commutation switching time .. actually is irrelevant .. only Phase A is active
-      static const uint16_t ARMING_BL_TIMING  = (uint16_t)BL_CT_RAMP_START; // arbitrary
-      static uint16_t atimer = 0;
+  BL_pi_ffwd = current_setpoint;
+  BL_pi_ffwd_update();
 
-      BL_set_timing( ARMING_BL_TIMING ); // set to some small value (sampling vBatt measurement)
+  integ = (int16_t)current_setpoint - (int16_t)BL_pi_ffwd;
 
-      if (atimer < BL_TIME_ARMING_TOTAL)
-      {
-        atimer += 1;
-        inp_dutycycle = 0;
+  if (integ > (int16_t)PI_INTEG_LIMIT)
+  {
+    integ = (int16_t)PI_INTEG_LIMIT;
+  }
+  else if (integ < -(int16_t)PI_INTEG_LIMIT)
+  {
+    integ = -(int16_t)PI_INTEG_LIMIT;
+  }
+  BL_pi_integ = (int32_t)integ << 8;
+}
+
+/**
+ * @brief closed loop control function
+ * @details  The timing error is updated from the back-EMF zero-crossing of
+ *   each sector, so in closed-loop the controller is invoked at each
+ *   commutation step (6 updates per electrical cycle).
+ *
+ *   PI controller with the measured sector period (or the open-loop timing
+ *   table) as feed-forward:
+ *
+ *     period = ffwd + Ki * sum(error) + Kp * error
+ *
+ *   The timing error is w.r.t. the advanced zero-crossing position given by
+ *   the timing advance curve at the measured speed.
+ *
+ *   The error is saturated at the control limits. Anti-windup: the integrator
+ *   is clamped, and does not integrate while the output is saturated in the
+ *   direction of the error.
+ * @return TRUE: within control limits, FALSE: not within control limits
+ */
+static bool BL_cl_control(void)
+{
+  // returns true if plausible conditions for transition to closed-loop
+  if (FALSE != Seq_get_timing_error_p())
+  {
+    // needs to be small enough to be stable upon transition from to closed-loop
+    static const int16_t ERROR_MAX = BL_ERROR_LIMIT;
+    static const int16_t ERROR_MIN = -1 * BL_ERROR_LIMIT;
+    static const int32_t INTEG_MAX = (int32_t)PI_INTEG_LIMIT << 8;
+
+    bool in_limits = TRUE;
+    int16_t timing_error = Seq_get_timing_error();
+    int32_t integ_max = INTEG_MAX;
+    int32_t integ_min = -INTEG_MAX;
+    int32_t output_min = (int32_t)BL_CT_CL_MIN;
+    int32_t integ;
+    int32_t output;
+
+    if (timing_error >= ERROR_MAX)
+    {
+      timing_error = ERROR_MAX;
+      in_limits = FALSE;
+    }
+    else if (timing_error <= ERROR_MIN)
+    {
+      timing_error = ERROR_MIN;
+      in_limits = FALSE;
+    }
+
+    BL_pi_ffwd_update();
+
+    if ( (BL_CLS_LOOP == BL_opstate) && (0 != Seq_get_sector_period()) )
+    {
+      int32_t trim_max = ( (int32_t)BL_pi_ffwd >> PI_TRIM_SHIFT ) << 8;
+
+      if (trim_max < integ_max)
+      {
+        integ_max = trim_max;
+      }
+      integ_min = 0;
+
+      if (output_min < (int32_t)BL_pi_ffwd)
+      {
+        output_min = (int32_t)BL_pi_ffwd;
+      }
+    }
+
+    integ = BL_pi_integ + (int32_t)BL_motor.pi_ki_q8 * timing_error;
+
+    if (integ > integ_max)
+    {
+      integ = integ_max;
+    }
+    else if (integ < integ_min)
+    {
+      integ = integ_min;
+    }
+
+    output = (int32_t)BL_pi_ffwd +
+             ( ( integ + (int32_t)BL_motor.pi_kp_q8 * timing_error ) >> 8 );
+
+    // output saturation, the integrator is held if it would wind up further
+    if (output > (int32_t)BL_CT_CL_MAX)
+    {
+      output = (int32_t)BL_CT_CL_MAX;
+      if (timing_error > 0)
+      {
+        integ = BL_pi_integ;
+      }
+    }
+    else if (output < output_min)
+    {
+      output = output_min;
+      if (timing_error < 0)
+      {
+        integ = BL_pi_integ;
+      }
+    }
+
+    BL_pi_integ = integ;
+    BL_set_timing((uint16_t)output);
+
+    BL_advance_update();
+
+    return in_limits;
+  }
+  return FALSE;
+}
+
+/**
+ * @brief  Commutation timing ramp control.
+ *
+ * At each iteration the commutation time period is ramped to the target value
+ * stepped in increment of +/- step depending on the sign of the error.
+ *
+ * @param setpoint Target value to track.
+ * @param target Target value to track.
+ */
+static void timing_ramp_control(uint16_t current_setpoint, uint16_t target_setpoint)
+{
+  uint16_t u16 = current_setpoint;
+
+  // determine signage of error i.e. step increment
+  if (u16 > target_setpoint)
+  {
+    u16 -= (uint16_t)BL_ONE_RAMP_UNIT;
+    if (u16 < target_setpoint)
+    {
+      u16 = target_setpoint;
+    }
+  }
+  else if (u16 < target_setpoint)
+  {
+    u16 += (uint16_t)BL_ONE_RAMP_UNIT;
+    if (u16 > target_setpoint)
+    {
+      u16 = target_setpoint;
+    }
+  }
+  BL_set_timing(u16);
+}
+
+/**
+ * @brief Commutation period ramp of constant acceleration
+ * @details The period step is T^2 / (K + T) (see BL_RAMP_ACCEL_K), computed
+ *   with an 8-bit fraction that is carried to the next frame. The divisor is
+ *   held at 1 or more for a constant K below 256.
+ * @param current_setpoint Commutation period.
+ * @param target_setpoint Commutation period at the end of the ramp.
+ */
+static void timing_accel_ramp(uint16_t current_setpoint, uint16_t target_setpoint)
+{
+  uint32_t t32 = current_setpoint;
+  uint32_t div_q8 = (BL_ramp_accel_k + t32) >> 8;
+  uint32_t step_q8;
+  uint16_t step;
+
+  if (current_setpoint <= target_setpoint)
+  {
+    BL_set_timing(target_setpoint);
+    return;
+  }
+
+  if (0 == div_q8)
+  {
+    div_q8 = 1;
+  }
+  step_q8 = (t32 * t32) / div_q8;
+  step_q8 += BL_ramp_accum;
+  step = (uint16_t)(step_q8 >> 8);
+  BL_ramp_accum = (uint16_t)(step_q8 & 0x00FF);
+
+  if ( (current_setpoint - target_setpoint) > step )
+  {
+    BL_set_timing(current_setpoint - step);
+  }
+  else
+  {
+    BL_set_timing(target_setpoint);
+  }
+}
+
+/*
+ * Slew rate of the duty-cycle command from the sync margin: the limit of the
+ * direction while the closed-loop timing error is within BL_SLEW_ERR_MIN,
+ * scaled down to the minimum rate at BL_SLEW_ERR_MAX. With the brake the
+ * limit of the deceleration is the brake rate, and the duty-cycle is held
+ * while the supply voltage is above the overshoot limit.
+ */
+static uint16_t BL_slew_rate(bool accel)
+{
+  uint16_t rate = BL_slew.accel_q8;
+  int16_t error = Seq_get_timing_error();
+  uint16_t margin;
+
+  if (FALSE == accel)
+  {
+    if (BL_BRAKE_OFF == BL_brake.mode)
+    {
+      rate = BL_slew.decel_q8;
+    }
+    else if (FALSE != BL_vbatt_ovs)
+    {
+      return 0;
+    }
+    else
+    {
+      rate = BL_brake.decel_q8;
+    }
+  }
+
+  if ( (BL_CLS_LOOP != BL_opstate) || (FALSE == BL_cl_sync) )
+  {
+    return BL_SLEW_MIN_Q8;
+  }
+
+  margin = (uint16_t)( (error < 0) ? -error : error );
+
+  if (margin >= BL_SLEW_ERR_MAX)
+  {
+    return BL_SLEW_MIN_Q8;
+  }
+  if (margin <= BL_SLEW_ERR_MIN)
+  {
+    return rate;
+  }
+  margin = BL_SLEW_ERR_MAX - margin;
+
+  return BL_SLEW_MIN_Q8 +
+         (uint16_t)( ( (uint32_t)(rate - BL_SLEW_MIN_Q8) * margin ) /
+                     (BL_SLEW_ERR_MAX - BL_SLEW_ERR_MIN) );
+}
+
+/**
+ * @brief step the motor speed from the present operation point toward the input speed setpoint
+ *
+ * @details The step is limited by the slew rate of the direction (BL_set_slew)
+ *  scaled by the sync margin of the closed-loop. The slew does not apply to
+ *  the open-loop ramp, and in the handoff to closed-loop the duty-cycle is not
+ *  lowered below the ramp duty-cycle (BL_TIME_CL_HANDOFF).
+ */
+uint16_t get_ramped_speed(uint16_t input_speed)
+{
+  static uint16_t ramp_accum; // fraction of ramp step carried to the next frame
+
+  // get the presently set speed/duty-cycle (command) as default
+  uint16_t ramped_speed = BL_duty_cmd;
+  uint16_t step;
+
+  ramp_accum += BL_slew_rate( (bool)(ramped_speed < input_speed) );
+  step = ramp_accum >> 8;
+  ramp_accum &= 0x00FF;
+
+  if (ramped_speed < input_speed)
+  {
+    ramped_speed += step;
+    if (ramped_speed > input_speed)
+    {
+      ramped_speed = input_speed;
+    }
+  }
+  else if (ramped_speed > input_speed)
+  {
+    if ((ramped_speed - input_speed) > step)
+    {
+      ramped_speed -= step;
+    }
+    else
+    {
+      ramped_speed = input_speed;
+    }
+  }
+
+  // handoff to closed-loop: the duty-cycle is not lowered below the ramp
+  // duty-cycle, which has kept the rotor in step, until the sync has held
+  if ( (BL_CLS_LOOP == BL_opstate) && (BL_cl_hold_timer < BL_TIME_CL_HANDOFF) )
+  {
+    uint16_t hold = (BL_duty_cmd < BL_startup.ramp_duty) ? BL_duty_cmd : BL_startup.ramp_duty;
+
+    if (ramped_speed < hold)
+    {
+      ramped_speed = hold;
+    }
+  }
+  return ramped_speed;
+}
+
+/*
+ * Update the motor speed from the commutation period, the forced open-loop
+ * timing, or in closed-loop the measured sector period (ZC->ZC interval).
+ * There is no speed measurement with the motor stopped or coasting.
+ */
+static void BL_rpm_update(void)
+{
+  uint16_t period = BL_get_timing();
+
+  if ( (BL_CLS_LOOP == BL_opstate) && (0 != Seq_get_sector_period()) )
+  {
+    period = Seq_get_sector_period();
+  }
+
+  BL_motor_rpm = 0;
+
+  if ( (BL_opstate >= BL_RAMPUP) && (BL_opstate <= BL_CLS_LOOP) &&
+       (0 != period) && (U16_MAX != period) )
+  {
+    BL_motor_rpm = BL_RPM_K( period, BL_motor.pole_pairs );
+  }
+}
+
+/*
+ * Speed governor step, the target speed is scaled from the speed command. The
+ * output is slew limited as the duty-cycle command (get_ramped_speed).
+ * Anti-windup: the integrator is clamped, and does not integrate while the
+ * output is limited in the direction of the error. The integrator is preset to
+ * the duty-cycle at the entry to closed-loop (see BL_state_control).
+ */
+static uint16_t BL_gov_control(void)
+{
+  static const int32_t INTEG_MAX = (int32_t)PWM_PERIOD_COUNTS << 16;
+  int32_t integ_min = (int32_t)BL_motor.duty_startup << 16;
+
+  uint16_t target = (uint16_t)(
+                      ( (uint32_t)BL_get_speed() * BL_motor.gov_rpm_fs ) / PWM_PERIOD_COUNTS );
+  int32_t error = (int32_t)target - (int32_t)BL_motor_rpm;
+  int32_t integ = BL_gov_integ + (int32_t)( BL_gov_kp_q16 / BL_GOV_TI ) * error;
+  int32_t output;
+  uint16_t duty;
+
+  if (integ > INTEG_MAX)
+  {
+    integ = INTEG_MAX;
+  }
+  else if (integ < integ_min)
+  {
+    integ = integ_min;
+  }
+
+  output = ( integ + (int32_t)BL_gov_kp_q16 * error ) >> 16;
+
+  if (output > (int32_t)PWM_PERIOD_COUNTS)
+  {
+    output = PWM_PERIOD_COUNTS;
+  }
+  else if (output < (int32_t)BL_motor.duty_startup)
+  {
+    output = BL_motor.duty_startup;
+  }
+
+  duty = get_ramped_speed( (uint16_t)output );
+
+  if ( ( (duty < (uint16_t)output) && (error > 0) ) ||
+       ( (duty > (uint16_t)output) && (error < 0) ) )
+  {
+    integ = BL_gov_integ; // slew limited
+  }
+  BL_gov_integ = integ;
+
+  return duty;
+}
+
+#if defined( ZC_CLOSED_LOOP_ENABLED )
+/*
+ * Handoff to closed-loop from the present commutation period, the controller
+ * is re-initialized at each try for bumpless transfer.
+ * Returns TRUE if the control step was successful i.e. closed-loop is entered.
+ */
+static bool BL_try_cls_loop(void)
+{
+  BL_pi_reset( BL_get_timing() );
+
+  if (FALSE != BL_cl_control())
+  {
+    BL_cl_sync = TRUE;
+    BL_cl_sync_timer = 0;
+    BL_cl_hold_timer = 0;
+    BL_cl_miss_count = 0;
+    BL_cl_handoff = TRUE;
+    BL_set_opstate( BL_CLS_LOOP );
+    BL_startup_time = BL_startup_timer;
+    return TRUE;
+  }
+  return FALSE;
+}
+#endif
+
+/*
+ * Start the motor from alignment of the rotor to sector 0.
+ */
+static void BL_start_align(void)
+{
+  // the control task is preemptible, the commutation ISR must not drive
+  // sector 0 once the phases are shorted
+  disableInterrupts();  //////////////// DI
+
+  BL_set_opstate( BL_ALIGN );
+  BL_optimer = BL_startup.align_time;
+  BL_align_brake = BL_TIME_ALIGN_BRAKE;
+
+  // Set initial commutation timing period upon state transition.
+  BL_set_timing( BL_startup.ramp_start );
+
+  PWM_set_dutycycle( 0 );
+  PWM_brake_short();
+
+  enableInterrupts();  ///////////////// EI
+}
+
+/*
+ * Start detection of the coasting rotor, the phases are floated until the
+ * resync so that the back-EMF of each phase is seen.
+ * from_cl: TRUE if closed-loop sync was lost, otherwise start command
+ */
+static void BL_start_resync(bool from_cl)
+{
+  // the control task is preemptible, the commutation ISR must not step the
+  // sequence until the state change is complete
+  disableInterrupts();  //////////////// DI
+
+  All_phase_stop();
+
+  BL_resync_from_cl = from_cl;
+  BL_resync_duty = 0;
+  BL_resync_stage = BL_RESYNC_DETECT;
+  BL_cl_sync = FALSE;
+
+  if (FALSE == from_cl)
+  {
+    BL_resync_tries = 0;
+  }
+
+  // commutation step is held off until the resync (see BL_resync_step)
+  BL_set_opstate( BL_RESYNC );
+  BL_optimer = BL_TIME_RESYNC;
+  Seq_coast_start();
+
+  enableInterrupts();  ///////////////// EI
+}
+
+/*
+ * Start command: the time to closed-loop is counted from here, the rotor may
+ * be already spinning.
+ */
+static void BL_start(void)
+{
+  BL_startup_timer = 0;
+  BL_startup_time = 0;
+
+#if defined( ZC_CLOSED_LOOP_ENABLED )
+  BL_start_resync(FALSE);
+#else
+  // the coasting rotor is not detected from the back-EMF of phase A only
+  BL_start_align();
+#endif
+}
+
+/*
+ * Short brake of the stopping rotor, the commutation is stopped. Released by
+ * BL_reset() at the end of the brake time, or by the resync at a start command.
+ */
+static void BL_start_brake(void)
+{
+  // the control task is preemptible, the commutation ISR must not step the
+  // sequence once the phases are shorted
+  disableInterrupts();  //////////////// DI
+
+  BL_set_opstate( BL_BRAKING );
+  BL_optimer = BL_brake.short_time;
+  BL_motor_speed = 0;
+  BL_brake_stop = FALSE;
+  BL_cl_sync = FALSE;
+  BL_set_timing( U16_MAX );
+
+  PWM_set_dutycycle( 0 );
+  PWM_brake_short();
+
+  enableInterrupts();  ///////////////// EI
+}
+
+/*
+ * Flying restart control step: once the speed of the coasting rotor is known
+ * the commutation timer is set to poll for the start of the 0, 2 or 4 sector
+ * at 1/8 of the sector period. The PWM duty-cycle that would give the same
+ * speed is looked up from the timing table.
+ * If the rotor is not detected the motor is started from alignment, or if the
+ * resync was following a loss of closed-loop sync, the fault is latched.
+ * Returns the PWM duty-cycle.
+ */
+static uint16_t BL_resync_control(void)
+{
+  if (BL_RESYNC_DETECT == BL_resync_stage)
+  {
+    uint16_t period = Seq_get_coast_period();
+
+    // too slow for the zero-crossing detection in closed-loop
+    if ( (0 != period) && (period < (uint16_t)BL_CT_CL_MAX) )
+    {
+      BL_resync_period = period;
+      BL_resync_duty = Mdata_get_dutycycle(period);
+
+      // at low speed the drive has to be at least that at the end of the startup
+      if (BL_resync_duty < BL_motor.duty_startup)
+      {
+        BL_resync_duty = BL_motor.duty_startup;
+      }
+
+      // the control task is preemptible, the commutation ISR has to see the
+      // stage change with the poll period
+      disableInterrupts();  //////////////// DI
+      BL_set_timing(period / 8);
+      BL_resync_stage = BL_RESYNC_ARMED;
+      enableInterrupts();  ///////////////// EI
+    }
+    else if ( (BL_optimer <= (BL_TIME_RESYNC - BL_TIME_COAST_DETECT)) ||
+              ( (BL_optimer <= (BL_TIME_RESYNC - BL_TIME_COAST_BEMF)) &&
+                (FALSE == Seq_get_coast_bemf()) ) )
+    {
+      // the rotor is stopped or too slow
+      BL_optimer = 0;
+    }
+  }
+
+  if (BL_optimer > 0)
+  {
+    BL_optimer -= 1;
+  }
+  else
+  {
+    bool timeout = FALSE;
+
+    // unless the commutation ISR has done the handoff in the meantime
+    disableInterrupts();  //////////////// DI
+    if (BL_RESYNC == BL_opstate)
+    {
+      timeout = TRUE;
+
+      if (FALSE != BL_resync_from_cl)
+      {
+        Faultm_set(FAULT_1);
+      }
+      else
+      {
+        BL_start_align();
+      }
+    }
+    enableInterrupts();  ///////////////// EI
+
+    if (FALSE != timeout)
+    {
+      return 0;
+    }
+  }
+  return BL_resync_duty;
+}
+
+/**
+ * @brief  Implement control task (fixed exec rate of ~1ms).
+ *
+ * @details  Invoked by the scheduler with interrupts enabled, so updates of the
+ *  state shared with the commutation ISR that must be seen as a whole are done
+ *  with interrupts masked.
+ */
+void BL_state_control(void)
+{
+  uint16_t inp_dutycycle = 0; // in case of error, PWM output remains 0
+
+  BL_vbatt_ovs_update();
+  BL_vbatt_update();
+
+  Faultm_tick();
+
+#if defined( CURRENT_BKIN_ENABLED )
+  // the hardware over-current break has disabled the PWM outputs
+  if (FALSE != PWM_get_break())
+  {
+    Faultm_set(OVER_CURRENT);
+  }
+#endif
+
+  if ( 0 != Faultm_get_status() )
+  {
+    // sets PWM period to 0 and disables timer PWM channels but doesn't
+    // re-init the system state
+    BL_stop();
+  }
+  else
+  {
+    BL_state_t bl_opstate = BL_get_opstate();
+
+    if (BL_MANUAL == bl_opstate)
+    {
+      // allow motor-speed/PWM-duty-cycle set to UI input (no ramping)
+      inp_dutycycle = BL_get_speed();
+    }
+
+    else if (BL_ARMING == bl_opstate)
+    {
+      // bl state is only set to ARMING at power-on/reset
+
+      static const uint16_t ARMING_TIME_MASK  = 0x01C0u;
+      // commutation switching time .. actually is irrelevant .. only Phase A is active
+      static const uint16_t ARMING_BL_TIMING  = (uint16_t)BL_CT_RAMP_START; // arbitrary
+      static uint16_t atimer = 0;
+
+      BL_set_timing( ARMING_BL_TIMING ); // set to some small value (sampling vBatt measurement)
+
+      if (atimer < BL_TIME_ARMING_TOTAL)
+      {
+        atimer += 1;
+        inp_dutycycle = 0;
 
         // after power-on briefly drive phase A PWM to measure battery voltage
         if (atimer < BL_TIME_ARMING_HOLD)
@@ -371,8 +1427,7 @@ BL_vbatt_measure = Seq_Get_Vbatt();
           // check plausibility of sample
           if (vbat > BL_VSYS_OOR_THRSH)
           {
-            BL_vbatt_measure = (BL_vbatt_measure + vbat) / 2; // simple moving average
-//            Vbattery = Seq_Get_Vbatt(); // only store the latest
+            BL_vbatt_rest = (BL_vbatt_rest + vbat) / 2; // simple moving average
           }
         }
         else
@@ -396,18 +1451,54 @@ BL_vbatt_measure = Seq_Get_Vbatt();
       uint16_t uispeed = BL_get_speed();
       if (uispeed > 0)
       {
-        BL_set_opstate( BL_ALIGN );
-        BL_optimer = BL_TIME_ALIGN;
-
-        // Set initial commutation timing period upon state transition.
-        BL_set_timing( (uint16_t)BL_CT_RAMP_START );
+        BL_start();
+      }
+    }
+    else if (BL_BRAKING == bl_opstate)
+    {
+      if (BL_get_speed() > 0)
+      {
+        // the resync releases the brake, the rotor is likely stopped
+        BL_start();
+      }
+      else if (BL_optimer > 0)
+      {
+        BL_optimer -= 1;
+      }
+      else
+      {
+        BL_reset();
       }
     }
+    else if (BL_RESYNC == bl_opstate)
+    {
+      inp_dutycycle = BL_resync_control();
+    }
     else if (BL_ALIGN == bl_opstate)
     {
-      if (BL_optimer > 0)
+      if (BL_align_brake > 0)
+      {
+        BL_align_brake -= 1;
+
+        if (0 == BL_align_brake)
+        {
+          // release the brake, sector 0 is driven at the next commutation
+          disableInterrupts();  //////////////// DI
+          All_phase_stop();
+          enableInterrupts();  ///////////////// EI
+        }
+      }
+      else if (BL_optimer > 0)
       {
-        inp_dutycycle = PWM_PD_ALIGN;
+        uint16_t elapsed = BL_startup.align_time - BL_optimer;
+        uint16_t soft = BL_startup.align_time / 2;
+
+        // the duty-cycle is raised over the first half of the alignment
+        inp_dutycycle = BL_startup.align_duty;
+        if (elapsed < soft)
+        {
+          inp_dutycycle = (uint16_t)( ( (uint32_t)inp_dutycycle * (elapsed + 1) ) / soft );
+        }
         BL_optimer -=1;
       }
       else
@@ -421,138 +1512,356 @@ BL_vbatt_measure = Seq_Get_Vbatt();
       uint16_t timing_now = BL_get_timing();
 
       // set target commutation timing period for end of ramp
-      uint16_t timing_target = (uint16_t)BL_CT_RAMP_END;
+      uint16_t timing_target = BL_startup.ramp_end;
 
       // only needs to ramp in 1 direction
-      timing_ramp_control(timing_now, timing_target);
+      timing_accel_ramp(timing_now, timing_target);
 
       // Set PWM duty-cycle for rampup
-      inp_dutycycle = PWM_PD_RAMPUP;
+      inp_dutycycle = BL_startup.ramp_duty;
 
       if (timing_now <= timing_target)
       {
         BL_set_opstate( BL_OPN_LOOP );
+        BL_optimer = BL_TIME_OL_SYNC;
       }
+#if defined( ZC_CLOSED_LOOP_ENABLED )
+      // the handoff is tried from the ramp as soon as the zero-crossing is
+      // seen, while the rotor still keeps up with the ramp
+      else if (FALSE != BL_try_cls_loop())
+      {
+        inp_dutycycle = get_ramped_speed(BL_get_speed());
+      }
+#endif
     }
 
     else if (BL_OPN_LOOP == bl_opstate)
     {
       // get the present BL commutation timing setpoint
       uint16_t timing_now = BL_get_timing();
+#if !defined( ZC_CLOSED_LOOP_ENABLED )
+      uint16_t timing_target;
+#endif
 
       // Update the commutation timing using Startup Speed as control setpoint.
       // There is sort of an assumption here that the ramp-up over-shot the
       // speed (commutation period) and should now back off to the "startup"
       // timing. Unfortunately the exact values of those operating points are/were
-      // tied to a static open-loop timing table for 1100kv motor at precisely 12.5v
+      // tied to a static open-loop timing table for 1100kv motor at precisely 12.5v,
+      // they are now the startup timing of the motor profile (BL_set_motor).
       // Nonetheless syncing seems to work better to back the commutation timing
       //  off at this point. A new addition now is that here the real speed (PWM-DC)
       // is ramped to the user input speed while waiting for sync to occur.
-      timing_ramp_control(timing_now, (uint16_t)BL_CT_STARTUP);
+#if defined( ZC_CLOSED_LOOP_ENABLED )
+      timing_ramp_control(timing_now, BL_motor.ct_startup);
 
-      // controller returns true upon successful control step
-      if (FALSE != BL_cl_control(timing_now))
+      if (FALSE != BL_try_cls_loop())
       {
-        BL_set_opstate( BL_CLS_LOOP );
         // start ramping speed (PWM duty-cycle) toward UI input speed
         inp_dutycycle = get_ramped_speed(BL_get_speed());
       }
       else
       {
-        // Ramp toward lower speed until closed-loop control is sync'd
-        inp_dutycycle = get_ramped_speed(PWM_PD_STARTUP);
+        // the duty-cycle is ramped to the UI input speed while waiting for
+        // sync but not lowered below the ramp duty-cycle, a rotor lagging
+        // the backed-off timing needs the torque, and less duty-cycle can
+        // lose it
+        inp_dutycycle = get_ramped_speed(BL_get_speed());
+
+        if (inp_dutycycle < BL_startup.ramp_duty)
+        {
+          inp_dutycycle = BL_startup.ramp_duty;
+        }
+
+        if (BL_optimer > 0)
+        {
+          BL_optimer -= 1;
+        }
+        else
+        {
+          // no sync, the spinning rotor is picked up from the coast
+          BL_start_resync(FALSE);
+          inp_dutycycle = 0;
+        }
+      }
+#else
+      // open-loop drive (no ZC closed-loop), the commutation period is ramped
+      // to the open-loop timing of the ramped speed input
+      inp_dutycycle = get_ramped_speed(BL_get_speed());
+
+      if (inp_dutycycle < BL_motor.duty_startup)
+      {
+        inp_dutycycle = BL_motor.duty_startup;
+      }
+      timing_target = Get_OL_Timing(inp_dutycycle);
+
+      // the timing is held beyond the timing curve
+      if (U16_MAX != timing_target)
+      {
+        timing_ramp_control(timing_now, timing_target);
       }
+#endif
     }
     else if (BL_CLS_LOOP == bl_opstate)
     {
-#define CL_FAULT_CNTR 2000u
-      static const uint16_t FAULT_INCR = 20;
-      static const uint16_t FAULT_DECR = 1;
-      static uint16_t fault_counter = CL_FAULT_CNTR;
-
-      // controller returns false upon failed control step
-      if (FALSE != BL_cl_control(BL_get_timing()))
+      // closed-loop control step is done at each commutation (sector) using
+      // the latest zero-crossing, so the result from the latest sector is checked
+      if (FALSE != BL_cl_sync)
       {
-        // if in-control, fill or reset leaky bucket
-        if (fault_counter < CL_FAULT_CNTR)
+        BL_cl_sync_timer = 0;
+
+        // sync held long enough following a resync
+        if (BL_cl_hold_timer < BL_TIME_RESYNC_HOLD)
+        {
+          BL_cl_hold_timer += 1;
+        }
+        else
         {
-          // fault_counter += FAULT_INCR;
-          fault_counter = CL_FAULT_CNTR;
+          BL_resync_tries = 0;
+          BL_cl_handoff = FALSE;
         }
       }
       else
       {
-        // tends to fault at cutover to CL ... use leaky-bucket to suppress
-        if (fault_counter > 0)
+        // tends to lose sync briefly at cutover to CL so it is tolerated for a time
+        BL_cl_sync_timer += 1;
+        BL_cl_hold_timer = 0;
+      }
+
+      // but not if the rotor has stalled in the handoff
+      if ( (FALSE != BL_cl_handoff) && (BL_cl_miss_count >= BL_CL_HANDOFF_MISS) )
+      {
+        BL_cl_sync_timer = BL_TIME_CL_SYNC_LOSS;
+      }
+
+      if (BL_cl_sync_timer < BL_TIME_CL_SYNC_LOSS)
+      {
+        // allow user speed input
+        if (FALSE != BL_brake_stop)
+        {
+          inp_dutycycle = get_ramped_speed(BL_motor.duty_startup);
+
+          // or at once if the regenerative brake is held by the supply voltage,
+          // the short brake returns no current to the supply
+          if ( (inp_dutycycle <= BL_motor.duty_startup) || (FALSE != BL_vbatt_ovs) )
+          {
+            BL_start_brake();
+            inp_dutycycle = 0;
+          }
+        }
+        else if (FALSE != BL_gov_enabled)
         {
-          fault_counter -= FAULT_DECR;
+          inp_dutycycle = BL_gov_control();
         }
         else
         {
-          // ideally, the system might be able to remain running opeon-loop at current
-          // setpoints even once control is lost
-//          BL_set_opstate( BL_OPN_LOOP );
-          Faultm_set(FAULT_1);
+          inp_dutycycle = get_ramped_speed(BL_get_speed());
         }
       }
-      // allow user speed input
-      inp_dutycycle = get_ramped_speed(BL_get_speed());
+      else if (BL_resync_tries < BL_RESYNC_TRIES)
+      {
+        // the motor coasts until resync to the rotor
+        BL_resync_tries += 1;
+        BL_start_resync(TRUE);
+      }
+      else
+      {
+        Faultm_set(FAULT_1);
+      }
+
+      // the measured period is learned as the open-loop timing of the duty-cycle
+      if (FALSE != BL_cl_sync)
+      {
+        Mdata_learn(inp_dutycycle, Seq_get_sector_period());
+      }
+    }
+
+    if ( ( ( (bl_opstate >= BL_ALIGN) && (bl_opstate <= BL_OPN_LOOP) ) ||
+           ( (BL_RESYNC == bl_opstate) && (FALSE == BL_resync_from_cl) ) ) &&
+         (BL_startup_timer < U16_MAX) )
+    {
+      BL_startup_timer += 1;
     }
     // end '0 == Faultm_get_status'
   }
 
+  BL_duty_cmd = inp_dutycycle;
+
+  // governor integrator tracks the duty-cycle for bumpless entry to closed-loop
+  if (BL_CLS_LOOP != BL_opstate)
+  {
+    BL_gov_integ = (int32_t)inp_dutycycle << 16;
+  }
+  BL_rpm_update();
+
+  // the arming pulse (voltage measurement) and the manual duty-cycle are not
+  // compensated
+  if ( (BL_ARMING != BL_opstate) && (BL_MANUAL != BL_opstate) )
+  {
+    inp_dutycycle = BL_vcomp( inp_dutycycle );
+  }
+
   // pwm duty-cycle is propogated to timer peripheral at next commutation step
   PWM_set_dutycycle( inp_dutycycle );
+
+  bl_status_publish();
 }
 
 
-/**
- * @brief Enum typedef for setting the 6-step sequence pointer
+/*
+ * Flying restart handoff to closed-loop at the commutation step.
+ *   ARMED: the poll period (BL_resync_control) is preloaded at this step.
+ *   POLL: upon a step within the first 1/4 of sector 0, 2 or 4, that sector is
+ *     driven and the remainder of the sector (less the poll period now
+ *     running) is scheduled.
+ *   SKIP: no step, this is within the first sector. The sector period is
+ *     scheduled and the closed-loop control started from the next step, or the
+ *     startup ramp if the speed is below the end of the ramp.
+ * Returns the sector to drive, or SECTOR_INVALID.
  */
-typedef enum
+static Seq_sector_t BL_resync_step(void)
 {
-  SECTOR_0 = 0,
-  SECTOR_1,
-  SECTOR_2,
-  SECTOR_3,
-  SECTOR_4,
-  SECTOR_5,
-  SECTOR_INVALID = -1
-}
-Seq_sector_t;
+  Seq_sector_t sector = SECTOR_INVALID;
+  uint16_t poll = BL_resync_period / 8;
+  uint16_t elapsed;
+
+  switch (BL_resync_stage)
+  {
+  case BL_RESYNC_ARMED:
+    BL_resync_stage = BL_RESYNC_POLL;
+    break;
+
+  case BL_RESYNC_POLL:
+    sector = (Seq_sector_t)Seq_get_coast_sector(&elapsed);
+
+    if (elapsed < (BL_resync_period / 4))
+    {
+      BL_set_timing(BL_resync_period - elapsed - poll);
+      BL_resync_stage = BL_RESYNC_SKIP;
+    }
+    else
+    {
+      sector = SECTOR_INVALID;
+    }
+    break;
+
+  case BL_RESYNC_SKIP:
+    BL_set_timing(BL_resync_period);
 
+    if (BL_resync_period > BL_startup.ramp_end)
+    {
+      // too slow for closed-loop, remainder of the startup ramp from here
+      BL_set_opstate( BL_RAMPUP );
+    }
+    else
+    {
+      BL_pi_reset(BL_resync_period);
+      BL_cl_sync = FALSE;
+      BL_cl_sync_timer = 0;
+      BL_cl_hold_timer = 0;
+      BL_cl_miss_count = 0;
+      BL_cl_handoff = TRUE;
+      BL_set_opstate( BL_CLS_LOOP );
+    }
+    break;
 
-//static Seq_sector_t Seq_step;
+  case BL_RESYNC_DETECT:
+  default:
+    break;
+  }
+  return sector;
+}
 
 /**
  * @brief  commutation sequence step (timer ISR callback)
  */
 void BL_commutation_step(void)
 {
-  static Seq_sector_t comm_step;
+  Seq_sector_t comm_step;
+#if defined( TRACE_ENABLED )
+  static uint8_t trace_opstate = BL_NONE; // latest opstate in the trace
+
+  // transitions are made by the control task, traced at the next sector
+  if (trace_opstate != BL_opstate)
+  {
+    TRACE_EVENT( TRACE_EV_OPSTATE, BL_opstate, trace_opstate );
+    trace_opstate = BL_opstate;
+  }
+#endif
+  TRACE_EVENT( TRACE_EV_COMM, BL_opstate, BL_motor_speed );
 
   switch( BL_get_opstate() )
   {
   case BL_ARMING:
-  case BL_ALIGN:
     // drive sector 0 directly to generate the system voltage measurement
     Sequence_Step_0();
     break;
 
+  case BL_ALIGN:
+    // the phases are shorted until the brake is released (BL_start_align)
+    if (0 == BL_align_brake)
+    {
+      Sequence_Step_0();
+      PWM_align_drive();
+    }
+    break;
+
   case BL_MANUAL:
   case BL_RAMPUP:
   case BL_OPN_LOOP:
   case BL_CLS_LOOP:
 
-    comm_step = (uint8_t)((comm_step + 1) % SEQ_N_CSTEPS);
-
-    if (BL_motor_speed > PWM_PD_SHUTOFF)
+    if (BL_motor_speed > BL_motor.duty_shutoff)
     {
+      // the step following alignment (sector 0) is sector 1
+      comm_step = (uint8_t)((Seq_get_sector() + 1) % SEQ_N_CSTEPS);
       Sequence_Step(comm_step);
+
+      // timing correction from zero-crossing of the sector just completed
+      if (BL_CLS_LOOP == BL_opstate)
+      {
+        BL_cl_sync = BL_cl_control();
+
+#if defined( TRACE_ENABLED )
+        // the integrator is not derived from the other events, for the replay
+        if (SECTOR_0 == comm_step)
+        {
+          TRACE_EVENT( TRACE_EV_PI, 0, BL_pi_integ );
+          TRACE_EVENT( TRACE_EV_PI, 1, BL_pi_integ >> 16 );
+        }
+#endif
+
+        if (0 != Seq_get_sector_period())
+        {
+          BL_cl_miss_count = 0;
+        }
+        else if (BL_cl_miss_count < U8_MAX)
+        {
+          BL_cl_miss_count += 1;
+        }
+#if defined( SCOPE_ENABLED )
+        Scope_timing_error( Seq_get_timing_error() );
+#endif
+      }
+    }
+    break;
+
+  case BL_RESYNC:
+
+    if (BL_motor_speed > BL_motor.duty_shutoff)
+    {
+      Seq_sector_t sector = BL_resync_step();
+
+      if (SECTOR_INVALID != sector)
+      {
+        comm_step = sector;
+        Sequence_Step(comm_step);
+      }
     }
     break;
 
   case BL_STOPPED:
+  case BL_BRAKING: // the phases are shorted until the brake is released
   case BL_NONE:
   default:
     break;
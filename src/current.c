@@ -0,0 +1,167 @@
+/**
+  ******************************************************************************
+  * @file current.c
+  * @brief Shunt current measurement and cycle-by-cycle current limit
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * The low-side shunt carries the motor current only in the PWM on-time (the
+  * freewheeling current circulates through the low-side FETs), so the shunt is
+  * scanned with the phase inputs at each PWM cycle and the sample is valid if
+  * the pulse is longer than the sample point. A shorter pulse is not measured,
+  * so the measurement is held and the pulse may grow by no more than the
+  * recovery step per cycle until it is sampled again (about 12% duty-cycle at
+  * 8 kHz).
+  *
+  * The limit is applied in the ADC ISR of the PWM cycle that exceeded it: the
+  * pulse limit of the PWM phase is reduced by 1/4 and written to the running
+  * compare register, so the present pulse is cut short (or ends immediately if
+  * the counter is already past the new limit). The limit recovers by a small
+  * step at each cycle below the limit. The duty-cycle commanded by the control
+  * task is not changed.
+  *
+  ******************************************************************************
+  */
+/**
+ * \defgroup current Current limit
+ * @brief Shunt current measurement and cycle-by-cycle current limit
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include "current.h"
+#include "pwm_stm8s.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+/*
+ * Sample point of the shunt in PWM timer counts from the start of the PWM
+ * on-time: the scan is started at PWM_ADC_TRIG_OFFSET (or in the PWM ISR
+ * without ADC_HW_TRIGGER) and the shunt (AIN3) follows the 3 phase inputs. A
+ * conversion is 14 ADC clocks (fMASTER / 4), the input is sampled in the first
+ * 3. The margin allows 2 us for starting the scan in software.
+ */
+#define CURRENT_SCAN_INDEX      3u
+#define CURRENT_SAMPLE_FMASTER  ( (CURRENT_SCAN_INDEX * 14u + 3u) * 4u + 32u )
+#define CURRENT_SAMPLE_COUNTS \
+  (uint16_t)( PWM_ADC_TRIG_OFFSET + CURRENT_SAMPLE_FMASTER / PWM_TIMER_PSC )
+
+// recovery of the pulse limit per PWM cycle, the full range in 256 cycles
+#define CURRENT_LIMIT_RECOVERY  (uint16_t)( PWM_PERIOD_COUNTS / 256u )
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint16_t Curr_limit = CURRENT_COUNTS( CURRENT_LIMIT_MA );
+static volatile uint16_t Curr_filt;   // filtered on-time current (ADC counts)
+static volatile uint16_t Curr_limit_cycles; // count of PWM cycles cut short
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Raise the pulse limit toward the full PWM period.
+ */
+static void limit_recover(void)
+{
+  uint16_t limit = PWM_get_pulse_limit();
+
+  if (limit < PWM_PERIOD_COUNTS)
+  {
+    limit += CURRENT_LIMIT_RECOVERY;
+
+    PWM_set_pulse_limit( (limit < PWM_PERIOD_COUNTS) ? limit : PWM_PERIOD_COUNTS );
+  }
+}
+
+/*
+ * Hold the pulse limit within the recovery step of the present pulse, which is
+ * too short to be sampled, so that a step of the duty-cycle is sampled before
+ * the pulse can be much longer than the sample point.
+ */
+static void limit_step(uint16_t pulse)
+{
+  uint16_t limit = pulse + CURRENT_LIMIT_RECOVERY;
+
+  if (PWM_get_pulse_limit() != limit)
+  {
+    PWM_set_pulse_limit(limit);
+  }
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Shunt current sample of the present PWM cycle
+ *
+ * @details Invoked from the ADC ISR at each PWM cycle, the current can be
+ *  limited within the same cycle.
+ *
+ * @param counts  ADC conversion of the shunt amplifier
+ */
+void Current_sample(uint16_t counts)
+{
+  uint16_t pulse = PWM_get_pulse();
+
+  if (0 == pulse)
+  {
+    // no phase is PWM'd
+    Curr_filt = (uint16_t)( (Curr_filt * 7u) >> 3 );
+    limit_recover();
+  }
+  else if (pulse <= CURRENT_SAMPLE_COUNTS)
+  {
+    // the pulse ended before the sample, the current is not known and the
+    // latest valid sample is held
+    limit_step(pulse);
+  }
+  else
+  {
+    Curr_filt = (uint16_t)( (Curr_filt * 7u + counts) >> 3 );
+
+    if (counts > Curr_limit)
+    {
+      PWM_set_pulse_limit( pulse - (pulse >> 2) );
+
+      if (Curr_limit_cycles < U16_MAX)
+      {
+        Curr_limit_cycles += 1;
+      }
+    }
+    else
+    {
+      limit_recover();
+    }
+  }
+}
+
+/**
+ * @brief Accessor for the motor current
+ *
+ * @return  Filtered on-time shunt current, ADC counts (CURRENT_MA_PER_COUNT)
+ */
+uint16_t Current_get(void)
+{
+  return Curr_filt;
+}
+
+/**
+ * @brief Set the current limit
+ *
+ * @param counts  Limit of the on-time shunt current, ADC counts
+ */
+void Current_set_limit(uint16_t counts)
+{
+  Curr_limit = counts;
+}
+
+/**
+ * @brief Accessor for the count of PWM cycles cut short by the current limit
+ *
+ * @return  Count of limited cycles, saturates at U16_MAX
+ */
+uint16_t Current_get_limit_cycles(void)
+{
+  return Curr_limit_cycles;
+}
+
+/**@}*/ // defgroup
@@ -15,9 +15,13 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "mcu_stm8s.h"
+#include "hal_stm8s.h"
 #include "bldc_sm.h"
-#include "per_task.h"
 #include "pwm_stm8s.h"
+#include "sequence.h"
+#include "telem.h"
+#include "current.h"
+#include "trace.h"
 #include "driver.h"
 
 /* Private defines -----------------------------------------------------------*/
@@ -33,20 +37,76 @@
 #define GET_BACK_EMF_ADC( ) \
     ( ADC_Global - DC_HALF_REF )
 
+/*
+ * DShot frame is 16 bits MSB first: 11-bit throttle, telemetry request and
+ * 4-bit CRC. Every bit has the same period, the high time is 37.5% of the
+ * period for a 0 and 75% for a 1. Throttle values 1:47 are commands (not
+ * supported), 48:2047 is the throttle range.
+ */
+#define DSHOT_FRAME_BITS    16
+#define DSHOT_THR_MIN       48
+#define DSHOT_THR_RANGE     (2048 - DSHOT_THR_MIN)
+
+// number of consecutive pulses for detection of a fast throttle protocol
+#define THR_DETECT_COUNT    DSHOT_FRAME_BITS
+
+// bit count while the rest of a frame is discarded, i.e. until the next gap
+#define DSHOT_NO_SYNC       0xFF
+
+// bit period of DShot150, and the longest bit period accepted (+25%)
+#define DSHOT_BIT_TM        (uint16_t)(TCC_FAST_TICKS_PER_US * 1000uL / 150)
+#define DSHOT_BIT_TM_MAX    (DSHOT_BIT_TM + DSHOT_BIT_TM / 4)
+
+// throttle scaled to PWM duty-cycle counts (Q16)
+#define DSHOT_THR_SCALE_Q16 \
+    (uint32_t)( ( (uint32_t)PWM_PERIOD_COUNTS << 16 ) / DSHOT_THR_RANGE )
+
 /* Private types -----------------------------------------------------------*/
 /* Public variables  ---------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
-static uint16_t ADC_Global;
+// written by the ADC ISR, read only by the commutation ISR (Driver_Get_ADC),
+// which is at the same priority level i.e. preempts neither the write nor the read
+static volatile uint16_t ADC_Global;
 static uint16_t prev_pulse_start_tm;
 static uint16_t curr_pulse_start_tm;
 static uint16_t Pulse_perd;
 static uint16_t Pulse_dur;
 
+static Driver_thr_proto_t Throttle_proto;
+static Driver_thr_proto_t Thr_detect_proto;
+static uint8_t Thr_detect_count;
+static bool Thr_isr_enabled;
+static uint8_t Dshot_nbits = DSHOT_NO_SYNC;
+static uint16_t Dshot_word;
+static uint16_t Dshot_bit_tm = DSHOT_BIT_TM;
+static uint16_t Thr_frames;
+
+// throttle of the latest fast protocol frame, written by the capture ISR and
+// passed to the controller by the control task (Driver_Update)
+static uint16_t Thr_speed;
+static bool Thr_speed_ready;
+
+// Rx ring, the head is written by the Rx ISR and the tail by the reader
 static uint8_t rxReceive[RX_BUFFER_SIZE];
+static volatile uint8_t rxHead;
+static uint8_t rxTail;
+
+/**
+ * @brief ADC channels of the phase A, B, C back-EMF sensor inputs
+ */
+static const uint8_t Phase_ADC_ch[] =
+{
+  PH0_BEMF_IN_CH,
+#if defined( ZC_CLOSED_LOOP_ENABLED )
+  PH1_BEMF_IN_CH,
+  PH2_BEMF_IN_CH
+#endif
+};
 
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
+
 /* External functions ---------------------------------------------------------*/
 
 /** @cond */
@@ -54,28 +114,24 @@ static uint8_t rxReceive[RX_BUFFER_SIZE];
 /*
  * accessors ********************************
  */
-#if defined( S105_DEV )
+#if defined( HAL_SERVO_TIMER )
 
 uint16_t get_pulse_start(void)
 {
-  return TIM2_GetCapture1();
-}
+  uint16_t t16;
 
-uint16_t get_pulse_end(void)
-{
-  return TIM2_GetCapture2();
-}
+  HAL_TIM_GET_CCR( HAL_SERVO_CCR_RISE, t16 );
 
-#elif defined(S105_DISCOVERY)
-
-uint16_t get_pulse_start(void)
-{
-  return TIM1_GetCapture4();
+  return t16;
 }
 
 uint16_t get_pulse_end(void)
 {
-  return TIM1_GetCapture3();
+  uint16_t t16;
+
+  HAL_TIM_GET_CCR( HAL_SERVO_CCR_FALL, t16 );
+
+  return t16;
 }
 
 #else // unimplemented ... stm8s003
@@ -92,6 +148,143 @@ uint16_t get_pulse_end(void)
 #endif
 /** @endcond */
 
+/*
+ * Validate the CRC of a DShot frame and pass the throttle to the controller.
+ * The CRC is the XOR of the three nibbles of the 12-bit value.
+ */
+static void dshot_on_frame(uint16_t frame)
+{
+  uint16_t value = frame >> 4;
+  uint16_t crc = (value ^ (value >> 4) ^ (value >> 8)) & 0x0F;
+  uint16_t throttle = value >> 1;
+
+  if (crc != (frame & 0x0F))
+  {
+    return;
+  }
+
+  Thr_frames += 1;
+
+  if ( (0 != throttle) && (throttle < DSHOT_THR_MIN) )
+  {
+    return; // command frame, the throttle is not changed
+  }
+
+  if (0 != throttle)
+  {
+    throttle = (uint16_t)(
+      ( (uint32_t)(throttle - DSHOT_THR_MIN) * DSHOT_THR_SCALE_Q16 ) >> 16 );
+  }
+
+  if (FALSE != Thr_isr_enabled)
+  {
+    Thr_speed = throttle;
+    Thr_speed_ready = TRUE;
+  }
+}
+
+/*
+ * Classify the signal at the servo input by pulse period and width, the
+ * capture is switched to the fast protocol once it is seen on a number of
+ * consecutive pulses.
+ */
+static void thr_detect(uint16_t pulse_dur)
+{
+  Driver_thr_proto_t proto = THR_PROTO_SERVO;
+
+  if (Pulse_perd < TCC_TIME_DSHOT_DETECT)
+  {
+    proto = THR_PROTO_DSHOT;
+  }
+  else if (pulse_dur < TCC_TIME_MULTISHOT_DETECT)
+  {
+    proto = THR_PROTO_MULTISHOT;
+  }
+  else if (pulse_dur < TCC_TIME_ONESHOT_DETECT)
+  {
+    proto = THR_PROTO_ONESHOT125;
+  }
+
+  if (proto != Thr_detect_proto)
+  {
+    Thr_detect_proto = proto;
+    Thr_detect_count = 0;
+  }
+  else if (THR_PROTO_SERVO != proto)
+  {
+    Thr_detect_count += 1;
+
+    if (Thr_detect_count >= THR_DETECT_COUNT)
+    {
+      if (THR_PROTO_DSHOT == proto)
+      {
+        MCU_servo_dshot_mode();
+      }
+      else
+      {
+        MCU_servo_fast_mode();
+      }
+      Throttle_proto = proto;
+      Pulse_dur = 0;
+    }
+  }
+}
+
+/*
+ * Decode the DShot bit preceding a rising edge. The bit period is taken from
+ * rise to rise and the high time from the falling edge capture, which holds
+ * until the falling edge of the next bit i.e. the capture ISR may be delayed
+ * by up to the high time of a 0 (37.5% of the bit). A falling edge captured
+ * over before it could be read loses the bit and the rest of the frame is
+ * discarded. A bit period longer than two bits is the gap between frames so
+ * the rise is the first bit of a frame, and the last bit of a frame is decoded
+ * from the period of the previous bit at the first rise of the next frame.
+ * The bit threshold is half of the measured bit period so that DShot150 and
+ * DShot300 are both decoded.
+ */
+static void dshot_on_bit(void)
+{
+  uint16_t rise_tm = get_pulse_start();
+  uint16_t bit_tm = rise_tm - curr_pulse_start_tm;
+  uint16_t high_tm = get_pulse_end() - curr_pulse_start_tm;
+  bool is_gap =
+    (bit_tm > DSHOT_BIT_TM_MAX) || (bit_tm > (uint16_t)(Dshot_bit_tm << 1));
+
+  curr_pulse_start_tm = rise_tm;
+
+  if (FALSE == is_gap)
+  {
+    Dshot_bit_tm = bit_tm;
+  }
+
+  if (high_tm >= bit_tm)
+  {
+    Dshot_nbits = DSHOT_NO_SYNC; // the falling edge is of the new bit
+  }
+  else if (DSHOT_NO_SYNC != Dshot_nbits)
+  {
+    Dshot_word <<= 1;
+
+    if ( (uint16_t)(high_tm << 1) > Dshot_bit_tm )
+    {
+      Dshot_word |= 1;
+    }
+
+    Dshot_nbits += 1;
+
+    if (Dshot_nbits >= DSHOT_FRAME_BITS)
+    {
+      Dshot_nbits = 0;
+      dshot_on_frame(Dshot_word);
+    }
+  }
+
+  if (FALSE != is_gap)
+  {
+    Dshot_nbits = 0;
+  }
+}
+
 /**
  * @brief Accessor for measured pulse period.
  */
@@ -125,6 +318,33 @@ uint16_t Driver_get_servo_position_counts(void)
   return thr_posn_cnt;
 }
 
+/**
+ * @brief Accessor for the detected throttle protocol.
+ */
+Driver_thr_proto_t Driver_get_throttle_proto(void)
+{
+  return Throttle_proto;
+}
+
+/**
+ * @brief Enable the throttle of the fast protocols.
+ * @details The throttle of each valid frame of a fast protocol (OneShot125,
+ *   Multishot, DShot) is latched by the capture ISR and passed to the
+ *   controller (BL_set_speed()) at the next control task.
+ */
+void Driver_thr_isr_enable(bool enable)
+{
+  Thr_isr_enabled = enable;
+}
+
+/**
+ * @brief Accessor for the count of valid frames of a fast protocol.
+ */
+uint16_t Driver_get_thr_frames(void)
+{
+  return Thr_frames;
+}
+
 /**
  * @brief Accessor for system voltage measurement.
  * @details Phase voltage measurement from ADC Channel 0 is to be used as
@@ -137,57 +357,78 @@ uint16_t Driver_Get_ADC(void)
 }
 
 /**
- * @brief  Fill Rx Buffer in ISR Context
- *
- * @details  Invoked from Rx ISR
+ * @brief Accessor for phase voltage measurement.
+ * @details Reads the ADC scan buffer register of the given motor phase. The
+ *   scan sequence converts all phase channels on each PWM cycle so the latest
+ *   sample of any phase is available in the buffer without further conversion.
+ * @param phase  Motor phase index (0:A, 1:B, 2:C)
+ * @return  Most recent captured ADC conversion value of the phase
  */
-void Driver_Get_Rx_It(void)
+uint16_t Driver_Get_ADC_Phase(uint8_t phase)
 {
-  static uint8_t rxPos = 0;
-
-#if defined( S105_DEV ) || defined( S105_DISCOVERY )
-
-  rxReceive[rxPos] = UART2_ReceiveData8();
-
-#elif defined( S003_DEV )
+  uint16_t adc = 0;
 
-  rxReceive[rxPos] = UART1_ReceiveData8();
-
-#endif
-
-  rxPos++;
-
-  if (rxPos > (RX_BUFFER_SIZE - 1))
+#if !defined( ZC_CLOSED_LOOP_ENABLED )
+  // only phase A is sensed, no back-EMF is seen of phase B and C
+  if (phase >= sizeof(Phase_ADC_ch))
   {
-    rxPos = 0;
+    return adc;
   }
+#endif
+  HAL_ADC_GET_BUFFER( Phase_ADC_ch[ phase ], adc );
+
+  return adc;
 }
 
 /**
- * @brief  Return Rx Buffer
+ * @brief Reschedule the commutation step of the present sector.
+ * @details Invoked from the ADC ISR at the zero-crossing, which has the
+ *   priority level of the commutation ISR i.e. the sector does not end during
+ *   the update (see MCU_set_comm_delay()).
+ * @param delay  Commutation timer counts from now to the commutation step
  */
-uint8_t Driver_Return_Rx_Buffer(void)
+void Driver_set_comm_delay(uint16_t delay)
 {
-  static uint8_t rxReadLoc = 0;
+  MCU_set_comm_delay(delay);
+}
 
-  uint8_t tmp = rxReceive[rxReadLoc];
+/**
+ * @brief  Fill Rx Buffer in ISR Context
+ *
+ * @details  Invoked from Rx ISR
+ */
+void Driver_Get_Rx_It(void)
+{
+  uint8_t rxByte;
+  uint8_t next = (rxHead + 1) & (RX_BUFFER_SIZE - 1);
 
-  rxReadLoc += 1;
+  HAL_UART_GET_RX( rxByte );
 
-  if (rxReadLoc > (RX_BUFFER_SIZE - 1))
+  // the byte is dropped if the ring is full
+  if (next != rxTail)
   {
-    rxReadLoc = 0;
+    rxReceive[rxHead] = rxByte;
+    rxHead = next;
   }
-
-  return tmp;
 }
 
 /**
- * @brief  Clear Rx Buffer Element
+ * @brief  Get the next byte from the Rx ring
+ *
+ * @param [out] p_byte  Received byte
+ * @return  FALSE if the ring is empty
  */
-void Driver_Clear_Rx_Buffer_Element(uint8_t Location)
+bool Driver_Get_Rx_Byte(uint8_t *p_byte)
 {
-  rxReceive[Location] = 0;
+  if (rxTail == rxHead)
+  {
+    return FALSE;
+  }
+
+  *p_byte = rxReceive[rxTail];
+  rxTail = (rxTail + 1) & (RX_BUFFER_SIZE - 1);
+
+  return TRUE;
 }
 
 /*
@@ -196,10 +437,17 @@ void Driver_Clear_Rx_Buffer_Element(uint8_t Location)
 
 /**
  * @brief Call from timer/capture ISR on capture of rising edge of servo pulse
- *
+ * @details With DShot throttle, this is the only capture interrupt and each
+ *   invocation decodes the preceding bit.
 */
 void Driver_on_capture_rise(void)
 {
+  if (THR_PROTO_DSHOT == Throttle_proto)
+  {
+    dshot_on_bit();
+    return;
+  }
+
 // 16-bit counter setup to wrap at 0xffff so no concern for sign of result
   prev_pulse_start_tm = curr_pulse_start_tm;
   curr_pulse_start_tm = get_pulse_start();
@@ -211,13 +459,52 @@ void Driver_on_capture_rise(void)
 
 /**
  * @brief Call from timer/capture ISR on capture of falling edge of servo pulse
+ * @details The pulse duration is in counts of the servo pulse for all of the
+ *   pulse width protocols (analog servo, OneShot125, Multishot). The falling
+ *   edge is read by the rising edge ISR with DShot throttle.
  */
 void Driver_on_capture_fall(void)
 {
-  uint16_t t16 = get_pulse_end() - curr_pulse_start_tm /* get_pulse_start() */;
+  uint16_t t16;
 
-  // apply exponential filter (simple moving average) to smooth the signal
-  Pulse_dur = (Pulse_dur + t16) / 2;
+  if (THR_PROTO_DSHOT == Throttle_proto)
+  {
+    return;
+  }
+
+  t16 = get_pulse_end() - curr_pulse_start_tm /* get_pulse_start() */;
+
+  if (THR_PROTO_SERVO == Throttle_proto)
+  {
+    // apply exponential filter (simple moving average) to smooth the signal
+    Pulse_dur = (Pulse_dur + t16) / 2;
+
+    thr_detect(t16);
+  }
+  else
+  {
+    // fast protocols are not filtered, the throttle is passed on every frame
+    if (THR_PROTO_MULTISHOT == Throttle_proto)
+    {
+      if (t16 < TCC_MULTISHOT_MIN)
+      {
+        t16 = TCC_MULTISHOT_MIN;
+      }
+      else if (t16 > TCC_MULTISHOT_MAX)
+      {
+        t16 = TCC_MULTISHOT_MAX;
+      }
+      t16 = TCC_MULTISHOT_TO_SERVO( t16 );
+    }
+    Pulse_dur = t16;
+    Thr_frames += 1;
+
+    if (FALSE != Thr_isr_enabled)
+    {
+      Thr_speed = PWM_get_servo_position_counts( Pulse_dur );
+      Thr_speed_ready = TRUE;
+    }
+  }
 
 // clear test pin
 //    GPIO_WriteLow(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
@@ -228,18 +515,16 @@ void Driver_on_capture_fall(void)
  *
  * @details  Invoked from timer ISR.
  * Phase voltage measurements must be synchronized to PWM.
- * Initiates ADC sample sequence on start of PWM pulse.
+ * Initiates ADC sample sequence on start of PWM pulse. Not used with
+ * ADC_HW_TRIGGER, where the PWM timer starts the conversion in hardware.
  */
 void Driver_on_PWM_edge(void)
 {
   /* Toggles LED to verify task timing */
 //  GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
 
-  // Enable the ADC: 1 -> ADON for the first time it just wakes the ADC up
-  ADC1_Cmd(ENABLE);
-
-  // ADON = 1 for the 2nd time => starts the ADC conversion
-  ADC1_StartConversion();
+  // ADON is set twice: wakes the ADC up (if powered down), starts the conversion
+  HAL_ADC_START();
 }
 
 /**
@@ -251,62 +536,69 @@ void Driver_on_PWM_edge(void)
  */
 void Driver_on_ADC_conv(void)
 {
-  ADC_Global = ADC1_GetBufferValue( PH0_BEMF_IN_CH );
+#if defined( CURRENT_SENSE_ENABLED )
+  uint16_t ishunt;
+
+  // current limit first, the pulse of the present PWM cycle can be cut short
+  HAL_ADC_GET_BUFFER( ISHUNT_IN_CH, ishunt );
+  Current_sample( ishunt );
+#endif
+
+  HAL_ADC_GET_BUFFER( PH0_BEMF_IN_CH, ADC_Global );
+
+  // run the zero-crossing detector on the floating phase at each PWM sample
+  Seq_Bemf_Sample();
 
 // GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
 }
 
 /**
- * @brief  System Timer event handler
+ * @brief  BL Control Task
  *
  * @details
- *   Event handler for System Timer ISR. The event handler multiplexes the
- *   BL Control Task and the Periodic Task which occur at different rates.
- *   Responsible for updating the Commutation Timer period - invokes accessors
- *   from both MCU and BL classes.
- *   Presently all configurations use 16Mhz timer with PS=2
+ *   Handler of the control rate group (SCHED_RG_CONTROL), deferred from the
+ *   System Timer (PWM) ISR by the scheduler and preemptible by all ISRs. The
+ *   updated commutation period is applied by the commutation timer ISR at the
+ *   next sector (see Driver_Step()).
+ *   The PWM profile (PWM_PROFILE) sets the timer prescaler and period, and
+ *   the rate divider (SCHED_DIV_CONTROL) keeps the control rate (the default
+ *   7.8 kHz profile is shown):
  *
  *   System Timer period = fMaster    * PS * 100%DC
  *                       = (1/16 Mhz) * 2  * 1024 counts -> 0.000128 S
  *
- *    BL Control Timer frequency                        =
- *      timer period * ISR frame count * CT_FRAME       =
- *      0.000128 sec * 4 ISRs          * 2 timer events = 0.001024 seconds (~1000 Hz)
+ *    BL Control Timer frequency                =
+ *      timer period * SCHED_DIV_CONTROL        =
+ *      0.000128 sec * 8 ISRs = 0.001024 seconds (~1000 Hz)
  *
- *    Periodic Task Timer frequency                      =
- *      timer period * ISR frame count * UI_FRAME        =
- *      0.000128     * 4 ISRs          * 32 timer events = 0.016384 seconds (~60 Hz)
+ *    Periodic Task Timer frequency             =
+ *      timer period * SCHED_DIV_UI             =
+ *      0.000128     * 128 ISRs = 0.016384 seconds (~60 Hz)
  *
  */
 void Driver_Update(void)
 {
-  static const uint8_t UI_FRAME = 0x20; // UI task every 32 steps (even) 
-                                        //  i.e. 32 * 4 ISRs * 0.128 ms = 16.4 ms
-  static const uint8_t CT_FRAME = 0x01; // control task on odd steps i.e. @ 1.024 ms
-
-  static uint8_t trate = 0;
-  trate += 1;
-
-  // the controller and the UI are updated on alternate frames (doubled the
-  // timer rate) presently ths update done every 1.024mS so the controller 
-  // rate ~1Khz  (0.9765625 seconds)
-  if (0 != (trate & CT_FRAME))
+  // the control task is preemptible, the throttle latched by the capture ISR
+  // is handed off to the controller in a CS (BL_set_speed() may reset it)
+  disableInterrupts();  //////////////// DI
+  if (FALSE != Thr_speed_ready)
   {
-    BL_state_control();  // update commutation timing controller
+    Thr_speed_ready = FALSE;
+    BL_set_speed(Thr_speed);
+  }
+  enableInterrupts();  ///////////////// EI
+
+#if defined( TRACE_ENABLED )
+  // input of the control step, for replay of the trace
+  Trace_task_event( TRACE_EV_CTRL, BL_get_opstate(), BL_get_speed() );
+#endif
 
-    // refresh the timer with the updated commutation time period
-    MCU_set_comm_timer( BL_get_timing() );
+  BL_state_control();  // update commutation timing controller
 
-    /* Toggles LED to verify task timing */
-    //GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
-  }
-  else if (0 == (trate % UI_FRAME))
-  {
-    Periodic_Task_Wake();
+  Telem_Sample(); // telemetry is sampled at the control rate
 
-    /* Toggles LED to verify task timing */
-    // GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
-  }
+  /* Toggles LED to verify task timing */
+  //GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
 }
 
 /**
@@ -314,33 +606,17 @@ void Driver_Update(void)
  *
  * @details  Invoked from timer ISR
  *
- *   Every 4th timer event constitutes a 60-degree commutation "sector" at which
- *   time _Commutation_Step() is invoked.
- *   The timer was set up 4x faster than the commutation rate as a provision to
- *   coordinate PWM sampling for zero-crossing detection (still TBD).
+ *   Each timer event constitutes a 60-degree commutation "sector" at which
+ *   time BL_commutation_step() is invoked. The resolution of the commutation
+ *   period is that of the timer clock (see MCU_set_comm_timer()).
  */
 void Driver_Step(void)
 {
-  static const uint8_t Modulus = 4;
-  static int index = 0;
-
-  // The modulus being used (4) is a power of 2, so a bitwise & can be used
-  // instead of a MOD (%) to save a few instructions, which is actually significant
-  // as this is a very high frequency ISR!
-  index = (index + 1) & (Modulus - 1);
+  BL_commutation_step();
 
-  switch(index)
-  {
-  case 0:
-    BL_commutation_step();
-    break;
-
-  case 1:
-  case 2:
-  case 3:
-  default:
-    break;
-  }
+  // period of the next sector, scheduled once per sector at the commutation
+  // step - the reload is preloaded so it takes effect at the next update
+  MCU_set_comm_period( BL_get_timing() );
 
   /* Toggles LED */
   //GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
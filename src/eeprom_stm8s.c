@@ -0,0 +1,153 @@
+/**
+  ******************************************************************************
+  * @file eeprom_stm8s.c
+  * @brief Non-blocking write of the data EEPROM
+  * @author Neidermeier
+  * @version
+  * @date June-2022
+  ******************************************************************************
+  *
+  * Programming a byte of data EEPROM takes ~6 ms (erase + write). The data
+  * EEPROM is read-while-write, so the CPU continues to execute from program
+  * memory while the byte is programmed, and the end of programming (EOP)
+  * interrupt starts programming of the next byte. The control ISRs are never
+  * stalled by a write, and only the bytes that differ from the EEPROM content
+  * are programmed.
+  *
+  ******************************************************************************
+  */
+/**
+ * @defgroup eeprom Data EEPROM
+ * @brief Non-blocking write of the data EEPROM
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+
+#include "eeprom_stm8s.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+// data EEPROM is within the 16-bit address space on all supported MCUs
+#define EEPROM_BYTE( _ofs_ ) \
+  ( ( (volatile uint8_t *)FLASH_DATA_START_PHYSICAL_ADDRESS )[ (_ofs_) ] )
+
+/* Private variables ---------------------------------------------------------*/
+
+// the source buffer must remain valid and unchanged until the write finishes
+static const uint8_t *Wr_buf;
+static uint16_t Wr_offset;
+static uint8_t Wr_index;
+static volatile uint8_t Wr_len; // length of the write in progress, 0 if none
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Start programming of the next byte that differs from the EEPROM content, or
+ * finish the write and lock the data EEPROM.
+ */
+static void program_next(void)
+{
+  while (Wr_index < Wr_len)
+  {
+    uint16_t ofs = Wr_offset + Wr_index;
+    uint8_t data = Wr_buf[ Wr_index ];
+
+    Wr_index += 1;
+
+    if (data != EEPROM_BYTE( ofs ))
+    {
+      EEPROM_BYTE( ofs ) = data; // starts programming
+      return;
+    }
+  }
+
+  FLASH->CR1 &= (uint8_t)(~FLASH_CR1_IE);
+  FLASH->IAPSR &= (uint8_t)(~FLASH_IAPSR_DUL); // lock
+  Wr_len = 0;
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Read from the data EEPROM
+ * @param offset  Offset from start of data EEPROM
+ * @param [out] buf  Destination
+ * @param len  Number of bytes
+ */
+void EEPROM_read(uint16_t offset, uint8_t *buf, uint8_t len)
+{
+  uint8_t n;
+
+  for (n = 0; n < len; n++)
+  {
+    buf[ n ] = EEPROM_BYTE( offset + n );
+  }
+}
+
+/**
+ * @brief Start a write of the data EEPROM
+ * @details  Returns immediately, the bytes are programmed in the background
+ *   by the EOP interrupt (see EEPROM_on_eop).
+ * @param offset  Offset from start of data EEPROM
+ * @param buf  Source, not to be modified until the write is finished
+ * @param len  Number of bytes
+ * @return FALSE if a write is already in progress or out of range
+ */
+bool EEPROM_write(uint16_t offset, const uint8_t *buf, uint8_t len)
+{
+  if ( (0 != Wr_len) || (0 == len) || ((offset + len) > EEPROM_SIZE) )
+  {
+    return FALSE;
+  }
+
+  Wr_buf = buf;
+  Wr_offset = offset;
+  Wr_index = 0;
+  Wr_len = len;
+
+  // unlock key sequence of the data EEPROM (0xAE, 0x56)
+  FLASH->DUKR = FLASH_RASS_KEY2;
+  FLASH->DUKR = FLASH_RASS_KEY1;
+
+  while (0 == (FLASH->IAPSR & FLASH_IAPSR_DUL))
+  {
+    // wait for the data EEPROM to be unlocked
+  }
+
+  FLASH->CR1 |= FLASH_CR1_IE;
+
+  program_next();
+
+  return TRUE;
+}
+
+/**
+ * @brief Test for write in progress
+ * @return TRUE if a write is in progress
+ */
+bool EEPROM_busy(void)
+{
+  return (0 != Wr_len);
+}
+
+/**
+ * @brief End of programming handler (FLASH ISR)
+ * @details  Reading IAPSR clears the EOP and WR_PG_DIS flags. The write is
+ *   abandoned if programming was disabled (write protected).
+ */
+void EEPROM_on_eop(void)
+{
+  uint8_t iapsr = FLASH->IAPSR;
+
+  if (0 != (iapsr & FLASH_IAPSR_WR_PG_DIS))
+  {
+    Wr_index = Wr_len;
+  }
+
+  if (0 != Wr_len)
+  {
+    program_next();
+  }
+}
+
+/**@}*/ // defgroup
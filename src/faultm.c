@@ -16,34 +16,25 @@
 /* Includes ------------------------------------------------------------------*/
 #include <string.h> // memset
 #include "faultm.h" // public types used internally
+// sources of the state snapshot of the event log
+#include "bldc_sm.h"
+#include "sequence.h"
+#include "pwm_stm8s.h"
+#include "trace.h"
+#include "scope.h"
 
 
 /* Private defines -----------------------------------------------------------*/
 
 /**
- * @brief  Initialization value for fault counter bucket.
+ * @brief  Latch flag of the fault descriptor.
  *
- * @details  The fault matrix defines the bucket as a 6-bits unsigned integer bit-field.
- *
- * @note  This value should be derived from the faultm update rate somehow - it is
- * expected that faulm_upd() would be called for all fault codes from within
- * the background task. Therefore the bucket counts and/or increment rates should
- * share a timing factor with the background task.
+ * @details  A latched fault can only be cleared by Faultm_init (motor reset), an
+ * unlatched fault is cleared when its bucket has drained to the clear
+ * threshold.
  */
-#define  FAULT_BUCKET_BITS   6 // power of 2 ...  2^6==64
-
-// size limit of bucket - the fault is latched if the fault count reaches the limit
-#define  FAULT_BUCKET_MASK   ( ( 1 << FAULT_BUCKET_BITS ) - 1)  // 63 // 6-bits bit-field
-#define  FAULT_BUCKET_LIM     FAULT_BUCKET_MASK
-
-// INI must be <= Limit
-#define  FAULT_BUCKET_INI    (48 - 1)
-
-
-/**
- * @brief The fault status word is 8-bits wide.
- */
-#define NR_DEFINED_FAULTS  8
+#define  FAULT_LATCH    TRUE
+#define  FAULT_NOLATCH  FALSE
 
 
 /* Private types -----------------------------------------------------------*/
@@ -69,16 +60,30 @@ typedef enum
     ENABLED = !DISABLED
 } faultm_enable_t;
 
+/**
+ * @brief Fault descriptor (compile-time constant).
+ *
+ * @details  The bucket counts up at each update with the fault condition
+ * asserted and down otherwise (leaky-bucket). The fault is set when the
+ * bucket reaches the set threshold, and cleared (unless latched) when the
+ * bucket has drained to the clear threshold. The thresholds are in units of
+ * the rate that Faultm_upd() is called for the fault.
+ */
+typedef struct
+{
+    uint8_t set_thr; /**< bucket count to set the fault, > 0 */
+    uint8_t clr_thr; /**< bucket count to clear the fault, < set_thr */
+    bool latch;      /**< set fault remains set until Faultm_init */
+} faultm_desc_t;
+
 /**
  * @brief Fault tracking table.
  *
  * @details  Compact table for tracking faults with leaky-bucket algorithm.
- *
- * @note  Fault matrix instantiated as an array of 8-bit words to save RAM.
  */
 typedef struct fault_matrix
 {
-    unsigned char bucket: FAULT_BUCKET_BITS; /**< bucket counter (6 bits). */
+    uint8_t bucket; /**< bucket counter. */
     faultm_enable_t enabled: 1; /**< Enable bit. */
     faultm_state_t state:  1; /**< Fault activation state. */
 
@@ -95,44 +100,114 @@ fault_status_reg_t fault_status_reg;
 
 /* Private variables ---------------------------------------------------------*/
 
+/**
+ * @brief Fault descriptors, indexed by faultm_ID_t.
+ *
+ * @details  VOLTAGE_NG is updated by the periodic task (~60 Hz) i.e. the stall
+ * voltage must persist for ~0.8 s. FAULT_1 and OVER_CURRENT are set directly
+ * by the controller (Faultm_set).
+ */
+static const faultm_desc_t fault_desc[ NR_DEFINED_FAULTS ] =
+{
+    /* FAULT_0 */      { 48,  0, FAULT_LATCH },
+    /* FAULT_1 */      {  1,  0, FAULT_LATCH },
+    /* VOLTAGE_NG */   { 48,  0, FAULT_LATCH },
+    /* THROTTLE_HI */  { 32,  8, FAULT_NOLATCH },
+    /* OVER_CURRENT */ {  1,  0, FAULT_LATCH },
+};
+
 static faultm_mat_t fault_matrix[ NR_DEFINED_FAULTS ];
 
+// event log, not cleared by Faultm_init so that faults leading to a reset of
+// the motor remain available until the log is read out
+static faultm_event_t fault_log[ FAULTM_LOG_SZ ];
+static uint8_t fault_log_head; // index of the next entry to be written
+static uint8_t fault_log_count;
+
+static uint16_t fault_tick; // control task tick count
+
 
 /* Private function prototypes -----------------------------------------------*/
 
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * Append an event to the log with a snapshot of the controller state.
+ */
+static void log_event(uint8_t event)
+{
+    faultm_event_t * pevent = &fault_log[ fault_log_head ];
+
+    pevent->tick = fault_tick;
+    pevent->event = event;
+    pevent->opstate = BL_get_opstate();
+    pevent->duty = PWM_get_dutycycle();
+    pevent->period = BL_get_timing();
+    pevent->vsys = Seq_Get_Vbatt();
+
+    fault_log_head = (fault_log_head + 1) % FAULTM_LOG_SZ;
+
+    if (fault_log_count < FAULTM_LOG_SZ)
+    {
+        fault_log_count += 1;
+    }
+}
+
+/*
+ * Clear the fault state and status bit if the fault is not latched.
+ */
+static void fault_clr(faultm_ID_t faultm_ID)
+{
+    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
+
+    if ( (FCLR != pfaultm->state) && (FALSE == fault_desc[ faultm_ID ].latch) )
+    {
+        pfaultm->state = FCLR;
+        fault_status_reg &= (fault_status_reg_t)~FAULTM_MASK( faultm_ID );
+
+        log_event( (uint8_t)faultm_ID | FAULTM_EV_CLR );
+    }
+}
+
 
 /* Public functions ---------------------------------------------------------*/
 
 /**
  * @brief Initialize the Fault Manager
  *
- * Must be called each time the motor state changes from off to running.
+ * Must be called each time the motor state changes from off to running. The
+ * fault event log is retained.
  */
 void Faultm_init(void)
 {
-    uint16_t nnn;
+    uint8_t nnn;
 
     // intialize fault matrix
     memset(fault_matrix, 0, sizeof(fault_matrix) /* size in bytes */ );
 
-//fault_matrix[VOLTAGE_NG ].enabled = 1;
-//fault_matrix[THROTTLE_HI ].enabled = 1;
-
     for (nnn= 0; nnn < NR_DEFINED_FAULTS; nnn++)
     {
-        fault_matrix[nnn].enabled = TRUE;
+        fault_matrix[nnn].enabled = ENABLED;
     }
 
 // reset the fault status bitmap
     fault_status_reg = 0;
 }
 
+/**
+ * @brief Time base of the fault event log
+ *
+ * @details Invoked from ISR at the control task rate (~1 ms).
+ */
+void Faultm_tick(void)
+{
+    fault_tick += 1;
+}
+
 /**
  * @brief Returns the status word
  *
- * @details Returns the system status bitmap boolean state.
+ * @details Returns the system status bitmap, one bit per fault ID (FAULTM_MASK).
  * @retval  0  all faults cleared
  * @retval  !0  at least one fault is set
  */
@@ -149,64 +224,78 @@ fault_status_reg_t Faultm_get_status(void)
  */
 void Faultm_enable(faultm_ID_t faultm_ID, int enable_b)
 {
-// assert (fault_ID < MAX)
-
-// use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
-
-    pfaultm->enabled = enable_b;
+    if (faultm_ID < NR_DEFINED_FAULTS)
+    {
+        fault_matrix[ faultm_ID ].enabled = (FALSE != enable_b) ? ENABLED : DISABLED;
+    }
 }
 
 /**
  * @brief Set the fault matrix bit and status word.
  *
- * @note  A single fault shuts down the system, i.e. no need to flag/mask
- * multiple fault conditions.
+ * @details  The fault is set immediately regardless of the bucket threshold,
+ * if it is enabled. Simultaneous faults are indicated by their bits in the
+ * status word, and each fault is logged once when it is set.
+ *  Faults are set in ISR context (control task), so this function should be
+ *  invoked only from ISR or from within a CS.
  *
  * @param faultm_ID  Numerical ID of the fault to be set.
  */
 void Faultm_set(faultm_ID_t faultm_ID)
 {
-// assert (fault_ID < MAX)
+    faultm_mat_t * pfaultm;
+
+    if (faultm_ID >= NR_DEFINED_FAULTS)
+    {
+        return;
+    }
 
 // use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
+    pfaultm  = &fault_matrix[ faultm_ID ];
 
-//    fault_status_reg_t  mask = (1 << faultm_ID); // maybe ... not necessary for now
-    uint8_t  mask = (uint8_t) faultm_ID;
+// set bucket full so that the fault is held until the condition has cleared
+    pfaultm->bucket = fault_desc[ faultm_ID ].set_thr;
 
-    pfaultm->state =  (FALSE != pfaultm->enabled);
+    if ( (DISABLED != pfaultm->enabled) && (FSET != pfaultm->state) )
+    {
+        pfaultm->state = FSET;
+        fault_status_reg |= FAULTM_MASK( faultm_ID );
 
-// set bucket full ... wouldn't really need the "state" varaible
-    pfaultm->bucket = FAULT_BUCKET_INI;
+        log_event( (uint8_t)faultm_ID );
 
-    // note: OR allows multiple faults to be indicated in the status-word not that it
-    // makes much difference
-    fault_status_reg = mask; // |= mask;
+#if defined( TRACE_ENABLED )
+        Trace_freeze( (uint8_t)faultm_ID ); // the trace leading up to the fault
+#endif
+#if defined( SCOPE_ENABLED )
+        Scope_trigger( SCOPE_TRIG_FAULT );
+#endif
+    }
 }
 
 
 /**
  * @brief Manage fault status with leaky bucket.
+ * @details  To be invoked only from ISR or from within a CS (see Faultm_set).
  * @param faultm_ID  Numerical ID of the fault to be set.
  * @param tcondition  Boolean condition indicating if the fault condition was detected.
  */
 void Faultm_upd(faultm_ID_t faultm_ID, faultm_assert_t tcondition)
 {
-    // suspect that compiler clips the intermediate macro term out of range of 6-bit bitfield??
-    static const uint8_t const_lmt_term = FAULT_BUCKET_INI;
+    const faultm_desc_t * pdesc;
+    faultm_mat_t * pfaultm;
 
-// assert (fault_ID < MAX)
-//    fault_status_reg_t  mask = (1 << faultm_ID); // maybe ... not necessary for now
-    fault_status_reg_t  mask = (fault_status_reg_t) faultm_ID;
+    if (faultm_ID >= NR_DEFINED_FAULTS)
+    {
+        return;
+    }
 
-// use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
+    pdesc = &fault_desc[ faultm_ID ];
+    pfaultm  = &fault_matrix[ faultm_ID ];
 
     if (tcondition)
     {
-        // if bucket < thr, then increment it else latch the fault
-        if ( pfaultm->bucket < const_lmt_term )
+        // if bucket < thr, then increment it else set the fault
+        if ( pfaultm->bucket < (pdesc->set_thr - 1) )
         {
             pfaultm->bucket += 1;
         }
@@ -222,11 +311,57 @@ void Faultm_upd(faultm_ID_t faultm_ID, faultm_assert_t tcondition)
         {
             pfaultm->bucket -= 1; // leaky bucket
         }
-        else
+
+        if ( pfaultm->bucket <= pdesc->clr_thr )
         {
-// shouldnt need to do anything here ... we don't clear faults (requires system reset)
+            fault_clr(faultm_ID);
         }
     }
 }
 
+/**
+ * @brief Number of entries in the fault event log
+ */
+uint8_t Faultm_log_count(void)
+{
+    return fault_log_count;
+}
+
+/**
+ * @brief Read an entry of the fault event log
+ *
+ * @param n  Index of the entry, 0 is the oldest
+ * @param [out] p_event  Destination
+ * @return  FALSE if there is no such entry
+ */
+bool Faultm_log_get(uint8_t n, faultm_event_t *p_event)
+{
+    bool rv = FALSE;
+
+    disableInterrupts();  //////////////// DI
+
+    if (n < fault_log_count)
+    {
+        uint8_t index =
+            (uint8_t)(fault_log_head + FAULTM_LOG_SZ - fault_log_count + n) % FAULTM_LOG_SZ;
+
+        *p_event = fault_log[ index ];
+        rv = TRUE;
+    }
+
+    enableInterrupts();  ///////////////// EI
+
+    return rv;
+}
+
+/**
+ * @brief Clear the fault event log
+ * @details  To be invoked only from ISR or from within a CS.
+ */
+void Faultm_log_clear(void)
+{
+    fault_log_count = 0;
+    fault_log_head = 0;
+}
+
 /**@}*/ // defgroup
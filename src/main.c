@@ -13,11 +13,14 @@
  * @{
  */
 /* Includes ------------------------------------------------------------------*/
-#include <stdio.h>
-
 // app headers
 #include "mcu_stm8s.h"
+#include "term.h"
 #include "per_task.h"
+#include "mdata.h"
+#include "mparam.h"
+#include "pdu_manager.h"
+#include "sched.h"
 
 
 #ifdef _SDCC_
@@ -44,9 +47,20 @@ void main(int argc, char **argv)
   (void) argv;
 
   MCU_Init();
+
+  Mparam_init(); // motor profile selected in EEPROM
+
+  (void)Mdata_load(); // learned open-loop timing table from EEPROM
+
+#ifdef UART_IT_RXNE_ENABLE
+  Pdu_Manager_Init(); // node address on the multi-ESC bus
+#endif
+
   UI_Stop(); // resets and sets  initial control-state to ARMING
 
-  printf("\n\rProgram Startup (%hd)\n\r", BL_SW_VERSION);
+  Term_puts("\n\rProgram Startup (");
+  Term_dec(BL_SW_VERSION, 0);
+  Term_puts(")\n\r");
 
   enableInterrupts(); // interrupts are globally disabled by default
 
@@ -89,6 +103,8 @@ void main(int argc, char **argv)
       {
       }
     }
+
+    Sched_idle(); // wait for an interrupt unless background work is pending
   } // while 1
 }
 
@@ -16,7 +16,11 @@
 #include "stm8s_gpio.h"
 
 // app headers
+#include "mcu_stm8s.h"
+#include "hal_stm8s.h"
 #include "pwm_stm8s.h" // pwm timer channels
+#include "profile.h"
+#include "trace.h"
 
 /* Private defines -----------------------------------------------------------*/
 /**
@@ -33,83 +37,136 @@
 #define SDC_PORT  SDc_SD_PORT
 #define SDC_PIN   SDc_SD_PIN
 
-/**
- * @brief Forward declarations of low-level term IO functions 
- * Low-level access to support terminal IO on an available stm8s UART. Based on
- * example code from SPL ... Project/STM8S_StdPeriph_Examples/UART/UART1_Printf/
- * Macros for the prototypes were done evidently to support Raisonance compiler.
- */
-#ifdef _RAISONANCE_
-#define PUTCHAR_PROTOTYPE int putchar (char c)
-#define GETCHAR_PROTOTYPE int getchar (void)
-#elif defined (_COSMIC_)
-#define PUTCHAR_PROTOTYPE char putchar (char c)
-#define GETCHAR_PROTOTYPE char getchar (void)
-#else /* _IAR_ */
-#define PUTCHAR_PROTOTYPE int putchar (int c)
-#define GETCHAR_PROTOTYPE int getchar (void)
-#endif /* _RAISONANCE_ */
+/*
+ * Baud rate of the serial port, the multi-ESC bus (pdu_manager.h) needs a
+ * higher rate for the throttle frame and the telemetry reply of one node at
+ * each control step e.g. -DUART_BAUD=460800
+ */
+#if !defined( UART_BAUD )
+#define UART_BAUD  115200
+#endif
+
+/*
+ * UART TX pin (D5 on all boards), open-drain on the multi-ESC bus so that the
+ * TX outputs of the nodes are wired together with a single pull-up
+ */
+#define UART_TX_PORT  GPIOD
+#define UART_TX_PIN   GPIO_PIN_5
+
+/*
+ * Transmit FIFO size, must be a power of 2 (256 max). The S105 FIFO holds a
+ * complete status log line so that logging doesn't block the background task.
+ */
+#if defined( S003_DEV )
+#define TX_FIFO_SIZE  64 // RAM is scarce
+#else
+#define TX_FIFO_SIZE  256
+#endif
+
+#define TX_FIFO_NEXT( _I_ )  (uint8_t)(((_I_) + 1) & (TX_FIFO_SIZE - 1))
+
+/*
+ * Interrupt vector of the commutation timer update
+ */
+#if defined( S003_DEV )
+#define ITC_IRQ_COMM  ITC_IRQ_TIM1_OVF
+#else
+#define ITC_IRQ_COMM  ITC_IRQ_TIM3_OVF
+#endif
 
 
 /* Public variables  ---------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
 
+/*
+ * Transmit FIFO: single producer in background task context (head), drained by
+ * the UART TX-empty ISR (tail).
+ */
+static uint8_t Tx_fifo[TX_FIFO_SIZE];
+static volatile uint8_t Tx_head;
+static volatile uint8_t Tx_tail;
+static uint16_t Tx_dropped;
+
+// period of the next sector, preloaded again after a reschedule of the sector
+static uint16_t Comm_period;
+
 /* Private function prototypes -----------------------------------------------*/
 
 /* Private functions ---------------------------------------------------------*/
 
-/** @cond */
+/*
+ * Put a byte in the transmit FIFO, returns FALSE if the FIFO is full.
+ */
+static bool tx_fifo_put(uint8_t c)
+{
+  uint8_t next = TX_FIFO_NEXT(Tx_head);
 
-#ifdef STM8S105 // S105 Dev board or DISCOVERY
+  if (next == Tx_tail)
+  {
+    return FALSE;
+  }
+  Tx_fifo[Tx_head] = c;
+  Tx_head = next;
+  return TRUE;
+}
+
+/*
+ * Enable the TX-empty interrupt to start draining the FIFO.
+ */
+static void tx_start(void)
+{
+  HAL_UART->CR2 |= HAL_UART_CR2_TIEN;
+}
+
+/*
+ * Send the oldest byte from the FIFO by polling the UART. The TX interrupt is
+ * masked (only the UART source) so the ISR can't contend for the FIFO tail.
+ * Works with interrupts disabled i.e. from inside a critical section.
+ */
+static void tx_drain_one(void)
+{
+  HAL_UART->CR2 &= (uint8_t)~HAL_UART_CR2_TIEN;
+
+  while ( 0 == (HAL_UART->SR & HAL_UART_SR_TXE) ) {}
+
+  HAL_UART->DR = Tx_fifo[Tx_tail];
+  Tx_tail = TX_FIFO_NEXT(Tx_tail);
+}
+
+/** @cond */
 
 /**
   * @brief Low-level character IO on the serial terminal
-  * @details Based on SPL example from STM8S_StdPeriph_Examples/UART/UART1_Printf/
+  * @details Character is queued to the transmit FIFO. The FIFO is sized so that
+  *  the periodic logging doesn't fill it, but in case it is full this waits
+  *  for space so that terminal output is not lost (e.g. help text).
   * @param c Character to send
-  * @retval char Character sent
   */
-PUTCHAR_PROTOTYPE
+void Serial_putc(uint8_t c)
 {
-  /* Write a character to the UART1 */
-  UART2_SendData8(c);
-  /* Loop until the end of transmission */
-  while (UART2_GetFlagStatus(UART2_FLAG_TXE) == RESET) {}
-
-  return (c);
+  while ( FALSE == tx_fifo_put(c) )
+  {
+    tx_drain_one();
+  }
+  tx_start();
 }
 
+#ifdef STM8S105 // S105 Dev board or DISCOVERY
+
 /**
   * @brief Send byte over UART2
-  * @details 
-  * @param 
+  * @details Queued to the transmit FIFO (dropped if the FIFO is full)
+  * @param value Byte to send
   * @retval
   */
 
 void UartSend(uint8_t value)
 {
-    UART2_SendData8(value);
-    while ( 0 == (UART2->SR & UART2_SR_TXE) ) {}
+    (void)Serial_write(&value, 1);
 }
 
-/**
-  * @brief Low-level character IO on the serial terminal
-  * @details Based on SPL example from STM8S_StdPeriph_Examples/UART/UART1_Printf/
-  * @param None
-  * @retval char Character to read
-  */
-GETCHAR_PROTOTYPE
-{
-#ifdef _COSMIC_
-  char c = 0;
-#else
-  int c = 0;
 #endif
-  /* Loop until the Read data register flag is SET */
-  while (UART2_GetFlagStatus(UART2_FLAG_RXNE) == RESET) {}
-  c = UART2_ReceiveData8();
-  return (c);
-}
 
 /**
 * @brief  Test to see if a key has been pressed on the terminal.
@@ -121,77 +178,85 @@ GETCHAR_PROTOTYPE
 */
 uint8_t SerialKeyPressed(char *key)
 {
-  FlagStatus flag  ;
-  /* First clear Rx buffer */
-  flag = UART2_GetFlagStatus(UART2_FLAG_RXNE);
-  if ( flag == SET)
+  if ( HAL_UART_RX_READY() )
   {
-    *key = (char)UART2->DR;
+    *key = (char)HAL_UART->DR;
     return 1;
   }
 
   return 0;
 }
-#else // stm8s003
+/** @endcond */
+
 /**
-  * @brief Low-level character IO on the serial terminal
-  * @details Based on SPL example from STM8S_StdPeriph_Examples/UART/UART1_Printf/
-  * @param c Character to send
-  * @retval char Character sent
+  * @brief Write bytes to the serial terminal without blocking.
+  * @details Bytes are queued to the transmit FIFO which is drained by the UART
+  *  TX interrupt. Bytes that don't fit in the FIFO are dropped and counted.
+  *  Call only from background task context (single producer).
+  * @param buf Bytes to send
+  * @param len Number of bytes
+  * @retval Number of bytes queued
   */
-PUTCHAR_PROTOTYPE
+uint8_t Serial_write(const uint8_t *buf, uint8_t len)
 {
-  /* Write a character to the UART1 */
-  UART1_SendData8(c);
-  /* Loop until the end of transmission */
-  while (UART1_GetFlagStatus(UART1_FLAG_TXE) == RESET);
+  uint8_t n = 0;
+
+  while ( (n < len) && (FALSE != tx_fifo_put(buf[n])) )
+  {
+    n += 1;
+  }
+  Tx_dropped += (uint16_t)(len - n);
 
-  return (c);
+  if (n > 0)
+  {
+    tx_start();
+  }
+  return n;
 }
 
 /**
-  * @brief Low-level character IO on the serial terminal
-  * @details Based on SPL example from STM8S_StdPeriph_Examples/UART/UART1_Printf/
-  * @param one
-  * @retval char Character to read
+  * @brief Test if the transmit FIFO has bytes waiting to be sent.
+  * @retval TRUE if transmission is in progress
   */
-GETCHAR_PROTOTYPE
+bool Serial_tx_busy(void)
 {
-#ifdef _COSMIC_
-  char c = 0;
-#else
-  int c = 0;
-#endif
-  /* Loop until the Read data register flag is SET */
-  while (UART1_GetFlagStatus(UART1_FLAG_RXNE) == RESET);
-    c = UART1_ReceiveData8();
-  return (c);
+  return (bool)(Tx_head != Tx_tail);
 }
 
 /**
-* @brief  Test to see if a key has been pressed on the terminal.
-*
-* @details Read a character non-blocking from serial terminal (c-n-p from STM8s 
-*   application note AN3259). 
-* @param [out]  key  Pointer to byte for receiving character code.
-* @retval  1  a character has been read
-* @retval  0  no character has been read
-*/
-uint8_t SerialKeyPressed(char *key)
+  * @brief Number of bytes that can be written to the transmit FIFO.
+  * @retval Free space in bytes
+  */
+uint8_t Serial_tx_free(void)
 {
-  FlagStatus flag  ;
-  /* First clear Rx buffer */
-  flag = UART1_GetFlagStatus(UART1_FLAG_RXNE);
-  if ( flag == SET)
+  return (uint8_t)((Tx_tail - Tx_head - 1) & (TX_FIFO_SIZE - 1));
+}
+
+/**
+  * @brief Number of bytes dropped by Serial_write() due to full FIFO.
+  */
+uint16_t Serial_get_tx_dropped(void)
+{
+  return Tx_dropped;
+}
+
+/**
+  * @brief Handle UART transmit data register empty interrupt.
+  * @details Sends the next byte from the FIFO, and disables the interrupt once
+  *  the FIFO is empty. Invoked from ISR.
+  */
+void Serial_Tx_It(void)
+{
+  if (Tx_tail != Tx_head)
   {
-    *key = (char)UART1->DR;
-    return 1;
+    HAL_UART->DR = Tx_fifo[Tx_tail]; // write to DR clears TXE
+    Tx_tail = TX_FIFO_NEXT(Tx_tail);
+  }
+  else
+  {
+    HAL_UART->CR2 &= (uint8_t)~HAL_UART_CR2_TIEN;
   }
-
-  return 0;
 }
-#endif
-/** @endcond */
 
 /*
  * @brief Configure GPIO.
@@ -223,6 +288,16 @@ static void GPIO_Config(void)
 
 // AIN0 (back-EMF sensor): Input floating, no external interrupt
   GPIO_Init(PH0_BEMF_IN_PORT, (GPIO_Pin_TypeDef)PH0_BEMF_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
+#if defined( ZC_CLOSED_LOOP_ENABLED )
+// AIN1, AIN2 (phase B and C back-EMF sensors)
+  GPIO_Init(PH1_BEMF_IN_PORT, (GPIO_Pin_TypeDef)PH1_BEMF_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
+  GPIO_Init(PH2_BEMF_IN_PORT, (GPIO_Pin_TypeDef)PH2_BEMF_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
+#endif
+
+#if defined( CURRENT_SENSE_ENABLED )
+// AIN3 (shunt current amplifier)
+  GPIO_Init(ISHUNT_IN_PORT, (GPIO_Pin_TypeDef)ISHUNT_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
+#endif
 
 #if defined( HAS_SERVO_INPUT )
 // Input pull-up, no external interrupt
@@ -248,7 +323,7 @@ static void GPIO_Config(void)
 /**
  *  @brief Configure UART
  *  @details
- *      - BaudRate = 115200 baud
+ *      - BaudRate = 115200 baud (UART_BAUD)
  *      - Word Length = 8 Bits
  *      - One Stop Bit
  *      - No parity
@@ -262,7 +337,7 @@ static void UART_setup(void)
 
   UART2_DeInit();
 
-  UART2_Init(115200,
+  UART2_Init(UART_BAUD,
              UART2_WORDLENGTH_8D,
              UART2_STOPBITS_1,
              UART2_PARITY_NO,
@@ -278,7 +353,7 @@ static void UART_setup(void)
   UART1_DeInit();
 
   UART1_Init(
-    (uint32_t)115200,
+    (uint32_t)UART_BAUD,
     UART1_WORDLENGTH_8D,
     UART1_STOPBITS_1,
     UART1_PARITY_NO,
@@ -289,6 +364,11 @@ static void UART_setup(void)
  #endif
     UART1_Cmd(ENABLE);
 #endif
+
+#if defined( PDU_BUS_OPEN_DRAIN )
+  // the alternate function output type is selected by CR1 (0: open-drain)
+  UART_TX_PORT->CR1 &= (uint8_t)~UART_TX_PIN;
+#endif
 }
 
 /*
@@ -300,6 +380,12 @@ static void UART_setup(void)
 /*
  * https://community.st.com/s/question/0D50X00009XkbA1SAJ/multichannel-adc
  */
+#if defined( ADC_HW_TRIGGER )
+#define ADC_EXTTRIG_STATE  ENABLE  // scan is started by TIM1 TRGO at each PWM cycle
+#else
+#define ADC_EXTTRIG_STATE  DISABLE // scan is started in software from the PWM ISR
+#endif
+
 static void ADC1_setup(void)
 {
   CLK_PeripheralClockConfig(CLK_PERIPHERAL_ADC, ENABLE);
@@ -309,8 +395,8 @@ static void ADC1_setup(void)
   ADC1_Init(ADC1_CONVERSIONMODE_SINGLE, // don't care, see ConversionConfig below ..
             ADC1_CHANNEL_3,        // i.e. Ch 0, 1, 2, and 3 are enabled
             ADC_DIVIDER,
-            ADC1_EXTTRIG_TIM,      //  ADC1_EXTTRIG_GPIO ... not presently using any ex triggern
-            DISABLE,               // ExtTriggerState
+            ADC1_EXTTRIG_TIM,      // TIM1 TRGO
+            ADC_EXTTRIG_STATE,     // ExtTriggerState
             ADC1_ALIGN_RIGHT,
             ADC1_SCHMITTTRIG_ALL,
             DISABLE);              // SchmittTriggerState
@@ -323,8 +409,10 @@ static void ADC1_setup(void)
 // Enable the ADC: 1 -> ADON for the first time it just wakes the ADC up
   ADC1_Cmd(ENABLE);
 
+#if !defined( ADC_HW_TRIGGER )
 // ADON = 1 for the 2nd time => starts the ADC conversion of all channels in sequence
   ADC1_StartConversion(); // i.e. for scanning mode only has to start once ...
+#endif
 }
 
 /**
@@ -375,6 +463,10 @@ static void ADC1_setup(void)
  * channels 3 & 4 used to get leading and trailing edges of radio signal pulse.
  * Refer to the timer peripheral description in the STM8s10x Reference Manual (RM0016) 
  * for specific details of the CC functionality.
+ *
+ * The 0.5 uS/tick can't resolve the fast throttle protocols (OneShot125,
+ * Multishot, DShot), the prescaler is changed on detection of the protocol
+ * (see MCU_servo_fast_mode()).
 */
 static void Servo_CC_setup(void)
 {
@@ -411,6 +503,37 @@ static void Servo_CC_setup(void)
   TIM2_Cmd(ENABLE);
 }
 
+/**
+ * @brief Switch the servo input capture to the fast pulse width protocols.
+ *
+ * @details
+ * The timer is run at fMASTER (0.0625 uS/tick) to resolve the OneShot125 and
+ * Multishot pulses, the maximum time of the free running timer is then 4.1 ms
+ * i.e. frame rates down to ~250 Hz. Invoked from the capture ISR.
+ */
+void MCU_servo_fast_mode(void)
+{
+  TIM2_PrescalerConfig(TIM2_PRESCALER_1, TIM2_PSCRELOADMODE_IMMEDIATE);
+}
+
+/**
+ * @brief Switch the servo input capture to DShot bit timing.
+ *
+ * @details
+ * The timer is run at fMASTER (0.0625 uS/tick) and only the rising edge
+ * interrupt is kept enabled, from which the falling edge capture of the
+ * preceding bit is also read, i.e. one interrupt per DShot bit. The ISR must
+ * be entered within the high time of a 0 bit, 2.5 us at DShot150 but only
+ * 1.25 us at DShot300, which is shorter than the run time of the other ISRs,
+ * so that DShot300 frames are dropped while any other ISR is active (see
+ * ITC_setup). Invoked from the capture ISR.
+ */
+void MCU_servo_dshot_mode(void)
+{
+  TIM2_ITConfig(TIM2_IT_CC2, DISABLE);
+  MCU_servo_fast_mode();
+}
+
 #elif defined( S105_DISCOVERY )
 /*
  * STM8s105 Discovery TIM1 not available for PWM (unless touch pad disabled by
@@ -452,7 +575,36 @@ static void Servo_CC_setup(void)
 
   TIM1_Cmd(ENABLE);
 }
+
+/**
+ * @brief Switch the servo input capture to the fast pulse width protocols.
+ * @details The timer is run at fMASTER (0.0625 uS/tick), see S105_DEV.
+ */
+void MCU_servo_fast_mode(void)
+{
+  TIM1_PrescalerConfig(0, TIM1_PSCRELOADMODE_IMMEDIATE);
+}
+
+/**
+ * @brief Switch the servo input capture to DShot bit timing.
+ * @details Only the rising edge interrupt is kept enabled, see S105_DEV.
+ */
+void MCU_servo_dshot_mode(void)
+{
+  TIM1_ITConfig(TIM1_IT_CC3, DISABLE);
+  MCU_servo_fast_mode();
+}
 #endif // S105 DISCOVERY
+
+#else // no servo input
+
+void MCU_servo_fast_mode(void)
+{
+}
+
+void MCU_servo_dshot_mode(void)
+{
+}
 #endif // HAS_SERVO_INP
 
 /*
@@ -465,6 +617,9 @@ static void Servo_CC_setup(void)
  *
  *  fMASTER = 1/16 Mhz = 0000000625 seconds
  *  Timer Step = fMASTER * prescaler = 0.0000000625 * (2^1) = 0.000000125 seconds
+ *
+ *  Each update event is one commutation sector, so the longest sector is
+ *  65536 * 0.000000125 = ~8.2 ms.
  */
 #define TIM3_PSCR  0x01  // 2^1 == 2
 
@@ -474,13 +629,19 @@ static void Servo_CC_setup(void)
  */
 void MCU_set_comm_timer(uint16_t period)
 {
+  TRACE_EVENT( TRACE_EV_PERIOD, 0, period );
+
   TIM3->PSCR = TIM3_PSCR;
 
   TIM3->ARRH = (uint8_t)(period >> 8); // be sure to set byte ARRH first, see data sheet
   TIM3->ARRL = (uint8_t)(period & 0xff);
 
+  Comm_period = period;
+
   TIM3->IER |= TIM3_IER_UIE; // Enable Update Interrupt
-  TIM3->CR1 = TIM3_CR1_ARPE; // auto (re)loading the count
+  // auto (re)loading the count, the update interrupt is only by the counter
+  // overflow i.e. not by the reinitialization (see MCU_set_comm_delay())
+  TIM3->CR1 = TIM3_CR1_ARPE | TIM3_CR1_URS;
   TIM3->CR1 |= TIM3_CR1_CEN; // Enable TIM3
 }
 
@@ -496,6 +657,8 @@ void MCU_set_comm_timer(uint16_t period)
 {
   static const uint16_t TIM1_Prescaler = TIM1_PSCR - 1;
 
+  TRACE_EVENT( TRACE_EV_PERIOD, 0, period );
+
   /* Set the Prescaler value */
   TIM1->PSCRH = (uint8_t)(TIM1_Prescaler >> 8);
   TIM1->PSCRL = (uint8_t)(TIM1_Prescaler);
@@ -503,12 +666,71 @@ void MCU_set_comm_timer(uint16_t period)
   TIM1->ARRH = (uint8_t)(period >> 8); // be sure to set byte ARRH first, see data sheet
   TIM1->ARRL = (uint8_t)(period & 0xff);
 
+  Comm_period = period;
+
   TIM1->IER |= TIM1_IER_UIE; // Enable Update Interrupt
-  TIM1->CR1 = TIM1_CR1_ARPE; // auto (re)loading the count
+  // auto (re)loading the count, the update interrupt is only by the counter
+  // overflow i.e. not by the reinitialization (see MCU_set_comm_delay())
+  TIM1->CR1 = TIM1_CR1_ARPE | TIM1_CR1_URS;
   TIM1->CR1 |= TIM1_CR1_CEN; // Enable timer
 }
+
 #endif
 
+/**
+ * @brief  Update the commutation timing period of the running timer.
+ * @details  Only the reload register is written. The reload is preloaded
+ *   (ARPE) so the period takes effect at the next update event i.e. it does
+ *   not disturb the present count.
+ * @param  period  Value written to timer reload register
+ */
+void MCU_set_comm_period(uint16_t period)
+{
+  TRACE_EVENT( TRACE_EV_PERIOD, 0, period );
+
+  Comm_period = period;
+
+  HAL_COMM_TIMER->ARRH = (uint8_t)(period >> 8); // be sure to set byte ARRH first, see data sheet
+  HAL_COMM_TIMER->ARRL = (uint8_t)(period & 0xff);
+}
+
+/**
+ * @brief  Restart the count of the present sector to end after a delay.
+ * @details  The delay is preloaded and transferred by reinitializing the
+ *   counter (UG), which does not generate the update interrupt (URS), and the
+ *   period of the next sector (MCU_set_comm_period()) is preloaded again. Not
+ *   done if the update of the sector is pending i.e. the commutation step is
+ *   already due. To be invoked at the priority level of the commutation ISR.
+ * @param  delay  Timer counts to the next update event
+ */
+void MCU_set_comm_delay(uint16_t delay)
+{
+  if (FALSE == HAL_TIM_FLAG( HAL_COMM_TIMER, HAL_COMM_SR1_UIF ))
+  {
+    HAL_COMM_TIMER->ARRH = (uint8_t)(delay >> 8);
+    HAL_COMM_TIMER->ARRL = (uint8_t)(delay & 0xff);
+
+    HAL_COMM_TIMER->EGR = HAL_COMM_EGR_UG;
+
+    HAL_COMM_TIMER->ARRH = (uint8_t)(Comm_period >> 8);
+    HAL_COMM_TIMER->ARRL = (uint8_t)(Comm_period & 0xff);
+  }
+}
+
+/**
+ * @brief  Read the count of the commutation timer.
+ * @details  The count restarts from 0 at the update event, so in the
+ *   commutation ISR it is the latency from the update event.
+ * @return  Timer count (MCU_COMM_CT_PER_US counts per microsecond)
+ */
+uint16_t MCU_get_comm_count(void)
+{
+  uint8_t cnt_h = HAL_COMM_TIMER->CNTRH; // reading CNTRH latches CNTRL, see data sheet
+  uint8_t cnt_l = HAL_COMM_TIMER->CNTRL;
+
+  return (uint16_t)( ((uint16_t)cnt_h << 8) | cnt_l );
+}
+
 /*
  * http://embedded-lab.com/blog/starting-stm8-microcontrollers/13/
  * GN:  by default  microcontroller uses   internal 16MHz RC oscillator
@@ -537,6 +759,72 @@ static void Clock_setup(void)
   CLK_PeripheralClockConfig(CLK_PERIPHERAL_TIMER3, ENABLE);
 }
 
+#if defined( PROFILE_ENABLED )
+/*
+ * TIM4 is the time base for the execution time profiler: 8-bit free-running
+ * with overflow interrupt to extend the time stamp.
+ *
+ *  Timer Step = fMASTER * prescaler = 0.0000000625 * (2^4) = 0.000001 seconds
+ */
+#define TIM4_PSCR  0x04  // 2^4 == 16
+
+static void Prof_timer_setup(void)
+{
+  CLK_PeripheralClockConfig(CLK_PERIPHERAL_TIMER4, ENABLE);
+
+  Prof_reset();
+
+  TIM4->PSCR = TIM4_PSCR;
+  TIM4->ARR = 0xFF;
+  TIM4->IER |= TIM4_IER_UIE; // Enable Update Interrupt
+  TIM4->CR1 = TIM4_CR1_ARPE;
+  TIM4->CR1 |= TIM4_CR1_CEN; // Enable TIM4
+}
+#endif // PROFILE_ENABLED
+
+/*
+ * Set the software priority of an interrupt vector, 2 bits per vector in the
+ * ITC_SPR registers.
+ */
+static void ITC_set_level(uint8_t irq, uint8_t level)
+{
+  volatile uint8_t *pspr = &ITC->ISPR1 + (irq / 4);
+  uint8_t shift = (uint8_t)((irq % 4) * 2);
+
+  *pspr = (uint8_t)( (*pspr & ~(0x03 << shift)) | (level << shift) );
+}
+
+/*
+ * Interrupt software priorities. Out of reset every vector is at level 3 i.e.
+ * an ISR cannot be preempted, so the commutation step could be delayed by a
+ * PWM ISR running the control task. The commutation timer and ADC ISRs are set
+ * to the highest level, both at the same level so that the commutation step
+ * and the back-EMF sampling, which share the sequence state, still never
+ * preempt each other. The profiler time base is at the highest level so that
+ * the time stamp is coherent at any level. All other ISRs are at level 2 - the
+ * control task (see Sched_dispatch) runs at level 0 at the tail of the PWM ISR
+ * and is preempted by all of them. The servo capture is left at level 2 rather
+ * than delay the commutation step once per DShot bit, which limits the DShot
+ * rate to DShot150 (see MCU_servo_dshot_mode).
+ * The priorities can only be written with interrupts disabled. TLI (vector 0)
+ * has a fixed priority.
+ */
+static void ITC_setup(void)
+{
+  uint8_t irq;
+
+  for (irq = 1; irq <= ITC_IRQ_EEPROM_EEC; irq++)
+  {
+    ITC_set_level(irq, ITC_PRIORITYLEVEL_2);
+  }
+
+  ITC_set_level(ITC_IRQ_COMM, ITC_PRIORITYLEVEL_3);
+  ITC_set_level(ITC_IRQ_ADC1, ITC_PRIORITYLEVEL_3);
+#if defined( PROFILE_ENABLED )
+  ITC_set_level(ITC_IRQ_TIM4_OVF, ITC_PRIORITYLEVEL_3);
+#endif
+}
+
 #if SPI_ENABLED
 /**
  * @brief  Configure SPI bus
@@ -586,12 +874,11 @@ void SPI_setup(void)
            SPI_CLOCKPOLARITY_LOW, SPI_CLOCKPHASE_1EDGE,
            SPI_DATADIRECTION_2LINES_FULLDUPLEX, SPI_NSS_HARD, (uint8_t)0x07);
 
-#if 0 //  #ifdef SPI_PERPIPH_INT
-  SPI_ITConfig(SPI_IT_RXNE, ENABLE); // Interrupt when the Rx buffer is not empty.
-#endif
-
 #endif // SPI_ENABLED == SPI_STM8_MASTER
 
+  // frames are exchanged in the ISR, one byte per RXNE interrupt
+  SPI_ITConfig(SPI_IT_RXNE, ENABLE); // Interrupt when the Rx buffer is not empty.
+
   //Enable SPI.
   SPI_Cmd(ENABLE);
 }
@@ -600,11 +887,13 @@ void SPI_setup(void)
 
 /**
  * @brief  Initialize MCU and peripheral modules
- * @details  Configures clocks, GPIO, UART, ADC, timers, PWM.
+ * @details  Configures clocks, interrupt priorities, GPIO, UART, ADC, timers,
+ *   PWM. Invoked with interrupts disabled.
  */
 void MCU_Init(void)
 {
   Clock_setup();
+  ITC_setup();
   GPIO_Config();
   UART_setup();
   PWM_setup();
@@ -613,6 +902,10 @@ void MCU_Init(void)
   ADC1_setup();
 #endif
 
+  // commutation timer is started at the longest period, the control task
+  // sets the period which is then updated at each sector (see Driver_Step())
+  MCU_set_comm_timer( U16_MAX );
+
 #if defined( HAS_SERVO_INPUT )
   Servo_CC_setup();
 #endif
@@ -620,6 +913,10 @@ void MCU_Init(void)
 #if SPI_ENABLED
   SPI_setup();
 #endif
+
+#if defined( PROFILE_ENABLED )
+  Prof_timer_setup();
+#endif
 }
 
 /**@}*/ // defgroup
@@ -16,138 +16,333 @@
 /* Includes ------------------------------------------------------------------*/
 
 #include "pwm_stm8s.h"
+#include "eeprom_stm8s.h"
+#include "mparam.h"
 #include "mdata.h"
 
 
-// table size originated from 250 step PWM confiugration
-#define MDATA_TBL_SIZE            250
+/*
+ * The learned table has a node at each MDATA_LRN_STEP counts of PWM duty-cycle
+ * and is small enough for the data EEPROM of any of the supported MCUs. The
+ * timing curve of the motor profile has the same nodes (mparam.h).
+ */
+#define MDATA_LRN_N_PTS           MPARAM_OL_N_PTS
+#define MDATA_LRN_STEP            ( PWM_PERIOD_COUNTS / MDATA_LRN_N_PTS )
+
+// identifies a valid table image in the EEPROM
+#define MDATA_LRN_MAGIC           0x4F50 // "OP"
+
+// the duty-cycle has to be held for this many control frames (~1 ms) to be learned
+#define MDATA_LRN_SETTLE          250u
+
+// gain of the learning update i.e. 1 / 2^N of the error
+#define MDATA_LRN_GAIN_SHIFT      3
+
+/* Private types -----------------------------------------------------------*/
 
 /**
- * @brief rescale index parameter to scale of original table
- * @details
- *   PWM period counts must be a multiple of original table size
- *
- *   rescaled_index = index * PWM_PERIOD_COUNTS / MDATA_TBL_SIZE
+ * @brief Image of the learned table in the data EEPROM
+ */
+typedef struct
+{
+  uint16_t magic;
+  uint16_t period[ MDATA_LRN_N_PTS ]; // commutation period of each node, 0 if not learned
+  uint8_t profile; // motor profile of the table (Mparam_get_index)
+  uint16_t csum;
+}
+mdata_image_t;
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint16_t Lrn_period[ MDATA_LRN_N_PTS ]; // learned table
+static mdata_image_t Lrn_image; // source buffer of EEPROM write
+static bool Lrn_enabled;
+static uint16_t Lrn_dutycycle; // duty-cycle and time held at the latest learning step
+static uint16_t Lrn_settle;
 
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Node of the table at or below the duty-cycle, and the distance from
+ * it in counts of duty-cycle. Above the top node the top node is held.
  */
-#define PWM_PERIOD_SCALAR    (PWM_PERIOD_COUNTS / MDATA_TBL_SIZE)
- 
-#define MDATA_TBL_INDEX_PCNT_SCALE( _index_ ) \
-                                     ( _index_ / PWM_PERIOD_SCALAR )
+static uint8_t lrn_node(uint16_t dutycycle, uint16_t *p_dist)
+{
+    uint16_t node = dutycycle / MDATA_LRN_STEP;
+
+    *p_dist = dutycycle % MDATA_LRN_STEP;
+
+    if (node >= (MDATA_LRN_N_PTS - 1))
+    {
+        node = MDATA_LRN_N_PTS - 1;
+        *p_dist = 0;
+    }
+    return (uint8_t)node;
+}
 
 /*
- * The table is indexed by PWM duty cycle counts (i.e. [0:1:250)
- * The function generates the data in Scilab and imported from csv.
- * Gain and time constant experimentally determined for timing 1100kV motor @ 12.4v
- *
- *   Y =  A * exp( -t / TAU )
- *
- *   A     = 3400
- *   TAU   = 50
- *
- * Note that the first 16 or so table entries aren't really used as the motor 
- * can't run at such low duty-cycle!
+ * Lookup of a table of the nodes (the learned table or the timing curve of the
+ * motor profile), interpolated between the adjacent nodes if both are valid,
+ * otherwise the nearest node.
+ * Returns 0 if the nearest node is not valid.
  */
-static const uint16_t OL_Timing[ /* TABLE_SIZE */ ] =
+static uint16_t node_lookup(const uint16_t *p_tbl, uint16_t dutycycle)
 {
-#if defined (S003_DEV)
-1500, //   0, 0, 0, 5DC
-1470, //   1, 1, 1, 5BE
-1441, //   2, 1, 2, 5A1
-1413, //   3, 2, 3, 585
-1385, //   4, 2, 4, 569
-1357, //   5, 3, 5, 54D
-1330, //   6, 3, 6, 532
-1304, //   7, 4, 7, 518
-1278, //   8, 4, 8, 4FE
-1253, //   9, 5, 9, 4E5
-1228, //   10, 6, A, 4CC
-1204, //   11, 6, B, 4B4
-1180, //   12, 7, C, 49C
-1157, //   13, 7, D, 485
-1134, //   14, 8, E, 46E
-1111, //   15, 8, F, 457
-1089, //   16, 9, 10, 441
-1068, //   17, 9, 11, 42C
-1047, //   18, 10, 12, 417
-1026, //   19, 11, 13, 402
-1005, //   20, 11, 14, 3ED
-986, //   21, 12, 15, 3DA
-966, //   22, 12, 16, 3C6
-947, //   23, 13, 17, 3B3
-928, //   24, 13, 18, 3A0
-910, //   25, 14, 19, 38E
-892, //   26, 14, 1A, 37C
-874, //   27, 15, 1B, 36A
-857, //   28, 16, 1C, 359
-840, //   29, 16, 1D, 348
-823, //   30, 17, 1E, 337
-807, //   31, 17, 1F, 327
-791, //   32, 18, 20, 317
-775, //   33, 18, 21, 307
-760, //   34, 19, 22, 2F8
-745, //   35, 19, 23, 2E9
-730, //   36, 20, 24, 2DA
-716, //   37, 21, 25, 2CC
-701, //   38, 21, 26, 2BD
-688, //   39, 22, 27, 2B0
-674, //   40, 22, 28, 2A2
-661, //   41, 23, 29, 295
-648, //   42, 23, 2A, 288
-635, //   43, 24, 2B, 27B
-622, //   44, 24, 2C, 26E
-610, //   45, 25, 2D, 262
-598, //   46, 26, 2E, 256
-586, //   47, 26, 2F, 24A
-574, //   48, 27, 30, 23E
-563, //   49, 27, 31, 233
-552, //   50, 28, 32, 228
-541, //   51, 28, 33, 21D
-530, //   52, 29, 34, 212
-520, //   53, 29, 35, 208
-509, //   54, 30, 36, 1FD
-499, //   55, 31, 37, 1F3
-489, //   56, 31, 38, 1E9
-480, //   57, 32, 39, 1E0
-470, //   58, 32, 3A, 1D6
-461, //   59, 33, 3B, 1CD
-452, //   60, 33, 3C, 1C4
-443, //   61, 34, 3D, 1BB
-434, //   62, 34, 3E, 1B2
-425, //   63, 35, 3F, 1A9
-#else
-  #include "model.h" // hack   headers are horrible
-#endif	
-};
-
-#define OL_TIMING_TBL_SIZE    ( sizeof(OL_Timing) / sizeof(uint16_t) )
+    uint16_t dist;
+    uint8_t node = lrn_node(dutycycle, &dist);
+    uint16_t p0 = p_tbl[ node ];
+    uint16_t p1;
 
+    if (0 == dist)
+    {
+        return p0;
+    }
+
+    p1 = p_tbl[ node + 1 ];
+
+    if ( (0 != p0) && (0 != p1) )
+    {
+        return (uint16_t)( p0 +
+            ( ( (int32_t)p1 - p0 ) * (int16_t)dist ) / MDATA_LRN_STEP );
+    }
+    return (dist < (MDATA_LRN_STEP / 2)) ? p0 : p1;
+}
+
+/*
+ * Adjust a node of the learned table, which remains within valid range
+ * i.e. not 0 (not learned) or U16_MAX (error).
+ */
+static void lrn_adjust(uint8_t node, int32_t delta)
+{
+    int32_t period = Lrn_period[ node ] + delta;
+
+    if (period < 1)
+    {
+        period = 1;
+    }
+    else if (period > (U16_MAX - 1))
+    {
+        period = U16_MAX - 1;
+    }
+    Lrn_period[ node ] = (uint16_t)period;
+}
+
+static uint16_t lrn_checksum(const mdata_image_t *p_image)
+{
+    uint16_t sum = p_image->magic + p_image->profile;
+    uint8_t n;
+
+    for (n = 0; n < MDATA_LRN_N_PTS; n++)
+    {
+        sum += p_image->period[ n ];
+    }
+    return sum;
+}
+
+/* Public functions ---------------------------------------------------------*/
 
 /**
  * @brief Table lookup for open-loop commutation timing
  * @details 
- *   The table definition depends on the PWM duty-cycle being 250 steps.
- *   PWM now had 1024 steps so the macro is used to rescale it to lookup the
- *   commutation timing.
+ *   The learned table is used where it has been learned (see Mdata_learn),
+ *   otherwise the timing curve of the selected motor profile (Mparam_get).
  *
- * @param table_index Index into the table
+ * @param table_index PWM duty-cycle counts
  *
  * @return Commutation period expressed in timer counts
- * @retval -1 error
+ * @retval -1 error i.e. beyond the timing curve
  */
 uint16_t Get_OL_Timing(uint16_t table_index)
 {
-    uint16_t t16 = (U16_MAX); // error
+    uint16_t t16 = node_lookup(Lrn_period, table_index);
 
-    // rescxale index range to that of  original table size
-    uint16_t index = MDATA_TBL_INDEX_PCNT_SCALE(table_index);
+    if (0 == t16)
+    {
+        t16 = node_lookup(Mparam_get()->ol_timing, table_index);
+    }
+    return (0 != t16) ? t16 : U16_MAX;
+}
 
-    // assert index < OL_TIMING_TBL_SIZE
-    if ( index < OL_TIMING_TBL_SIZE )
+/**
+ * @brief Reverse lookup of the open-loop commutation timing
+ * @details  Binary search of the duty-cycle at which the timing table has the
+ *   commutation period, as the period decreases with the duty-cycle.
+ *
+ * @param period  Commutation period expressed in timer counts
+ *
+ * @return PWM duty-cycle counts
+ */
+uint16_t Mdata_get_dutycycle(uint16_t period)
+{
+    uint16_t lo = 0;
+    uint16_t hi = PWM_PERIOD_COUNTS;
+
+    while (lo < hi)
     {
-        t16 = OL_Timing[ index ] * CTIME_SCALAR;
+        uint16_t mid = (lo + hi) >> 1;
+        uint16_t t16 = Get_OL_Timing(mid);
+
+        // beyond the range of the table is taken as the shortest period
+        if ( (U16_MAX != t16) && (t16 > period) )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
     }
-    return t16;
+    return lo;
+}
+
+/**
+ * @brief Learn the commutation period at the present duty-cycle
+ * @details  Called at each control frame while in closed-loop control with
+ *   the measured sector period. Once the duty-cycle has been held for the
+ *   settling time, the nodes of the table adjacent to the duty-cycle are
+ *   corrected by a fraction of the error of the table lookup, weighted by the
+ *   distance from each node (least mean squares). A node that has never been
+ *   learned takes the measured period.
+ *
+ * @param dutycycle  PWM duty-cycle counts
+ * @param period  Measured sector period (commutation timer counts), 0 if none
+ */
+void Mdata_learn(uint16_t dutycycle, uint16_t period)
+{
+    uint16_t dist;
+    uint8_t node;
+    uint16_t estimate;
+    int32_t error;
+
+    if ( (FALSE == Lrn_enabled) || (0 == period) )
+    {
+        return;
+    }
+
+    if (dutycycle != Lrn_dutycycle)
+    {
+        Lrn_dutycycle = dutycycle;
+        Lrn_settle = 0;
+        return;
+    }
+
+    if (Lrn_settle < MDATA_LRN_SETTLE)
+    {
+        Lrn_settle += 1;
+        return;
+    }
+
+    node = lrn_node(dutycycle, &dist);
+    estimate = node_lookup(Lrn_period, dutycycle);
+
+    if (dist >= (MDATA_LRN_STEP / 2))
+    {
+        node += 1; // nearest node
+        dist = MDATA_LRN_STEP - dist;
+    }
+
+    if (0 == estimate)
+    {
+        Lrn_period[ node ] = period;
+        return;
+    }
+
+    error = ( (int32_t)period - estimate ) / (1 << MDATA_LRN_GAIN_SHIFT);
+
+    if (0 == dist)
+    {
+        lrn_adjust(node, error);
+    }
+    else
+    {
+        // the other node adjacent to the duty-cycle
+        uint8_t other = (dutycycle < (node * MDATA_LRN_STEP)) ? (node - 1) : (node + 1);
+
+        if (0 != Lrn_period[ other ])
+        {
+            lrn_adjust(other, error * (int16_t)dist / MDATA_LRN_STEP);
+            error -= error * (int16_t)dist / MDATA_LRN_STEP;
+        }
+        lrn_adjust(node, error);
+    }
+}
+
+/**
+ * @brief Enable or disable the learning of the open-loop timing table
+ * @details  The learned table is saved to the EEPROM when learning is
+ *   disabled. Not to be called from ISR (the EEPROM write is started here).
+ * @param enable  TRUE to enable
+ */
+void Mdata_set_learn(bool enable)
+{
+    if ( (FALSE != Lrn_enabled) && (FALSE == enable) )
+    {
+        (void)Mdata_save();
+    }
+    Lrn_enabled = enable;
+    Lrn_settle = 0;
+}
+
+/**
+ * @brief Accessor for the learning state
+ * @return TRUE if learning is enabled
+ */
+bool Mdata_get_learn(void)
+{
+    return Lrn_enabled;
+}
+
+/**
+ * @brief Load the learned table from the EEPROM
+ * @details  To be called at startup and at the selection of a motor profile.
+ *   If the EEPROM has no valid image of the selected profile the table is
+ *   cleared i.e. the timing curve of the profile is used.
+ * @return TRUE if a valid table was loaded
+ */
+bool Mdata_load(void)
+{
+    uint8_t n;
+    bool valid;
+
+    EEPROM_read(EEPROM_OFS_MDATA, (uint8_t *)&Lrn_image, sizeof(mdata_image_t));
+
+    valid = (MDATA_LRN_MAGIC == Lrn_image.magic) &&
+            (Mparam_get_index() == Lrn_image.profile) &&
+            (lrn_checksum(&Lrn_image) == Lrn_image.csum);
+
+    for (n = 0; n < MDATA_LRN_N_PTS; n++)
+    {
+        Lrn_period[ n ] = (FALSE != valid) ? Lrn_image.period[ n ] : 0;
+    }
+    return valid;
+}
+
+/**
+ * @brief Save the learned table to the EEPROM
+ * @details  The write is non-blocking (see EEPROM_write), the table is copied
+ *   to the image buffer so learning may continue meanwhile.
+ * @return FALSE if a write is already in progress
+ */
+bool Mdata_save(void)
+{
+    uint8_t n;
+
+    if (FALSE != EEPROM_busy())
+    {
+        return FALSE;
+    }
+
+    Lrn_image.magic = MDATA_LRN_MAGIC;
+    Lrn_image.profile = Mparam_get_index();
+
+    for (n = 0; n < MDATA_LRN_N_PTS; n++)
+    {
+        Lrn_image.period[ n ] = Lrn_period[ n ];
+    }
+    Lrn_image.csum = lrn_checksum(&Lrn_image);
+
+    return EEPROM_write(
+             EEPROM_OFS_MDATA, (const uint8_t *)&Lrn_image, sizeof(mdata_image_t));
 }
 
 /**@}*/ // defgroup
@@ -0,0 +1,307 @@
+/**
+  ******************************************************************************
+  * @file mparam.c
+  * @brief Motor parameter profiles
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * A motor profile holds the startup profile, the motor parameters and the
+  * open-loop timing curve of a motor type (mparam_t). The profiles are indexed
+  * by the built-in profiles (in flash, generated from the motor constants,
+  * see tools/mparam_gen) followed by the slots of the data EEPROM, which are
+  * written over the PDU. The selected profile is applied to the controller
+  * (BL_set_startup, BL_set_motor) and to the timing table (Get_OL_Timing), and
+  * its index is saved to the EEPROM to be selected at the next startup.
+  *
+  * A profile is selected only with the motor stopped. The learned timing
+  * table is of the profile it was learned with, and is reloaded at the
+  * selection (Mdata_load).
+  *
+  ******************************************************************************
+  */
+/**
+ * \defgroup mparam Motor Parameters
+ * @brief Motor parameter profiles
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h> // NULL
+#include "mparam.h"
+#include "mparam_tbl.h"
+#include "mdata.h"
+#include "pwm_stm8s.h"
+#include "eeprom_stm8s.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+// identifies a valid profile image in the EEPROM
+#define MPARAM_MAGIC  0x4D50 // "MP"
+
+// PWM duty-cycle counts of a profile duty-cycle
+#define MPARAM_DUTY_COUNTS( _DUTY_ ) \
+  (uint16_t)( ( (uint32_t)( _DUTY_ ) * PWM_PERIOD_COUNTS ) / MPARAM_DUTY_FS )
+
+/* Private types -------------------------------------------------------------*/
+
+/**
+ * @brief Image of a profile slot in the data EEPROM
+ */
+typedef struct
+{
+  uint16_t magic;
+  mparam_t prof;
+  uint16_t csum;
+}
+mparam_image_t;
+
+/**
+ * @brief Image of the selected profile index in the data EEPROM
+ */
+typedef struct
+{
+  uint8_t index;
+  uint8_t check; // complement of the index
+}
+mparam_sel_image_t;
+
+/* Private variables ---------------------------------------------------------*/
+
+/*
+ * Built-in profiles, the first is the default of the board
+ */
+static const mparam_t Mparam_builtin[] =
+{
+#if defined( S003_DEV )
+  MPARAM_PROFILE_S003,
+#endif
+  MPARAM_PROFILE_D1100,
+  MPARAM_PROFILE_K1400P7
+};
+
+#define MPARAM_N_BUILTIN  (uint8_t)( sizeof(Mparam_builtin) / sizeof(mparam_t) )
+
+static const mparam_t *Mparam_active = &Mparam_builtin[ 0 ];
+static uint8_t Mparam_index;
+static mparam_sel_image_t Sel_image; // source of the EEPROM write
+
+#if ( MPARAM_N_SLOTS > 0 )
+static mparam_t Mparam_slot_prof; // the selected profile if from a slot
+static mparam_image_t Slot_image; // staging of Mparam_load, source of the EEPROM write
+#endif
+
+/* Private functions ---------------------------------------------------------*/
+
+#if ( MPARAM_N_SLOTS > 0 )
+static uint16_t mparam_checksum(const mparam_image_t *p_image)
+{
+  const uint8_t *p_byte = (const uint8_t *)&p_image->prof;
+  uint16_t sum = p_image->magic;
+  uint8_t n;
+
+  for (n = 0; n < sizeof(mparam_t); n++)
+  {
+    sum += p_byte[ n ];
+  }
+  return sum;
+}
+
+/*
+ * Offset of a slot in the data EEPROM
+ */
+static uint16_t mparam_slot_ofs(uint8_t slot)
+{
+  return (uint16_t)( EEPROM_OFS_MPARAM + (uint16_t)slot * sizeof(mparam_image_t) );
+}
+#endif
+
+/*
+ * Profile of the index, read from its slot if not built-in (to the staging
+ * buffer i.e. not while written)
+ * Returns NULL if the index is beyond the slots or the slot is not valid.
+ */
+static const mparam_t *mparam_find(uint8_t index)
+{
+  if (index < MPARAM_N_BUILTIN)
+  {
+    return &Mparam_builtin[ index ];
+  }
+#if ( MPARAM_N_SLOTS > 0 )
+  if ( (index < (MPARAM_N_BUILTIN + MPARAM_N_SLOTS)) && (FALSE == EEPROM_busy()) )
+  {
+    EEPROM_read( mparam_slot_ofs( (uint8_t)(index - MPARAM_N_BUILTIN) ),
+                 (uint8_t *)&Slot_image, sizeof(mparam_image_t) );
+
+    if ( (MPARAM_MAGIC == Slot_image.magic) &&
+         (mparam_checksum(&Slot_image) == Slot_image.csum) )
+    {
+      Mparam_slot_prof = Slot_image.prof;
+      return &Mparam_slot_prof;
+    }
+  }
+#endif
+  return NULL;
+}
+
+/*
+ * Set the controller to the profile, the duty-cycles are scaled to the PWM
+ * period
+ */
+static void mparam_apply(const mparam_t *p_prof)
+{
+  BL_startup_t startup = p_prof->startup;
+  BL_motor_t motor = p_prof->motor;
+
+  startup.align_duty = MPARAM_DUTY_COUNTS( startup.align_duty );
+  startup.ramp_duty = MPARAM_DUTY_COUNTS( startup.ramp_duty );
+  motor.duty_startup = MPARAM_DUTY_COUNTS( motor.duty_startup );
+  motor.duty_shutoff = MPARAM_DUTY_COUNTS( motor.duty_shutoff );
+
+  BL_set_startup(&startup);
+  BL_set_motor(&motor);
+
+  Mparam_active = p_prof;
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Select the profile saved in the EEPROM, or the default profile
+ *
+ * @details To be called at startup, before loading the learned timing table
+ *   (Mdata_load).
+ */
+void Mparam_init(void)
+{
+  const mparam_t *p_prof = NULL;
+
+  EEPROM_read(EEPROM_OFS_MPARAM_SEL, (uint8_t *)&Sel_image, sizeof(mparam_sel_image_t));
+
+  if ((uint8_t)~Sel_image.index == Sel_image.check)
+  {
+    p_prof = mparam_find(Sel_image.index);
+  }
+
+  Mparam_index = (NULL != p_prof) ? Sel_image.index : 0;
+
+  mparam_apply( (NULL != p_prof) ? p_prof : &Mparam_builtin[ 0 ] );
+}
+
+/**
+ * @brief Select a profile and save the selection to the EEPROM
+ *
+ * @details Only with the motor stopped. The learned timing table of the
+ *   profile is loaded.
+ * @param index  Built-in profiles then the EEPROM slots
+ * @return FALSE if not stopped, the EEPROM is busy, or the profile not valid
+ */
+bool Mparam_select(uint8_t index)
+{
+  uint8_t opstate = BL_get_opstate();
+  const mparam_t *p_prof;
+
+  if ( ( (BL_ARMING != opstate) && (BL_STOPPED != opstate) ) ||
+       (FALSE != EEPROM_busy()) )
+  {
+    return FALSE;
+  }
+
+  p_prof = mparam_find(index);
+
+  if (NULL == p_prof)
+  {
+    return FALSE;
+  }
+
+  mparam_apply(p_prof);
+  Mparam_index = index;
+
+  (void)Mdata_load();
+
+  Sel_image.index = index;
+  Sel_image.check = (uint8_t)~index;
+
+  return EEPROM_write(
+           EEPROM_OFS_MPARAM_SEL, (const uint8_t *)&Sel_image, sizeof(mparam_sel_image_t));
+}
+
+/**
+ * @brief Accessor for the index of the selected profile
+ */
+uint8_t Mparam_get_index(void)
+{
+  return Mparam_index;
+}
+
+/**
+ * @brief Number of profile indexes i.e. built-in profiles and EEPROM slots
+ */
+uint8_t Mparam_get_count(void)
+{
+  return (uint8_t)( MPARAM_N_BUILTIN + MPARAM_N_SLOTS );
+}
+
+/**
+ * @brief Accessor for the selected profile
+ */
+const mparam_t *Mparam_get(void)
+{
+  return Mparam_active;
+}
+
+#if ( MPARAM_N_SLOTS > 0 )
+/**
+ * @brief Copy part of a profile to the staging buffer of Mparam_save
+ *
+ * @details The profile is sent in parts of the PDU frame, as its memory image
+ *   (see mparam_t).
+ * @param offset  Offset in the profile
+ * @param buf  Data, beyond the end of the profile is ignored
+ * @param len  Number of bytes
+ * @return FALSE if beyond the profile or the EEPROM is busy
+ */
+bool Mparam_load(uint8_t offset, const uint8_t *buf, uint8_t len)
+{
+  uint8_t *p_byte = (uint8_t *)&Slot_image.prof;
+  uint8_t n;
+
+  if ( (offset >= sizeof(mparam_t)) || (FALSE != EEPROM_busy()) )
+  {
+    return FALSE;
+  }
+
+  for (n = 0; (n < len) && ((offset + n) < sizeof(mparam_t)); n++)
+  {
+    p_byte[ offset + n ] = buf[ n ];
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Save the staged profile to an EEPROM slot
+ *
+ * @details The write is non-blocking (see EEPROM_write). A profile selected
+ *   from the slot is changed at the next selection.
+ * @param slot  Slot index 0 : MPARAM_N_SLOTS - 1
+ * @return FALSE if the slot is invalid, the profile has no timing curve or no
+ *   ramp end period, or the EEPROM is busy
+ */
+bool Mparam_save(uint8_t slot)
+{
+  if ( (slot >= MPARAM_N_SLOTS) || (0 == Slot_image.prof.ol_timing[ 0 ]) ||
+       (0 == Slot_image.prof.startup.ramp_end) || (FALSE != EEPROM_busy()) )
+  {
+    return FALSE;
+  }
+
+  Slot_image.prof.name[ MPARAM_NAME_LEN - 1 ] = '\0';
+  Slot_image.magic = MPARAM_MAGIC;
+  Slot_image.csum = mparam_checksum(&Slot_image);
+
+  return EEPROM_write(
+           mparam_slot_ofs(slot), (const uint8_t *)&Slot_image, sizeof(mparam_image_t));
+}
+#endif // MPARAM_N_SLOTS
+
+/**@}*/ // defgroup
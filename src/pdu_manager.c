@@ -16,111 +16,465 @@
 /* Includes ------------------------------------------------------------------*/
 
 #include "driver.h"
+#include "bldc_sm.h"
+#include "per_task.h"
+#include "telem.h"
+#include "faultm.h"
+#include "eeprom_stm8s.h"
+#include "mparam.h"
+#include "term.h"
+#include "pdu_manager.h"
+
+#if defined( UART_IT_RXNE_ENABLE )
 
 /* Private defines -----------------------------------------------------------*/
 
 #define SOF 52
+#define SOF_NODE 53 // addressed frame
 
-#define MAX_RX_DATA_SIZE 8  //how big should this be?
+// the largest command data is the throttle of all nodes and the reply node,
+// also the size of the offset and part of a motor profile
+#define MAX_RX_DATA_SIZE ( 2 * PDU_BUS_N_NODES + 1 )
 
-#define NO_FRAME 255
+#if ( (PDU_MOTOR_LOAD_LEN + 1) > MAX_RX_DATA_SIZE )
+  #error "PDU_MOTOR_LOAD_LEN exceeds the frame data"
+#endif
 
 /* Private types -----------------------------------------------------------*/
 
+/**
+ * @brief Receiver state, i.e. the field of the frame expected in the next byte
+ */
+typedef enum
+{
+  PDU_RX_SOF,
+  PDU_RX_NODE,
+  PDU_RX_SIZE,
+  PDU_RX_CMD,
+  PDU_RX_DATA,
+  PDU_RX_CSUM
+}
+pdu_rx_state_t;
+
+/**
+ * @brief Function pointer type for the command handlers
+ */
+typedef void (*pdu_handlrp_t)(const uint8_t *pdata);
+
+/**
+ * @brief Data type for the command handler table.
+ */
+typedef struct
+{
+  uint8_t        command;   /**< Command code. */
+  uint8_t        size;      /**< Size of the command data. */
+  pdu_handlrp_t  phandler;  /**< Pointer to handler function. */
+}
+pdu_cmd_handler_t;
+
+/**
+ * @brief Image of the node address in the data EEPROM
+ */
+typedef struct
+{
+  uint8_t node;
+  uint8_t check; // complement of the address
+}
+pdu_node_image_t;
+
 /* Public variables  ---------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
 
 static uint8_t data[MAX_RX_DATA_SIZE];
 
+static pdu_rx_state_t rxState = PDU_RX_SOF;
+static bool rxAddressed;
+static uint8_t rxNode;
+static uint8_t rxSize;
+static uint8_t rxCommand;
+static uint8_t rxCount;
+static uint8_t activeCheck;
+
+static uint8_t rxKey;     // terminal key received outside of a frame
+static bool rxKeyReady;
+
+static uint8_t Pdu_node = PDU_NODE_DFLT;
+static pdu_node_image_t Node_image; // source of the EEPROM write
+
 /* Private function prototypes -----------------------------------------------*/
 
+static void set_speed(const uint8_t *pdata);
+static void set_mode(const uint8_t *pdata);
+static void set_telem_rate(const uint8_t *pdata);
+static void fault_log(const uint8_t *pdata);
+static void throttle_all(const uint8_t *pdata);
+static void set_node(const uint8_t *pdata);
+static void motor_select(const uint8_t *pdata);
+#if ( MPARAM_N_SLOTS > 0 )
+static void motor_load(const uint8_t *pdata);
+static void motor_save(const uint8_t *pdata);
+#endif
+
+/**
+ * @brief Lookup table for the command handlers
+ */
+static const pdu_cmd_handler_t pdu_cmd_handlers_tb[] =
+{
+  {PDU_CMD_SET_SPEED,  2, set_speed},
+  {PDU_CMD_SET_MODE,   1, set_mode},
+  {PDU_CMD_TELEM_RATE, 1, set_telem_rate},
+  {PDU_CMD_FAULT_LOG,  1, fault_log},
+  {PDU_CMD_THROTTLE_ALL, 2 * PDU_BUS_N_NODES + 1, throttle_all},
+  {PDU_CMD_SET_NODE,   1, set_node},
+  {PDU_CMD_MOTOR_SEL,  1, motor_select},
+#if ( MPARAM_N_SLOTS > 0 )
+  {PDU_CMD_MOTOR_LOAD, PDU_MOTOR_LOAD_LEN + 1, motor_load},
+  {PDU_CMD_MOTOR_SAVE, 1, motor_save},
+#endif
+};
+
+#define _SIZE_CMD_LUT  ( sizeof( pdu_cmd_handlers_tb ) / sizeof( pdu_cmd_handler_t ) )
+
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * Handlers for the PDU commands
+ * Invoked with interrupts masked
+ */
+/*
+ * set motor speed (PWM duty-cycle counts, MSB first)
+ */
+static void set_speed(const uint8_t *pdata)
+{
+  UI_set_speed( ((uint16_t)pdata[0] << 8) | pdata[1] );
+}
+
+/*
+ * set the brake mode, the other brake parameters are unchanged
+ */
+static void set_brake_mode(uint8_t mode)
+{
+  BL_brake_t brake;
+
+  BL_get_brake(&brake);
+  brake.mode = mode;
+  BL_set_brake(&brake);
+}
+
+/*
+ * set control mode
+ */
+static void set_mode(const uint8_t *pdata)
+{
+  switch (pdata[0])
+  {
+  case PDU_MODE_STOP:
+    UI_Stop();
+    break;
+  case PDU_MODE_AUTO:
+    BL_set_opstate(BL_OPN_LOOP);
+    break;
+  case PDU_MODE_MANUAL:
+    BL_set_opstate(BL_MANUAL);
+    break;
+  case PDU_MODE_GOV_ON:
+    BL_set_governor(TRUE);
+    break;
+  case PDU_MODE_GOV_OFF:
+    BL_set_governor(FALSE);
+    break;
+  case PDU_MODE_BRAKE_OFF:
+  case PDU_MODE_BRAKE_REGEN:
+  case PDU_MODE_BRAKE_FULL:
+    set_brake_mode( (uint8_t)(pdata[0] - PDU_MODE_BRAKE_OFF) );
+    break;
+  default:
+    break;
+  }
+}
+
+/*
+ * set binary telemetry rate (divider of the control rate, 0 is off)
+ */
+static void set_telem_rate(const uint8_t *pdata)
+{
+  Telem_set_rate(pdata[0]);
+}
+
+/*
+ * dump or clear the fault event log
+ */
+static void fault_log(const uint8_t *pdata)
+{
+  switch (pdata[0])
+  {
+  case PDU_FLOG_DUMP:
+    Telem_dump_faults();
+    break;
+  case PDU_FLOG_CLEAR:
+    Faultm_log_clear();
+    break;
+  default:
+    break;
+  }
+}
+
+/*
+ * set the motor speed from the slot of the node in the throttle frame of all
+ * nodes, and reply with a telemetry frame if polled. Only the polled node
+ * transmits, so the replies of the nodes are staggered over the frames.
+ */
+static void throttle_all(const uint8_t *pdata)
+{
+  if (Pdu_node < PDU_BUS_N_NODES)
+  {
+    const uint8_t *pslot = &pdata[ 2 * Pdu_node ];
+
+    UI_set_speed( ((uint16_t)pslot[0] << 8) | pslot[1] );
+  }
+  if (Pdu_node == pdata[ 2 * PDU_BUS_N_NODES ])
+  {
+    Telem_poll();
+  }
+}
+
+/*
+ * set the node address and save it to EEPROM, from a frame addressed to the
+ * present address of the node or a point-to-point frame (e.g. to configure
+ * each unit in turn before connecting it to the bus)
+ */
+static void set_node(const uint8_t *pdata)
+{
+  if ( (PDU_NODE_BROADCAST == pdata[0]) ||
+       ( (FALSE != rxAddressed) && (Pdu_node != rxNode) ) )
+  {
+    return;
+  }
+  Pdu_node = pdata[0];
+  Telem_set_node(Pdu_node);
+
+  Node_image.node = Pdu_node;
+  Node_image.check = (uint8_t)~Pdu_node;
+
+  // the write is dropped if the EEPROM is busy, the host reads back the
+  // address in the telemetry frame
+  (void)EEPROM_write(
+    EEPROM_OFS_PDU_NODE, (const uint8_t *)&Node_image, sizeof(pdu_node_image_t));
+}
+
+/*
+ * select the motor profile, ignored unless stopped (the host reads back the
+ * selection on the terminal)
+ */
+static void motor_select(const uint8_t *pdata)
+{
+  (void)Mparam_select(pdata[0]);
+}
+
+#if ( MPARAM_N_SLOTS > 0 )
+/*
+ * load part of a motor profile (offset, data) to be saved to an EEPROM slot
+ */
+static void motor_load(const uint8_t *pdata)
+{
+  (void)Mparam_load(pdata[0], &pdata[1], PDU_MOTOR_LOAD_LEN);
+}
+
+/*
+ * save the loaded motor profile to an EEPROM slot, it is then selected by the
+ * index following the built-in profiles
+ */
+static void motor_save(const uint8_t *pdata)
+{
+  (void)Mparam_save(pdata[0]);
+}
+#endif
+
 /**
- * @brief Find SOF of Rx buffer
+ * @brief Dispatch a received frame to its command handler
  *
+ * @details Frames of an unknown command or with data size not matching the
+ * command are discarded, as well as addressed frames for other nodes. The
+ * terminal output is muted once an addressed frame is received.
 */
-
-static uint8_t Find_Frame(void)
+static void Dispatch_Frame(void)
 {
-  uint8_t count;
+  uint8_t n;
 
-  for(count = 0; count < RX_BUFFER_SIZE; count++)
+  if (FALSE != rxAddressed)
   {
-    if(SOF == Driver_Return_Rx_Buffer())
+    Term_set_mute(TRUE);
+
+    if ( (Pdu_node != rxNode) && (PDU_NODE_BROADCAST != rxNode) )
     {
-      return count;
+      return;
+    }
+  }
+
+  for (n = 0; n < _SIZE_CMD_LUT; n++)
+  {
+    if (rxCommand == pdu_cmd_handlers_tb[n].command)
+    {
+      if (rxSize == pdu_cmd_handlers_tb[n].size)
+      {
+        disableInterrupts();  //////////////// DI
+        pdu_cmd_handlers_tb[n].phandler(data);
+        enableInterrupts();  ///////////////// EI
+      }
+      break;
     }
   }
-  return NO_FRAME;
 }
 
 /**
- * @brief Reads data off Rx buffer and adds together checkSum
+ * @brief Frame receiver, advanced by one byte
  *
+ * @details Frame is SOF, size, command, data[size], checksum where the
+ * checksum is the sum of the size, command and data bytes, or the addressed
+ * frame SOF_NODE, node, size, command, data[size], checksum where the node
+ * is included in the checksum. The receiver returns to searching for SOF on
+ * an oversized or invalid frame.
 */
-static  uint8_t receivedCheckSum;
-
-static uint8_t Read_Data(void)
+static void Rx_Byte(uint8_t rxByte)
 {
-  uint8_t i;
-  uint8_t activeCheck;
-  uint8_t size;
-  uint8_t command;
+  switch (rxState)
+  {
+  case PDU_RX_SOF:
+    activeCheck = 0;
+    if (SOF == rxByte)
+    {
+      rxAddressed = FALSE;
+      rxState = PDU_RX_SIZE;
+    }
+    else if (SOF_NODE == rxByte)
+    {
+      rxAddressed = TRUE;
+      rxState = PDU_RX_NODE;
+    }
+    else
+    {
+      rxKey = rxByte;
+      rxKeyReady = TRUE;
+    }
+    break;
 
-  size = Driver_Return_Rx_Buffer();
-  command = Driver_Return_Rx_Buffer();
+  case PDU_RX_NODE:
+    rxNode = rxByte;
+    activeCheck = rxByte;
+    rxState = PDU_RX_SIZE;
+    break;
 
-  activeCheck = size + command;
+  case PDU_RX_SIZE:
+    if (rxByte > MAX_RX_DATA_SIZE)
+    {
+      rxState = PDU_RX_SOF;
+    }
+    else
+    {
+      rxSize = rxByte;
+      activeCheck += rxByte;
+      rxState = PDU_RX_CMD;
+    }
+    break;
 
-  for(i = 0; i < size; i++)
-  {
-    data[i] = Driver_Return_Rx_Buffer();
-    activeCheck += data[i];
-  }
+  case PDU_RX_CMD:
+    rxCommand = rxByte;
+    activeCheck += rxByte;
+    rxCount = 0;
+    rxState = (rxSize > 0) ? PDU_RX_DATA : PDU_RX_CSUM;
+    break;
 
-  receivedCheckSum = Driver_Return_Rx_Buffer();
+  case PDU_RX_DATA:
+    data[rxCount] = rxByte;
+    activeCheck += rxByte;
+    rxCount += 1;
+    if (rxCount >= rxSize)
+    {
+      rxState = PDU_RX_CSUM;
+    }
+    break;
 
-  return activeCheck;
+  case PDU_RX_CSUM:
+  default:
+    if (activeCheck == rxByte)
+    {
+      Dispatch_Frame();
+    }
+    rxState = PDU_RX_SOF;
+    break;
+  }
 }
 
+
+/* External functions ---------------------------------------------------------*/
+
 /**
- * @brief Checksum data off Rx buffer
+ * @brief Load the node address from EEPROM
  *
+ * @details A unit that has not been configured has the default address.
 */
-
-static uint8_t Check_Data(uint8_t activeCheck)
+void Pdu_Manager_Init(void)
 {
-  if(activeCheck == receivedCheckSum)
+  pdu_node_image_t image;
+
+  EEPROM_read(EEPROM_OFS_PDU_NODE, (uint8_t *)&image, sizeof(pdu_node_image_t));
+
+  Pdu_node = PDU_NODE_DFLT;
+
+  if ( ((uint8_t)~image.node == image.check) && (PDU_NODE_BROADCAST != image.node) )
   {
-    return TRUE;
+    Pdu_node = image.node;
   }
-  return FALSE;
+  Telem_set_node(Pdu_node);
 }
 
-
-/* External functions ---------------------------------------------------------*/
+/**
+ * @brief Accessor for the node address
+*/
+uint8_t Pdu_get_node(void)
+{
+  return Pdu_node;
+}
 
 /**
  * @brief Handle Rx Buffer
  *
+ * @details Consumes the bytes received since the previous call, a complete
+ * and valid frame is dispatched to its command handler.
 */
 
 void Pdu_Manager_Handle_Rx(void)
 {
-  uint8_t frameLocation;
-  uint8_t checkSum;
+  uint8_t rxByte;
 
-  frameLocation = Find_Frame();
+  while (FALSE != Driver_Get_Rx_Byte(&rxByte))
+  {
+    Rx_Byte(rxByte);
+  }
+}
 
-  if(NO_FRAME != frameLocation)
+/**
+ * @brief Get a terminal key
+ *
+ * @details The RX interrupt takes the bytes from the UART, so a byte received
+ * outside of a frame is passed on to the terminal (the SOF are not key codes).
+ * Only the latest key since the previous call is kept.
+ * @param [out] key  Key code
+ * @return  FALSE if no key has been received
+*/
+bool Pdu_Manager_Get_Key(char *key)
+{
+  if (FALSE == rxKeyReady)
   {
-    checkSum = Read_Data();
-    if(Check_Data(checkSum))  //return TRUE if good
-    {
-      Driver_Clear_Rx_Buffer_Element(frameLocation);
-    }
+    return FALSE;
   }
+
+  *key = (char)rxKey;
+  rxKeyReady = FALSE;
+
+  return TRUE;
 }
+
+#endif // UART_IT_RXNE_ENABLE
 /**@}*/ // defgroup
@@ -13,17 +13,23 @@
  * @{
  */
 /* Includes ------------------------------------------------------------------*/
-#include <stdio.h>
 #include <stddef.h> // NULL
-#include <string.h> // memcpy
 // app headers - there are several needed for logging system data
 #include "mcu_stm8s.h"
+#include "term.h"
 #include "sequence.h"
 #include "bldc_sm.h"
 #include "faultm.h"
 #include "driver.h"
 #include "spi_stm8s.h"
 #include "pdu_manager.h"
+#include "profile.h"
+#include "telem.h"
+#include "mdata.h"
+#include "mparam.h"
+#include "sched.h"
+#include "trace.h"
+#include "scope.h"
 
 /* Private defines -----------------------------------------------------------*/
 // Stall-voltage threshold must be set low enuogh to avoid false-positive as
@@ -34,6 +40,8 @@
 //  Vbatt == 12.5v 10k/(33k+10k) * 12.5v = 2.91v
 //  2.9v * 1024 / 3.3v = $0384
 //  observed stall voltage ~$02F0
+// The threshold is w.r.t. the nominal supply voltage (BL_VSYS_NOMINAL) and is
+// scaled to the supply voltage measured in arming (see vsys_shutdown_thr).
 #define V_SHUTDOWN_THR      0x0280 // GN: 6/14/2022
 
 // each +/- press of speed keys inc/decrements this amount (100% -> 1000/4 = 250 steps)
@@ -51,6 +59,22 @@ static void spd_minus(void);
 static void m_stop(void);
 static void m_start(void);
 static void help_me(void);
+static void telem_rate(void);
+static void learn_mode(void);
+static void flog_request(void);
+static void governor(void);
+static void brake_mode(void);
+static void motor_next(void);
+#if defined( PROFILE_ENABLED )
+static void prof_request(void);
+#endif
+#if defined( TRACE_ENABLED )
+static void trace_request(void);
+#endif
+#if defined( SCOPE_ENABLED )
+static void scope_trig_next(void);
+static void scope_pre_next(void);
+#endif
 
 
 /* Private types     ---------------------------------------------------------*/
@@ -73,6 +97,22 @@ typedef enum
   SPD_PLUS    = '.', // >
   SPD_MINUS   = ',', // <
   HELP_ME     = '?',
+  TELEM_RATE  = 't',
+  LEARN_MODE  = 'l',
+  FAULT_LOG   = 'f',
+  GOVERNOR    = 'g',
+  BRAKE_MODE  = 'b',
+  MOTOR_NEXT  = 'M',
+#if defined( PROFILE_ENABLED )
+  PROF_DUMP   = 'p',
+#endif
+#if defined( TRACE_ENABLED )
+  TRACE_DUMP  = 'd',
+#endif
+#if defined( SCOPE_ENABLED )
+  SCOPE_TRIG  = 'o',
+  SCOPE_PRE   = 'O',
+#endif
   K_UNDEFINED = -1
 }
 ui_keycode_t;
@@ -89,9 +129,6 @@ ui_key_handler_t;
 
 /* Private variables ---------------------------------------------------------*/
 
-// shared between ISR and non-ISR context
-static volatile uint8_t TaskRdy; // flag for timer interrupt for BG task timing
-
 static BL_status_t bl_status;
 
 static uint8_t Log_Level;
@@ -101,6 +138,39 @@ static uint16_t UI_Speed; // motor percent speed input from servo or remote UI
 static uint8_t Radio_detect_timer;
 static bool Enable_radio_input;
 
+static bool Flog_print_req;
+static bool Mparam_print_req;
+
+#if defined( TRACE_ENABLED )
+static bool Trace_dump_req;
+#endif
+
+#if defined( SCOPE_ENABLED )
+static bool Scope_cfg_print_req;
+static bool Scope_streaming;
+static uint8_t Scope_line; // next sample to stream
+
+/**
+ * @brief Names of the scope trigger sources in order of scope_trig_t
+ */
+static const char * const Scope_trig_names[SCOPE_N_TRIGS] =
+{
+  "off", "CL entry", "timing error", "fault", "now"
+};
+#endif
+
+#if defined( PROFILE_ENABLED )
+static bool Prof_dump_req;
+
+/**
+ * @brief Names of profiled items in order of prof_item_t
+ */
+static const char * const Prof_names[PROF_N_ITEMS] =
+{
+  "COMM", "LAT ", "PWM ", "ADC ", "CTRL", "TASK"
+};
+#endif
+
 /**
  * @brief Lookup table for UI input handlers
  */
@@ -114,7 +184,23 @@ static const ui_key_handler_t ui_keyhandlers_tb[] =
   {SPD_MINUS,   spd_minus},
   {M_STOP,      m_stop},
   {M_START,     m_start},
-  {HELP_ME,     help_me}
+  {HELP_ME,     help_me},
+  {TELEM_RATE,  telem_rate},
+  {LEARN_MODE,  learn_mode},
+  {FAULT_LOG,   flog_request},
+  {GOVERNOR,    governor},
+  {BRAKE_MODE,  brake_mode},
+  {MOTOR_NEXT,  motor_next},
+#if defined( PROFILE_ENABLED )
+  {PROF_DUMP,   prof_request},
+#endif
+#if defined( TRACE_ENABLED )
+  {TRACE_DUMP,  trace_request},
+#endif
+#if defined( SCOPE_ENABLED )
+  {SCOPE_TRIG,  scope_trig_next},
+  {SCOPE_PRE,   scope_pre_next},
+#endif
 };
 
 // macros to help make the LUT slightly more encapsulated
@@ -124,10 +210,21 @@ static const ui_key_handler_t ui_keyhandlers_tb[] =
 
 
 /* Private functions ---------------------------------------------------------*/
+/*
+ * Write a labeled hex field of the status line
+ */
+static void log_hex(const char *label, uint16_t val, uint8_t digits)
+{
+  Term_puts(label);
+  Term_hex(val, digits);
+}
+
 /**
  * @brief Print one line to the debug serial port.
- * @note: NOT appropriate in either an ISR or critical section because of printf
- *  to serial terminal is blocking.
+ * @note: NOT appropriate in either an ISR or critical section because the
+ *  terminal output may wait for space in the serial transmit FIFO.
+ *  The line is queued to the serial transmit FIFO, and is skipped if the
+ *  previous output is still being sent so that it never waits for space.
  *
  * @param zeroflag set 1 to zero the line count
  */
@@ -139,26 +236,36 @@ static void Log_println(int zrof)
   {
     Line_Count = 0;
   }
-  // if logger is enabled (level>0) then invoke its output
-  if ( Log_Level > 0)
+  // if logger is enabled (level>0) then invoke its output, unless the binary
+  // telemetry is on which replaces the status line
+  if ( (Log_Level > 0) && (FALSE == Serial_tx_busy()) &&
+       (TELEM_RATE_OFF == Telem_get_rate()) )
   {
-    printf(
-      "{%04X) PWMDC%=%X CtmCt=%04X BLdc=%04X Vs=%04X Sflt=%X RCsigCt=%04X MspdCt=%04u ERR=%04X ST=%u BR=%04X BF=%04X \r\n",
-      Line_Count++,  // increment line count
-      PWM_get_dutycycle(),
-      BL_get_timing(),
-      BL_get_speed(),
-      bl_status.bl_sys_voltage,
-      (int)Faultm_get_status(),
-
-      Driver_get_pulse_dur(),
-      Driver_get_servo_position_counts(), // servo posn counts -> PWM pulse DC counts [0:1023]
-
-      Seq_get_timing_error(),
-      (uint16_t)BL_get_opstate(),
-      Seq_Get_bemfR(),
-      Seq_Get_bemfF()
-    );
+    log_hex("{", Line_Count++, 4);  // increment line count
+    log_hex(") PWMDC=", PWM_get_dutycycle(), 3);
+    log_hex(" CtmCt=", BL_get_timing(), 4);
+    log_hex(" BLdc=", BL_get_speed(), 4);
+    log_hex(" Vs=", bl_status.bl_sys_voltage, 4);
+    log_hex(" Im=", bl_status.bl_motor_current, 4);
+    Term_puts(" RPM=");
+    Term_dec(bl_status.bl_motor_rpm, 5 | TERM_PAD_ZERO);
+    Term_puts(" Ld=");
+    Term_dec(bl_status.bl_cpu_load, 3 | TERM_PAD_ZERO);
+    log_hex(" Sflt=", (uint16_t)Faultm_get_status(), 2);
+
+    log_hex(" RCsigCt=", Driver_get_pulse_dur(), 4);
+    // servo posn counts -> PWM pulse DC counts [0:1023]
+    Term_puts(" MspdCt=");
+    Term_dec(Driver_get_servo_position_counts(), 4 | TERM_PAD_ZERO);
+
+    log_hex(" ERR=", (uint16_t)Seq_get_timing_error(), 4);
+    Term_puts(" ST=");
+    Term_dec((uint16_t)BL_get_opstate(), 0);
+    log_hex(" BR=", Seq_Get_bemfR(), 4);
+    log_hex(" BF=", Seq_Get_bemfF(), 4);
+    Term_puts(" Tcl=");
+    Term_dec(BL_get_startup_time(), 0); // ms from start command to closed-loop
+    Term_puts(" \r\n");
     Log_Level -= 1;
   }
 }
@@ -200,12 +307,142 @@ static void timing_minus(void)
   BL_timing_step_faster();
 }
 
+/*
+ * select next binary telemetry rate: off -> 1/16 -> 1/4 -> 1/2 -> 1/1 of the
+ * control rate (~1 kHz) -> off
+ */
+static void telem_rate(void)
+{
+  uint8_t rate_div = Telem_get_rate();
+
+  if (TELEM_RATE_OFF == rate_div)
+  {
+    rate_div = 16;
+  }
+  else if (rate_div > 4)
+  {
+    rate_div = 4;
+  }
+  else
+  {
+    rate_div >>= 1; // 1 -> 0 i.e. off
+  }
+  Telem_set_rate(rate_div);
+}
+
+/*
+ * toggle learning of the open-loop timing table, which is saved to EEPROM
+ * when learning is turned off
+ */
+static void learn_mode(void)
+{
+  Mdata_set_learn( (FALSE != Mdata_get_learn()) ? FALSE : TRUE );
+}
+
+/*
+ * request print of the fault event log (printed outside of the CS)
+ */
+static void flog_request(void)
+{
+  Flog_print_req = TRUE;
+  Log_Level = 0; // stop the status log from running over the fault log
+}
+
+/*
+ * toggle the speed governor i.e. the speed input is the target RPM
+ */
+static void governor(void)
+{
+  BL_set_governor( (FALSE != BL_get_governor()) ? FALSE : TRUE );
+}
+
+/*
+ * step the brake mode (off, regenerative, regenerative + short brake)
+ */
+static void brake_mode(void)
+{
+  BL_brake_t brake;
+
+  BL_get_brake(&brake);
+  brake.mode = (uint8_t)( (brake.mode + 1) % BL_BRAKE_N_MODES );
+  BL_set_brake(&brake);
+}
+
+/*
+ * select the next valid motor profile, only with the motor stopped (the
+ * selected profile is printed outside of the CS)
+ */
+static void motor_next(void)
+{
+  uint8_t count = Mparam_get_count();
+  uint8_t index = Mparam_get_index();
+  uint8_t n;
+
+  for (n = 1; n < count; n++)
+  {
+    if (FALSE != Mparam_select( (uint8_t)((index + n) % count) ))
+    {
+      break;
+    }
+  }
+  Mparam_print_req = TRUE;
+  Log_Level = 0;
+}
+
+/**
+ * @brief Print the selected motor profile to the terminal.
+ */
+static void mparam_print(void)
+{
+  const mparam_t *p_prof = Mparam_get();
+
+  Term_puts("\r\nMotor profile ");
+  Term_dec((uint16_t)Mparam_get_index(), 0);
+  Term_puts(": ");
+  Term_puts(p_prof->name);
+  Term_puts(" kv=");
+  Term_dec(p_prof->kv, 0);
+  Term_puts(" pole-pairs=");
+  Term_dec((uint16_t)p_prof->motor.pole_pairs, 0);
+  Term_puts("\r\n");
+}
+
+/**
+ * @brief Print the fault event log to the terminal, oldest entry first.
+ */
+static void flog_print(void)
+{
+  faultm_event_t event;
+  uint8_t n;
+
+  Term_puts("\r\nFault log (");
+  Term_dec((uint16_t)Faultm_log_count(), 0);
+  Term_puts("):  tick  fault  ST  PWMDC  CtmCt  Vs\r\n");
+
+  for (n = 0; FALSE != Faultm_log_get(n, &event); n++)
+  {
+    Term_puts("  ");
+    Term_dec(event.tick, 5);
+    Term_puts("  ");
+    Term_hex((uint16_t)(event.event & FAULTM_EV_ID), 2);
+    Term_puts( (0 != (event.event & FAULTM_EV_CLR)) ? " clr  " : " set  " );
+    Term_dec((uint16_t)event.opstate, 2);
+    log_hex("  ", event.duty, 4);
+    log_hex("  ", event.period, 4);
+    log_hex("  ", event.vsys, 4);
+    Term_puts("\r\n");
+  }
+}
+
 /*
  * motor start
  */
 static void m_start(void)
 {
-  UI_Speed = (uint16_t)(PWM_PD_STARTUP + MSPEED_PCNT_INCREM_STEP);
+  BL_motor_t motor;
+
+  BL_get_motor(&motor);
+  UI_Speed = (uint16_t)(motor.duty_startup + MSPEED_PCNT_INCREM_STEP);
   BL_set_speed( UI_Speed );
 }
 /*
@@ -213,12 +450,12 @@ static void m_start(void)
  */
 static void m_stop(void)
 {
-  printf("\r\nStopped!\r\n");
+  Term_puts("\r\nStopped!\r\n");
   BL_reset();
 
   UI_Speed = 0;
 
-  Log_Level = 1; // allow one more status line printfd to terminal then stops log output
+  Log_Level = 1; // allow one more status line printed to terminal then stops log output
   Log_println(1 /* clear line count */ );
 }
 
@@ -250,6 +487,219 @@ static void spd_minus(void)
   Log_Level = 1;
 }
 
+#if defined( PROFILE_ENABLED )
+/*
+ * request dump of execution time profile (printed outside of the CS)
+ */
+static void prof_request(void)
+{
+  Prof_dump_req = TRUE;
+  Log_Level = 0; // stop the status log from running over the profile output
+}
+
+/**
+ * @brief Print the execution time profile to the terminal and restart.
+ * @note: Not in a CS, only the copy of the statistics is.
+ */
+static void prof_dump(void)
+{
+  prof_stats_t stats;
+  uint16_t avg;
+  uint8_t n;
+
+  Term_puts("\r\nProfile (us):  min   avg   max  budget overrun\r\n");
+
+  for (n = 0; n < PROF_N_ITEMS; n++)
+  {
+    disableInterrupts();
+    Prof_get_stats((prof_item_t)n, &stats);
+    enableInterrupts();
+
+    avg = (0 != stats.count) ? (uint16_t)(stats.t_sum / stats.count) : 0;
+
+    Term_puts("  ");
+    Term_puts(Prof_names[n]);
+    Term_puts("  ");
+    Term_dec((0 != stats.count) ? stats.t_min : 0, 5);
+    Term_putc(' ');
+    Term_dec(avg, 5);
+    Term_putc(' ');
+    Term_dec(stats.t_max, 5);
+    Term_putc(' ');
+    Term_dec(Prof_get_budget((prof_item_t)n), 5);
+    Term_putc(' ');
+    Term_dec(stats.overruns, 5);
+    Term_puts("\r\n");
+  }
+
+  Term_puts("Deadline overruns: CTRL ");
+  Term_dec(Sched_get_overruns(SCHED_RG_CONTROL), 0);
+  Term_puts("  TASK ");
+  Term_dec(Sched_get_overruns(SCHED_RG_UI), 0);
+  Term_puts("\r\n");
+
+  disableInterrupts();
+  Prof_reset();
+  enableInterrupts();
+}
+#endif // PROFILE_ENABLED
+
+#if defined( TRACE_ENABLED )
+/*
+ * request dump of the event trace (printed outside of the CS)
+ */
+static void trace_request(void)
+{
+  Trace_dump_req = TRUE;
+  Log_Level = 0; // stop the status log from running over the trace
+}
+
+/**
+ * @brief Print the event trace to the terminal, oldest event first, and re-arm.
+ * @details A trace that is not frozen by a fault is frozen for the dump. The
+ *  lines are read by the host replay (see TRACE_DUMP_KEY).
+ */
+static void trace_dump(void)
+{
+  trace_event_t event;
+  uint16_t n;
+
+  Trace_freeze(TRACE_FREEZE_DUMP);
+
+  Term_puts("\r\nTrace (");
+  Term_dec(TRACE_N_EVENTS, 0);
+  Term_puts("): tag tick val\r\n");
+
+  for (n = 0; FALSE != Trace_get(n, &event); n++)
+  {
+    if (TRACE_EV_NONE != TRACE_TAG_TYPE(event.tag))
+    {
+      Term_putc(TRACE_DUMP_KEY);
+      Term_putc(' ');
+      Term_hex(event.tag, 2);
+      Term_putc(' ');
+      Term_hex(event.tick, 2);
+      Term_putc(' ');
+      Term_hex(event.val, 4);
+      Term_puts("\r\n");
+    }
+  }
+
+  // no writer while frozen, the recording restarts once cleared
+  Trace_arm();
+}
+#endif // TRACE_ENABLED
+
+#if defined( SCOPE_ENABLED )
+/*
+ * re-arm the back-EMF scope with the next trigger source: off -> CL entry ->
+ * timing error -> fault -> now -> off
+ */
+static void scope_trig_next(void)
+{
+  scope_cfg_t cfg;
+
+  Scope_get_cfg(&cfg);
+  cfg.trig = (uint8_t)((cfg.trig + 1) % SCOPE_N_TRIGS);
+  Scope_arm(&cfg);
+
+  Scope_streaming = FALSE;
+  Scope_cfg_print_req = TRUE;
+}
+
+/*
+ * re-arm the back-EMF scope with the next pre-trigger depth: 0 -> 1/4 -> 1/2
+ * -> 3/4 of the buffer -> 0
+ */
+static void scope_pre_next(void)
+{
+  scope_cfg_t cfg;
+
+  Scope_get_cfg(&cfg);
+  cfg.pre += (uint8_t)(SCOPE_N_SAMPLES / 4);
+  if (cfg.pre >= SCOPE_N_SAMPLES)
+  {
+    cfg.pre = 0;
+  }
+  Scope_arm(&cfg);
+
+  Scope_streaming = FALSE;
+  Scope_cfg_print_req = TRUE;
+}
+
+/**
+ * @brief Stream out the completed back-EMF capture.
+ * @details Non-blocking, the lines are written as space becomes available
+ *  in the serial transmit FIFO, over as many task periods as needed. The
+ *  capture is stopped once streamed, to be re-armed from the terminal. The
+ *  status log is held off while streaming.
+ */
+static void scope_stream(void)
+{
+  scope_sample_t smp;
+
+  if (FALSE != Scope_cfg_print_req)
+  {
+    scope_cfg_t cfg;
+
+    Scope_cfg_print_req = FALSE;
+    Scope_get_cfg(&cfg);
+
+    Term_puts("\r\nScope trigger: ");
+    Term_puts(Scope_trig_names[cfg.trig]);
+    Term_puts(", pre-trigger ");
+    Term_dec(cfg.pre, 0);
+    Term_puts("/");
+    Term_dec(SCOPE_N_SAMPLES, 0);
+    Term_puts("\r\n");
+  }
+
+  if ( (FALSE == Scope_streaming) && (FALSE != Scope_is_done()) )
+  {
+    Scope_streaming = TRUE;
+    Scope_line = 0;
+
+    Term_puts("\r\nScope (");
+    Term_dec(SCOPE_N_SAMPLES, 0);
+    Term_puts(", trigger at ");
+    Term_dec(Scope_get_trigger_index(), 0);
+    Term_puts("): A B C sector\r\n");
+  }
+
+  if (FALSE == Scope_streaming)
+  {
+    return;
+  }
+
+  Log_Level = 0; // keep the status log from running into the capture
+
+  while (Serial_tx_free() >= SCOPE_LINE_LEN)
+  {
+    if (FALSE == Scope_get(Scope_line, &smp))
+    {
+      // the buffer is released for the next capture once streamed
+      Scope_streaming = FALSE;
+      disableInterrupts();  //////////////// DI
+      Scope_stop();
+      enableInterrupts();  ///////////////// EI
+      break;
+    }
+    Term_putc(SCOPE_DUMP_KEY);
+    Term_putc(' ');
+    Term_hex(SCOPE_SAMPLE_ADC(smp, 0), 3);
+    Term_putc(' ');
+    Term_hex(SCOPE_SAMPLE_ADC(smp, 1), 3);
+    Term_putc(' ');
+    Term_hex(SCOPE_SAMPLE_ADC(smp, 2), 3);
+    Term_putc(' ');
+    Term_hex(SCOPE_SAMPLE_SECTOR(smp), 1);
+    Term_puts("\r\n");
+
+    Scope_line += 1;
+  }
+}
+#endif // SCOPE_ENABLED
+
 /*
  * handle terminal input - these are simple 1-key inputs for now
  */
@@ -259,7 +709,11 @@ static ui_handlrp_t handle_term_inp(void)
   char key;
 
 // Uses non-blocking/non-buffered scan for key input similar to getch()
+#ifdef UART_IT_RXNE_ENABLE
+  if (Pdu_Manager_Get_Key(&key)) // the RX interrupt passes the key on
+#else
   if (SerialKeyPressed(&key))
+#endif
   {
     int n;
     for (n = 0; n < _SIZE_K_LUT ; n++)
@@ -285,18 +739,36 @@ static ui_handlrp_t handle_term_inp(void)
 
 void help_me(void)
 {
-  printf("\r\n");
-  printf("----------------------------------------------\r\n");
-  printf("BL Motor Control Version %d\r\n", BL_SW_VERSION);
-  printf("  Detected Vbatt 0x%04X\r\n", bl_status.bl_sys_voltage);
-  printf("  Keys:\r\n");
-  printf("     / (slash):  start\r\n");
-  printf("     <    >   :  speed-/speed+\r\n");
-  printf("     m        :  toggle auto/manual control\r\n");
-  printf("     [    ]   :  speed+/speed- (manual commutation control)\r\n");
-  printf("     Space Bar:  stop\r\n");
-  printf("----------------------------------------------\r\n");
-  printf("\r\n");
+  Term_puts("\r\n");
+  Term_puts("----------------------------------------------\r\n");
+  Term_puts("BL Motor Control Version ");
+  Term_dec(BL_SW_VERSION, 0);
+  log_hex("\r\n  Detected Vbatt 0x", bl_status.bl_sys_voltage, 4);
+  Term_puts("\r\n");
+  Term_puts("  Keys:\r\n");
+  Term_puts("     / (slash):  start\r\n");
+  Term_puts("     <    >   :  speed-/speed+\r\n");
+  Term_puts("     m        :  toggle auto/manual control\r\n");
+  Term_puts("     [    ]   :  speed+/speed- (manual commutation control)\r\n");
+  Term_puts("     Space Bar:  stop\r\n");
+  Term_puts("     t        :  binary telemetry rate (off, 1/16 .. 1/1 kHz)\r\n");
+  Term_puts("     l        :  toggle learning of open-loop timing (saved when off)\r\n");
+  Term_puts("     f        :  print fault log\r\n");
+  Term_puts("     g        :  toggle speed governor (speed input is RPM)\r\n");
+  Term_puts("     b        :  brake mode (off, regen, regen + short at stop)\r\n");
+  Term_puts("     M        :  next motor profile (stopped)\r\n");
+#if defined( PROFILE_ENABLED )
+  Term_puts("     p        :  print execution time profile\r\n");
+#endif
+#if defined( TRACE_ENABLED )
+  Term_puts("     d        :  dump event trace (frozen at the first fault)\r\n");
+#endif
+#if defined( SCOPE_ENABLED )
+  Term_puts("     o        :  back-EMF scope trigger (off, CL, error, fault, now)\r\n");
+  Term_puts("     O        :  back-EMF scope pre-trigger depth\r\n");
+#endif
+  Term_puts("----------------------------------------------\r\n");
+  Term_puts("\r\n");
 }
 
 /**
@@ -318,6 +790,34 @@ void UI_Stop(void)
   Log_Level = 10; // show some information on the terminal
 }
 
+/**
+ * @brief  Extern function for setting the motor speed of the remote UI
+ * @details  Has no effect if the radio input is enabled.
+ * @param speed  Commanded speed, PWM duty-cycle counts
+ */
+void UI_set_speed(uint16_t speed)
+{
+  UI_Speed = speed;
+}
+
+#if defined( UNDERVOLTAGE_FAULT_ENABLED )
+/*
+ * Stall-voltage threshold scaled to the unloaded supply voltage measured in
+ * arming, so that the stall is detected by the droop relative to the battery
+ * at any state of charge.
+ */
+static uint16_t vsys_shutdown_thr(void)
+{
+  uint16_t vrest = BL_get_vbatt_rest();
+
+  if (vrest > BL_VSYS_OOR_THRSH)
+  {
+    return (uint16_t)( ((uint32_t)vrest * V_SHUTDOWN_THR) / BL_VSYS_NOMINAL );
+  }
+  return V_SHUTDOWN_THR;
+}
+#endif
+
 /**
  * @brief  The User Interface task
  *
@@ -328,26 +828,35 @@ static void Periodic_task(void)
 {
   static bool rf_enabled = FALSE;
   static uint16_t servo_pulse_sma = 0;
+  static uint16_t thr_frames = 0;
 
 // Invoke the terminal input and ui speed subroutines.
 // If there is a valid key input, a function pointer to the input handler is
 // returned. This is done prior to entering a Critical Section (DI/EI) in which
 // it will then be safe to invoke the input handler function (e.g. can call
 // subfunctions that may be messing with global variables e.g. motor speed etc.
+// The CS is only entered on a key input, which is rare.
   ui_handlrp_t fp = handle_term_inp();
-  BL_status_t * p_bl_status = NULL;
+  uint16_t cmd_speed;
+
+  // status snapshot is published by the control task and read w/o a CS
+  BL_get_status(&bl_status);
 
-  disableInterrupts();  //////////////// DI
+#if SPI_ENABLED
+  // exchange of the status and throttle frame with the host
+  SPI_set_status(&bl_status);
 
-  p_bl_status = BL_get_status();
-  if (NULL != p_bl_status)
+  if (FALSE != SPI_get_throttle(&cmd_speed))
   {
-    memcpy(&bl_status, p_bl_status, sizeof(BL_status_t));
+    UI_set_speed(cmd_speed);
   }
+#endif
 
   if (NULL != fp)
   {
+    disableInterrupts();  //////////////// DI
     fp();
+    enableInterrupts();  ///////////////// EI
   }
 
   // passes the UI percent motor speed to the BL controller
@@ -356,15 +865,36 @@ static void Periodic_task(void)
     // if any key input inside keyboard detect window, Enable Manual Speed will set True
     Radio_detect_timer += 1;
     // todo: if radio detected ... stop looking for key input
-    if ( Driver_get_pulse_dur() > TCC_TIME_DETECT )
+    if (THR_PROTO_SERVO != Driver_get_throttle_proto())
     {
+      // throttle of each frame is latched by the capture ISR and passed to the
+      // controller by the control task
       Radio_detect_timer = KEYBOARD_DETECT_WINDOW;
       Enable_radio_input = TRUE;
+      Driver_thr_isr_enable(TRUE);
+    }
+    else if ( Driver_get_pulse_dur() > TCC_TIME_DETECT )
+    {
+      Radio_detect_timer = KEYBOARD_DETECT_WINDOW;
+      Enable_radio_input = TRUE;
+    }
+  }
+  else if ( (FALSE != Enable_radio_input) &&
+            (THR_PROTO_SERVO != Driver_get_throttle_proto()) )
+  {
+    // stop the motor if no valid frame was received since the previous task
+    uint16_t frames = Driver_get_thr_frames();
+
+    if (frames == thr_frames)
+    {
+      disableInterrupts();  //////////////// DI
+      BL_set_speed(0);
+      enableInterrupts();  ///////////////// EI
     }
+    thr_frames = frames;
   }
   else
   {
-    uint16_t cmd_speed;
     if (FALSE != Enable_radio_input)
     {
       servo_pulse_sma = (Driver_get_servo_position_counts() + servo_pulse_sma) / 2;
@@ -374,17 +904,22 @@ static void Periodic_task(void)
     {
       cmd_speed = UI_Speed;
     }
+
+    // only the speed command hand-off to the controller is in the CS
+    disableInterrupts();  //////////////// DI
     BL_set_speed(cmd_speed);
+    enableInterrupts();  ///////////////// EI EI O
   }
 
-  enableInterrupts();  ///////////////// EI EI O
-
 #if defined( UNDERVOLTAGE_FAULT_ENABLED )
   // update system voltage diagnostic - check plausibilty of Vsys
   if (bl_status.bl_sys_voltage > BL_VSYS_OOR_THRSH)
   {
+    disableInterrupts();  //////////////// DI
     Faultm_upd(
-      VOLTAGE_NG, (faultm_assert_t)(bl_status.bl_sys_voltage < V_SHUTDOWN_THR));
+      VOLTAGE_NG,
+      (faultm_assert_t)(bl_status.bl_sys_voltage < vsys_shutdown_thr()));
+    enableInterrupts();  ///////////////// EI
   }
 #endif
 }
@@ -395,7 +930,7 @@ static void Periodic_task(void)
  * @details
  * Called in non-ISR context - checks the background task ready flag which if !0
  * will invoke the Periodic Task function.
- * @note  Called at ~60 Hz (0.0167 ms) - see Driver_Update()
+ * @note  Released at ~60 Hz (16.4 ms) by the scheduler (SCHED_RG_UI)
  * @return  True if task ran (allows caller to also sync w/ the time period)
  */
 uint8_t Task_Ready(void)
@@ -407,6 +942,8 @@ uint8_t Task_Ready(void)
   Pdu_Manager_Handle_Rx();
 #endif
 
+  Telem_Task();
+
   if (is_first)
   {
     is_first = FALSE;
@@ -414,11 +951,53 @@ uint8_t Task_Ready(void)
     Enable_radio_input = FALSE;
   }
 
-  if (0 != TaskRdy)
+  if (FALSE != Sched_bg_ready(SCHED_RG_UI))
   {
-    TaskRdy = FALSE;
+// profiler time stamps are only coherent with interrupts masked
+#if defined( PROFILE_ENABLED )
+    disableInterrupts();
+    PROF_BEGIN(PROF_PER_TASK);
+    enableInterrupts();
+#endif
+
     Periodic_task();
 
+    if (FALSE != Flog_print_req)
+    {
+      Flog_print_req = FALSE;
+      flog_print();
+    }
+
+    if (FALSE != Mparam_print_req)
+    {
+      Mparam_print_req = FALSE;
+      mparam_print();
+    }
+
+#if defined( PROFILE_ENABLED )
+    disableInterrupts();
+    PROF_END(PROF_PER_TASK);
+    enableInterrupts();
+
+    if (FALSE != Prof_dump_req)
+    {
+      Prof_dump_req = FALSE;
+      prof_dump();
+    }
+#endif
+
+#if defined( TRACE_ENABLED )
+    if (FALSE != Trace_dump_req)
+    {
+      Trace_dump_req = FALSE;
+      trace_dump();
+    }
+#endif
+
+#if defined( SCOPE_ENABLED )
+    scope_stream();
+#endif
+
     framecount += 1;
 
     // periodic task @ ~60 Hz - modulus 0x10 -> 16 * 0.016 s = 0.267 seconds (~4 Hz)
@@ -427,29 +1006,15 @@ uint8_t Task_Ready(void)
       /* Toggles LED to verify task timing */
       //GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
 
-      Log_println(0); // note: no printf to serial terminal inside a CS
+      Log_println(0); // note: no terminal output inside a CS
     }
-    else if (4 == (framecount % 0x80)) // don't let it fall on the modulus of Log Print
-    {
-      // SPI can TX more frequently than Log Print but don't let both on the same frames
+
 #if SPI_ENABLED == SPI_STM8_MASTER
-      SPI_controld();
+    // frame is exchanged by the SPI ISR, the task only starts it
+    SPI_controld();
 #endif
-    }
     return TRUE;
   }
   return FALSE;
 }
-
-/**
- * @brief  Trigger background task.
- *
- * @details
- * Called in ISR context - sets the background task ready flag which when seen
- * by polling Task_Ready in background task will invoke the Periodic Task function.
- */
-void Periodic_Task_Wake(void)
-{
-  TaskRdy = TRUE; // notify background process
-}
 /**@}*/ // defgroup
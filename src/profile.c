@@ -0,0 +1,193 @@
+/**
+  ******************************************************************************
+  * @file profile.c
+  * @brief Execution time profiling of ISRs and background task
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup profile Profiler
+ * @brief Execution time profiling of ISRs and background task
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include "profile.h"
+#include "pwm_stm8s.h"
+#include "sched.h"
+
+#if defined( PROFILE_ENABLED )
+
+/* Private defines -----------------------------------------------------------*/
+
+// PWM period in microseconds e.g. 1024 counts * 2 (prescaler) / 16 Mhz = 128 us
+#define PWM_PERIOD_US   (uint16_t)(PWM_PERIOD_FMASTER / 16)
+
+// commutation ISR latency - at the highest level it can only be held off by
+// the ADC ISR and by critical sections
+#define COMM_LAT_US     (uint16_t)20
+
+// control task period in microseconds (~1 kHz)
+#define CTRL_TASK_US    (uint16_t)(PWM_PERIOD_US * SCHED_DIV_CONTROL)
+
+// Periodic task period in microseconds (~60 Hz)
+#define PER_TASK_US     (uint16_t)(1000000UL / 60)
+
+/* Private variables ---------------------------------------------------------*/
+
+/**
+ * @brief Time budget of each item (us), elapsed time over the budget counts an overrun.
+ * @details ISRs are budgeted the PWM period (i.e. a PWM cycle would be missed),
+ * the tasks their own repetition period.
+ * The commutation latency is budgeted the time that it can be held off by the
+ * ADC ISR.
+ */
+static const uint16_t Prof_budget[PROF_N_ITEMS] =
+{
+  PWM_PERIOD_US,  // PROF_COMM_ISR
+  COMM_LAT_US,    // PROF_COMM_LAT
+  PWM_PERIOD_US,  // PROF_PWM_ISR
+  PWM_PERIOD_US,  // PROF_ADC_ISR
+  CTRL_TASK_US,   // PROF_CTRL_TASK
+  PER_TASK_US     // PROF_PER_TASK
+};
+
+static prof_stats_t Prof_stats[PROF_N_ITEMS];
+
+static uint16_t Prof_t_start[PROF_N_ITEMS];
+
+// upper byte of the time stamp counter, extends the 8-bit TIM4
+static volatile uint8_t Prof_tick_hi;
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Read 16-bit microsecond time stamp.
+ * @details TIM4 is 8-bit free-running at 1 us, the upper byte is maintained
+ *  by the TIM4 overflow ISR. Must be called with interrupts masked - a pending
+ *  overflow is accounted for by checking the update flag.
+ */
+static uint16_t prof_time(void)
+{
+  uint8_t lo = TIM4->CNTR;
+  uint8_t hi = Prof_tick_hi;
+
+  if ( 0 != (TIM4->SR1 & TIM4_SR1_UIF) )
+  {
+    // overflow is pending: re-read the counter which is known to have wrapped
+    lo = TIM4->CNTR;
+    hi += 1;
+  }
+  return ((uint16_t)hi << 8) | lo;
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Time stamp entry to a profiled item.
+ *
+ * @param item  Item ID
+ */
+void Prof_begin(prof_item_t item)
+{
+  Prof_t_start[item] = prof_time();
+}
+
+/**
+ * @brief Time stamp exit from a profiled item and update its statistics.
+ *
+ * @param item  Item ID
+ */
+void Prof_end(prof_item_t item)
+{
+  Prof_sample(item, prof_time() - Prof_t_start[item]);
+}
+
+/**
+ * @brief Update the statistics of an item with a time measured by the caller.
+ * @details Only use with interrupts masked (i.e. in ISR context, or inside a
+ *  critical section).
+ *
+ * @param item  Item ID
+ * @param dt  Elapsed time (us)
+ */
+void Prof_sample(prof_item_t item, uint16_t dt)
+{
+  prof_stats_t *p = &Prof_stats[item];
+
+  if (dt < p->t_min)
+  {
+    p->t_min = dt;
+  }
+  if (dt > p->t_max)
+  {
+    p->t_max = dt;
+  }
+  if (dt > Prof_budget[item])
+  {
+    p->overruns += 1;
+  }
+  // halve the running sum and count if the counter would overflow
+  if (U16_MAX == p->count)
+  {
+    p->t_sum >>= 1;
+    p->count >>= 1;
+  }
+  p->t_sum += dt;
+  p->count += 1;
+}
+
+/**
+ * @brief Handle overflow of the time stamp counter.
+ * @details Invoked from the TIM4 ISR (every 256 us).
+ */
+void Prof_timer_ovf(void)
+{
+  Prof_tick_hi += 1;
+}
+
+/**
+ * @brief Copy statistics of an item.
+ * @details Call from inside a critical section for coherency of the copy.
+ *
+ * @param item  Item ID
+ * @param p_stats  Destination
+ */
+void Prof_get_stats(prof_item_t item, prof_stats_t *p_stats)
+{
+  *p_stats = Prof_stats[item];
+}
+
+/**
+ * @brief Get the time budget of an item.
+ *
+ * @param item  Item ID
+ * @return  time budget (us)
+ */
+uint16_t Prof_get_budget(prof_item_t item)
+{
+  return Prof_budget[item];
+}
+
+/**
+ * @brief Reset statistics of all items.
+ */
+void Prof_reset(void)
+{
+  uint8_t n;
+  for (n = 0; n < PROF_N_ITEMS; n++)
+  {
+    Prof_stats[n].t_min = U16_MAX;
+    Prof_stats[n].t_max = 0;
+    Prof_stats[n].t_sum = 0;
+    Prof_stats[n].count = 0;
+    Prof_stats[n].overruns = 0;
+  }
+}
+
+#endif // PROFILE_ENABLED
+
+/**@}*/ // defgroup
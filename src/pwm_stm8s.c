@@ -16,8 +16,10 @@
 
 /* Includes ------------------------------------------------------------------*/
 // stm8s header is provided by the tool chain and is needed for typedefs of uint etc.
+#include <stddef.h> // NULL
 #include <stm8s.h>
 #include "pwm_stm8s.h" // externalized macros used internally
+#include "hal_stm8s.h"
 
 /* Private defines -----------------------------------------------------------*/
 /**
@@ -37,16 +39,91 @@
 
 
 /* Private types -----------------------------------------------------------*/
+#if defined( SEQ_REG_TABLE )
+/*
+ * Precomputed register image of a commutation sector. The PWM timer channel
+ * enables are given as the CCER1/CCER2 bits to be set (all other phase channel
+ * enables are cleared) while the /SD (half-bridge enable) of each phase is
+ * resolved to its port output register and pin mask.
+ */
+typedef struct
+{
+  volatile uint8_t * p_ccr_hi;   // compare register (MSB) of the PWM phase
+  uint8_t ccer1;                 // channel enable bits of the PWM phase
+  uint8_t ccer2;
+  volatile uint8_t * p_sd_flt;   // /SD of the floating phase (disabled)
+  uint8_t sd_flt_pin;
+  volatile uint8_t * p_sd_pwm;   // /SD of the PWM phase (enabled)
+  uint8_t sd_pwm_pin;
+  volatile uint8_t * p_sd_ls;    // /SD of the low-side phase (enabled)
+  uint8_t sd_ls_pin;
+#if defined( PWM_COMPLEMENTARY )
+  volatile uint8_t * p_ccmr_pwm; // output compare mode of the PWM phase
+  volatile uint8_t * p_ccmr_ls;  // output compare mode of the low-side phase
+#endif
+}
+PWM_sector_rec_t;
+#endif
 
 /* Public variables  ---------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
 static uint16_t global_uDC;
 
+// pulse limit set by the current limit (current.c), in PWM timer counts
+static uint16_t PWM_pulse_limit = PWM_PERIOD_COUNTS;
+
+// compare register (MSB) of the PWM phase of the present sector, NULL if none
+static volatile uint8_t * PWM_pccr;
+
 /* Private function prototypes -----------------------------------------------*/
 
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * Pulse of the PWM phase: the duty-cycle clamped to the pulse limit
+ */
+static uint16_t pwm_pulse(void)
+{
+  return (global_uDC < PWM_pulse_limit) ? global_uDC : PWM_pulse_limit;
+}
+
+/*
+ * With the register table sequencer the low-side (IN=0) drive of a phase is
+ * simply its timer channel disabled, so the PWM pins must already be
+ * configured as push-pull outputs driving low when they revert to GPIO. Also
+ * the low-side drive of all 3 phases of the short brake (PWM_brake_short).
+ */
+static void pwm_pins_outp_lo(void)
+{
+  SDa_PWM_PORT->ODR &= (uint8_t) ( ~SDa_PWM_PIN );
+  SDa_PWM_PORT->DDR |=  SDa_PWM_PIN;
+  SDa_PWM_PORT->CR1 |=  SDa_PWM_PIN;
+
+  SDb_PWM_PORT->ODR &= (uint8_t) ( ~SDb_PWM_PIN );
+  SDb_PWM_PORT->DDR |=  SDb_PWM_PIN;
+  SDb_PWM_PORT->CR1 |=  SDb_PWM_PIN;
+
+  SDc_PWM_PORT->ODR &= (uint8_t) ( ~SDc_PWM_PIN );
+  SDc_PWM_PORT->DDR |=  SDc_PWM_PIN;
+  SDc_PWM_PORT->CR1 |=  SDc_PWM_PIN;
+
+#if defined( PWM_COMPLEMENTARY )
+  // low-side inputs are also held off while the phase is floating
+  SDa_PWMN_PORT->ODR &= (uint8_t) ( ~SDa_PWMN_PIN );
+  SDa_PWMN_PORT->DDR |=  SDa_PWMN_PIN;
+  SDa_PWMN_PORT->CR1 |=  SDa_PWMN_PIN;
+
+  SDb_PWMN_PORT->ODR &= (uint8_t) ( ~SDb_PWMN_PIN );
+  SDb_PWMN_PORT->DDR |=  SDb_PWMN_PIN;
+  SDb_PWMN_PORT->CR1 |=  SDb_PWMN_PIN;
+
+  SDc_PWMN_PORT->ODR &= (uint8_t) ( ~SDc_PWMN_PIN );
+  SDc_PWMN_PORT->DDR |=  SDc_PWMN_PIN;
+  SDc_PWMN_PORT->CR1 |=  SDc_PWMN_PIN;
+#endif
+}
+
 /* Public functions ---------------------------------------------------------*/
 
 /**
@@ -62,6 +139,66 @@ void All_phase_stop(void)
 
   PWM_PhC_Disable();
   PWM_PhC_HB_DISABLE();
+
+#if defined( PWM_COMPLEMENTARY )
+  // release the low-side inputs of the short brake
+  SDa_PWMN_PORT->ODR &= (uint8_t) ( ~SDa_PWMN_PIN );
+  SDb_PWMN_PORT->ODR &= (uint8_t) ( ~SDb_PWMN_PIN );
+  SDc_PWMN_PORT->ODR &= (uint8_t) ( ~SDc_PWMN_PIN );
+#endif
+}
+
+/**
+ * @brief Short brake: low-side switch of all 3 phases on.
+ *
+ * @details The timer channels are disabled so that the PWM pins revert to
+ *  GPIO driving IN low, and the half-bridges are enabled i.e. the IR2104 turns
+ *  on the low-side FET of each phase. The back-EMF drives the braking current
+ *  through the windings and the low-side FETs, none of it is returned to the
+ *  supply. With the complementary drive the low-side inputs (LIN) are driven
+ *  high. Released by All_phase_stop().
+ */
+void PWM_brake_short(void)
+{
+  PWM_PhA_Disable();
+  PWM_PhB_Disable();
+  PWM_PhC_Disable();
+
+  pwm_pins_outp_lo();
+
+#if defined( PWM_COMPLEMENTARY )
+  SDa_PWMN_PORT->ODR |= SDa_PWMN_PIN;
+  SDb_PWMN_PORT->ODR |= SDb_PWMN_PIN;
+  SDc_PWMN_PORT->ODR |= SDc_PWMN_PIN;
+#endif
+
+  PWM_PhA_HB_ENABLE();
+  PWM_PhB_HB_ENABLE();
+  PWM_PhC_HB_ENABLE();
+}
+
+/**
+ * @brief Alignment drive: low-side switch of phase C on, with sector 0.
+ *
+ * @details Driven after sector 0 (phase A PWM, phase B low-side) so that the
+ *  floating phase C is also switched to the low-side. The back-EMF of the
+ *  phases B and C drives a braking current through the 2 low-side FETs which
+ *  damps the swing of the rotor about the alignment, where that of the 2
+ *  phases of sector 0 is nil. The rotor is aligned 30 degrees behind the
+ *  field of sector 1, the first step of the ramp. With the complementary
+ *  drive the low-side input (LIN) is driven high, released by the next sector
+ *  (PWM_set_sector) or All_phase_stop().
+ */
+void PWM_align_drive(void)
+{
+  PWM_PhC_Disable();
+  PWM_PhC_OUTP_LO();
+
+#if defined( PWM_COMPLEMENTARY )
+  SDc_PWMN_PORT->ODR |= SDc_PWMN_PIN;
+#endif
+
+  PWM_PhC_HB_ENABLE();
 }
 
 /**
@@ -79,6 +216,46 @@ void PWM_set_dutycycle(uint16_t global_dutycycle)
 {
   global_uDC = global_dutycycle;
 }
+
+/**
+ * @brief Accessor for the pulse of the PWM phase
+ * @return  Compare value of the PWM phase of the present sector, 0 if no phase
+ *   is PWM'd
+ */
+uint16_t PWM_get_pulse(void)
+{
+  return (NULL != PWM_pccr) ? pwm_pulse() : 0;
+}
+
+/**
+ * @brief Set the limit of the pulse of the PWM phase
+ * @details  The clamped pulse is written to the running compare register, so
+ *   it takes effect in the present PWM cycle - the present pulse ends at once
+ *   if the counter is already past it. The compare register is also written at
+ *   each commutation step, so only invoke from ISR at the same level (ADC).
+ * @param limit  Pulse limit (PWM timer counts), PWM_PERIOD_COUNTS if none
+ */
+void PWM_set_pulse_limit(uint16_t limit)
+{
+  volatile uint8_t * pccr = PWM_pccr;
+
+  PWM_pulse_limit = limit;
+
+  if (NULL != pccr)
+  {
+    uint16_t pulse = pwm_pulse();
+
+    HAL_TIM_SET_CCR( pccr, pulse );
+  }
+}
+
+/**
+ * @brief Accessor for the limit of the pulse of the PWM phase
+ */
+uint16_t PWM_get_pulse_limit(void)
+{
+  return PWM_pulse_limit;
+}
 /** @cond */ // hide the low-level code
 
 /*
@@ -93,11 +270,27 @@ void PWM_set_dutycycle(uint16_t global_dutycycle)
  *               0.000125 S / (1/16Mhz) * 1600 = 0.0001
  *               1 / 0.0001 = 10000
  */
-#define TIM2_PRESCALER   TIM2_PRESCALER_2
-
-#define PWM_TIMER_CHAN_A  TIM2_CHANNEL_1
-#define PWM_TIMER_CHAN_B  TIM2_CHANNEL_2
-#define PWM_TIMER_CHAN_C  TIM2_CHANNEL_3
+#if ( 1 == PWM_TIMER_PSC )
+  #define TIM2_PRESCALER   TIM2_PRESCALER_1
+#else
+  #define TIM2_PRESCALER   TIM2_PRESCALER_2
+#endif
+
+// channel enables and compare registers of A/B/C
+#define PWM_CCER1_MASK  ( TIM2_CCER1_CC1E | TIM2_CCER1_CC2E )
+#define PWM_CCER2_MASK  ( TIM2_CCER2_CC3E )
+
+#define PWM_CCER1_a     TIM2_CCER1_CC1E
+#define PWM_CCER2_a     0
+#define PWM_CCR_a       ( &TIM2->CCR1H )
+#define PWM_CCER1_b     TIM2_CCER1_CC2E
+#define PWM_CCER2_b     0
+#define PWM_CCR_b       ( &TIM2->CCR2H )
+#define PWM_CCER1_c     0
+#define PWM_CCER2_c     TIM2_CCER2_CC3E
+#define PWM_CCR_c       ( &TIM2->CCR3H )
+
+#define PWM_TIMER       TIM2
 
 void PWM_setup(void)
 {
@@ -121,55 +314,71 @@ void PWM_setup(void)
   /* Enables TIM2 peripheral Preload register on ARR */
 //  TIM2_ARRPreloadConfig(ENABLE);
 
+#if defined( SEQ_REG_TABLE )
+  pwm_pins_outp_lo();
+#endif
+
   TIM2_ITConfig(TIM2_IT_UPDATE, ENABLE);  // for triggering ADC capture
   TIM2_Cmd(ENABLE);
 }
 
-/*
- * Operate /SD inputs to IR2104
- */
-void PWM_PhA_Disable(void)
-{
-  TIM2_CCxCmd( PWM_TIMER_CHAN_A, DISABLE );
-}
-
-void PWM_PhB_Disable(void)
-{
-  TIM2_CCxCmd( PWM_TIMER_CHAN_B, DISABLE );
-}
-
-void PWM_PhC_Disable(void)
-{
-  TIM2_CCxCmd( PWM_TIMER_CHAN_C, DISABLE );
-}
-
-void PWM_PhA_Enable(void)
-{
-  TIM2_SetCompare1( global_uDC );
-  TIM2_CCxCmd( PWM_TIMER_CHAN_A, ENABLE );
-}
-
-void PWM_PhB_Enable(void)
-{
-  TIM2_SetCompare2( global_uDC );
-  TIM2_CCxCmd( PWM_TIMER_CHAN_B, ENABLE );
-}
-
-void PWM_PhC_Enable(void)
-{
-  TIM2_SetCompare3( global_uDC );
-  TIM2_CCxCmd( PWM_TIMER_CHAN_C, ENABLE );
-}
-
 #elif defined ( S105_DEV )
 
-#define TIM1_PRESCALER 2
+#define TIM1_PRESCALER PWM_TIMER_PSC
 
 #define PWM_MODE  TIM1_OCMODE_PWM2
 
-#define PWM_TIMER_CHAN_A  TIM1_CHANNEL_2
-#define PWM_TIMER_CHAN_B  TIM1_CHANNEL_3
-#define PWM_TIMER_CHAN_C  TIM1_CHANNEL_4
+#if defined( PWM_COMPLEMENTARY )
+/*
+ * Phases on CH1:CH3 w/ complementary outputs, CH4 (no output) is left for the
+ * ADC trigger reference.
+ */
+
+// channel enables and compare registers of A/B/C
+#define PWM_CCER1_MASK  ( TIM1_CCER1_CC1E | TIM1_CCER1_CC1NE | \
+                          TIM1_CCER1_CC2E | TIM1_CCER1_CC2NE )
+#define PWM_CCER2_MASK  ( TIM1_CCER2_CC3E | TIM1_CCER2_CC3NE )
+
+#define PWM_CCER1_a     ( TIM1_CCER1_CC1E | TIM1_CCER1_CC1NE )
+#define PWM_CCER2_a     0
+#define PWM_CCR_a       ( &TIM1->CCR1H )
+#define PWM_CCMR_a      ( &TIM1->CCMR1 )
+#define PWM_CCER1_b     ( TIM1_CCER1_CC2E | TIM1_CCER1_CC2NE )
+#define PWM_CCER2_b     0
+#define PWM_CCR_b       ( &TIM1->CCR2H )
+#define PWM_CCMR_b      ( &TIM1->CCMR2 )
+#define PWM_CCER1_c     0
+#define PWM_CCER2_c     ( TIM1_CCER2_CC3E | TIM1_CCER2_CC3NE )
+#define PWM_CCR_c       ( &TIM1->CCR3H )
+#define PWM_CCMR_c      ( &TIM1->CCMR3 )
+
+// low-side phase: OCxREF forced active i.e. OCx (HIN) off, OCxN (LIN) on
+#define PWM_MODE_LS     TIM1_FORCEDACTION_ACTIVE
+
+#else
+// channel enables and compare registers of A/B/C
+#define PWM_CCER1_MASK  ( TIM1_CCER1_CC2E )
+#define PWM_CCER2_MASK  ( TIM1_CCER2_CC3E | TIM1_CCER2_CC4E )
+
+#define PWM_CCER1_a     TIM1_CCER1_CC2E
+#define PWM_CCER2_a     0
+#define PWM_CCR_a       ( &TIM1->CCR2H )
+#define PWM_CCER1_b     0
+#define PWM_CCER2_b     TIM1_CCER2_CC3E
+#define PWM_CCR_b       ( &TIM1->CCR3H )
+#define PWM_CCER1_c     0
+#define PWM_CCER2_c     TIM1_CCER2_CC4E
+#define PWM_CCR_c       ( &TIM1->CCR4H )
+#endif // PWM_COMPLEMENTARY
+
+#define PWM_TIMER       TIM1
+
+// BKIN over-current comparator (active low), the break is latched until cleared
+#if defined( CURRENT_BKIN_ENABLED )
+#define PWM_BREAK_STATE  TIM1_BREAK_ENABLE
+#else
+#define PWM_BREAK_STATE  TIM1_BREAK_DISABLE
+#endif
 
 void PWM_setup(void)
 {
@@ -185,6 +394,61 @@ void PWM_setup(void)
    */
   TIM1_TimeBaseInit(( TIM1_PRESCALER - 1 ), TIM1_COUNTERMODE_UP, T1_Period, 0);
 
+#if defined( PWM_COMPLEMENTARY )
+  /* Channel 1:3 PWM configuration, complementary outputs */
+  TIM1_OC1Init( PWM_MODE,
+                TIM1_OUTPUTSTATE_ENABLE,
+                TIM1_OUTPUTNSTATE_ENABLE,
+                0,
+                TIM1_OCPOLARITY_LOW,
+                TIM1_OCNPOLARITY_LOW,
+                TIM1_OCIDLESTATE_RESET,
+                TIM1_OCNIDLESTATE_RESET);
+
+  TIM1_OC2Init( PWM_MODE,
+                TIM1_OUTPUTSTATE_ENABLE,
+                TIM1_OUTPUTNSTATE_ENABLE,
+                0,
+                TIM1_OCPOLARITY_LOW,
+                TIM1_OCNPOLARITY_LOW,
+                TIM1_OCIDLESTATE_RESET,
+                TIM1_OCNIDLESTATE_RESET);
+
+  TIM1_OC3Init( PWM_MODE,
+                TIM1_OUTPUTSTATE_ENABLE,
+                TIM1_OUTPUTNSTATE_ENABLE,
+                0,
+                TIM1_OCPOLARITY_LOW,
+                TIM1_OCNPOLARITY_LOW,
+                TIM1_OCIDLESTATE_RESET,
+                TIM1_OCNIDLESTATE_RESET);
+
+  /*
+   * Dead-time between the complementary outputs, the outputs are forced to
+   * their idle (reset) state i.e. both FETs off if the main output is disabled.
+   */
+  TIM1_BDTRConfig( TIM1_OSSISTATE_ENABLE,
+                   TIM1_LOCKLEVEL_OFF,
+                   PWM_DEAD_TIME_DTG,
+                   PWM_BREAK_STATE,
+                   TIM1_BREAKPOLARITY_LOW,
+                   TIM1_AUTOMATICOUTPUT_DISABLE);
+
+#if defined( ADC_HW_TRIGGER )
+  /*
+   * Channel 4 (no output) is the compare timing reference for the ADC trigger.
+   * In PWM mode 2 the OC4REF rising edge (TRGO) occurs at the compare value.
+   */
+  TIM1_OC4Init( TIM1_OCMODE_PWM2,
+                TIM1_OUTPUTSTATE_DISABLE,
+                PWM_ADC_TRIG_OFFSET,
+                TIM1_OCPOLARITY_HIGH,
+                TIM1_OCIDLESTATE_RESET);
+
+  TIM1_SelectOutputTrigger(TIM1_TRGOSOURCE_OC4REF);
+#endif
+
+#else
   /* Channel 2 PWM configuration */
   TIM1_OC2Init( PWM_MODE,
                 TIM1_OUTPUTSTATE_ENABLE,
@@ -212,47 +476,228 @@ void PWM_setup(void)
                TIM1_OCPOLARITY_LOW,
                TIM1_OCIDLESTATE_RESET);
 
+#if defined( CURRENT_BKIN_ENABLED )
+  // hardware over-current break, the outputs are disabled (MOE cleared)
+  TIM1_BDTRConfig( TIM1_OSSISTATE_ENABLE,
+                   TIM1_LOCKLEVEL_OFF,
+                   0,
+                   PWM_BREAK_STATE,
+                   TIM1_BREAKPOLARITY_LOW,
+                   TIM1_AUTOMATICOUTPUT_DISABLE);
+#endif
+
+#if defined( ADC_HW_TRIGGER )
+  /*
+   * Channel 1 (no output) is set as a compare timing reference at a fixed
+   * offset into the PWM on-time, with TRGO driven from the CC1 compare pulse to
+   * start the ADC conversion directly in hardware.
+   */
+  TIM1_OC1Init( TIM1_OCMODE_TIMING,
+                TIM1_OUTPUTSTATE_DISABLE,
+                TIM1_OUTPUTNSTATE_DISABLE,
+                PWM_ADC_TRIG_OFFSET,
+                TIM1_OCPOLARITY_LOW,
+                TIM1_OCNPOLARITY_LOW,
+                TIM1_OCIDLESTATE_RESET,
+                TIM1_OCNIDLESTATE_RESET);
+
+  TIM1_SelectOutputTrigger(TIM1_TRGOSOURCE_OC1);
+#endif
+#endif // PWM_COMPLEMENTARY
+
+#if defined( SEQ_REG_TABLE )
+  pwm_pins_outp_lo();
+#endif
+
   TIM1_CtrlPWMOutputs(ENABLE);
 
-  TIM1_ITConfig(TIM1_IT_UPDATE, ENABLE);  // for triggering ADC capture
+  TIM1_ITConfig(TIM1_IT_UPDATE, ENABLE);  // PWM frame rate task timing
   TIM1_Cmd(ENABLE);
 }
+
+#if defined( CURRENT_BKIN_ENABLED )
 /**
+ * @brief Test for the hardware over-current break
+ * @details  BKIN has cleared MOE i.e. the PWM outputs are disabled until
+ *   PWM_clear_break.
+ * @return TRUE if the break has occurred
+ */
+bool PWM_get_break(void)
+{
+  return (0 != (TIM1->SR1 & TIM1_SR1_BIF));
+}
+
+/**
+ * @brief Clear the hardware over-current break and re-enable the PWM outputs.
+ * @details  MOE can't be set while BKIN is still active, the break flag is set
+ *   again.
+ */
+void PWM_clear_break(void)
+{
+  TIM1->SR1 = (uint8_t)( ~TIM1_SR1_BIF );
+  TIM1_CtrlPWMOutputs(ENABLE);
+}
+#endif // CURRENT_BKIN_ENABLED
+#endif // S105
+
+/*
  * Control /SD inputs to IR2104
+ *
+ * The timer channel of the phase is switched in its enable register CCER1 or
+ * CCER2, the register having no enable bits of the phase is not written (the
+ * condition is constant).
  */
+#define PWM_PH_CC_ENABLE( _PH_ )                                         \
+  do {                                                                   \
+    if (0 != PWM_CCER1_##_PH_) { PWM_TIMER->CCER1 |= PWM_CCER1_##_PH_; } \
+    if (0 != PWM_CCER2_##_PH_) { PWM_TIMER->CCER2 |= PWM_CCER2_##_PH_; } \
+  } while (0)
+
+#define PWM_PH_CC_DISABLE( _PH_ )                                    \
+  do {                                                               \
+    if (0 != PWM_CCER1_##_PH_) {                                     \
+      PWM_TIMER->CCER1 &= (uint8_t)( ~(uint8_t)PWM_CCER1_##_PH_ ); } \
+    if (0 != PWM_CCER2_##_PH_) {                                     \
+      PWM_TIMER->CCER2 &= (uint8_t)( ~(uint8_t)PWM_CCER2_##_PH_ ); } \
+  } while (0)
+
 void PWM_PhA_Disable(void)
 {
-  TIM1_CCxCmd( PWM_TIMER_CHAN_A, DISABLE );
+  PWM_PH_CC_DISABLE( a );
+  if (PWM_CCR_a == PWM_pccr)
+  {
+    PWM_pccr = NULL;
+  }
 }
 
 void PWM_PhB_Disable(void)
 {
-  TIM1_CCxCmd( PWM_TIMER_CHAN_B, DISABLE );
+  PWM_PH_CC_DISABLE( b );
+  if (PWM_CCR_b == PWM_pccr)
+  {
+    PWM_pccr = NULL;
+  }
 }
 
 void PWM_PhC_Disable(void)
 {
-  TIM1_CCxCmd( PWM_TIMER_CHAN_C, DISABLE );
+  PWM_PH_CC_DISABLE( c );
+  if (PWM_CCR_c == PWM_pccr)
+  {
+    PWM_pccr = NULL;
+  }
 }
 
 void PWM_PhA_Enable(void)
 {
-  TIM1_SetCompare2( global_uDC );
-  TIM1_CCxCmd( PWM_TIMER_CHAN_A, ENABLE );
+  uint16_t pulse = pwm_pulse();
+
+  HAL_TIM_SET_CCR( PWM_CCR_a, pulse );
+  PWM_PH_CC_ENABLE( a );
+  PWM_pccr = PWM_CCR_a;
 }
 
 void PWM_PhB_Enable(void)
 {
-  TIM1_SetCompare3( global_uDC );
-  TIM1_CCxCmd( PWM_TIMER_CHAN_B, ENABLE );
+  uint16_t pulse = pwm_pulse();
+
+  HAL_TIM_SET_CCR( PWM_CCR_b, pulse );
+  PWM_PH_CC_ENABLE( b );
+  PWM_pccr = PWM_CCR_b;
 }
 
 void PWM_PhC_Enable(void)
 {
-  TIM1_SetCompare4( global_uDC );
-  TIM1_CCxCmd( PWM_TIMER_CHAN_C, ENABLE );
+  uint16_t pulse = pwm_pulse();
+
+  HAL_TIM_SET_CCR( PWM_CCR_c, pulse );
+  PWM_PH_CC_ENABLE( c );
+  PWM_pccr = PWM_CCR_c;
 }
-#endif // S105
+
+#if defined( SEQ_REG_TABLE )
+/*
+ * Sector record: PWM phase, low-side phase, floating phase
+ */
+#if defined( PWM_COMPLEMENTARY )
+// the low-side phase outputs are also enabled (forced LIN on)
+#define PWM_SECTOR_REC( _PWM_, _LS_, _FLT_ )         \
+  { PWM_CCR_##_PWM_,                                 \
+    PWM_CCER1_##_PWM_ | PWM_CCER1_##_LS_,            \
+    PWM_CCER2_##_PWM_ | PWM_CCER2_##_LS_,            \
+    &SD##_FLT_##_SD_PORT->ODR, SD##_FLT_##_SD_PIN,   \
+    &SD##_PWM_##_SD_PORT->ODR, SD##_PWM_##_SD_PIN,   \
+    &SD##_LS_##_SD_PORT->ODR, SD##_LS_##_SD_PIN,     \
+    PWM_CCMR_##_PWM_, PWM_CCMR_##_LS_ }
+#else
+#define PWM_SECTOR_REC( _PWM_, _LS_, _FLT_ )         \
+  { PWM_CCR_##_PWM_, PWM_CCER1_##_PWM_, PWM_CCER2_##_PWM_, \
+    &SD##_FLT_##_SD_PORT->ODR, SD##_FLT_##_SD_PIN,   \
+    &SD##_PWM_##_SD_PORT->ODR, SD##_PWM_##_SD_PIN,   \
+    &SD##_LS_##_SD_PORT->ODR, SD##_LS_##_SD_PIN }
+#endif
+
+static const PWM_sector_rec_t PWM_sector_tbl[ 6 ] =
+{
+  PWM_SECTOR_REC( a, b, c ), // A_PWM_HS | B_OFF_LS | C_FLOAT_NEG
+  PWM_SECTOR_REC( a, c, b ), // A_PWM_HS | B_FLOAT_POS | C_OFF_LS
+  PWM_SECTOR_REC( b, c, a ), // A_FLOAT_NEG | B_PWM_HS | C_OFF_LS
+  PWM_SECTOR_REC( b, a, c ), // A_OFF_LS | B_PWM_HS | C_FLOAT_POS
+  PWM_SECTOR_REC( c, a, b ), // A_OFF_LS | B_FLOAT_NEG | C_PWM_HS
+  PWM_SECTOR_REC( c, b, a )  // A_FLOAT_POS | B_OFF_LS | C_PWM_HS
+};
+
+/**
+ * @brief Switch the phase outputs to a commutation sector.
+ *
+ * @details Alternative to the per-sector handler functions of the sequencer
+ *  (SEQ_REG_TABLE): the sector record is applied with direct register writes.
+ *  The pulse (duty-cycle clamped by the current limit) is loaded to the
+ *  compare register of the PWM phase (MSB first as required by the 16-bit
+ *  preload) and the channel enables are switched in a single write to each
+ *  of CCER1/CCER2, preserving the polarity
+ *  and complementary enable bits, so that the PWM of the previous phase drops
+ *  out as the PWM of the next phase comes on. The floating phase /SD is then
+ *  deasserted and the two driven phases enabled. The low-side phase requires no
+ *  write other than its /SD as its pin reverts to GPIO output driving low.
+ *
+ *  Complementary drive (PWM_COMPLEMENTARY): the output compare mode of the two
+ *  driven phases is set before their channels are enabled - the PWM phase
+ *  switches HIN/LIN with the dead-time inserted by the timer, the low-side
+ *  phase is forced to LIN on. Each phase goes through a floating sector between
+ *  PWM and low-side drive, so its mode is never changed while it is driven.
+ *
+ * @param sector  Commutation sector (0:5)
+ */
+void PWM_set_sector(uint8_t sector)
+{
+  const PWM_sector_rec_t * prec = &PWM_sector_tbl[ sector ];
+  volatile uint8_t * pccr = prec->p_ccr_hi;
+  uint16_t pulse = pwm_pulse();
+
+#if defined( PWM_COMPLEMENTARY )
+  // low-side input of phase C held by the alignment drive (PWM_align_drive)
+  SDc_PWMN_PORT->ODR &= (uint8_t) ( ~SDc_PWMN_PIN );
+
+  *prec->p_ccmr_ls =
+    ( *prec->p_ccmr_ls & (uint8_t)( ~TIM1_CCMR_OCM ) ) | PWM_MODE_LS;
+  *prec->p_ccmr_pwm =
+    ( *prec->p_ccmr_pwm & (uint8_t)( ~TIM1_CCMR_OCM ) ) | PWM_MODE;
+#endif
+
+  HAL_TIM_SET_CCR( pccr, pulse );
+  PWM_pccr = pccr;
+
+  PWM_TIMER->CCER1 =
+    ( PWM_TIMER->CCER1 & (uint8_t)( ~PWM_CCER1_MASK ) ) | prec->ccer1;
+  PWM_TIMER->CCER2 =
+    ( PWM_TIMER->CCER2 & (uint8_t)( ~PWM_CCER2_MASK ) ) | prec->ccer2;
+
+  *prec->p_sd_flt &= (uint8_t)( ~prec->sd_flt_pin );
+  *prec->p_sd_pwm |= prec->sd_pwm_pin;
+  *prec->p_sd_ls |= prec->sd_ls_pin;
+}
+#endif // SEQ_REG_TABLE
 /** @endcond */
 
 
@@ -0,0 +1,345 @@
+/**
+  ******************************************************************************
+  * @file sched.c
+  * @brief Rate group scheduler
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * The PWM timer update ISR releases each rate group at its rate divider. A
+  * group runs either deferred from the PWM ISR, at the end of the ISR with
+  * interrupts enabled i.e. at a software priority below all ISRs so that the
+  * commutation and ADC ISRs are never delayed by the control task, or in the
+  * background task which polls for the release.
+  *
+  * The deadline of a group is its next release - a group that has not run to
+  * completion (or for a background group, has not started) by then is counted
+  * as an overrun, and the release is dropped.
+  *
+  * The background task waits for the next interrupt (WFI) when no background
+  * group is pending, and the time spent waiting is the idle time of the CPU
+  * load measurement, in counts of the PWM timer. The PWM ISR wakes the CPU at
+  * least once each PWM cycle, so each wait is shorter than the PWM period and
+  * is measured by the timer count modulo the period. The wait ends at the
+  * entry to the first ISR (Sched_wake()) - ISRs that do not invoke
+  * Sched_wake() (serial, SPI, EEPROM) are short and counted as idle time.
+  *
+  ******************************************************************************
+  */
+/**
+ * \defgroup sched Scheduler
+ * @brief Rate group scheduler
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h> // NULL
+
+#include "sched.h"
+#include "hal_stm8s.h"
+#include "driver.h"
+#include "profile.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+// PWM timer counts per PWM ISR, the timer reloads at PWM_PERIOD_COUNTS
+#define SCHED_PWM_CYCLE_CT  ( (uint32_t)PWM_PERIOD_COUNTS + 1u )
+
+/* Private types -------------------------------------------------------------*/
+
+/**
+ * @brief State of a rate group
+ */
+typedef enum
+{
+  SCHED_IDLE = 0,
+  SCHED_PENDING,  /**< released, not started */
+  SCHED_RUNNING
+}
+sched_state_t;
+
+/**
+ * @brief Rate group descriptor (compile-time constant)
+ */
+typedef struct
+{
+  uint16_t divider;       /**< rate divider of the PWM ISR rate */
+  void (*phandler)(void); /**< run deferred from the PWM ISR, NULL if polled */
+}
+sched_desc_t;
+
+/* Private variables ---------------------------------------------------------*/
+
+/**
+ * @brief Rate group table, in order of sched_group_t.
+ */
+static const sched_desc_t Sched_table[ SCHED_N_GROUPS ] =
+{
+  { SCHED_DIV_CONTROL, Driver_Update }, // SCHED_RG_CONTROL
+  { SCHED_DIV_UI,      NULL }           // SCHED_RG_UI
+};
+
+// PWM ISRs since the latest release - the phase of the control group is set
+// so that the control and UI groups are released at alternate frames of
+// PWM_FRAME_COUNT ISRs i.e. do not coincide
+static uint16_t Sched_count[ SCHED_N_GROUPS ] =
+{
+  SCHED_DIV_CONTROL - PWM_FRAME_COUNT, // SCHED_RG_CONTROL
+  0                                    // SCHED_RG_UI
+};
+static volatile uint8_t Sched_state[ SCHED_N_GROUPS ];
+static uint16_t Sched_overruns[ SCHED_N_GROUPS ];
+
+static bool Sched_active; // dispatcher is running (PWM ISR has nested)
+
+static volatile uint16_t Sched_ticks; // PWM ISR count, free-running
+
+static volatile bool Sched_idling; // background task is waiting (WFI)
+static volatile uint16_t Sched_wake_ct; // PWM timer count at the wake-up ISR
+
+// idle time (PWM timer counts) and PWM ISR count at the start of the window
+static uint32_t Load_idle_sum;
+static uint16_t Load_tick0;
+static uint8_t Sched_cpu_load; // percent
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Count of the PWM timer, reading CNTRH latches CNTRL
+ */
+static uint16_t pwm_count(void)
+{
+  uint8_t cnt_h = HAL_PWM_TIMER->CNTRH;
+  uint8_t cnt_l = HAL_PWM_TIMER->CNTRL;
+
+  return (uint16_t)( ((uint16_t)cnt_h << 8) | cnt_l );
+}
+
+/*
+ * Update the CPU load at the end of the measurement window
+ */
+static void load_update(void)
+{
+  uint16_t ticks;
+  uint32_t window;
+  uint32_t idle_pct;
+
+  disableInterrupts();  //////////////// DI
+  ticks = Sched_ticks - Load_tick0;
+  enableInterrupts();  ///////////////// EI
+
+  if (ticks < SCHED_LOAD_WINDOW)
+  {
+    return;
+  }
+  Load_tick0 += ticks;
+
+  // window in units of 1% of the timer counts
+  window = ( (uint32_t)ticks * SCHED_PWM_CYCLE_CT ) / 100u;
+
+  idle_pct = Load_idle_sum / window;
+  if (idle_pct > 100u)
+  {
+    idle_pct = 100u; // truncation of the window
+  }
+  Sched_cpu_load = (uint8_t)( 100u - idle_pct );
+  Load_idle_sum = 0;
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Release the rate groups that are due
+ *
+ * @details Invoked from the PWM timer update ISR, with interrupts masked.
+ */
+void Sched_tick(void)
+{
+  uint8_t group;
+
+  Sched_ticks += 1;
+
+  for (group = 0; group < SCHED_N_GROUPS; group++)
+  {
+    Sched_count[ group ] += 1;
+
+    if (Sched_count[ group ] >= Sched_table[ group ].divider)
+    {
+      Sched_count[ group ] = 0;
+
+      if (SCHED_IDLE != Sched_state[ group ])
+      {
+        Sched_overruns[ group ] += 1; // missed its deadline
+      }
+      else
+      {
+        Sched_state[ group ] = SCHED_PENDING;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Run the released rate groups that are deferred from the PWM ISR
+ *
+ * @details Invoked at the end of the PWM timer update ISR, after the interrupt
+ *  flag is cleared. The handlers run with interrupts enabled, so they can be
+ *  preempted by any ISR including a PWM ISR which releases the next groups,
+ *  but they return here to finish (the dispatcher is not re-entered). After
+ *  each handler the pending groups are run highest priority first.
+ *  Enabling interrupts sets the main level (0): the PWM ISR is at level 2 as
+ *  are all ISRs other than commutation and ADC (see ITC_setup), so it can only
+ *  have preempted the background task, or a handler at the main level.
+ *  The handlers have to mask interrupts around any sequence of updates that
+ *  the commutation ISR needs to see as a whole.
+ */
+void Sched_dispatch(void)
+{
+  uint8_t group = 0;
+
+  if (FALSE != Sched_active)
+  {
+    return;
+  }
+  Sched_active = TRUE;
+
+  while (group < SCHED_N_GROUPS)
+  {
+    if ( (NULL != Sched_table[ group ].phandler) &&
+         (SCHED_PENDING == Sched_state[ group ]) )
+    {
+      Sched_state[ group ] = SCHED_RUNNING;
+
+#if defined( PROFILE_ENABLED )
+      if (SCHED_RG_CONTROL == group)
+      {
+        PROF_BEGIN(PROF_CTRL_TASK);
+      }
+#endif
+      enableInterrupts();  ///////////////// EI
+
+      Sched_table[ group ].phandler();
+
+      disableInterrupts();  //////////////// DI
+#if defined( PROFILE_ENABLED )
+      if (SCHED_RG_CONTROL == group)
+      {
+        PROF_END(PROF_CTRL_TASK);
+      }
+#endif
+      Sched_state[ group ] = SCHED_IDLE;
+
+      group = 0; // re-scan from the highest priority
+    }
+    else
+    {
+      group += 1;
+    }
+  }
+
+  Sched_active = FALSE;
+}
+
+/**
+ * @brief Poll for release of a background rate group
+ *
+ * @details Invoked in the execution context of 'main()' (background task). The
+ *  group is started at the release i.e. overruns count releases that were
+ *  not polled within the group period.
+ * @param group  Rate group
+ * @return  TRUE if the group was released since the previous poll
+ */
+bool Sched_bg_ready(sched_group_t group)
+{
+  if (SCHED_PENDING == Sched_state[ group ])
+  {
+    Sched_state[ group ] = SCHED_IDLE;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/**
+ * @brief Number of deadline overruns of a rate group
+ */
+uint16_t Sched_get_overruns(sched_group_t group)
+{
+  return Sched_overruns[ group ];
+}
+
+/**
+ * @brief End the idle time of the background task
+ *
+ * @details Invoked at the entry to the PWM, commutation and ADC ISRs. An ISR
+ *  preempting another one between the test and the clear of the flag only
+ *  shifts the wake-up count by its own duration.
+ */
+void Sched_wake(void)
+{
+  if (FALSE != Sched_idling)
+  {
+    Sched_idling = FALSE;
+    Sched_wake_ct = pwm_count();
+  }
+}
+
+/**
+ * @brief Wait for an interrupt if no background rate group is pending
+ *
+ * @details Invoked in the execution context of 'main()' (background task) at
+ *  each pass of the loop. The pending test and the WFI are in a critical
+ *  section, WFI enables the interrupts (main level) and waits. A background
+ *  event that is not a rate group (e.g. a byte received) is handled after
+ *  the next interrupt, at most one PWM cycle later.
+ */
+void Sched_idle(void)
+{
+  uint16_t t_idle;
+  uint16_t t_wake;
+  uint8_t group;
+
+  load_update();
+
+  disableInterrupts();  //////////////// DI
+
+  for (group = 0; group < SCHED_N_GROUPS; group++)
+  {
+    if ( (NULL == Sched_table[ group ].phandler) &&
+         (SCHED_PENDING == Sched_state[ group ]) )
+    {
+      enableInterrupts();  ///////////////// EI
+      return;
+    }
+  }
+
+  t_idle = pwm_count();
+  Sched_idling = TRUE;
+
+  wfi();
+
+  disableInterrupts();  //////////////// DI
+  // the wake-up was by an ISR not invoking Sched_wake() if still idling
+  t_wake = (FALSE != Sched_idling) ? pwm_count() : Sched_wake_ct;
+  Sched_idling = FALSE;
+  enableInterrupts();  ///////////////// EI
+
+  // the counter has reloaded if the wake-up count is below the start count
+  if (t_wake < t_idle)
+  {
+    t_wake += (uint16_t)SCHED_PWM_CYCLE_CT;
+  }
+  Load_idle_sum += (uint16_t)(t_wake - t_idle);
+}
+
+/**
+ * @brief CPU load, the time not spent idle by the background task
+ *
+ * @return  Percent of the latest measurement window (SCHED_LOAD_WINDOW)
+ */
+uint8_t Sched_get_cpu_load(void)
+{
+  return Sched_cpu_load;
+}
+
+/**@}*/ // defgroup
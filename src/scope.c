@@ -0,0 +1,230 @@
+/**
+  ******************************************************************************
+  * @file scope.c
+  * @brief Triggered capture of the raw back-EMF samples
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * Oscilloscope of the phase inputs: the ADC samples of the 3 phases and the
+  * sector are stored to a circular buffer at each PWM cycle (Seq_Bemf_Sample()).
+  * The capture is armed with a trigger source and a pre-trigger depth, and
+  * stops once the post-trigger part of the buffer is filled, to be read out by
+  * the background task.
+  *
+  * The samples are written by the ADC ISR. The trigger is a request flag set
+  * at any level and taken by the ADC ISR at the next sample, so the sample at
+  * the trigger is the first one following the triggering event. A trigger
+  * before the pre-trigger part is filled is taken with the samples available.
+  *
+  ******************************************************************************
+  */
+/**
+ * \defgroup scope Scope
+ * @brief Triggered capture of the raw back-EMF samples
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include "scope.h"
+#include "driver.h"
+
+#if defined( SCOPE_ENABLED )
+
+/* Private types -------------------------------------------------------------*/
+
+/**
+ * @brief Capture states
+ */
+typedef enum
+{
+  SCOPE_IDLE = 0,
+  SCOPE_ARMED,     /**< pre-trigger, waiting for the trigger */
+  SCOPE_TRIGGERED, /**< post-trigger */
+  SCOPE_DONE       /**< buffer held for the readout */
+}
+scope_state_t;
+
+/* Private variables ---------------------------------------------------------*/
+
+static scope_cfg_t Scope_cfg =
+{
+  SCOPE_TRIG_OFF, SCOPE_PRE_DFLT, SCOPE_TERR_THR_DFLT
+};
+
+static scope_sample_t Scope_buf[ SCOPE_N_SAMPLES ];
+static uint8_t Scope_head;  // next sample to write, the oldest sample if full
+static uint8_t Scope_count; // number of samples in the buffer
+static uint8_t Scope_post;  // samples remaining to be captured after the trigger
+static uint8_t Scope_trig_at; // buffer index of the sample at the trigger
+
+static volatile uint8_t Scope_state;
+static volatile bool Scope_trig_req;
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Buffer index of the oldest sample
+ */
+static uint8_t scope_oldest(void)
+{
+  return (Scope_count < SCOPE_N_SAMPLES) ? 0 : Scope_head;
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Clear the buffer and arm the capture.
+ *
+ * @details Not while the ADC ISR is enabled i.e. in a critical section.
+ * @param p_cfg  Trigger source and depths, SCOPE_TRIG_OFF stops the capture
+ */
+void Scope_arm(const scope_cfg_t *p_cfg)
+{
+  Scope_cfg = *p_cfg;
+
+  if (Scope_cfg.pre >= SCOPE_N_SAMPLES)
+  {
+    Scope_cfg.pre = SCOPE_N_SAMPLES - 1;
+  }
+  Scope_head = 0;
+  Scope_count = 0;
+  Scope_trig_req = FALSE;
+
+  Scope_state = (SCOPE_TRIG_OFF != Scope_cfg.trig) ? SCOPE_ARMED : SCOPE_IDLE;
+}
+
+/**
+ * @brief Accessor for the capture configuration
+ */
+void Scope_get_cfg(scope_cfg_t *p_cfg)
+{
+  *p_cfg = Scope_cfg;
+}
+
+/**
+ * @brief Stop the capture, the buffer is released.
+ */
+void Scope_stop(void)
+{
+  Scope_state = SCOPE_IDLE;
+}
+
+/**
+ * @brief Store the samples of the phase inputs (ADC ISR)
+ *
+ * @details Invoked at each PWM cycle following the ADC scan.
+ * @param sector  Present commutation sector
+ */
+void Scope_sample(uint8_t sector)
+{
+  scope_sample_t *p_smp;
+  uint8_t state = Scope_state;
+
+  if ( (SCOPE_ARMED != state) && (SCOPE_TRIGGERED != state) )
+  {
+    return;
+  }
+
+  p_smp = &Scope_buf[ Scope_head ];
+  p_smp->ph[ 0 ] = (Driver_Get_ADC_Phase( 0 ) & 0x03FFu) | ((uint16_t)sector << 12);
+  p_smp->ph[ 1 ] = Driver_Get_ADC_Phase( 1 );
+  p_smp->ph[ 2 ] = Driver_Get_ADC_Phase( 2 );
+
+  if (SCOPE_ARMED == state)
+  {
+    if ( (FALSE != Scope_trig_req) ||
+         ((SCOPE_TRIG_NOW == Scope_cfg.trig) && (Scope_count >= Scope_cfg.pre)) )
+    {
+      Scope_trig_at = Scope_head;
+      Scope_post = (uint8_t)(SCOPE_N_SAMPLES - 1 - Scope_cfg.pre);
+      state = (Scope_post > 0) ? SCOPE_TRIGGERED : SCOPE_DONE;
+    }
+  }
+  else if (Scope_post > 0)
+  {
+    Scope_post -= 1;
+
+    if (0 == Scope_post)
+    {
+      state = SCOPE_DONE;
+    }
+  }
+
+  if (Scope_count < SCOPE_N_SAMPLES)
+  {
+    Scope_count += 1;
+  }
+  Scope_head += 1;
+  if (Scope_head >= SCOPE_N_SAMPLES)
+  {
+    Scope_head = 0;
+  }
+  Scope_state = state;
+}
+
+/**
+ * @brief Trigger the capture if armed for the source
+ *
+ * @details Invoked at any level, the trigger is taken at the next sample.
+ */
+void Scope_trigger(scope_trig_t source)
+{
+  if ( (SCOPE_ARMED == Scope_state) && ((uint8_t)source == Scope_cfg.trig) )
+  {
+    Scope_trig_req = TRUE;
+  }
+}
+
+/**
+ * @brief Trigger on the timing error of the closed-loop controller
+ *
+ * @param error  Timing error (commutation timer counts)
+ */
+void Scope_timing_error(int16_t error)
+{
+  if ( (SCOPE_TRIG_TERROR == Scope_cfg.trig) &&
+       ( ((error >= 0) ? (uint16_t)error : (uint16_t)(-error)) >= Scope_cfg.terr_thr ) )
+  {
+    Scope_trigger(SCOPE_TRIG_TERROR);
+  }
+}
+
+/**
+ * @brief Test if the capture is complete.
+ */
+bool Scope_is_done(void)
+{
+  return (bool)(SCOPE_DONE == Scope_state);
+}
+
+/**
+ * @brief Index of the sample at the trigger, in the order of Scope_get()
+ */
+uint8_t Scope_get_trigger_index(void)
+{
+  return (uint8_t)( (Scope_trig_at + SCOPE_N_SAMPLES - scope_oldest()) % SCOPE_N_SAMPLES );
+}
+
+/**
+ * @brief Read a sample of the completed capture.
+ *
+ * @param index  0 is the oldest sample
+ * @param p_sample  Copy of the sample
+ * @return  FALSE if the capture is not complete or beyond the latest sample
+ */
+bool Scope_get(uint8_t index, scope_sample_t *p_sample)
+{
+  if ( (SCOPE_DONE != Scope_state) || (index >= Scope_count) )
+  {
+    return FALSE;
+  }
+
+  *p_sample = Scope_buf[ (scope_oldest() + index) % SCOPE_N_SAMPLES ];
+
+  return TRUE;
+}
+
+#endif // SCOPE_ENABLED
+
+/**@}*/ // defgroup
@@ -17,36 +17,102 @@
 #include <stddef.h> // NULL
 #include "pwm_stm8s.h"
 #include "driver.h"
+#include "sequence.h"
+#include "trace.h"
+#include "scope.h"
 
 
 /* Private defines -----------------------------------------------------------*/
 /**
  * Plausibility of back-EMF measurement: the threshold (somewhat arbitrary) is
  * based on taking the average of the latest back-EMF leading-side and trailing-
- * side measurements, i.e.:
- * [ (Back_EMF_Falling_PhX + Back_EMF_Riseing_PhX) > BACK_EMF_PLAUS_THR ]
- * The open-loop ramp-to speed should ensure this condition.
+ * side measurements, i.e. for each phase:
+ * [ (Back_EMF_Falling[ph] + Back_EMF_Rising[ph]) > BACK_EMF_PLAUS_THR ]
+ * The open-loop ramp-to speed should ensure this condition. The floating phase
+ * is centered on the neutral i.e. half the supply voltage, so the threshold is
+ * a fraction of the measured supply voltage: 0x0190 * 2 at the nominal 0x0384
+ * (BL_VSYS_NOMINAL).
  */
-#define  BACK_EMF_PLAUS_THR  (0x0190 * 2) // TBD
+#define  BACK_EMF_PLAUS_Q8   228 // TBD
 
-/* Private types -----------------------------------------------------------*/
+/**
+ * Minimum number of initial back-EMF samples of each sector excluded from the
+ * zero-crossing test and the back-EMF measurement, to allow for the
+ * flyback/demagnetization time following the commutation switching. The
+ * blanking window is extended in proportion to the measured sector period
+ * (see Seq_set_blanking()). The minimum is ~128 us (2048 fMASTER cycles) i.e.
+ * 1 sample at 8 kHz, rounded to the nearest number of PWM cycles of the
+ * profile (2 at 16 kHz, 3 at 24 kHz, 4 at 32 kHz).
+ */
+#define ZC_BLANK_SAMPLES     ( ( 2048u + PWM_PERIOD_FMASTER / 2 ) / PWM_PERIOD_FMASTER )
 
-/* Private types -----------------------------------------------------------*/
+// limit of the blanking window (Q8 fraction of the sector), ahead of the ZC
+#define ZC_BLANK_MAX_Q8      ( ( (60 - SEQ_ZC_DELAY_DEG) * 256u ) / 120 )
 
-/**
- * @brief Enum typedef for setting the 6-step sequence pointer
+/*
+ * Samples accumulated to the back-EMF measurement of a sector, bounded so
+ * that the sum of 10-bit conversions is held in 16-bits.
  */
-typedef enum
-{
-  SECTOR_0 = 0,
-  SECTOR_1,
-  SECTOR_2,
-  SECTOR_3,
-  SECTOR_4,
-  SECTOR_5,
-  SECTOR_INVALID = -1
-}
-Seq_sector_t;
+#define BEMF_ACC_N_MAX       64
+
+/*
+ * Zero-crossing times are kept as PWM sample counts with 4 bits of fraction
+ * (from interpolation between the two samples adjacent to the crossing).
+ */
+#define ZC_TIME_LSH          4
+
+/*
+ * The commutation timer is clocked at fMASTER / 2, so one PWM period spans
+ * PWM_PERIOD_FMASTER / 2 counts of the commutation timer. The sector is 1
+ * commutation timer period (see Driver_Step()) so a PWM sample period is
+ * equivalent to that many counts of commutation period.
+ */
+#define ZC_CT_PER_SAMPLE     (PWM_PERIOD_FMASTER / 2)
+
+// ideal position of the zero-crossing as a fraction of the sector (8-bit fraction)
+#define ZC_POSITION_Q8       ( ( (60 - SEQ_ZC_DELAY_DEG) * 256u ) / 60 )
+
+// limit of the timing advance, the zero-crossing can't be scheduled past the sector end
+#define ZC_ADVANCE_MAX_DEG   SEQ_ZC_DELAY_DEG
+
+// shortest delay of the commutation from the zero-crossing, commutation timer counts
+#define ZC_COMM_DELAY_MIN    8 // 1 us
+
+// bounds the timing error term so that it can be rescaled within 16-bits
+#define ZC_ERROR_MAX         ( ( (int32_t)S16_MAX << ZC_TIME_LSH ) / ZC_CT_PER_SAMPLE )
+
+/*
+ * Supply voltage: the phase driven PWM in the sector reads the supply voltage
+ * in the on-time, filtered at each PWM sample (IIR 1/16 i.e. ~2 ms at 8 kHz).
+ * The filter is lengthened with the PWM rate to keep the time constant of ~2
+ * ms, as the reference of the zero-crossing test is half of the filter output
+ * (the 10-bit sample is held in 16-bits up to 1/64).
+ * The phases not having a sensor input are not sampled (see system.h).
+ */
+#if ( PWM_PROFILE == PWM_PROFILE_16K )
+  #define VBATT_FILT_SHIFT   5
+#elif ( PWM_PROFILE == PWM_PROFILE_24K ) || ( PWM_PROFILE == PWM_PROFILE_32K )
+  #define VBATT_FILT_SHIFT   6
+#else
+  #define VBATT_FILT_SHIFT   4
+#endif
+
+#if defined( ZC_CLOSED_LOOP_ENABLED )
+  #define VBATT_PHASE_SENSED( _PHASE_ )  TRUE
+#else
+  #define VBATT_PHASE_SENSED( _PHASE_ )  (0 == (_PHASE_))
+#endif
+
+/*
+ * Coasting rotor detector: minimum back-EMF (ADC counts, ~0.2 V at the phase
+ * terminal) and the hysteresis of the change of the highest phase, and the
+ * count of consecutive forward transitions (120 degrees each) to be synced.
+ */
+#define COAST_BEMF_MIN       0x10
+#define COAST_HYST           8
+#define COAST_N_SYNC         3
+
+/* Private types -----------------------------------------------------------*/
 
 /**
 * @brief  Table of handler functions for 6 commutation steps.
@@ -58,6 +124,17 @@ Seq_sector_t;
 */
 typedef void (*step_ptr_t)( void );
 
+/**
+ * @brief Floating and PWM driven phase of a commutation sector.
+ */
+typedef struct
+{
+  uint8_t phase;   /**< floating phase index (0:A, 1:B, 2:C) */
+  bool    rising;  /**< back-EMF is positive-going */
+  uint8_t pwm;     /**< PWM driven phase index, reads the supply voltage */
+}
+Seq_float_t;
+
 /* Private function prototypes -----------------------------------------------*/
 static void sector_0(void);
 static void sector_1(void);
@@ -69,13 +146,64 @@ static void sector_5(void);
 /* Public variables  ---------------------------------------------------------*/
 
 /** @cond */ // hide some developer/debug code
-uint16_t Back_EMF_Falling_PhX;
-uint16_t Back_EMF_Riseing_PhX;
+// average back-EMF of each phase in the negative-going and positive-going sectors
+volatile uint16_t Back_EMF_Falling[ SEQ_N_PHASES ];
+volatile uint16_t Back_EMF_Rising[ SEQ_N_PHASES ];
 /** @endcond */
 
 /* Private variables  ---------------------------------------------------------*/
 
-static uint16_t Vbatt_;
+/*
+ * The measurements are updated by the commutation ISR (Sequence_Step) and the
+ * ADC ISR (Seq_Bemf_Sample), which are at the same priority level and never
+ * preempt each other. The accessors are also used by the control task and the
+ * background task, which can be preempted by these ISRs at any instruction: the
+ * count is incremented by each update so that an accessor can retry if the
+ * measurements were updated while they were being read.
+ */
+static volatile uint8_t Seq_upd_count;
+
+static volatile uint16_t Vbatt_;
+static uint16_t Vbatt_filt;     // supply voltage filter (VBATT_FILT_SHIFT fraction bits)
+
+static Seq_sector_t Seq_sector; // present commutation sector
+
+static uint8_t  zc_sample_n;    // count of PWM samples since commutation step
+static int16_t  zc_prev_diff;   // previous back-EMF sample less its reference
+static uint16_t zc_tick;        // free running count of PWM samples
+static uint16_t zc_sector_start; // time of the commutation step (Q4 sample count)
+static uint16_t zc_comm_time;   // time of the commutation scheduled from the ZC (Q4)
+static bool     zc_comm_sched;  // commutation of the present sector is scheduled
+static uint16_t zc_last_time;   // time of latest zero-crossing (Q4 sample count)
+static volatile uint16_t zc_interval;  // time between latest two zero-crossings (Q4)
+static bool     zc_found;       // zero-crossing detected in the present sector
+static volatile uint8_t zc_sync_count; // count of consecutive sectors having detected ZC
+static uint16_t zc_position = ZC_POSITION_Q8; // ideal ZC position incl. timing advance (Q8)
+static bool     zc_comm_enabled; // commutation is scheduled from the zero-crossing
+static uint8_t  zc_blank_q8 = SEQ_BLANK_Q8;   // blanking window, fraction of the sector (Q8)
+static uint8_t  zc_blank_n = ZC_BLANK_SAMPLES; // blanking window of the present sector (samples)
+
+static uint16_t bemf_sum;       // sum of the floating phase samples following the blanking
+static uint8_t  bemf_count;     // count of samples accumulated to the sum
+
+static bool     coast_enabled;  // all phases floating, coasting rotor detector enabled
+static uint8_t  coast_phase;    // phase having the highest back-EMF
+static volatile uint8_t coast_count;     // count of consecutive forward transitions
+static uint16_t coast_time;     // time of the latest transition (PWM sample count)
+static volatile uint16_t coast_interval; // time between the latest two transitions
+
+/**
+ * @brief Floating phase and back-EMF slope in each of the 6 sectors
+ */
+static const Seq_float_t Seq_float_tbl[ SEQ_N_CSTEPS ] =
+{
+  { 2, FALSE, 0 }, // sector 0: C_FLOAT_NEG, A_PWM_HS
+  { 1, TRUE,  0 }, // sector 1: B_FLOAT_POS, A_PWM_HS
+  { 0, FALSE, 1 }, // sector 2: A_FLOAT_NEG, B_PWM_HS
+  { 2, TRUE,  1 }, // sector 3: C_FLOAT_POS, B_PWM_HS
+  { 1, FALSE, 2 }, // sector 4: B_FLOAT_NEG, C_PWM_HS
+  { 0, TRUE,  2 }  // sector 5: A_FLOAT_POS, C_PWM_HS
+};
 
 /**
  * @brief commutation timing steps (6)
@@ -162,32 +290,142 @@ static const step_ptr_t step_ptr_table[] =
 };
 
 /*
- * Timing error term -  magnitude of the "falling"
- * (right) side is proportional to the degree of timing advance .. advanced
- * condition is seen when there is greater distribution of back-emf area on the
- * right side.
+ * Timing error term - difference between the measured zero-crossing time and its
+ * ideal position within the sector (SEQ_ZC_DELAY_DEG before the end of the
+ * sector), expressed in counts of commutation period. The zero-crossing is seen
+ * late in the sector when the commutation is early w.r.t. the rotor position.
  */
-// There isn't a timing control point to use to determine the error - however
-// ratio of the leading and falling slopes (integration) indicates the direction
-// and varies according to the magnitude of the timing error.
-//  ratio = ( L / F  ) - 1
-static int16_t comm_tm_err_ratio;
-
-#define SCALE_64_LSH   6
-#define SCALE_64_ONE  (1 << SCALE_64_LSH)
+static volatile int16_t comm_tm_error;
 
 /* Private functions ---------------------------------------------------------*/
+
+/*
+ * Coherent read of a 16-bit measurement, from any execution context (see
+ * Seq_upd_count).
+ */
+static uint16_t seq_read_u16(volatile const uint16_t *pvar)
+{
+  uint8_t count;
+  uint16_t u16;
+
+  do
+  {
+    count = Seq_upd_count;
+    u16 = *pvar;
+  }
+  while (count != Seq_upd_count);
+
+  return u16;
+}
+/*
+ * Back-EMF measurement of the phase floating in the sector just completed.
+ *
+ * The samples of the floating phase following the blanking window are
+ * accumulated over the sector (see Seq_Bemf_Sample()), and their average is
+ * taken as the back-EMF voltage of the sector i.e. positive-going float as the
+ * rising-side measurement or negative-going float as the falling-side. The
+ * measurement is held if no sample was taken in the sector.
+ *
+ * @param sector  The commutation sector just completed
+ */
+static void bemf_measure(Seq_sector_t sector)
+{
+  const Seq_float_t * pflt = &Seq_float_tbl[ sector ];
+  uint8_t phase = pflt->phase;
+  uint16_t bemf;
+
+  if (0 == bemf_count)
+  {
+    return;
+  }
+
+  bemf = bemf_sum / bemf_count;
+
+  if (FALSE != pflt->rising)
+  {
+    Back_EMF_Rising[ phase ] = bemf;
+  }
+  else
+  {
+    Back_EMF_Falling[ phase ] = bemf;
+  }
+}
+
+/*
+ * Supply voltage filter, invoked at each PWM sample with the sample of the PWM
+ * driven phase. A zero duty-cycle has no on-time to be sampled. The samples of
+ * the driven phase are not traced, the filter state is traced instead at each
+ * change of the output (see Seq_set_vbatt_filt()).
+ */
+static void vbatt_sample(uint8_t phase)
+{
+  if ( (FALSE != VBATT_PHASE_SENSED( phase )) && (0 != PWM_get_dutycycle()) )
+  {
+    uint16_t vbatt;
+
+    Vbatt_filt = Vbatt_filt - (Vbatt_filt >> VBATT_FILT_SHIFT) +
+                 Driver_Get_ADC_Phase( phase );
+    vbatt = Vbatt_filt >> VBATT_FILT_SHIFT;
+
+    if (vbatt != Vbatt_)
+    {
+      Vbatt_ = vbatt;
+      TRACE_EVENT( TRACE_EV_VBATT, 0, Vbatt_filt );
+    }
+  }
+}
+
+/*
+ * Time of the commutation step, the time scheduled from the zero-crossing, or
+ * else taken at the middle of the PWM cycle following the latest sample as
+ * the step is not synchronous to the PWM.
+ */
+static uint16_t zc_step_time(void)
+{
+  uint16_t step_time = (uint16_t)( zc_tick << ZC_TIME_LSH ) + (1u << (ZC_TIME_LSH - 1));
+
+  if (FALSE != zc_comm_sched)
+  {
+    step_time = zc_comm_time;
+  }
+  zc_comm_sched = FALSE;
+
+  return step_time;
+}
+
+/*
+ * Blanking window of the sector, from the measured sector period (the ZC->ZC
+ * interval is valid once the crossing was detected in the latest two sectors),
+ * otherwise the minimum.
+ */
+static uint8_t zc_blank_samples(void)
+{
+  uint16_t blank_n = ZC_BLANK_SAMPLES;
+
+  if (zc_sync_count >= 2)
+  {
+    blank_n = (uint16_t)(
+                ( (uint32_t)zc_interval * zc_blank_q8 ) >> (8 + ZC_TIME_LSH) );
+
+    if (blank_n < ZC_BLANK_SAMPLES)
+    {
+      blank_n = ZC_BLANK_SAMPLES;
+    }
+    else if (blank_n > (U8_MAX - 2))
+    {
+      blank_n = U8_MAX - 2; // the sample count is held at U8_MAX
+    }
+  }
+  return (uint8_t)blank_n;
+}
+
 /*
  * Sector 0:  A_PWM_HS | B_OFF_LS | C_FLOAT_NEG
  *
- * Previous sector (5) phase-A was floating (positive-going transition) so ADC
- * input from phase A resistor divider is taken as average back-EMF voltage
- * during the positive-going float sector.
+ * Previous sector (5) phase-A was floating (positive-going transition).
  */
 static void sector_0(void)
 {
-  Back_EMF_Riseing_PhX = ( Back_EMF_Riseing_PhX + Driver_Get_ADC() ) >> 1;
-
 // C FLOAT NEG
   PWM_PhC_Disable(); // phase C PWM asserted off (negative-going float)
   PWM_PhC_HB_DISABLE(); // half-bridge disable
@@ -221,14 +459,9 @@ static void sector_1(void)
 
 /*
  * Sector 2:  A_FLOAT_NEG | B_PWM_HS | C_OFF_LS
- *
- * Phase A was driven PWM, so that latest ADC input from phase A resistor divider
- * (during PWM on-time is taken as battery/system voltage.
  */
 static void sector_2(void)
 {
-  Vbatt_ = Driver_Get_ADC();
-
 // A FLOAT NEG
   PWM_PhA_Disable();  // phase A PWM asserted off (negative-going float)
   PWM_PhA_HB_DISABLE();
@@ -245,17 +478,10 @@ static void sector_2(void)
 /*
  * Sector 3:  A_OFF_LS | B_PWM_HS | C_FLOAT_POS
  *
- * ADC input from phase A resistor divider is taken as average back-EMF voltage
- * (previously phase-A was floating-falling transition).
-
- * Previous sector (2) phase-A was floating (negative-going transition) so ADC
- * input from phase A resistor divider is taken as average back-EMF voltage
- * during the negative-going float sector.
+ * Previous sector (2) phase-A was floating (negative-going transition).
  */
 static void sector_3(void)
 {
-  Back_EMF_Falling_PhX = ( Back_EMF_Falling_PhX + Driver_Get_ADC() ) >> 1;
-
 // C FLOAT POS
   PWM_PhC_Disable(); //phase C PWM asserted off (positive-going float)
   PWM_PhC_HB_DISABLE();
@@ -305,21 +531,209 @@ static void sector_5(void)
 // C PWM HS
 //  PWM_PhC_Enable();  // NO
 //  PWM_PhC_HB_ENABLE(); NO-OP?
+}
+
+/*
+ * Update the timing error from the zero-crossing detected in the present sector.
+ *
+ * @param zc_time  Time of the crossing from the start of the sector (Q4 samples)
+ */
+static void zc_timing_update(int16_t zc_time)
+{
+  // ideal position of the ZC in the sector, from the measured ZC->ZC interval
+  uint16_t zc_ideal = (uint16_t)( ( (uint32_t)zc_interval * zc_position ) >> 8 );
+  int16_t error = zc_time - (int16_t)zc_ideal;
+
+  if (error > (int16_t)ZC_ERROR_MAX)
+  {
+    error = (int16_t)ZC_ERROR_MAX;
+  }
+  else if (error < -(int16_t)ZC_ERROR_MAX)
+  {
+    error = -(int16_t)ZC_ERROR_MAX;
+  }
+  // rescale Q4 PWM samples to commutation period counts
+  comm_tm_error =
+    (int16_t)( ( (int32_t)error * ZC_CT_PER_SAMPLE ) >> ZC_TIME_LSH );
+}
+
+/*
+ * Schedule the commutation from the zero-crossing detected at the present
+ * sample. The commutation follows the crossing by the sector period (latest
+ * ZC->ZC interval) less the ideal position of the crossing in the sector i.e.
+ * 30 degrees less the timing advance. The crossing was interpolated between
+ * the previous and the present sample.
+ *
+ * @param frac  Fraction of sample period from the previous sample to the
+ *   crossing (Q4)
+ */
+static void zc_comm_schedule(uint16_t frac)
+{
+  // complement of the ideal position (zc_timing_update()) in the same rounding
+  uint16_t delay = zc_interval -
+    (uint16_t)( ( (uint32_t)zc_interval * zc_position ) >> 8 );
+  uint16_t since = (uint16_t)(1u << ZC_TIME_LSH) - frac; // crossing to present sample
+  uint32_t counts = ZC_COMM_DELAY_MIN;
 
-// update the timing error once per frame
-//  comm_timing_error = (comm_timing_error + TIMING_ERROR_TERM) > 1; // sma
+  if (delay > since)
+  {
+    counts = ( (uint32_t)(delay - since) * ZC_CT_PER_SAMPLE ) >> ZC_TIME_LSH;
 
-  // signed_error_ratio = ( post / pre ) - 1
-  // Uses scalar of 64 to get most precision from ADC 10-bit terms (assuming max 0x03ff).
-  // ADC 10-bit i.e. 0x03FF << 6 = 0xFFC0
-  // Calculation result gets scaled down in conjunction with factoring in of
-  //  controller gain term(s).
-  comm_tm_err_ratio =
-    (int16_t)( ( Back_EMF_Falling_PhX << SCALE_64_LSH ) / Back_EMF_Riseing_PhX )
-    - (int16_t)SCALE_64_ONE;
+    if (counts < ZC_COMM_DELAY_MIN)
+    {
+      counts = ZC_COMM_DELAY_MIN;
+    }
+    else if (counts > U16_MAX)
+    {
+      counts = U16_MAX;
+    }
+  }
+  Driver_set_comm_delay( (uint16_t)counts );
+
+  zc_comm_time = (uint16_t)( zc_tick << ZC_TIME_LSH ) +
+    (uint16_t)( ( (counts << ZC_TIME_LSH) + (ZC_CT_PER_SAMPLE / 2) ) / ZC_CT_PER_SAMPLE );
+  zc_comm_sched = TRUE;
+}
+
+/*
+ * Coasting rotor detector, invoked at each PWM cycle with all phases floating.
+ *
+ * The phase having the highest back-EMF changes at each 120 degrees where
+ * the line-line back-EMF crosses zero, which is 30 degrees before the
+ * zero-crossing of the falling phase i.e. at the start of sector 0 (A exceeds
+ * C), sector 2 (B exceeds A) and sector 4 (C exceeds B). The order of the
+ * transitions is A -> B -> C in the forward direction.
+ */
+static void coast_sample(void)
+{
+  uint16_t bemf[ SEQ_N_PHASES ];
+  uint8_t top = 0;
+  uint8_t phase;
+
+  for (phase = 0; phase < SEQ_N_PHASES; phase++)
+  {
+    bemf[ phase ] = Driver_Get_ADC_Phase( phase );
+    TRACE_EVENT( TRACE_EV_ADC, phase, bemf[ phase ] );
+
+    if (bemf[ phase ] > bemf[ top ])
+    {
+      top = phase;
+    }
+  }
+
+  // too slow or stopped
+  if (bemf[ top ] < COAST_BEMF_MIN)
+  {
+    coast_count = 0;
+    coast_phase = SEQ_N_PHASES;
+    return;
+  }
+
+  if (coast_phase >= SEQ_N_PHASES)
+  {
+    coast_phase = top;
+    coast_time = zc_tick;
+  }
+  else if ( (top != coast_phase) &&
+            (bemf[ top ] > (bemf[ coast_phase ] + COAST_HYST)) )
+  {
+    uint16_t interval = zc_tick - coast_time;
+
+    if (((coast_phase + 1) % SEQ_N_PHASES) == top)
+    {
+      // the first transition does not have a complete interval
+      coast_interval =
+        (coast_count > 1) ? ((coast_interval + interval) >> 1) : interval;
+
+      if (coast_count < U8_MAX)
+      {
+        coast_count += 1;
+      }
+    }
+    else
+    {
+      coast_count = 0; // reverse rotation
+    }
+    coast_phase = top;
+    coast_time = zc_tick;
+  }
 }
 
 /* Public functions ---------------------------------------------------------*/
+/**
+ * @brief  Start the coasting rotor detector
+ *
+ * @details  The phases must be floating (see All_phase_stop()). The detection
+ *   ends at the next commutation step.
+ */
+void Seq_coast_start(void)
+{
+  coast_count = 0;
+  coast_phase = SEQ_N_PHASES; // not known
+  coast_enabled = TRUE;
+}
+
+/**
+ * @brief Test for back-EMF of a coasting rotor
+ *
+ * @return  TRUE if the latest sample has back-EMF above the detection limit
+ */
+bool Seq_get_coast_bemf(void)
+{
+  return (coast_phase < SEQ_N_PHASES);
+}
+
+/**
+ * @brief Accessor for the sector period of the coasting rotor
+ *
+ * @return  Sector time expressed in counts of commutation period, 0 if not
+ *   synced to the coasting rotor
+ */
+uint16_t Seq_get_coast_period(void)
+{
+  uint8_t count;
+  uint8_t sync;
+  uint16_t interval;
+
+  do
+  {
+    count = Seq_upd_count;
+    sync = coast_count;
+    interval = coast_interval;
+  }
+  while (count != Seq_upd_count);
+
+  if ( (FALSE != coast_enabled) && (sync >= COAST_N_SYNC) )
+  {
+    // the transitions are 2 sectors apart
+    uint32_t period = ( (uint32_t)interval * ZC_CT_PER_SAMPLE ) >> 1;
+
+    if (period < U16_MAX)
+    {
+      return (uint16_t)period;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Accessor for the position of the coasting rotor
+ *
+ * @details  Invoked from the commutation ISR (not coherent at lower levels).
+ *
+ * @param [out] p_elapsed  Time since the start of the sector, in counts of
+ *   commutation period
+ * @return  The sector started at the latest transition (0, 2 or 4)
+ */
+uint8_t Seq_get_coast_sector(uint16_t *p_elapsed)
+{
+  uint32_t elapsed = (uint32_t)(uint16_t)(zc_tick - coast_time) * ZC_CT_PER_SAMPLE;
+
+  *p_elapsed = (elapsed < U16_MAX) ? (uint16_t)elapsed : U16_MAX;
+
+  return (uint8_t)(coast_phase * 2);
+}
+
 /**
  * @brief  Determine plausibility of Control error term.
  *
@@ -330,11 +744,31 @@ static void sector_5(void)
  */
 bool Seq_get_timing_error_p(void)
 {
-  if ( (Back_EMF_Falling_PhX + Back_EMF_Riseing_PhX) > BACK_EMF_PLAUS_THR )
+  uint8_t count;
+  bool plaus;
+
+  do
   {
-    return TRUE;
+    uint16_t thr;
+    uint8_t phase;
+
+    count = Seq_upd_count;
+    thr = (uint16_t)( ( (uint32_t)Vbatt_ * BACK_EMF_PLAUS_Q8 ) >> 8 );
+
+    // zero-crossing must have been detected in each sector of the latest cycle
+    plaus = (zc_sync_count >= SEQ_N_CSTEPS);
+
+    for (phase = 0; phase < SEQ_N_PHASES; phase++)
+    {
+      if ( (Back_EMF_Falling[ phase ] + Back_EMF_Rising[ phase ]) <= thr )
+      {
+        plaus = FALSE;
+      }
+    }
   }
-  return FALSE;
+  while (count != Seq_upd_count);
+
+  return plaus;
 }
 
 /**
@@ -347,23 +781,265 @@ bool Seq_get_timing_error_p(void)
  */
 int16_t Seq_get_timing_error(void)
 {
-  return comm_tm_err_ratio; // positive if advanced
+  return (int16_t)seq_read_u16( (volatile const uint16_t *)&comm_tm_error ); // positive if advanced
+}
+
+/**
+ * @brief Accessor for measured time between the latest two zero-crossings
+ *
+ * @return  Sector time expressed as PWM samples (4-bits fraction)
+ */
+uint16_t Seq_get_zc_interval(void)
+{
+  return seq_read_u16( &zc_interval );
+}
+
+/**
+ * @brief Accessor for the present commutation sector
+ *
+ * @details  Invoked from the commutation ISR, which is the only writer.
+ */
+uint8_t Seq_get_sector(void)
+{
+  return (uint8_t)Seq_sector;
+}
+
+/**
+ * @brief Accessor for measured sector period
+ *
+ * @details  The ZC->ZC interval is only valid if the crossing was detected in
+ *   each of the latest two sectors.
+ *
+ * @return  Sector time expressed in counts of commutation period, 0 if not valid
+ */
+uint16_t Seq_get_sector_period(void)
+{
+  uint8_t count;
+  uint8_t sync;
+  uint16_t interval;
+
+  do
+  {
+    count = Seq_upd_count;
+    sync = zc_sync_count;
+    interval = zc_interval;
+  }
+  while (count != Seq_upd_count);
+
+  if (sync >= 2)
+  {
+    uint32_t period =
+      ( (uint32_t)interval * ZC_CT_PER_SAMPLE ) >> ZC_TIME_LSH;
+
+    if (period < U16_MAX)
+    {
+      return (uint16_t)period;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Set the timing advance of the commutation switching
+ *
+ * @details  The commutation is advanced w.r.t. the rotor position by moving
+ *   the ideal position of the zero-crossing toward the end of the sector, i.e.
+ *   the commutation delay following the zero-crossing is SEQ_ZC_DELAY_DEG less
+ *   the advance.
+ *
+ * @param advance_deg  Electrical degrees of timing advance
+ */
+void Seq_set_timing_advance(uint8_t advance_deg)
+{
+  if (advance_deg > ZC_ADVANCE_MAX_DEG)
+  {
+    advance_deg = ZC_ADVANCE_MAX_DEG;
+  }
+  zc_position =
+    ( (uint16_t)(60 - SEQ_ZC_DELAY_DEG + advance_deg) * 256u ) / 60;
+}
+
+/**
+ * @brief Enable the commutation from the zero-crossing
+ *
+ * @details  With the commutation from the zero-crossing (closed-loop), the
+ *   commutation timer is rescheduled at the crossing detected in each sector
+ *   to step at the ideal position (see Seq_set_timing_advance()) from the
+ *   crossing. The period scheduled at the commutation step (BL_get_timing())
+ *   is the fallback of a sector having no crossing, or having the crossing
+ *   past the end of the period. Otherwise the period set at the step is
+ *   applied as is (open-loop).
+ *
+ * @param enable  TRUE to schedule the commutation from the zero-crossing
+ */
+void Seq_set_zc_commutation(bool enable)
+{
+  zc_comm_enabled = enable;
+}
+
+/**
+ * @brief Set the blanking window following the commutation switching
+ *
+ * @details  The samples of the floating phase in the window are excluded
+ *   from the zero-crossing test and the back-EMF measurement, as the phase
+ *   voltage is clamped by the flyback diode until the winding is
+ *   demagnetized. The window is applied from the next sector, and is at least
+ *   ZC_BLANK_SAMPLES PWM cycles. It is limited to half of the sector ahead of
+ *   the ideal zero-crossing.
+ *
+ * @param blank_q8  Fraction of the sector period (8-bit fraction)
+ */
+void Seq_set_blanking(uint8_t blank_q8)
+{
+  if (blank_q8 > ZC_BLANK_MAX_Q8)
+  {
+    blank_q8 = ZC_BLANK_MAX_Q8;
+  }
+  zc_blank_q8 = blank_q8;
+}
+
+/**
+ * @brief  Zero-crossing detector for the back-EMF of the floating phase
+ *
+ * @details  Invoked from the ADC ISR at each PWM cycle. The sample of the
+ *   floating phase is compared to the motor neutral point (approximated as
+ *   1/2 Vbatt as phase measurements are taken during PWM on-time). Upon the
+ *   first crossing in the sector, the time of crossing is interpolated between
+ *   the two adjacent samples and the timing error is updated, which gives a
+ *   timing update at each of the 6 commutation sectors. The samples following
+ *   the blanking window are accumulated to the back-EMF measurement of the
+ *   sector.
+ */
+void Seq_Bemf_Sample(void)
+{
+  const Seq_float_t * pflt = &Seq_float_tbl[ Seq_sector ];
+  uint16_t bemf = Driver_Get_ADC_Phase( pflt->phase );
+  uint16_t zc_ref = Vbatt_ >> 1;
+  int16_t diff;
+
+  Seq_upd_count += 1;
+  zc_tick += 1;
+  TRACE_TICK();
+
+#if defined( SCOPE_ENABLED )
+  Scope_sample( Seq_sector );
+#endif
+
+  if (FALSE != coast_enabled)
+  {
+    coast_sample();
+    return;
+  }
+
+  TRACE_EVENT( TRACE_EV_ADC, pflt->phase, bemf );
+
+  vbatt_sample( pflt->pwm );
+
+  if (zc_sample_n < U8_MAX)
+  {
+    zc_sample_n += 1;
+  }
+
+  // each sample is taken relative to the reference of the same PWM cycle, the
+  // reference is of the filtered supply voltage which may step by a count
+  // between the 2 samples, so that a sample at the reference is not missed
+  diff = (int16_t)bemf - (int16_t)zc_ref;
+
+  if (zc_sample_n <= zc_blank_n)
+  {
+    zc_prev_diff = diff;
+    return;
+  }
+
+  if (bemf_count < BEMF_ACC_N_MAX)
+  {
+    bemf_sum += bemf;
+    bemf_count += 1;
+  }
+
+  // test the latest two samples, the previous sample may be of the blanking
+  // window: the flyback diode clamps the phase at the rail to which it is
+  // going i.e. a sample of the demagnetization is past the crossing, so only
+  // the sample past the crossing must follow the blanking
+  if (FALSE == zc_found)
+  {
+    uint16_t dv = 0;
+    uint16_t dref = 0;
+
+    if (FALSE != pflt->rising)
+    {
+      if ( (zc_prev_diff < 0) && (diff >= 0) )
+      {
+        dv = (uint16_t)(diff - zc_prev_diff);
+        dref = (uint16_t)(-zc_prev_diff);
+      }
+    }
+    else
+    {
+      if ( (zc_prev_diff > 0) && (diff <= 0) )
+      {
+        dv = (uint16_t)(zc_prev_diff - diff);
+        dref = (uint16_t)zc_prev_diff;
+      }
+    }
+
+    if (dv > 0)
+    {
+      // fraction of sample period from the previous sample to the crossing
+      uint16_t frac = (uint16_t)( (dref << ZC_TIME_LSH) / dv );
+      uint16_t zc_abs = (uint16_t)( (uint16_t)(zc_tick - 1) << ZC_TIME_LSH ) + frac;
+
+      zc_interval = zc_abs - zc_last_time; // 16-bit overflow is ok
+      zc_last_time = zc_abs;
+      zc_found = TRUE;
+
+      // interval is only valid if the preceding sector also had its crossing
+      if (zc_sync_count > 0)
+      {
+        zc_timing_update( (int16_t)(zc_abs - zc_sector_start) );
+
+        if (FALSE != zc_comm_enabled)
+        {
+          zc_comm_schedule(frac);
+        }
+      }
+    }
+  }
+  zc_prev_diff = diff;
 }
 
 /**
- * @brief  Accessor for back-EMF measurement.
+ * @brief  Accessor for back-EMF measurement of phase A.
  */
 uint16_t Seq_Get_bemfR(void)
 {
-  return Back_EMF_Riseing_PhX ;
+  return seq_read_u16( &Back_EMF_Rising[ 0 ] );
 }
 
 /**
- * @brief  Accessor for back-EMF measurement.
+ * @brief  Accessor for back-EMF measurement of phase A.
  */
 uint16_t Seq_Get_bemfF(void)
 {
-  return Back_EMF_Falling_PhX ;
+  return seq_read_u16( &Back_EMF_Falling[ 0 ] );
+}
+
+/**
+ * @brief  Accessor for back-EMF measurement (positive-going float) of a phase.
+ * @param phase  Motor phase index (0:A, 1:B, 2:C)
+ */
+uint16_t Seq_Get_bemfR_Ph(uint8_t phase)
+{
+  return seq_read_u16( &Back_EMF_Rising[ phase ] );
+}
+
+/**
+ * @brief  Accessor for back-EMF measurement (negative-going float) of a phase.
+ * @param phase  Motor phase index (0:A, 1:B, 2:C)
+ */
+uint16_t Seq_Get_bemfF_Ph(uint8_t phase)
+{
+  return seq_read_u16( &Back_EMF_Falling[ phase ] );
 }
 
 /**
@@ -374,9 +1050,23 @@ uint16_t Seq_Get_bemfF(void)
  */
 uint16_t Seq_Get_Vbatt(void)
 {
-  return Vbatt_;
+  return seq_read_u16( &Vbatt_ );
 }
 
+#if defined( TRACE_ENABLED )
+/**
+ * @brief  Load the supply voltage filter state of a trace event.
+ *
+ * @details  For the replay of a trace (TRACE_EV_VBATT), the samples of the
+ *           filter input are not traced.
+ */
+void Seq_set_vbatt_filt(uint16_t filt)
+{
+  Vbatt_filt = filt;
+  Vbatt_ = filt >> VBATT_FILT_SHIFT;
+}
+#endif // TRACE_ENABLED
+
 /**
  * @brief Public accessor for step 0 in the commutation sequence function table
  *
@@ -388,10 +1078,29 @@ uint16_t Seq_Get_Vbatt(void)
 void Sequence_Step_0(void)
 {
   Seq_sector_t step = SECTOR_0;
+
+  Seq_upd_count += 1;
+  Seq_sector = step;
+  zc_sync_count = 0;
+  zc_sample_n = 0;
+  zc_blank_n = ZC_BLANK_SAMPLES;
+  zc_sector_start = zc_step_time();
+  bemf_sum = 0;
+  bemf_count = 0;
+  coast_enabled = FALSE;
+
+#if defined( SEQ_REG_TABLE )
+  PWM_set_sector( step );
+#else
   step_ptr_table[ step ]();
+#endif
 
-  // In Arming-state a single motor-phase is PWM'd to generate a voltage measurement
+  // In Arming-state a single motor-phase is PWM'd to generate a voltage
+  // measurement, the filter is preset to the sample of phase A
   Vbatt_ = Driver_Get_ADC();
+  Vbatt_filt = Vbatt_ << VBATT_FILT_SHIFT;
+
+  TRACE_EVENT( TRACE_EV_SECTOR, step, Vbatt_ );
 }
 
 /**
@@ -401,6 +1110,44 @@ void Sequence_Step_0(void)
  */
 void Sequence_Step(uint8_t step)
 {
-    step_ptr_table[step]();
+  Seq_upd_count += 1;
+
+  // the rotor was coasting in the sector just completed
+  if (FALSE != coast_enabled)
+  {
+    coast_enabled = FALSE;
+    zc_found = FALSE;
+  }
+  else
+  {
+    // floating phase of the sector just completed
+    bemf_measure(Seq_sector);
+  }
+
+  // close out the zero-crossing detection of the sector just completed
+  if (FALSE == zc_found)
+  {
+    zc_sync_count = 0;
+  }
+  else if (zc_sync_count < U8_MAX)
+  {
+    zc_sync_count += 1;
+  }
+  zc_found = FALSE;
+  zc_sample_n = 0;
+  zc_blank_n = zc_blank_samples();
+  zc_sector_start = zc_step_time();
+  bemf_sum = 0;
+  bemf_count = 0;
+
+  Seq_sector = (Seq_sector_t)step;
+
+#if defined( SEQ_REG_TABLE )
+  PWM_set_sector( step );
+#else
+  step_ptr_table[step]();
+#endif
+
+  TRACE_EVENT( TRACE_EV_SECTOR, step, Vbatt_ );
 }
 /**@}*/ // defgroup
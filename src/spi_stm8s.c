@@ -13,9 +13,6 @@
  * @{
  */
 /* Includes ------------------------------------------------------------------*/
-#include <stdio.h>
-#include <ctype.h> // isprint
-#include <string.h> // memset
 
 // unfortunately this has to be included merely for SPI ENABLED define
 // todo consider -DSPI_ENABLED ? in project/makefile
@@ -25,6 +22,7 @@
 
 // app headers
 #include "mcu_stm8s.h"
+#include "spi_stm8s.h"
 
 
 /* Private defines -----------------------------------------------------------*/
@@ -32,82 +30,27 @@
 /* Chip select */
 #define CS_PIN      5
 
-#define TIME_OUT_0 0x1000 // timer1 free running, time between periodic task is 0x2080
-#define TIME_OUT_1 0x0002 //
-#define RX_BUF_SZ 16
-
 
 /** @cond */
 
 /* Private variables ---------------------------------------------------------*/
 
-uint8_t spi_rx_buf[RX_BUF_SZ];
-
-/* Private functions ---------------------------------------------------------*/
-
-int SPI_read_write_b(uint8_t * chbuf, uint8_t data, uint16_t time_out)
-{
-    uint8_t index = 0;
-    uint8_t hup = FALSE;
-    uint8_t spi_rx;
-    uint8_t spi_tx;
-    uint16_t start = TIM1_GetCounter();
-    (void)data; // unused atm
+/*
+ * The frame being sent is not written by the background task, which builds the
+ * next status frame in the other buffer and hands it over (Tx_next) to
+ * be switched in by the ISR at the start of the next frame.
+ */
+static uint8_t Tx_frame[2][SPI_FRAME_SZ];
+static volatile uint8_t Tx_sel;  // frame being sent
+static volatile uint8_t Tx_next; // most recent frame
 
-// shouldn't need this if it worked correctly ;
-    memset(spi_rx_buf, 0, SPI_RX_BUF_SZ);
+static uint8_t Rx_frame[SPI_FRAME_SZ];
+static volatile uint8_t Xfer_index = SPI_FRAME_SZ; // no transfer in progress
 
+static volatile uint16_t Rx_throttle;
+static volatile uint8_t Rx_frames; // count of valid frames received
 
-    while( 1 )
-    {
-        if (SPI->SR & SPI_SR_RXNE)
-        {
-            // Clearing the RXNE bit is performed by reading the SPI_DR register
-            spi_rx = SPI->DR;
-            hup = FALSE; // as long as they keep sending ... keep listening
-            index = (uint8_t)((index < (RX_BUF_SZ-1) ) ? index + 1 : 0);
-
-            if ( spi_rx == 0xF2 )
-            {
-                index = 0;
-                spi_rx = 'X'; // trust rx_cntr get reset!
-            }
-            spi_tx = chbuf[ index ]; // send something back
-
-            while (! (SPI->SR & SPI_SR_TXE) ) {}
-
-            SPI->DR = spi_tx;
-
-            spi_rx_buf[ index ] =  spi_rx; // trust rx_cntr get reset!
-        }
-        else
-        {
-            // if timed out then return error
-            if ( (TIM1_GetCounter() - start) > time_out )
-            {
-//                index = -1; // timed out, return error
-//								goto exit;
-                return -1 ;
-            }
-            if (FALSE == hup )
-            {
-                // one more time in the loop
-                hup = TRUE;
-            }
-            else // if hup == true
-            {
-                if (index > 0)
-                {
-//                    goto exit;
-                    return index;
-                }
-            }
-        }
-    } // while
-
-exit:
-    return index;
-}
+/* Private functions ---------------------------------------------------------*/
 
 /*
  * example codes for SPI functions from
@@ -126,113 +69,161 @@ void chip_deselect(void)
     GPIOE->ODR |= (1 << CS_PIN);
 #endif
 }
-/** @endcond */
 
-/**
- * @brief  Write a byte onto SPI bus.
- *
- * @return  Error on time-out.
+/*
+ * checksum is the sum of the bytes following SOF
  */
-void SPI_write(uint8_t data)
+static uint8_t frame_checksum(const uint8_t *frame)
 {
-    SPI->DR = data;
-    while (! (SPI->SR & SPI_SR_TXE) ) {}
+    uint8_t csum = 0;
+    uint8_t n;
+
+    for (n = 1; n < SPI_FCS; n++)
+    {
+        csum += frame[n];
+    }
+    return csum;
 }
 
+/*
+ * validate the received frame and latch the throttle command
+ */
+static void on_frame_received(void)
+{
+    if ( (SPI_SOF == Rx_frame[SPI_SOF_IDX]) &&
+         (frame_checksum(Rx_frame) == Rx_frame[SPI_FCS]) )
+    {
+        Rx_throttle =
+            ((uint16_t)Rx_frame[SPI_RX_THR_H] << 8) | Rx_frame[SPI_RX_THR_L];
+        Rx_frames += 1;
+    }
+}
+/** @endcond */
+
 /**
- * @brief  Read a byte from SPI bus.
+ * @brief  Build the status frame to be sent at the next exchange.
  *
- * @return  Error on time-out.
+ * @details  Called from the background task. If the previous status frame has
+ *   not been sent yet, it is replaced by this one.
  */
-uint8_t SPI_read( void )
+void SPI_set_status(const BL_status_t *p_status)
 {
-    SPI_write( 0xA5 );
-    while ( ! (SPI->SR & SPI_SR_RXNE) ) {}
-    return SPI->DR;
+    uint8_t sel;
+    uint8_t *frame;
+
+    // the idle buffer can only be written while the ISR is not about to switch
+    // to it i.e. if it has been handed over it is taken back first
+    disableInterrupts();
+    Tx_next = Tx_sel;
+    sel = Tx_sel ^ 1;
+    enableInterrupts();
+
+    frame = Tx_frame[ sel ];
+
+    frame[SPI_SOF_IDX] = SPI_SOF;
+    frame[SPI_TX_STATE] = (uint8_t)p_status->bL_opstate;
+    frame[SPI_TX_VSYS_H] = (uint8_t)(p_status->bl_sys_voltage >> 8);
+    frame[SPI_TX_VSYS_L] = (uint8_t)p_status->bl_sys_voltage;
+    frame[SPI_TX_SPEED_H] = (uint8_t)(p_status->bl_motor_speed >> 8);
+    frame[SPI_TX_SPEED_L] = (uint8_t)p_status->bl_motor_speed;
+    frame[SPI_TX_PERD_H] = (uint8_t)(p_status->bl_comm_period >> 8);
+    frame[SPI_TX_PERD_L] = (uint8_t)p_status->bl_comm_period;
+    frame[SPI_FCS] = frame_checksum(frame);
+
+    Tx_next = sel;
 }
 
 /**
- * @brief  Read/write byte on SPI bus.
+ * @brief  Get the throttle command received from the host.
  *
- * @return  Error on time-out.
+ * @param [out] p_throttle  Commanded speed, PWM duty-cycle counts
+ * @return  TRUE if a valid frame has been received since the previous call
  */
-uint8_t SPI_read_write(uint8_t data)
+bool SPI_get_throttle(uint16_t *p_throttle)
 {
-    while (! (SPI->SR & SPI_SR_TXE) ) {}
+    static uint8_t frames = 0;
+    bool is_new = FALSE;
 
-    SPI->DR = data;
-
-    while ( ! (SPI->SR & SPI_SR_RXNE) ) {}
+    disableInterrupts();
+    if (frames != Rx_frames)
+    {
+        frames = Rx_frames;
+        *p_throttle = Rx_throttle;
+        is_new = TRUE;
+    }
+    enableInterrupts();
 
-    return SPI->DR;
+    return is_new;
 }
 
 /**
  * @brief  Top-level task for SPI controller (master) task.
  *
- * @return  Error on time-out.
+ * @details  Starts the exchange of a frame, which is then completed by the SPI
+ *   ISR, one byte per RXNE interrupt. No effect if the previous exchange is
+ *   not complete.
  */
 void SPI_controld(void)
 {
-    static uint8_t n;
-    char sbuf[16]; // am i big enuff?
-    uint8_t rxbuf[8] = { 0, 0, 0, 0 } ;
-
-    n = (uint8_t)((n >= 0x30 && n < 126) ? n + 1 : 0x30);
+#if SPI_ENABLED == SPI_STM8_MASTER
+    if (Xfer_index < SPI_FRAME_SZ)
+    {
+        return;
+    }
 
-// pretty sure it shouldnot be necessary to DI/EI ... all byte read/writes and
-// SPI is not being run in interrupt mode. Not shared variables. EI/DI
-// will tick the motor if the SPI rate is real low!
-//     disableInterrupts();
+    disableInterrupts();
+    Tx_sel = Tx_next;
+    Xfer_index = 0;
     chip_select();
-
-    rxbuf[0] = SPI_read_write(0xa5); // start of sequence
-    rxbuf[1] = SPI_read_write( n );
-    rxbuf[2] = SPI_read_write('1');
-    rxbuf[3] = SPI_read_write('2');
-
-    chip_deselect();
-//    enableInterrupts();
-// tmp dump test SPI test data to UART
-    sbuf[0] = '>';
-    sbuf[1] = n;
-    sbuf[2] = isprint( (int)rxbuf[0] ) ? rxbuf[0] : '.' ;
-    sbuf[3] = isprint( (int)rxbuf[1] ) ? rxbuf[1] : '.' ;
-    sbuf[4] = isprint( (int)rxbuf[2] ) ? rxbuf[2] : '.' ;
-    sbuf[5] = isprint( (int)rxbuf[3] ) ? rxbuf[3] : '.' ;
-    sbuf[6] = 0;
-    printf("%s\r\n", sbuf);
+    SPI->DR = Tx_frame[ Tx_sel ][0];
+    enableInterrupts();
+#endif
 }
 
-
-#if 0
-static void SPI_periphd(void)
+/**
+ * @brief  SPI RXNE event handler.
+ *
+ * @details  Invoked from the SPI ISR on each byte exchanged. In master mode the
+ *   next byte of the frame is written to start its transfer, in slave mode it is
+ *   loaded to be shifted out at the next byte clocked by the host, which must
+ *   start each frame with SOF.
+ */
+void SPI_on_transfer(void)
 {
-    static int i;
-    char sbuf[16]; // am i big enuff?
+    // Clearing the RXNE bit is performed by reading the SPI_DR register
+    uint8_t rx = SPI->DR;
 
-    i = (i >= 0x30 && i < 126) ? i+1 : 0x30;
-// tmp dump test SPI test data to UART
-    disableInterrupts();
-    sbuf[0] = '>';
-    sbuf[1] = i;
-    sbuf[2] = isprint( (int)SPI_rxbuf[0] ) ? SPI_rxbuf[0] : '.' ;
-    sbuf[3] = isprint( (int)SPI_rxbuf[1] ) ? SPI_rxbuf[1] : '.' ;
-    sbuf[4] = isprint( (int)SPI_rxbuf[2] ) ? SPI_rxbuf[2] : '.' ;
-    sbuf[5] = isprint( (int)SPI_rxbuf[3] ) ? SPI_rxbuf[3] : '.' ;
-    sbuf[6] = isprint( (int)SPI_rxbuf[4] ) ? SPI_rxbuf[4] : '.' ;
-    sbuf[7] = '$';
-    sbuf[8] = 0;
-    is_SPI_rx = FALSE;
-    memset(SPI_rxbuf, 0, SPI_RX_BUF_SZ); // tmp
-    enableInterrupts();
+#if SPI_ENABLED == SPI_STM8_SLAVE
+    if (Xfer_index >= SPI_FRAME_SZ)
+    {
+        Xfer_index = 0;
+    }
+    if ( (0 == Xfer_index) && (SPI_SOF != rx) )
+    {
+        SPI->DR = Tx_frame[ Tx_sel ][0]; // resync to the next frame
+        return;
+    }
+#endif
 
-    strcat(sbuf, "\r\n");
-    UARTputs(sbuf);
-}
+    Rx_frame[ Xfer_index ] = rx;
+    Xfer_index += 1;
+
+    if (Xfer_index < SPI_FRAME_SZ)
+    {
+        SPI->DR = Tx_frame[ Tx_sel ][ Xfer_index ];
+    }
+    else
+    {
+        on_frame_received();
+#if SPI_ENABLED == SPI_STM8_MASTER
+        chip_deselect();
+#else
+        Tx_sel = Tx_next;
+        SPI->DR = Tx_frame[ Tx_sel ][0];
 #endif
+    }
+}
 
 #endif // SPI_ENABLED
 
 /**@}*/ // defgroup
-
@@ -13,7 +13,13 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm8s_it.h"
 #include "system.h"
+#include "hal_stm8s.h"
 #include "driver.h"
+#include "mcu_stm8s.h"
+#include "profile.h"
+#include "spi_stm8s.h"
+#include "eeprom_stm8s.h"
+#include "sched.h"
 
 
 /** @addtogroup Template_Project
@@ -205,9 +211,10 @@ INTERRUPT_HANDLER(EXTI_PORTE_IRQHandler, 7)
   */
 INTERRUPT_HANDLER(SPI_IRQHandler, 10)
 {
-  /* In order to detect unexpected events during development,
-     it is recommended to set a breakpoint on the following instruction.
-  */
+#if SPI_ENABLED
+  // RXNE is cleared by reading the data register
+  SPI_on_transfer();
+#endif
 }
 
 /**
@@ -217,30 +224,36 @@ INTERRUPT_HANDLER(SPI_IRQHandler, 10)
   */
 INTERRUPT_HANDLER(TIM1_UPD_OVF_TRG_BRK_IRQHandler, 11)
 {
-#if defined ( S003_DEV )
+#if defined( HAL_COMM_TIM1 )
+#if defined( PROFILE_ENABLED )
+    // timer count since the update event, read first thing in the ISR
+    Prof_sample(PROF_COMM_LAT, MCU_get_comm_count() / MCU_COMM_CT_PER_US);
+#endif
+    Sched_wake();
+    PROF_BEGIN(PROF_COMM_ISR);
     Driver_Step();
 
     // reset interrupt flag
-    TIM1_ClearITPendingBit(TIM1_IT_UPDATE);
-    TIM1_ClearFlag(TIM1_FLAG_UPDATE);
-#endif
-#if defined(S105_DEV) || defined (S105_DISCOVERY)
+    HAL_TIM_CLR_FLAG(TIM1, TIM1_SR1_UIF);
+    PROF_END(PROF_COMM_ISR);
 
-    static const int Frame_count = 4;
-    static uint8_t frame_counter = 0;
+#elif defined( HAL_PWM_TIM1 )
 
-// note pre-increment on variable 
-    if ( ++frame_counter >= Frame_count )
-    {
-        frame_counter = 0;
+    Sched_wake();
+    PROF_BEGIN(PROF_PWM_ISR);
 
-        Driver_Update();
-    }
+    Sched_tick();
+
+#if !defined( ADC_HW_TRIGGER )
     Driver_on_PWM_edge(); // starts ADC conversion
+#endif
 
     // reset interrupt flag
-    TIM1_ClearITPendingBit(TIM1_IT_UPDATE);
-    TIM1_ClearFlag(TIM1_FLAG_UPDATE);
+    HAL_TIM_CLR_FLAG(TIM1, TIM1_SR1_UIF);
+
+    PROF_END(PROF_PWM_ISR);
+
+    Sched_dispatch(); // control task, preemptible by all ISRs
 #endif
 }
 
@@ -251,21 +264,21 @@ INTERRUPT_HANDLER(TIM1_UPD_OVF_TRG_BRK_IRQHandler, 11)
   */
 INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
 {
-#if defined( S105_DISCOVERY ) && defined( HAS_SERVO_INPUT )
-    if ( 0 != TIM1_GetFlagStatus(TIM1_FLAG_CC3) )
+#if defined( HAL_SERVO_TIM1 ) && defined( HAS_SERVO_INPUT )
+    // rise first, the falling edge flag of the preceding DShot bit is set
+    // but its interrupt is not enabled
+    if ( HAL_TIM_FLAG(TIM1, HAL_SERVO_SR1_RISE) )
+    {
+//        GPIOD->ODR |=  (1<<LED); // set test pin
+        Driver_on_capture_rise();
+        HAL_TIM_CLR_FLAG(TIM1, HAL_SERVO_SR1_RISE);
+    }
+    else if ( HAL_TIM_FLAG(TIM1, HAL_SERVO_SR1_FALL) )
     {
 //        GPIOD->ODR &=  ~(1<<LED); // clear test pin
         Driver_on_capture_fall();
 
-        TIM1_ClearITPendingBit(TIM1_IT_CC3);
-        TIM1_ClearFlag(TIM1_FLAG_CC3);
-    }
-    else if ( 0 != TIM1_GetFlagStatus(TIM1_FLAG_CC4) )
-    {
-//        GPIOD->ODR |=  (1<<LED); // set test pin
-        Driver_on_capture_rise();
-        TIM1_ClearITPendingBit(TIM1_IT_CC4);
-        TIM1_ClearFlag(TIM1_FLAG_CC4);
+        HAL_TIM_CLR_FLAG(TIM1, HAL_SERVO_SR1_FALL);
     }
 #endif
 }
@@ -303,22 +316,23 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
   */
  INTERRUPT_HANDLER(TIM2_UPD_OVF_BRK_IRQHandler, 13)
 {
-    static const int Frame_count = 4;
-    static uint8_t frame_counter = 0;
+#if defined( HAL_PWM_TIM2 )
+    Sched_wake();
+    PROF_BEGIN(PROF_PWM_ISR);
 
-// note pre-increment on variable 
-    if ( ++frame_counter >= Frame_count )
-    {
-        frame_counter = 0;
-
-        Driver_Update();
-    }
+    Sched_tick();
 
+#if !defined( ADC_HW_TRIGGER )
     Driver_on_PWM_edge(); // starts ADC conversion
+#endif
 
     // reset interrupt flag
-    TIM2_ClearITPendingBit(TIM2_IT_UPDATE); // TIM2 interrupt sources defined in stm8s_tim2.h
-//    TIM2->SR1 &= ~ TIM2_SR1_UIF; // Update Interrupt Flag mask defined in stm8s.h
+    HAL_TIM_CLR_FLAG(TIM2, TIM2_SR1_UIF);
+
+    PROF_END(PROF_PWM_ISR);
+
+    Sched_dispatch(); // control task, preemptible by all ISRs
+#endif
 }
 
 /**
@@ -328,21 +342,19 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
   */
  INTERRUPT_HANDLER(TIM2_CAP_COM_IRQHandler, 14)
  {
-#if defined( S105_DEV ) && defined( HAS_SERVO_INPUT )
+#if defined( HAL_SERVO_TIM2 ) && defined( HAS_SERVO_INPUT )
 
-    if ( 0 != TIM2_GetFlagStatus(TIM2_FLAG_CC1) )
+    if ( HAL_TIM_FLAG(TIM2, HAL_SERVO_SR1_RISE) )
     {
         Driver_on_capture_rise();
 
-        TIM2_ClearITPendingBit(TIM2_IT_CC1);
-        TIM2_ClearFlag(TIM2_FLAG_CC1);
+        HAL_TIM_CLR_FLAG(TIM2, HAL_SERVO_SR1_RISE);
     }
-    else if ( 0 != TIM2_GetFlagStatus(TIM2_FLAG_CC2) )
+    else if ( HAL_TIM_FLAG(TIM2, HAL_SERVO_SR1_FALL) )
     {
         Driver_on_capture_fall();
 
-        TIM2_ClearITPendingBit(TIM2_IT_CC2);
-        TIM2_ClearFlag(TIM2_FLAG_CC2);
+        HAL_TIM_CLR_FLAG(TIM2, HAL_SERVO_SR1_FALL);
     }
 #endif
  }
@@ -357,11 +369,17 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
   */
  INTERRUPT_HANDLER(TIM3_UPD_OVF_BRK_IRQHandler, 15)
  {
-#if defined( S105_DEV ) || defined(S105_DISCOVERY)
+#if defined( HAL_COMM_TIM3 )
+#if defined( PROFILE_ENABLED )
+    // timer count since the update event, read first thing in the ISR
+    Prof_sample(PROF_COMM_LAT, MCU_get_comm_count() / MCU_COMM_CT_PER_US);
+#endif
+    Sched_wake();
+    PROF_BEGIN(PROF_COMM_ISR);
     Driver_Step();
     // reset interrupt flag
-//    TIM3_ClearITPendingBit(TIM3_IT_UPDATE);
-    TIM3->SR1 &= (uint8_t)~TIM3_SR1_UIF;
+    HAL_TIM_CLR_FLAG(TIM3, TIM3_SR1_UIF);
+    PROF_END(PROF_COMM_ISR);
 #endif
  }
 
@@ -387,9 +405,7 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
   */
  INTERRUPT_HANDLER(UART1_TX_IRQHandler, 17)
  {
-    /* In order to detect unexpected events during development,
-       it is recommended to set a breakpoint on the following instruction.
-    */
+    Serial_Tx_It();
  }
 
 /**
@@ -402,6 +418,9 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
     /* In order to detect unexpected events during development,
        it is recommended to set a breakpoint on the following instruction.
     */
+
+    // RXNE (and overrun) is cleared by reading the data register
+    Driver_Get_Rx_It();
  }
 #endif /* (STM8S208) || (STM8S207) || (STM8S103) || (STM8S001) || (STM8S903) || (STM8AF62Ax) || (STM8AF52Ax) */
 
@@ -451,9 +470,7 @@ INTERRUPT_HANDLER(I2C_IRQHandler, 19)
   */
  INTERRUPT_HANDLER(UART2_TX_IRQHandler, 20)
  {
-    /* In order to detect unexpected events during development,
-       it is recommended to set a breakpoint on the following instruction.
-    */
+    Serial_Tx_It();
  }
 
 /**
@@ -467,21 +484,8 @@ INTERRUPT_HANDLER(I2C_IRQHandler, 19)
        it is recommended to set a breakpoint on the following instruction.
     */
 
+    // RXNE (and overrun) is cleared by reading the data register
     Driver_Get_Rx_It();
-
-    #if defined( S105_DEV ) || defined( S105_DISCOVERY )
-
-        UART2_ClearITPendingBit(UART2_IT_RXNE);
-        UART2_ClearFlag(UART2_FLAG_RXNE);
-
-    #elif defined( S003_DEV )
-
-        UART1_ClearITPendingBit(UART1_IT_RXNE);
-        UART1_ClearFlag(UART1_FLAG_RXNE);
-
-    #endif
-
-    
  }
 #endif /* (STM8S105) || (STM8AF626x) */
 
@@ -531,9 +535,12 @@ INTERRUPT_HANDLER(I2C_IRQHandler, 19)
   */
  INTERRUPT_HANDLER(ADC1_IRQHandler, 22)
  {
+    Sched_wake();
+    PROF_BEGIN(PROF_ADC_ISR);
     Driver_on_ADC_conv();
 
-    ADC1_ClearFlag(ADC1_FLAG_EOC);
+    HAL_ADC_CLR_EOC();
+    PROF_END(PROF_ADC_ISR);
  }
 #endif /* (STM8S208) || (STM8S207) || (STM8AF52Ax) || (STM8AF62Ax) */
 
@@ -557,10 +564,11 @@ INTERRUPT_HANDLER(TIM6_UPD_OVF_TRG_IRQHandler, 23)
   */
  INTERRUPT_HANDLER(TIM4_UPD_OVF_IRQHandler, 23)
  {
-  /* In order to detect unexpected events during development,
-     it is recommended to set a breakpoint on the following instruction.
-  */
-
+#if defined( PROFILE_ENABLED )
+    Prof_timer_ovf();
+    // reset interrupt flag
+    HAL_TIM_CLR_FLAG(TIM4, TIM4_SR1_UIF);
+#endif
  }
 #endif /* (STM8S903) || (STM8AF622x)*/
 
@@ -571,9 +579,8 @@ INTERRUPT_HANDLER(TIM6_UPD_OVF_TRG_IRQHandler, 23)
   */
 INTERRUPT_HANDLER(EEPROM_EEC_IRQHandler, 24)
 {
-  /* In order to detect unexpected events during development,
-     it is recommended to set a breakpoint on the following instruction.
-  */
+  // end of programming of a data EEPROM byte
+  EEPROM_on_eop();
 }
 
 /**
@@ -0,0 +1,275 @@
+/**
+  ******************************************************************************
+  * @file telem.c
+  * @brief Binary telemetry stream
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup telem Telemetry
+ * @brief Fixed-layout binary telemetry frames on the serial port
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h> // memcpy
+
+#include "telem.h"
+#include "mcu_stm8s.h"
+#include "bldc_sm.h"
+#include "sequence.h"
+#include "faultm.h"
+#include "pwm_stm8s.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+#define PUT_U16( _BUF_, _OFS_, _VAL_ ) \
+  _BUF_[ (_OFS_) ] = (uint8_t)((uint16_t)(_VAL_) >> 8); \
+  _BUF_[ (_OFS_) + 1 ] = (uint8_t)(_VAL_)
+
+/* Private variables ---------------------------------------------------------*/
+
+// written in ISR context by Telem_Sample(), consumed by the background task
+static uint8_t Sample_frame[TELEM_FRAME_SZ];
+static volatile bool Sample_ready;
+
+static bool Flog_req;
+static uint8_t Flog_index; // next entry of the fault log dump
+
+static volatile bool Poll_req; // one sample regardless of the rate
+
+static uint8_t Telem_node;
+static uint8_t Telem_rate_div;
+static uint8_t Telem_seq;
+static uint16_t Telem_dropped;
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * CRC-8 bitwise, no table to save flash (computed in the background task)
+ */
+static uint8_t crc8(const uint8_t *buf, uint8_t len)
+{
+  uint8_t crc = 0;
+  uint8_t n;
+
+  while (len-- > 0)
+  {
+    crc ^= *buf++;
+    for (n = 0; n < 8; n++)
+    {
+      crc = (0 != (crc & 0x80)) ? (uint8_t)((crc << 1) ^ TELEM_CRC_POLY) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+
+/*
+ * Send the next frame of a fault log dump if it fits in the serial TX FIFO.
+ */
+static void flog_task(void)
+{
+  uint8_t frame[TELEM_FLOG_FRAME_SZ];
+  faultm_event_t event;
+  uint8_t count = Faultm_log_count();
+
+  if (Serial_tx_free() < TELEM_FLOG_FRAME_SZ)
+  {
+    return;
+  }
+
+  memset(frame, 0, TELEM_FLOG_FRAME_SZ);
+
+  if (FALSE != Faultm_log_get(Flog_index, &event))
+  {
+    frame[TELEM_FLOG_OFS_EVENT] = event.event;
+    frame[TELEM_FLOG_OFS_OPSTATE] = event.opstate;
+    PUT_U16( frame, TELEM_FLOG_OFS_TICK, event.tick );
+    PUT_U16( frame, TELEM_FLOG_OFS_DUTY, event.duty );
+    PUT_U16( frame, TELEM_FLOG_OFS_PERIOD, event.period );
+    PUT_U16( frame, TELEM_FLOG_OFS_VSYS, event.vsys );
+  }
+  else
+  {
+    count = 0; // empty (or cleared during the dump)
+  }
+
+  frame[TELEM_FLOG_OFS_SYNC] = TELEM_SYNC_FLOG;
+  frame[TELEM_FLOG_OFS_INDEX] = Flog_index;
+  frame[TELEM_FLOG_OFS_COUNT] = count;
+  frame[TELEM_FLOG_OFS_CRC] = crc8(frame, TELEM_FLOG_OFS_CRC);
+
+  (void)Serial_write(frame, TELEM_FLOG_FRAME_SZ);
+
+  Flog_index += 1;
+
+  if (Flog_index >= count)
+  {
+    Flog_req = FALSE;
+  }
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Sample the telemetry data.
+ *
+ * @details Invoked from ISR at the control task rate following the state
+ *  control update, so that the frame is a coherent snapshot of one control
+ *  step. A sample that has not been sent by the background task yet is
+ *  overwritten (seen by the host as a gap in the sequence counter). A polled
+ *  sample (Telem_poll()) is taken at the next step, regardless of the rate.
+ */
+void Telem_Sample(void)
+{
+  static uint8_t rate_count = 0;
+  BL_status_t status;
+
+  if (FALSE != Poll_req)
+  {
+    Poll_req = FALSE;
+  }
+  else
+  {
+    if (TELEM_RATE_OFF == Telem_rate_div)
+    {
+      return;
+    }
+
+    rate_count += 1;
+    if (rate_count < Telem_rate_div)
+    {
+      return;
+    }
+    rate_count = 0;
+  }
+
+  BL_get_status(&status);
+
+  Sample_frame[TELEM_OFS_SYNC] = TELEM_SYNC;
+  Sample_frame[TELEM_OFS_SEQ] = Telem_seq++;
+  Sample_frame[TELEM_OFS_OPSTATE] = (uint8_t)status.bL_opstate;
+  Sample_frame[TELEM_OFS_FAULT] = (uint8_t)Faultm_get_status();
+  PUT_U16( Sample_frame, TELEM_OFS_VSYS, status.bl_sys_voltage );
+  PUT_U16( Sample_frame, TELEM_OFS_SPEED, status.bl_motor_speed );
+  PUT_U16( Sample_frame, TELEM_OFS_PERIOD, status.bl_comm_period );
+  PUT_U16( Sample_frame, TELEM_OFS_DUTY, PWM_get_dutycycle() );
+  PUT_U16( Sample_frame, TELEM_OFS_TM_ERR, Seq_get_timing_error() );
+  PUT_U16( Sample_frame, TELEM_OFS_BEMF_R, Seq_Get_bemfR() );
+  PUT_U16( Sample_frame, TELEM_OFS_BEMF_F, Seq_Get_bemfF() );
+  PUT_U16( Sample_frame, TELEM_OFS_RPM, status.bl_motor_rpm );
+  Sample_frame[TELEM_OFS_NODE] = Telem_node;
+  Sample_frame[TELEM_OFS_LOAD] = status.bl_cpu_load;
+
+  Sample_ready = TRUE;
+}
+
+/**
+ * @brief Send the latest telemetry sample.
+ *
+ * @details Invoked in the execution context of 'main()' (background task) at
+ *  each pass of the loop. A fault log dump takes precedence over the samples,
+ *  one entry per pass. The frame is only queued if it fits entirely in the
+ *  serial TX FIFO, otherwise the sample is dropped.
+ */
+void Telem_Task(void)
+{
+  uint8_t frame[TELEM_FRAME_SZ];
+
+  if (FALSE != Flog_req)
+  {
+    flog_task(); // the pending sample, if any, is sent at the next pass
+    return;
+  }
+
+  if (FALSE == Sample_ready)
+  {
+    return;
+  }
+
+  disableInterrupts();  //////////////// DI
+  memcpy(frame, Sample_frame, TELEM_FRAME_SZ);
+  Sample_ready = FALSE;
+  enableInterrupts();  ///////////////// EI
+
+  frame[TELEM_OFS_CRC] = crc8(frame, TELEM_OFS_CRC);
+
+  if (Serial_tx_free() >= TELEM_FRAME_SZ)
+  {
+    (void)Serial_write(frame, TELEM_FRAME_SZ);
+  }
+  else
+  {
+    Telem_dropped += 1;
+  }
+}
+
+/**
+ * @brief Set the telemetry rate.
+ *
+ * @param rate_div  Divider of the control task rate, TELEM_RATE_OFF to disable
+ */
+void Telem_set_rate(uint8_t rate_div)
+{
+  if (rate_div > TELEM_RATE_MAX_DIV)
+  {
+    rate_div = TELEM_RATE_MAX_DIV;
+  }
+  Telem_rate_div = rate_div;
+}
+
+/**
+ * @brief Get the telemetry rate.
+ *
+ * @return  Divider of the control task rate, TELEM_RATE_OFF if disabled
+ */
+uint8_t Telem_get_rate(void)
+{
+  return Telem_rate_div;
+}
+
+/**
+ * @brief Request a dump of the fault event log.
+ *
+ * @details  The entries are sent by the background task regardless of the
+ *  telemetry rate, see TELEM_SYNC_FLOG.
+ */
+void Telem_dump_faults(void)
+{
+  Flog_index = 0;
+  Flog_req = TRUE;
+}
+
+/**
+ * @brief Request a single telemetry sample.
+ *
+ * @details  The sample is taken at the next control step and sent by the
+ *  background task, e.g. the reply to a poll on the multi-ESC bus with the
+ *  rate off.
+ */
+void Telem_poll(void)
+{
+  Poll_req = TRUE;
+}
+
+/**
+ * @brief Set the node address sent in the telemetry frames.
+ */
+void Telem_set_node(uint8_t node)
+{
+  Telem_node = node;
+}
+
+/**
+ * @brief Number of samples dropped due to the serial TX FIFO being full.
+ */
+uint16_t Telem_get_dropped(void)
+{
+  return Telem_dropped;
+}
+
+/**@}*/ // defgroup
@@ -0,0 +1,136 @@
+/**
+  ******************************************************************************
+  * @file term.c
+  * @brief Minimal formatted output to the serial terminal
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * Replaces printf for the terminal output: hex and unsigned decimal fields
+  * of fixed width written directly to the serial transmit FIFO, so neither
+  * stdio nor a varargs formatter is linked.
+  *
+  ******************************************************************************
+  */
+/**
+ * \defgroup term Terminal output
+ * @brief Minimal formatted output to the serial terminal
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include "term.h"
+#include "mcu_stm8s.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+#define TERM_DEC_DIGITS  5 // U16_MAX
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char Term_hex_digits[] = "0123456789ABCDEF";
+
+static bool Term_muted;
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Write a byte of the terminal output unless muted
+ */
+static void term_out(uint8_t c)
+{
+  if (FALSE == Term_muted)
+  {
+    Serial_putc( c );
+  }
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Write a character to the terminal
+ *
+ * @details Waits for space in the transmit FIFO (see Serial_putc), so must not
+ *  be used in an ISR or critical section.
+ */
+void Term_putc(char c)
+{
+  term_out( (uint8_t)c );
+}
+
+/**
+ * @brief Write a string to the terminal
+ */
+void Term_puts(const char *s)
+{
+  while ('\0' != *s)
+  {
+    term_out( (uint8_t)*s );
+    s += 1;
+  }
+}
+
+/**
+ * @brief Write a hex field to the terminal
+ *
+ * @param val     Value
+ * @param digits  Number of digits (1:4), leading zeros
+ */
+void Term_hex(uint16_t val, uint8_t digits)
+{
+  while (digits > 0)
+  {
+    digits -= 1;
+    term_out( (uint8_t)Term_hex_digits[ (val >> (digits * 4u)) & 0x0Fu ] );
+  }
+}
+
+/**
+ * @brief Write an unsigned decimal field to the terminal
+ *
+ * @param val    Value
+ * @param width  Minimum field width, right-aligned, padded with spaces or
+ *   with zeros if TERM_PAD_ZERO is set. 0 for no padding.
+ */
+void Term_dec(uint16_t val, uint8_t width)
+{
+  char buf[ TERM_DEC_DIGITS ];
+  char pad = (0 != (width & TERM_PAD_ZERO)) ? '0' : ' ';
+  uint8_t n = 0;
+
+  width &= (uint8_t)~TERM_PAD_ZERO;
+
+  do
+  {
+    buf[ n ] = (char)( '0' + (val % 10u) );
+    val /= 10u;
+    n += 1;
+  }
+  while (0 != val);
+
+  while (width > n)
+  {
+    term_out( (uint8_t)pad );
+    width -= 1;
+  }
+  while (n > 0)
+  {
+    n -= 1;
+    term_out( (uint8_t)buf[ n ] );
+  }
+}
+
+/**
+ * @brief Mute the terminal output
+ *
+ * @details The serial port is shared with the binary frames e.g. on the
+ *  multi-ESC bus (pdu_manager.h), where the text output would corrupt the
+ *  frames of the other nodes.
+ * @param mute  TRUE to drop the terminal output
+ */
+void Term_set_mute(bool mute)
+{
+  Term_muted = mute;
+}
+
+/**@}*/ // defgroup
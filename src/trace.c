@@ -0,0 +1,130 @@
+/**
+  ******************************************************************************
+  * @file trace.c
+  * @brief Event trace recorder of the ISR paths
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * Circular buffer of the latest events of the back-EMF sampling, commutation
+  * and control paths, for analysis of a loss of sync after the fact. The
+  * buffer is frozen at the first fault (Faultm_set()) and read out by the
+  * background task, the host replays the events through the sequencer and
+  * the controller (see stm_mcp_utest/src/test_trace_replay).
+  *
+  * The events are written by the commutation and ADC ISRs which are at the same
+  * interrupt level, so they don't preempt each other, and by the control task
+  * inside a critical section. The freeze is a single write of the flag, after
+  * which there is no writer, so the freeze event is appended without masking.
+  *
+  ******************************************************************************
+  */
+/**
+ * \defgroup trace Trace
+ * @brief Event trace recorder of the ISR paths
+ * @{
+ */
+/* Includes ------------------------------------------------------------------*/
+#include "trace.h"
+
+#if defined( TRACE_ENABLED )
+
+/* Public variables  ---------------------------------------------------------*/
+
+trace_event_t Trace_buf[ TRACE_N_EVENTS ];
+uint16_t Trace_head; // next entry to write, the oldest entry if full
+uint8_t Trace_tick;
+volatile bool Trace_frozen;
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Clear and (re)start the trace.
+ *
+ * @details Not while the recording ISRs are enabled unless the trace is
+ *  frozen.
+ */
+void Trace_arm(void)
+{
+  uint16_t n;
+
+  for (n = 0; n < TRACE_N_EVENTS; n++)
+  {
+    Trace_buf[ n ].tag = TRACE_TAG( TRACE_EV_NONE, 0 );
+  }
+  Trace_head = 0;
+  Trace_frozen = FALSE;
+}
+
+/**
+ * @brief Stop the trace, the latest event is the freeze event.
+ *
+ * @details Invoked at any level. Once frozen, the trace is held until re-armed
+ *  i.e. it shows the first fault.
+ * @param cause  Fault ID, or TRACE_FREEZE_DUMP
+ */
+void Trace_freeze(uint8_t cause)
+{
+  trace_event_t *p_ev;
+
+  if (FALSE != Trace_frozen)
+  {
+    return;
+  }
+  Trace_frozen = TRUE;
+
+  p_ev = &Trace_buf[ Trace_head ];
+  p_ev->tag = TRACE_TAG( TRACE_EV_FREEZE, cause );
+  p_ev->tick = Trace_tick;
+  p_ev->val = 0;
+  Trace_head = (uint16_t)( (Trace_head + 1u) & (TRACE_N_EVENTS - 1u) );
+}
+
+/**
+ * @brief Test if the trace is frozen.
+ */
+bool Trace_is_frozen(void)
+{
+  return Trace_frozen;
+}
+
+/**
+ * @brief Record an event from the control task
+ *
+ * @details Invoked with interrupts enabled at the main level, the event is
+ *  written inside a critical section.
+ */
+void Trace_task_event(trace_ev_t type, uint8_t param, uint16_t val)
+{
+  disableInterrupts();  //////////////// DI
+  TRACE_EVENT( type, param, val );
+  enableInterrupts();  ///////////////// EI
+}
+
+/**
+ * @brief Read an event of the frozen trace.
+ *
+ * @param index  0 is the oldest event
+ * @param p_event  Copy of the event
+ * @return  FALSE if the trace is not frozen or beyond the latest event
+ */
+bool Trace_get(uint16_t index, trace_event_t *p_event)
+{
+  const trace_event_t *p_ev;
+
+  if ( (FALSE == Trace_frozen) || (index >= TRACE_N_EVENTS) )
+  {
+    return FALSE;
+  }
+
+  // the freeze event is the latest
+  p_ev = &Trace_buf[ (Trace_head + index) & (TRACE_N_EVENTS - 1u) ];
+  *p_event = *p_ev;
+
+  return TRUE;
+}
+
+#endif // TRACE_ENABLED
+
+/**@}*/ // defgroup
@@ -0,0 +1,86 @@
+/**
+  ******************************************************************************
+  * @file    plant.h
+  * @brief   Simulated BLDC motor plant for host benchmark of the controller.
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date MAR-2022
+  ******************************************************************************
+  */
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stdint.h>
+
+/*
+ * defines
+ */
+#define PLANT_N_PHASES   3
+
+// 10-bit ADC (5 V reference) behind the 33k/18k phase voltage divider
+#define PLANT_ADC_VREF   5.0
+#define PLANT_ADC_FS     1024
+#define PLANT_ADC_DIVR   ( 18.0 / ( 18.0 + 33.0 ) )
+
+/*
+ * types
+ */
+
+/**
+ * @brief Drive state of a motor phase
+ */
+typedef enum
+{
+  PLANT_FLOAT = 0,  // half-bridge disabled (/SD low)
+  PLANT_LS,         // low-side switch on (IN low)
+  PLANT_PWM         // high-side PWM at the channel duty-cycle
+}
+Plant_drive_t;
+
+/**
+ * @brief Motor, load and supply parameters
+ */
+typedef struct
+{
+  double kv;          // speed constant, RPM/V
+  double pole_pairs;
+  double r_phase;     // phase resistance, ohm
+  double l_phase;     // phase inductance, H
+  double inertia;     // rotor + load inertia, kg m^2
+  double k_load;      // propeller load, N m / (rad/s)^2
+  double b_fric;      // viscous friction, N m / (rad/s)
+  double vbatt;       // supply voltage, V
+  double adc_noise;   // amplitude of ADC noise, counts (+/-)
+}
+Plant_param_t;
+
+/**
+ * @brief Plant state
+ */
+typedef struct
+{
+  double omega;       // mechanical speed, rad/s
+  double theta_e;     // electrical angle, degrees [0:360)
+  double i_ph[ PLANT_N_PHASES ]; // phase currents, A
+  double e_ph[ PLANT_N_PHASES ]; // phase back-EMF, V
+  double torque;      // motor torque, N m
+}
+Plant_state_t;
+
+/*
+ * prototypes
+ */
+void Plant_init(const Plant_param_t *p_param);
+
+void Plant_step(
+  double dt, const Plant_drive_t drive[ PLANT_N_PHASES ],
+  const double duty[ PLANT_N_PHASES ] );
+
+void Plant_get_adc(
+  const Plant_drive_t drive[ PLANT_N_PHASES ], uint16_t adc[ PLANT_N_PHASES ] );
+
+const Plant_state_t * Plant_get_state(void);
+
+double Plant_get_rpm(void);
+
+#endif // PLANT_H
@@ -0,0 +1,35 @@
+/**
+  ******************************************************************************
+  * @file    sim_hal.h
+  * @brief   Simulated PWM/ADC driver layer linked with the firmware modules.
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date MAR-2022
+  ******************************************************************************
+  */
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+
+#include "plant.h"
+
+/*
+ * prototypes
+ */
+void Sim_hal_reset(void);
+
+void Sim_get_drive(
+  Plant_drive_t drive[ PLANT_N_PHASES ], double duty[ PLANT_N_PHASES ] );
+
+int Sim_sector_of_drive(const Plant_drive_t drive[ PLANT_N_PHASES ]);
+
+void Sim_set_adc(uint8_t phase, uint16_t counts);
+
+bool Sim_get_comm_delay(uint16_t *p_delay);
+
+int Sim_eeprom_load(const char *fname);
+
+int Sim_eeprom_save(const char *fname);
+
+#endif // SIM_HAL_H
@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file    stm8s.h
+  * @brief   Host build substitute of the STM8S standard peripheral library.
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date MAR-2022
+  ******************************************************************************
+  *
+  * Only the types and register definitions that are referenced by the
+  * hardware-independent firmware modules (BLDC_sm.c, sequence.c, faultm.c,
+  * mdata.c) and their headers. The GPIO "registers" are plain variables so
+  * that the simulated plant can read back the half-bridge /SD outputs.
+  *
+  ******************************************************************************
+  */
+#ifndef STM8S_H
+#define STM8S_H
+
+#include <stdint.h>
+
+/*
+ * base types of the SPL
+ */
+typedef enum {FALSE = 0, TRUE = !FALSE} bool;
+
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+
+#define U8_MAX     (255)
+#define S8_MAX     (127)
+#define S8_MIN     (-128)
+#define U16_MAX    (65535u)
+#define S16_MAX    (32767)
+#define S16_MIN    (-32768)
+#define U32_MAX    (4294967295uL)
+
+#define __IO  volatile
+
+#define enableInterrupts()
+#define disableInterrupts()
+
+/*
+ * GPIO
+ */
+typedef struct GPIO_struct
+{
+  __IO uint8_t ODR; /*!< Output Data Register */
+  __IO uint8_t IDR; /*!< Input Data Register */
+  __IO uint8_t DDR; /*!< Data Direction Register */
+  __IO uint8_t CR1; /*!< Configuration Register 1 */
+  __IO uint8_t CR2; /*!< Configuration Register 2 */
+}
+GPIO_TypeDef;
+
+extern GPIO_TypeDef Sim_GPIOA, Sim_GPIOB, Sim_GPIOC, Sim_GPIOD, Sim_GPIOE;
+
+#define GPIOA  (&Sim_GPIOA)
+#define GPIOB  (&Sim_GPIOB)
+#define GPIOC  (&Sim_GPIOC)
+#define GPIOD  (&Sim_GPIOD)
+#define GPIOE  (&Sim_GPIOE)
+
+#define GPIO_PIN_0  ((uint8_t)0x01)
+#define GPIO_PIN_1  ((uint8_t)0x02)
+#define GPIO_PIN_2  ((uint8_t)0x04)
+#define GPIO_PIN_3  ((uint8_t)0x08)
+#define GPIO_PIN_4  ((uint8_t)0x10)
+#define GPIO_PIN_5  ((uint8_t)0x20)
+#define GPIO_PIN_6  ((uint8_t)0x40)
+#define GPIO_PIN_7  ((uint8_t)0x80)
+
+/*
+ * timer channel type referenced by pwm_stm8s.h
+ */
+typedef enum
+{
+  TIM2_CHANNEL_1 = ((uint8_t)0x00),
+  TIM2_CHANNEL_2 = ((uint8_t)0x01),
+  TIM2_CHANNEL_3 = ((uint8_t)0x02)
+}
+TIM2_Channel_TypeDef;
+
+#endif // STM8S_H
@@ -0,0 +1,292 @@
+/**
+  ******************************************************************************
+  * @file    plant.c
+  * @brief   Simulated BLDC motor plant for host benchmark of the controller.
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date MAR-2022
+  ******************************************************************************
+  *
+  * Averaged (PWM period) model of a wye-connected motor with trapezoidal
+  * back-EMF. The driven phases are switched by the firmware sequencer through
+  * the simulated /SD and timer channel outputs, a floating phase carries no
+  * current and its terminal voltage is the neutral point plus its back-EMF,
+  * which is what the ADC samples during the PWM on-time.
+  *
+  ******************************************************************************
+  */
+#include <math.h>
+#include <stddef.h>
+
+#include "plant.h"
+
+/*
+ * defines
+ */
+#define PI_D        3.14159265358979323846
+
+// ADC counts per volt at the phase terminal
+#define ADC_SCALE   ( PLANT_ADC_DIVR * PLANT_ADC_FS / PLANT_ADC_VREF )
+
+// conduction of the ADC input clamp diodes
+#define V_DIODE     0.7
+
+/*
+ * variables
+ */
+static Plant_param_t Param;
+static Plant_state_t State;
+
+static double Ke_phase;   // phase back-EMF constant, V / (rad/s)
+static double Tau_inv;    // inverse of electrical time constant, 1/s
+static double R_inv;
+static double J_inv;
+static double Deg_per_rad_e; // electrical degrees per mechanical radian
+static uint32_t Noise_seed = 1;
+
+/*
+ * Trapezoidal back-EMF shape (normalized) at the electrical angle (degrees),
+ * rising through zero at 0, flat top over 30:150, flat bottom over 210:330.
+ */
+static double bemf_shape(double theta)
+{
+  if (theta < 0)
+  {
+    theta += 360.0;
+  }
+  if (theta < 30.0)
+  {
+    return theta * (1.0 / 30.0);
+  }
+  if (theta < 150.0)
+  {
+    return 1.0;
+  }
+  if (theta < 210.0)
+  {
+    return (180.0 - theta) * (1.0 / 30.0);
+  }
+  if (theta < 330.0)
+  {
+    return -1.0;
+  }
+  return (theta - 360.0) * (1.0 / 30.0);
+}
+
+/*
+ * Uniform noise (+/- amplitude) from a linear congruential generator so runs
+ * are repeatable.
+ */
+static double adc_noise(void)
+{
+  Noise_seed = Noise_seed * 1103515245u + 12345u;
+  return Param.adc_noise * ( (double)( (Noise_seed >> 16) & 0x7FFF ) / 16384.0 - 1.0 );
+}
+
+/*
+ * Neutral point voltage from the driven phase terminal voltages. Currents of
+ * the driven phases sum to zero and the phases are identical, so the neutral
+ * is the average of (V - e) over the driven phases.
+ */
+static int neutral_voltage(
+  const Plant_drive_t drive[], const double v_term[], double *p_vn)
+{
+  double sum = 0;
+  int n_driven = 0;
+  int ph;
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    if (PLANT_FLOAT != drive[ ph ])
+    {
+      sum += v_term[ ph ] - State.e_ph[ ph ];
+      n_driven += 1;
+    }
+  }
+  *p_vn = (n_driven > 0) ? (sum / n_driven) : 0;
+
+  return n_driven;
+}
+
+/*
+ * functions
+ */
+
+/**
+ * @brief Initialize the plant at standstill
+ * @param p_param  Motor, load and supply parameters
+ */
+void Plant_init(const Plant_param_t *p_param)
+{
+  int ph;
+
+  Param = *p_param;
+
+  // line-line back-EMF peak is 2x the phase back-EMF (trapezoidal)
+  Ke_phase = 60.0 / ( 2.0 * PI_D * Param.kv ) / 2.0;
+  Tau_inv = Param.r_phase / Param.l_phase;
+  R_inv = 1.0 / Param.r_phase;
+  J_inv = 1.0 / Param.inertia;
+  Deg_per_rad_e = Param.pole_pairs * 180.0 / PI_D;
+
+  State.omega = 0;
+  State.theta_e = 0;
+  State.torque = 0;
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    State.i_ph[ ph ] = 0;
+    State.e_ph[ ph ] = 0;
+  }
+  Noise_seed = 1;
+}
+
+/**
+ * @brief Advance the plant by a time step
+ * @details  The driven phase currents respond to the PWM averaged terminal
+ *   voltages with the electrical time constant, the exponential decay over the
+ *   step being approximated by a (2,2) Pade approximant (error < 1e-4 for
+ *   steps up to the time constant). The current of a phase is assumed to
+ *   decay immediately when it is switched to floating.
+ * @param dt     Time step, seconds
+ * @param drive  Drive state of each phase
+ * @param duty   PWM duty-cycle (0:1.0) of each phase
+ */
+void Plant_step(
+  double dt, const Plant_drive_t drive[ PLANT_N_PHASES ],
+  const double duty[ PLANT_N_PHASES ] )
+{
+  double v_term[ PLANT_N_PHASES ];
+  double shape[ PLANT_N_PHASES ];
+  double vn;
+  double torque = 0;
+  double i_sum = 0;
+  double x = dt * Tau_inv;
+  double x2 = x * x / 12.0;
+  double decay = (1.0 - x / 2.0 + x2) / (1.0 + x / 2.0 + x2);
+  double accel;
+  int n_driven;
+  int ph;
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    shape[ ph ] = bemf_shape( State.theta_e - 120.0 * ph );
+    State.e_ph[ ph ] = Ke_phase * State.omega * shape[ ph ];
+
+    v_term[ ph ] = (PLANT_PWM == drive[ ph ]) ? (duty[ ph ] * Param.vbatt) : 0;
+  }
+
+  n_driven = neutral_voltage(drive, v_term, &vn);
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    if ( (n_driven > 1) && (PLANT_FLOAT != drive[ ph ]) )
+    {
+      double i_ss = (v_term[ ph ] - State.e_ph[ ph ] - vn) * R_inv;
+
+      State.i_ph[ ph ] = i_ss + (State.i_ph[ ph ] - i_ss) * decay;
+      i_sum += State.i_ph[ ph ];
+    }
+    else
+    {
+      State.i_ph[ ph ] = 0;
+    }
+  }
+
+  // current of a phase just switched to floating is redistributed
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    if ( (n_driven > 1) && (PLANT_FLOAT != drive[ ph ]) )
+    {
+      State.i_ph[ ph ] -= i_sum / n_driven;
+    }
+    torque += Ke_phase * shape[ ph ] * State.i_ph[ ph ];
+  }
+  State.torque = torque;
+
+  accel = ( torque -
+            Param.k_load * State.omega * fabs(State.omega) -
+            Param.b_fric * State.omega ) * J_inv;
+
+  State.omega += accel * dt;
+  State.theta_e += State.omega * dt * Deg_per_rad_e;
+
+  while (State.theta_e >= 360.0)
+  {
+    State.theta_e -= 360.0;
+  }
+  while (State.theta_e < 0)
+  {
+    State.theta_e += 360.0;
+  }
+}
+
+/**
+ * @brief ADC scan of the phase terminals during the PWM on-time
+ * @param drive  Drive state of each phase
+ * @param [out] adc  ADC counts (10-bit) of each phase
+ */
+void Plant_get_adc(
+  const Plant_drive_t drive[ PLANT_N_PHASES ], uint16_t adc[ PLANT_N_PHASES ] )
+{
+  double v_term[ PLANT_N_PHASES ];
+  double vn;
+  int ph;
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    v_term[ ph ] = (PLANT_PWM == drive[ ph ]) ? Param.vbatt : 0;
+  }
+
+  // with no driven phases the terminal is held to ground by the divider
+  (void)neutral_voltage(drive, v_term, &vn);
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    double v = v_term[ ph ];
+    double counts;
+
+    if (PLANT_FLOAT == drive[ ph ])
+    {
+      v = vn + State.e_ph[ ph ];
+    }
+
+    if (v > (Param.vbatt + V_DIODE))
+    {
+      v = Param.vbatt + V_DIODE;
+    }
+    else if (v < -V_DIODE)
+    {
+      v = -V_DIODE;
+    }
+
+    counts = v * ADC_SCALE + adc_noise();
+
+    if (counts < 0)
+    {
+      counts = 0;
+    }
+    else if (counts > (PLANT_ADC_FS - 1))
+    {
+      counts = PLANT_ADC_FS - 1;
+    }
+    adc[ ph ] = (uint16_t)counts;
+  }
+}
+
+/**
+ * @brief Accessor for the plant state
+ */
+const Plant_state_t * Plant_get_state(void)
+{
+  return &State;
+}
+
+/**
+ * @brief Accessor for the mechanical speed
+ * @return RPM
+ */
+double Plant_get_rpm(void)
+{
+  return State.omega * 60.0 / ( 2.0 * PI_D );
+}
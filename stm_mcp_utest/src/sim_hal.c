@@ -0,0 +1,347 @@
+/**
+  ******************************************************************************
+  * @file    sim_hal.c
+  * @brief   Simulated PWM/ADC driver layer linked with the firmware modules.
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date MAR-2022
+  ******************************************************************************
+  *
+  * Replaces pwm_stm8s.c, eeprom_stm8s.c, the ADC accessors of driver.c and
+  * the CPU load of sched.c in the host build.
+  * The phase outputs set by the sequencer (timer channel enable + compare,
+  * and the /SD GPIO) are read back as the drive state of the plant.
+  *
+  ******************************************************************************
+  */
+#include <stdio.h>
+#include <string.h>
+
+#include "pwm_stm8s.h"
+#include "driver.h"
+#include "eeprom_stm8s.h"
+#include "sched.h"
+#include "sim_hal.h"
+
+/*
+ * variables
+ */
+// GPIO "registers" of the /SD outputs
+GPIO_TypeDef Sim_GPIOA, Sim_GPIOB, Sim_GPIOC, Sim_GPIOD, Sim_GPIOE;
+
+static uint16_t Global_uDC;
+static uint16_t Pulse_limit = PWM_PERIOD_COUNTS;
+static int Pwm_phase = -1; // phase of the latest PWM enable
+static uint16_t Chan_compare[ PLANT_N_PHASES ];
+static bool Chan_enabled[ PLANT_N_PHASES ];
+static uint16_t Adc_buffer[ PLANT_N_PHASES ];
+static uint8_t Eeprom[ EEPROM_SIZE ];
+static bool Comm_delay_set; // commutation rescheduled at the zero-crossing
+static uint16_t Comm_delay;
+
+/*
+ * simulation interface
+ */
+
+/**
+ * @brief Reset the outputs and ADC samples
+ */
+void Sim_hal_reset(void)
+{
+  int ph;
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    Chan_compare[ ph ] = 0;
+    Chan_enabled[ ph ] = FALSE;
+    Adc_buffer[ ph ] = 0;
+  }
+  Global_uDC = 0;
+  Pulse_limit = PWM_PERIOD_COUNTS;
+  Pwm_phase = -1;
+  Comm_delay_set = FALSE;
+  All_phase_stop();
+}
+
+/**
+ * @brief Drive state of the phases from the sequencer outputs
+ * @param [out] drive  Drive state of each phase
+ * @param [out] duty   PWM duty-cycle (0:1.0) of each phase
+ */
+void Sim_get_drive(
+  Plant_drive_t drive[ PLANT_N_PHASES ], double duty[ PLANT_N_PHASES ] )
+{
+  bool sd_enabled[ PLANT_N_PHASES ];
+  int ph;
+
+  sd_enabled[ 0 ] = (0 != (SDa_SD_PORT->ODR & SDa_SD_PIN));
+  sd_enabled[ 1 ] = (0 != (SDb_SD_PORT->ODR & SDb_SD_PIN));
+  sd_enabled[ 2 ] = (0 != (SDc_SD_PORT->ODR & SDc_SD_PIN));
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    duty[ ph ] = 0;
+
+    if (FALSE == sd_enabled[ ph ])
+    {
+      drive[ ph ] = PLANT_FLOAT;
+    }
+    else if (FALSE == Chan_enabled[ ph ])
+    {
+      drive[ ph ] = PLANT_LS;
+    }
+    else
+    {
+      drive[ ph ] = PLANT_PWM;
+      duty[ ph ] = (double)Chan_compare[ ph ] / PWM_PERIOD_COUNTS;
+    }
+  }
+}
+
+/**
+ * @brief Sector driven by the sequencer, from the PWM and low-side phases
+ * @details The alignment drive (PWM_align_drive) has the low-side of both of
+ *   the other phases on, it is sector 0 i.e. the first low-side.
+ * @return  Sector, -1 if not a sector of the 6-step sequence
+ */
+int Sim_sector_of_drive(const Plant_drive_t drive[ PLANT_N_PHASES ])
+{
+  // [pwm phase][ls phase]
+  static const int Sector_tbl[ PLANT_N_PHASES ][ PLANT_N_PHASES ] =
+  {
+    { -1,  0,  1 },
+    {  3, -1,  2 },
+    {  4,  5, -1 }
+  };
+  int pwm = -1;
+  int ls = -1;
+  int ph;
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    if (PLANT_PWM == drive[ ph ])
+    {
+      pwm = ph;
+    }
+    else if ( (PLANT_LS == drive[ ph ]) && (ls < 0) )
+    {
+      ls = ph;
+    }
+  }
+  if ( (pwm < 0) || (ls < 0) )
+  {
+    return -1;
+  }
+  return Sector_tbl[ pwm ][ ls ];
+}
+
+/**
+ * @brief Store an ADC conversion of a phase to the scan buffer
+ */
+void Sim_set_adc(uint8_t phase, uint16_t counts)
+{
+  Adc_buffer[ phase ] = counts;
+}
+
+/**
+ * @brief Commutation timer delay set by the sequencer (Driver_set_comm_delay)
+ * @details  The delay is cleared by the read, the timeline restarts the count
+ *   of the commutation timer as by MCU_set_comm_delay().
+ * @param [out] p_delay  Timer counts from the ADC sample to the update event
+ * @return TRUE if the delay was set since the previous read
+ */
+bool Sim_get_comm_delay(uint16_t *p_delay)
+{
+  bool set = Comm_delay_set;
+
+  *p_delay = Comm_delay;
+  Comm_delay_set = FALSE;
+
+  return set;
+}
+
+/**
+ * @brief Load the data EEPROM from a file
+ * @details  The EEPROM is erased (0xFF) if the file can't be read.
+ * @return 0 if loaded
+ */
+int Sim_eeprom_load(const char *fname)
+{
+  FILE *fp = fopen(fname, "rb");
+  size_t n = 0;
+
+  memset(Eeprom, 0xFF, sizeof(Eeprom));
+
+  if (NULL != fp)
+  {
+    n = fread(Eeprom, 1, sizeof(Eeprom), fp);
+    fclose(fp);
+  }
+  return (sizeof(Eeprom) == n) ? 0 : -1;
+}
+
+/**
+ * @brief Save the data EEPROM to a file
+ * @return 0 if saved
+ */
+int Sim_eeprom_save(const char *fname)
+{
+  FILE *fp = fopen(fname, "wb");
+  size_t n = 0;
+
+  if (NULL != fp)
+  {
+    n = fwrite(Eeprom, 1, sizeof(Eeprom), fp);
+    fclose(fp);
+  }
+  return (sizeof(Eeprom) == n) ? 0 : -1;
+}
+
+/*
+ * substitutes of the firmware PWM, EEPROM and ADC driver functions
+ */
+void All_phase_stop(void)
+{
+  PWM_PhA_Disable();
+  PWM_PhA_HB_DISABLE();
+
+  PWM_PhB_Disable();
+  PWM_PhB_HB_DISABLE();
+
+  PWM_PhC_Disable();
+  PWM_PhC_HB_DISABLE();
+}
+
+// all phases PLANT_LS
+void PWM_brake_short(void)
+{
+  PWM_PhA_Disable();
+  PWM_PhA_HB_ENABLE();
+
+  PWM_PhB_Disable();
+  PWM_PhB_HB_ENABLE();
+
+  PWM_PhC_Disable();
+  PWM_PhC_HB_ENABLE();
+}
+
+// phase C PLANT_LS with sector 0
+void PWM_align_drive(void)
+{
+  PWM_PhC_Disable();
+  PWM_PhC_HB_ENABLE();
+}
+
+uint16_t PWM_get_dutycycle(void)
+{
+  return Global_uDC;
+}
+
+void PWM_set_dutycycle(uint16_t global_dutycycle)
+{
+  Global_uDC = global_dutycycle;
+}
+
+// pulse of a phase enable, limited as by pwm_pulse() in pwm_stm8s.c
+static void phase_enable(int ph)
+{
+  Chan_compare[ ph ] = (Global_uDC < Pulse_limit) ? Global_uDC : Pulse_limit;
+  Chan_enabled[ ph ] = TRUE;
+  Pwm_phase = ph;
+}
+
+uint16_t PWM_get_pulse(void)
+{
+  if ( (Pwm_phase < 0) || (FALSE == Chan_enabled[ Pwm_phase ]) )
+  {
+    return 0;
+  }
+  return Chan_compare[ Pwm_phase ];
+}
+
+void PWM_set_pulse_limit(uint16_t limit)
+{
+  Pulse_limit = limit;
+
+  if ( (Pwm_phase >= 0) && (FALSE != Chan_enabled[ Pwm_phase ]) )
+  {
+    Chan_compare[ Pwm_phase ] = (Global_uDC < limit) ? Global_uDC : limit;
+  }
+}
+
+uint16_t PWM_get_pulse_limit(void)
+{
+  return Pulse_limit;
+}
+
+void PWM_PhA_Disable(void)
+{
+  Chan_enabled[ 0 ] = FALSE;
+}
+
+void PWM_PhB_Disable(void)
+{
+  Chan_enabled[ 1 ] = FALSE;
+}
+
+void PWM_PhC_Disable(void)
+{
+  Chan_enabled[ 2 ] = FALSE;
+}
+
+void PWM_PhA_Enable(void)
+{
+  phase_enable(0);
+}
+
+void PWM_PhB_Enable(void)
+{
+  phase_enable(1);
+}
+
+void PWM_PhC_Enable(void)
+{
+  phase_enable(2);
+}
+
+void EEPROM_read(uint16_t offset, uint8_t *buf, uint8_t len)
+{
+  memcpy(buf, &Eeprom[ offset ], len);
+}
+
+// the write completes immediately
+bool EEPROM_write(uint16_t offset, const uint8_t *buf, uint8_t len)
+{
+  if ((offset + len) > EEPROM_SIZE)
+  {
+    return FALSE;
+  }
+  memcpy(&Eeprom[ offset ], buf, len);
+  return TRUE;
+}
+
+bool EEPROM_busy(void)
+{
+  return FALSE;
+}
+
+uint16_t Driver_Get_ADC(void)
+{
+  return Adc_buffer[ 0 ];
+}
+
+uint16_t Driver_Get_ADC_Phase(uint8_t phase)
+{
+  return Adc_buffer[ phase ];
+}
+
+void Driver_set_comm_delay(uint16_t delay)
+{
+  Comm_delay = delay;
+  Comm_delay_set = TRUE;
+}
+
+uint8_t Sched_get_cpu_load(void)
+{
+  return 0; // no background task
+}
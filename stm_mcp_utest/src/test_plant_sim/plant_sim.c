@@ -0,0 +1,779 @@
+/**
+  ******************************************************************************
+  * @file    plant_sim.c
+  * @brief   Closed-loop benchmark of the BLDC controller on the simulated plant
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date MAR-2022
+  ******************************************************************************
+  *
+  * Links the firmware control modules (BLDC_sm.c, sequence.c, faultm.c,
+  * mdata.c, mparam.c, current.c) with the simulated driver layer and motor plant. The
+  * timer and ISR schedule of the firmware is replicated on a timeline in counts
+  * of the PWM and commutation timer clock (fMASTER / 2):
+  *
+  *   PWM timer update (128 us): ADC sample -> Current_sample() and
+  *     Seq_Bemf_Sample(), and the rate groups of the scheduler (sched.h):
+  *     BL_state_control() every SCHED_DIV_CONTROL ISRs, UI speed command every
+  *     SCHED_DIV_UI ISRs
+  *   Commutation timer update (one per sector): BL_commutation_step() followed
+  *     by the (preloaded) reload of the commutation timer period, the count
+  *     restarted by the sequencer at the zero-crossing in closed-loop
+  *
+  * With an EEPROM image file (-e) the open-loop timing table is learned during
+  * the run and saved to the file, to be used by the next run with the file.
+  * With the speed governor (-g 1) the throttle is the target speed in percent
+  * of BL_GOV_RPM_FS.
+  * The motor profile (-m, mparam.h) is selected as by the terminal or PDU,
+  * by default the profile saved in the EEPROM image or the default profile.
+  * The brake mode (-b, BL_brake_mode_t) is exercised by the 'stop' profile, a
+  * step down of the throttle followed by the stop.
+  *
+  * The throttle profile is a list of (time, percent duty-cycle) points with
+  * linear interpolation, either a built-in profile or read from a file.
+  *
+  * With a trace dump file (-d) the event trace (trace.h) is written at the end
+  * of the run in the format of the terminal dump, for the replay test.
+  * With a scope file (-o) the back-EMF scope (scope.h) is armed to trigger at
+  * the entry to closed-loop, and the capture is written at the end of the run.
+  *
+  * The exit status is 0 (pass) if closed-loop is reached without a fault and
+  * the sectors out of sync are at most SYNC_LOSS_MAX_PCT (or -s) percent of
+  * the closed-loop sectors, otherwise 1.
+  *
+  ******************************************************************************
+  */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bldc_sm.h"
+#include "current.h"
+#include "faultm.h"
+#include "sequence.h"
+#include "mdata.h"
+#include "mparam.h"
+#include "pwm_stm8s.h"
+#include "sched.h"
+#include "trace.h"
+#include "scope.h"
+#include "plant.h"
+#include "sim_hal.h"
+
+/*
+ * defines
+ */
+#define TIMER_HZ          8000000.0 // fMASTER / 2
+
+// PWM period on the timeline of the commutation timer clock
+#define PWM_PERIOD_TICKS  ( PWM_PERIOD_FMASTER / 2 )
+
+// commutation more than 1/2 sector from ideal is counted as loss of sync
+#define SYNC_LOSS_DEG     30.0
+
+// pass limit of the sectors out of sync, percent of the closed-loop sectors (-s)
+#define SYNC_LOSS_MAX_PCT 1.0
+
+#define MAX_PROFILE_PTS   64
+
+/*
+ * types
+ */
+typedef struct
+{
+  double t_ms;
+  double pcnt;
+}
+profile_pt_t;
+
+typedef struct
+{
+  const char *name;
+  const profile_pt_t *pts;
+  int n_pts;
+}
+profile_t;
+
+typedef struct
+{
+  uint32_t n;
+  double sum;
+  double sumsq;
+  double min;
+  double max;
+}
+stats_t;
+
+/*
+ * built-in throttle profiles (arming takes ~2 seconds from power-on)
+ */
+static const profile_pt_t Prof_startup[] =
+{
+  {     0,  0 }, {  2500,  0 },
+  {  2500, 15 }, {  6000, 15 },
+  {  9000, 30 }, { 12000, 30 }
+};
+
+static const profile_pt_t Prof_steps[] =
+{
+  {     0,  0 }, {  2500,  0 },
+  {  2500, 15 }, {  6000, 15 },
+  {  6000, 25 }, {  9000, 25 },
+  {  9000, 40 }, { 12000, 40 },
+  { 12000, 20 }, { 15000, 20 }
+};
+
+static const profile_pt_t Prof_stop[] =
+{
+  {     0,  0 }, {  2500,  0 },
+  {  2500, 15 }, {  6000, 15 },
+  {  6000, 40 }, {  9000, 40 },
+  {  9000, 15 }, { 10500, 15 },
+  { 10500,  0 }, { 12000,  0 }
+};
+
+#define N_PTS( _a_ )  ( (int)( sizeof(_a_) / sizeof(profile_pt_t) ) )
+
+static const profile_t Profiles[] =
+{
+  { "startup", Prof_startup, N_PTS(Prof_startup) },
+  { "steps",   Prof_steps,   N_PTS(Prof_steps) },
+  { "stop",    Prof_stop,    N_PTS(Prof_stop) }
+};
+
+#define N_PROFILES  ( (int)( sizeof(Profiles) / sizeof(profile_t) ) )
+
+/*
+ * default plant: 1100 kV outrunner w/ propeller at 12.5 V
+ */
+static Plant_param_t Plant_param =
+{
+  1100.0,   // kv
+  6.0,      // pole_pairs
+  0.2,      // r_phase
+  30.0e-6,  // l_phase
+  5.0e-6,   // inertia
+  1.5e-7,   // k_load
+  1.0e-6,   // b_fric
+  12.5,     // vbatt
+  2.0       // adc_noise
+};
+
+/*
+ * variables
+ */
+static profile_pt_t File_pts[ MAX_PROFILE_PTS ];
+
+static uint32_t Control_ticks;
+static double T_align_ms = -1;
+static double T_ramp_end_ms = -1;
+static double T_clsloop_ms = -1;
+static double T_fault_ms = -1;
+static double Max_rpm;
+
+static uint32_t Cl_sectors;
+static uint32_t Sync_lost_sectors;
+static uint32_t Sync_loss_events;
+static bool Sync_lost;
+
+static stats_t Angle_err;  // commutation angle error in closed-loop, degrees
+static stats_t Timing_err; // controller timing error in closed-loop, counts
+
+/*
+ * functions
+ */
+static void stats_add(stats_t *ps, double x)
+{
+  if (0 == ps->n)
+  {
+    ps->min = x;
+    ps->max = x;
+  }
+  else if (x < ps->min)
+  {
+    ps->min = x;
+  }
+  else if (x > ps->max)
+  {
+    ps->max = x;
+  }
+  ps->n += 1;
+  ps->sum += x;
+  ps->sumsq += x * x;
+}
+
+static void stats_print(const char *label, const stats_t *ps)
+{
+  if (ps->n > 0)
+  {
+    double mean = ps->sum / ps->n;
+    double var = ps->sumsq / ps->n - mean * mean;
+
+    printf("  %-26s mean %8.2f  sd %8.2f  min %8.2f  max %8.2f\n",
+           label, mean, sqrt( (var > 0) ? var : 0 ), ps->min, ps->max);
+  }
+  else
+  {
+    printf("  %-26s (no samples)\n", label);
+  }
+}
+
+/*
+ * Throttle (percent) at time t by interpolation of the profile points
+ */
+static double throttle_at(const profile_t *pp, double t_ms)
+{
+  int n;
+
+  for (n = 1; n < pp->n_pts; n++)
+  {
+    const profile_pt_t *p0 = &pp->pts[ n - 1 ];
+    const profile_pt_t *p1 = &pp->pts[ n ];
+
+    if (t_ms < p1->t_ms)
+    {
+      if (p1->t_ms > p0->t_ms)
+      {
+        return p0->pcnt +
+               (p1->pcnt - p0->pcnt) * (t_ms - p0->t_ms) / (p1->t_ms - p0->t_ms);
+      }
+      return p0->pcnt;
+    }
+  }
+  return pp->pts[ pp->n_pts - 1 ].pcnt;
+}
+
+/*
+ * Read profile points "t_ms pcnt" one per line, '#' starts a comment line
+ */
+static int profile_load(const char *fname, profile_t *pp)
+{
+  char line[ 128 ];
+  int n = 0;
+  FILE *fp = fopen(fname, "r");
+
+  if (NULL == fp)
+  {
+    return -1;
+  }
+  while ( (n < MAX_PROFILE_PTS) && (NULL != fgets(line, sizeof(line), fp)) )
+  {
+    if ( ('#' != line[0]) &&
+         (2 == sscanf(line, "%lf %lf", &File_pts[ n ].t_ms, &File_pts[ n ].pcnt)) )
+    {
+      n += 1;
+    }
+  }
+  fclose(fp);
+
+  pp->name = fname;
+  pp->pts = File_pts;
+  pp->n_pts = n;
+
+  return (n > 1) ? 0 : -1;
+}
+
+/*
+ * Commutation angle error: sector N is ideally entered at rotor electrical
+ * angle 30 + N * 60 degrees (floating phase back-EMF crossing at mid-sector).
+ */
+static void commutation_metrics(void)
+{
+  Plant_drive_t drive[ PLANT_N_PHASES ];
+  double duty[ PLANT_N_PHASES ];
+  double err;
+  int sector;
+
+  if (BL_CLS_LOOP != BL_get_opstate())
+  {
+    return;
+  }
+
+  Sim_get_drive(drive, duty);
+  sector = Sim_sector_of_drive(drive);
+
+  if (sector < 0)
+  {
+    return;
+  }
+
+  err = Plant_get_state()->theta_e - (30.0 + 60.0 * sector);
+
+  while (err > 180.0)
+  {
+    err -= 360.0;
+  }
+  while (err < -180.0)
+  {
+    err += 360.0;
+  }
+
+  Cl_sectors += 1;
+  stats_add(&Angle_err, err);
+  stats_add(&Timing_err, Seq_get_timing_error());
+
+  if (fabs(err) > SYNC_LOSS_DEG)
+  {
+    Sync_lost_sectors += 1;
+    if (FALSE == Sync_lost)
+    {
+      Sync_loss_events += 1;
+    }
+    Sync_lost = TRUE;
+  }
+  else
+  {
+    Sync_lost = FALSE;
+  }
+}
+
+/*
+ * The shunt carries the current of the PWM'd phase during the on-time.
+ */
+static uint16_t shunt_adc(void)
+{
+  Plant_drive_t drive[ PLANT_N_PHASES ];
+  double duty[ PLANT_N_PHASES ];
+  double counts = 0;
+  int ph;
+
+  Sim_get_drive(drive, duty);
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    if (PLANT_PWM == drive[ ph ])
+    {
+      counts = Plant_get_state()->i_ph[ ph ] * 1000.0 / CURRENT_MA_PER_COUNT;
+    }
+  }
+  if (counts < 0)
+  {
+    counts = 0;
+  }
+  return (counts < 1023.0) ? (uint16_t)counts : 1023u;
+}
+
+static void control_metrics(double t_ms, FILE *ftrace, double throttle)
+{
+  uint8_t opstate = BL_get_opstate();
+  double rpm = Plant_get_rpm();
+
+  if ( (T_align_ms < 0) && (BL_ALIGN == opstate) )
+  {
+    T_align_ms = t_ms;
+  }
+  // the ramp ends in open-loop or, at higher PWM rates, directly in closed-loop
+  if ( (T_ramp_end_ms < 0) && (T_align_ms >= 0) &&
+       (BL_ALIGN != opstate) && (BL_RAMPUP != opstate) )
+  {
+    T_ramp_end_ms = t_ms;
+  }
+  if ( (T_clsloop_ms < 0) && (BL_CLS_LOOP == opstate) )
+  {
+    T_clsloop_ms = t_ms;
+  }
+  if ( (T_fault_ms < 0) && (0 != Faultm_get_status()) )
+  {
+    T_fault_ms = t_ms;
+  }
+  if (rpm > Max_rpm)
+  {
+    Max_rpm = rpm;
+  }
+
+  if (NULL != ftrace)
+  {
+    fprintf(ftrace, "%.3f,%u,%.1f,%u,%u,%.0f,%d,%.1f\n",
+            t_ms, opstate, throttle, PWM_get_dutycycle(), BL_get_timing(),
+            rpm, Seq_get_timing_error(), Plant_get_state()->theta_e);
+  }
+}
+
+/*
+ * Write the event trace, frozen by the first fault or else at the end of the
+ * run, in the format of the terminal dump (see trace_dump() in per_task.c)
+ */
+static void trace_dump(const char *fname)
+{
+  FILE *fp = fopen(fname, "w");
+  trace_event_t event;
+  uint16_t n;
+
+  if (NULL == fp)
+  {
+    printf("can't write %s\n", fname);
+    return;
+  }
+
+  Trace_freeze(TRACE_FREEZE_DUMP);
+
+  fprintf(fp, "Trace (%u): tag tick val\n", TRACE_N_EVENTS);
+
+  for (n = 0; FALSE != Trace_get(n, &event); n++)
+  {
+    if (TRACE_EV_NONE != TRACE_TAG_TYPE(event.tag))
+    {
+      fprintf(fp, "%c %02X %02X %04X\n",
+              TRACE_DUMP_KEY, event.tag, event.tick, event.val);
+    }
+  }
+  fclose(fp);
+}
+
+/*
+ * Write the back-EMF capture in the format of the terminal stream (see
+ * scope_stream() in per_task.c)
+ */
+static void scope_write(const char *fname)
+{
+  FILE *fp;
+  scope_sample_t smp;
+  uint8_t n;
+
+  if (FALSE == Scope_is_done())
+  {
+    printf("scope not triggered\n");
+    return;
+  }
+  fp = fopen(fname, "w");
+
+  if (NULL == fp)
+  {
+    printf("can't write %s\n", fname);
+    return;
+  }
+
+  fprintf(fp, "Scope (%u, trigger at %u): A B C sector\n",
+          SCOPE_N_SAMPLES, Scope_get_trigger_index());
+
+  for (n = 0; FALSE != Scope_get(n, &smp); n++)
+  {
+    fprintf(fp, "%c %03X %03X %03X %X\n", SCOPE_DUMP_KEY,
+            SCOPE_SAMPLE_ADC(smp, 0), SCOPE_SAMPLE_ADC(smp, 1),
+            SCOPE_SAMPLE_ADC(smp, 2), SCOPE_SAMPLE_SECTOR(smp));
+  }
+  fclose(fp);
+}
+
+static void usage(const char *prog)
+{
+  printf("usage: %s [-p startup|steps|stop] [-f profile.txt] [-t trace.csv]\n"
+         "          [-v vbatt] [-k kv] [-r r_phase] [-j inertia] [-l k_load]\n"
+         "          [-n adc_noise] [-e eeprom.bin] [-g 0|1] [-b 0|1|2]\n"
+         "          [-d dump.txt] [-o scope.txt] [-m motor_profile]\n"
+         "          [-s sync_loss_max_pct]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+  profile_t profile = Profiles[ 0 ];
+  FILE *ftrace = NULL;
+  const char *feeprom = NULL;
+  const char *fdump = NULL;
+  const char *fscope = NULL;
+  int mprofile = -1;
+  double sync_loss_max = SYNC_LOSS_MAX_PCT;
+  double sync_loss_pct;
+  bool pass;
+  uint64_t t = 0;
+  uint64_t t_end;
+  uint64_t next_pwm = PWM_PERIOD_TICKS;
+  uint64_t next_comm;
+  uint16_t comm_arr = U16_MAX;
+  uint16_t comm_arr_preload = U16_MAX;
+  uint16_t comm_delay;
+  // phase of the rate groups as in the scheduler (sched.c)
+  uint16_t ctrl_count = SCHED_DIV_CONTROL - PWM_FRAME_COUNT;
+  uint16_t ui_count = 0;
+  double throttle = 0;
+  clock_t wall;
+  int n;
+
+  for (n = 1; n < argc; n++)
+  {
+    const char *arg = (n + 1 < argc) ? argv[ n + 1 ] : NULL;
+
+    if ( (0 == strcmp(argv[ n ], "-h")) || (NULL == arg) )
+    {
+      usage(argv[0]);
+      return 2;
+    }
+    if (0 == strcmp(argv[ n ], "-p"))
+    {
+      int k;
+      for (k = 0; k < N_PROFILES; k++)
+      {
+        if (0 == strcmp(arg, Profiles[ k ].name))
+        {
+          profile = Profiles[ k ];
+        }
+      }
+    }
+    else if (0 == strcmp(argv[ n ], "-f"))
+    {
+      if (0 != profile_load(arg, &profile))
+      {
+        printf("can't read profile %s\n", arg);
+        return 2;
+      }
+    }
+    else if (0 == strcmp(argv[ n ], "-v"))
+    {
+      Plant_param.vbatt = atof(arg);
+    }
+    else if (0 == strcmp(argv[ n ], "-k"))
+    {
+      Plant_param.kv = atof(arg);
+    }
+    else if (0 == strcmp(argv[ n ], "-r"))
+    {
+      Plant_param.r_phase = atof(arg);
+    }
+    else if (0 == strcmp(argv[ n ], "-j"))
+    {
+      Plant_param.inertia = atof(arg);
+    }
+    else if (0 == strcmp(argv[ n ], "-l"))
+    {
+      Plant_param.k_load = atof(arg);
+    }
+    else if (0 == strcmp(argv[ n ], "-n"))
+    {
+      Plant_param.adc_noise = atof(arg);
+    }
+    else if (0 == strcmp(argv[ n ], "-g"))
+    {
+      BL_set_governor( (0 != atoi(arg)) ? TRUE : FALSE );
+    }
+    else if (0 == strcmp(argv[ n ], "-b"))
+    {
+      BL_brake_t brake;
+
+      BL_get_brake(&brake);
+      brake.mode = (uint8_t)atoi(arg);
+      BL_set_brake(&brake);
+    }
+    else if (0 == strcmp(argv[ n ], "-e"))
+    {
+      feeprom = arg;
+    }
+    else if (0 == strcmp(argv[ n ], "-m"))
+    {
+      mprofile = atoi(arg);
+    }
+    else if (0 == strcmp(argv[ n ], "-d"))
+    {
+      fdump = arg;
+    }
+    else if (0 == strcmp(argv[ n ], "-o"))
+    {
+      fscope = arg;
+    }
+    else if (0 == strcmp(argv[ n ], "-s"))
+    {
+      sync_loss_max = atof(arg);
+    }
+    else if (0 == strcmp(argv[ n ], "-t"))
+    {
+      ftrace = fopen(arg, "w");
+      if (NULL != ftrace)
+      {
+        fprintf(ftrace, "t_ms,opstate,throttle,duty,comm_period,rpm,timing_error,theta_e\n");
+      }
+    }
+    n += 1;
+  }
+
+  t_end = (uint64_t)( profile.pts[ profile.n_pts - 1 ].t_ms * TIMER_HZ / 1000.0 );
+  next_comm = (uint64_t)comm_arr + 1;
+
+  Plant_init(&Plant_param);
+  Sim_hal_reset();
+
+  if (NULL != feeprom)
+  {
+    (void)Sim_eeprom_load(feeprom);
+  }
+  Mparam_init();
+
+  if (NULL != feeprom)
+  {
+    printf("EEPROM %s: %s open-loop timing table\n", feeprom,
+           (FALSE != Mdata_load()) ? "learned" : "no learned");
+    Mdata_set_learn(TRUE);
+  }
+
+  // power-on initialization (see UI_Stop())
+  BL_reset();
+  BL_set_opstate( BL_ARMING );
+
+  if ( (mprofile >= 0) && (FALSE == Mparam_select((uint8_t)mprofile)) )
+  {
+    printf("invalid motor profile %d\n", mprofile);
+    return 2;
+  }
+  printf("Motor profile %u: %s\n", Mparam_get_index(), Mparam_get()->name);
+
+  if (NULL != fscope)
+  {
+    scope_cfg_t cfg;
+
+    Scope_get_cfg(&cfg);
+    cfg.trig = SCOPE_TRIG_CLS_LOOP;
+    Scope_arm(&cfg);
+  }
+
+  wall = clock();
+
+  while (t < t_end)
+  {
+    Plant_drive_t drive[ PLANT_N_PHASES ];
+    double duty[ PLANT_N_PHASES ];
+    uint16_t adc[ PLANT_N_PHASES ];
+    uint64_t t_next = (next_pwm < next_comm) ? next_pwm : next_comm;
+
+    Sim_get_drive(drive, duty);
+    Plant_step( (double)(t_next - t) / TIMER_HZ, drive, duty );
+    t = t_next;
+
+    if (t == next_comm)
+    {
+      // auto-reload preload takes effect at the update event
+      comm_arr = comm_arr_preload;
+      next_comm = t + comm_arr + 1;
+
+      BL_commutation_step();
+      comm_arr_preload = BL_get_timing();
+      TRACE_EVENT( TRACE_EV_PERIOD, 0, comm_arr_preload ); // see Driver_Step()
+      commutation_metrics();
+    }
+
+    if (t == next_pwm)
+    {
+      next_pwm = t + PWM_PERIOD_TICKS;
+
+      ctrl_count += 1;
+      ui_count += 1;
+
+      if (ctrl_count >= SCHED_DIV_CONTROL)
+      {
+        ctrl_count = 0;
+
+        Trace_task_event( TRACE_EV_CTRL, BL_get_opstate(), BL_get_speed() );
+        BL_state_control();
+        Control_ticks += 1;
+        control_metrics(t * 1000.0 / TIMER_HZ, ftrace, throttle);
+      }
+      else if (ui_count >= SCHED_DIV_UI)
+      {
+        ui_count = 0;
+
+        throttle = throttle_at(&profile, t * 1000.0 / TIMER_HZ);
+        BL_set_speed( PWM_GET_PULSE_COUNTS( throttle ) );
+      }
+
+      // ADC scan of the phase inputs during PWM on-time
+      Sim_get_drive(drive, duty);
+      Plant_get_adc(drive, adc);
+      for (n = 0; n < PLANT_N_PHASES; n++)
+      {
+        Sim_set_adc(n, adc[ n ]);
+      }
+      Current_sample( shunt_adc() );
+      Seq_Bemf_Sample();
+
+      // the count is restarted at the zero-crossing (see MCU_set_comm_delay())
+      if (FALSE != Sim_get_comm_delay(&comm_delay))
+      {
+        comm_arr = comm_delay;
+        next_comm = t + comm_arr + 1;
+      }
+    }
+  }
+
+  wall = clock() - wall;
+
+  if (NULL != ftrace)
+  {
+    fclose(ftrace);
+  }
+
+  if (NULL != fdump)
+  {
+    trace_dump(fdump);
+  }
+
+  if (NULL != fscope)
+  {
+    scope_write(fscope);
+  }
+
+  if (NULL != feeprom)
+  {
+    Mdata_set_learn(FALSE); // saves the learned table
+    if (0 != Sim_eeprom_save(feeprom))
+    {
+      printf("can't write %s\n", feeprom);
+    }
+  }
+
+  printf("Plant simulation: profile '%s', %.1f V, %.0f kV, PWM %.1f kHz\n",
+         profile.name, Plant_param.vbatt, Plant_param.kv,
+         TIMER_HZ / PWM_PERIOD_TICKS / 1000.0);
+  printf("  simulated time             %.3f s (%u control ticks, %.2f M ticks/s)\n",
+         t / TIMER_HZ, Control_ticks,
+         (wall > 0) ? (Control_ticks / ((double)wall / CLOCKS_PER_SEC) / 1.0e6) : 0);
+
+  if (T_clsloop_ms >= 0)
+  {
+    double t_ramp_ms = T_ramp_end_ms - T_align_ms;
+    double t_sync_ms = T_clsloop_ms - T_ramp_end_ms;
+
+    assert( (t_ramp_ms >= 0) && (t_sync_ms >= 0) );
+
+    printf("  time to closed-loop        %.1f ms (ramp %.1f ms, sync wait %.1f ms)\n",
+           T_clsloop_ms - T_align_ms, t_ramp_ms, t_sync_ms);
+    printf("  firmware time to CL        %u control frames\n",
+           BL_get_startup_time());
+  }
+  else
+  {
+    printf("  time to closed-loop        not reached\n");
+  }
+  if (T_fault_ms >= 0)
+  {
+    faultm_event_t event;
+    uint8_t n;
+
+    printf("  fault                      0x%02X at %.1f ms\n",
+           Faultm_get_status(), T_fault_ms);
+
+    for (n = 0; FALSE != Faultm_log_get(n, &event); n++)
+    {
+      printf("  fault log %u                ID %u %s tick %u, state %u duty %u period %u\n",
+             n, event.event & FAULTM_EV_ID,
+             (0 != (event.event & FAULTM_EV_CLR)) ? "clr" : "set",
+             event.tick, event.opstate, event.duty, event.period);
+    }
+  }
+  sync_loss_pct = (Cl_sectors > 0) ? (100.0 * Sync_lost_sectors / Cl_sectors) : 0;
+
+  printf("  closed-loop sectors        %u\n", Cl_sectors);
+  printf("  sync-loss                  %u events, %u sectors (%.3f %%)\n",
+         Sync_loss_events, Sync_lost_sectors, sync_loss_pct);
+  stats_print("commutation angle (deg)", &Angle_err);
+  stats_print("timing error (counts)", &Timing_err);
+  printf("  current limited            %u PWM cycles\n", Current_get_limit_cycles());
+  printf("  speed final/max            %.0f / %.0f RPM\n", Plant_get_rpm(), Max_rpm);
+
+  pass = (bool)( (T_clsloop_ms >= 0) && (T_fault_ms < 0) &&
+                 (sync_loss_pct <= sync_loss_max) );
+
+  printf("  result                     %s (sync-loss limit %.3f %%)\n",
+         (FALSE != pass) ? "pass" : "FAIL", sync_loss_max);
+
+  return (FALSE != pass) ? 0 : 1;
+}
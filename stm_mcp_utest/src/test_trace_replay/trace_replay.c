@@ -0,0 +1,441 @@
+/**
+  ******************************************************************************
+  * @file    trace_replay.c
+  * @brief   Replay of a dump of the event trace through the firmware modules
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * Feeds the events of a trace dump (trace.h, the "T tag tick val" lines of
+  * the terminal dump or of the plant simulation, other lines are ignored) to
+  * the firmware control modules linked with the simulated driver layer:
+  *
+  *   ADC: the sample is stored to the ADC buffer of the phase, and the samples
+  *     of a PWM cycle are processed by Seq_Bemf_Sample()
+  *   COMM: BL_commutation_step(), with the system voltage of the following
+  *     SECTOR event in the ADC buffer of each phase (filtered by the sequencer
+  *     from the PWM driven phase)
+  *   CTRL: the recorded speed command and BL_state_control()
+  *   VBATT: the supply voltage filter is loaded (the samples of the PWM driven
+  *     phase are not traced, in the replay they are at the supply voltage so
+  *     that the filter holds)
+  *   PI: the closed-loop integrator is loaded, once per electrical cycle
+  *   FREEZE: end of the trace
+  *
+  * The decisions of the replay are compared with the recorded events, the
+  * opstate and speed against COMM, the sector and system voltage against
+  * SECTOR, the commutation period against PERIOD and the integrator against
+  * PI. The trace is a ring buffer so the replay starts from an unknown state:
+  * the recorded state is forced during the sync-in i.e. the sync-in sectors
+  * (-s) and in closed-loop until the first PI event, and at each mismatch,
+  * which is counted after the sync-in. The state not in the events of the
+  * trace is restored from the VBATT and PI events, so the replay is exact
+  * from the end of the sync-in. The motor profile is the default (mparam.h).
+  *
+  * The exit status is 0 (pass) if there is no mismatch, otherwise 1.
+  *
+  * A longer trace can be recorded by the plant simulation built with e.g.
+  * 'make TRACE_N_EVENTS=2048u'.
+  *
+  * Usage: trace_replay [-v] [-s sync_sectors] dump.txt
+  *
+  ******************************************************************************
+  */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bldc_sm.h"
+#include "sequence.h"
+#include "trace.h"
+#include "mparam.h"
+#include "sim_hal.h"
+
+/*
+ * defines
+ */
+#define MAX_EVENTS         4096
+
+#define SYNC_SECTORS_DFLT  12 // two cycles, the zero-crossing timing is then valid
+
+/*
+ * types
+ */
+typedef enum
+{
+  MISS_OPSTATE = 0,
+  MISS_SPEED,
+  MISS_SECTOR,
+  MISS_VSYS,
+  MISS_PERIOD,
+  MISS_PI,
+  MISS_N_KINDS
+}
+miss_kind_t;
+
+typedef struct
+{
+  trace_event_t ev;
+  uint32_t tick; // unwrapped time stamp
+}
+replay_event_t;
+
+/*
+ * variables
+ */
+static const char * const Miss_label[ MISS_N_KINDS ] =
+{
+  "opstate", "speed", "sector", "vsys", "period", "pi"
+};
+
+static replay_event_t Events[ MAX_EVENTS ];
+static int N_events;
+
+static uint32_t Miss_count[ MISS_N_KINDS ];
+static int32_t Period_offs_min = INT32_MAX; // replayed - recorded period
+static int32_t Period_offs_max = INT32_MIN;
+static int32_t First_miss_tick = -1;
+static uint32_t N_comm;
+static int Sync_sectors = SYNC_SECTORS_DFLT;
+static int Verbose;
+static uint16_t Pi_integ_lo; // low word of the PI event pair
+static bool Pi_loaded;       // the integrator was loaded from the trace
+
+/*
+ * functions
+ */
+static int load_dump(const char *fname)
+{
+  FILE *fp = fopen(fname, "r");
+  char line[ 128 ];
+  uint32_t tick = 0;
+  int prev = -1;
+
+  if (NULL == fp)
+  {
+    return -1;
+  }
+
+  while ( (N_events < MAX_EVENTS) && (NULL != fgets(line, sizeof(line), fp)) )
+  {
+    unsigned int tag, tck, val;
+
+    if ( (TRACE_DUMP_KEY != line[ 0 ]) ||
+         (3 != sscanf(&line[ 1 ], "%x %x %x", &tag, &tck, &val)) )
+    {
+      continue;
+    }
+    // unwrap the 8-bit time stamp
+    if (prev >= 0)
+    {
+      tick += (uint8_t)(tck - (unsigned int)prev);
+    }
+    prev = (int)tck;
+
+    Events[ N_events ].ev.tag = (uint8_t)tag;
+    Events[ N_events ].ev.tick = (uint8_t)tck;
+    Events[ N_events ].ev.val = (uint16_t)val;
+    Events[ N_events ].tick = tick;
+    N_events += 1;
+  }
+  fclose(fp);
+
+  return 0;
+}
+
+/*
+ * Count a mismatch of the replayed state, unless during the sync-in i.e. the
+ * sync-in sectors and in closed-loop until the integrator is loaded, the
+ * recorded state is then forced
+ */
+static void mismatch(miss_kind_t kind, uint32_t tick,
+                     unsigned int recorded, unsigned int replayed)
+{
+  if ( (N_comm > (uint32_t)Sync_sectors) && (FALSE != Pi_loaded) )
+  {
+    Miss_count[ kind ] += 1;
+
+    if (First_miss_tick < 0)
+    {
+      First_miss_tick = (int32_t)tick;
+    }
+    if (0 != Verbose)
+    {
+      printf("  tick %6u: %-7s recorded %5u replayed %5u\n",
+             tick, Miss_label[ kind ], recorded, replayed);
+    }
+  }
+}
+
+static void replay_comm(int n)
+{
+  const replay_event_t *pe = &Events[ n ];
+  uint8_t opstate = TRACE_TAG_PARAM( pe->ev.tag );
+  int k;
+
+  N_comm += 1;
+
+  // the integrator is preset at the entry to closed-loop (see BL_pi_reset)
+  if (BL_CLS_LOOP != opstate)
+  {
+    Pi_loaded = TRUE;
+  }
+
+  if (BL_get_opstate() != opstate)
+  {
+    mismatch(MISS_OPSTATE, pe->tick, opstate, BL_get_opstate());
+    BL_set_opstate( opstate );
+  }
+  if (BL_get_speed() != pe->ev.val)
+  {
+    mismatch(MISS_SPEED, pe->tick, pe->ev.val, BL_get_speed());
+    BL_set_speed( pe->ev.val );
+  }
+
+  // system voltage of the sector, read by the sequencer from the PWM driven
+  // phase (the ADC events are of the floating phase only)
+  for (k = n + 1; k < N_events; k++)
+  {
+    uint8_t type = TRACE_TAG_TYPE( Events[ k ].ev.tag );
+
+    if (TRACE_EV_SECTOR == type)
+    {
+      int ph;
+
+      for (ph = 0; ph < PLANT_N_PHASES; ph++)
+      {
+        Sim_set_adc(ph, Events[ k ].ev.val);
+      }
+      break;
+    }
+    if (TRACE_EV_COMM == type)
+    {
+      break;
+    }
+  }
+
+  BL_commutation_step();
+
+  if (0 != Verbose)
+  {
+    printf("  tick %6u: comm opstate %u speed %4u sector %u period %5u\n",
+           pe->tick, opstate, pe->ev.val, Seq_get_sector(), BL_get_timing());
+  }
+}
+
+static void replay_sector(const replay_event_t *pe)
+{
+  Plant_drive_t drive[ PLANT_N_PHASES ];
+  double duty[ PLANT_N_PHASES ];
+  uint8_t sector = TRACE_TAG_PARAM( pe->ev.tag );
+  int replayed;
+
+  Sim_get_drive(drive, duty);
+  replayed = Sim_sector_of_drive(drive);
+
+  if ((int)sector != replayed)
+  {
+    mismatch(MISS_SECTOR, pe->tick, sector, (unsigned int)replayed);
+  }
+  if (Seq_Get_Vbatt() != pe->ev.val)
+  {
+    mismatch(MISS_VSYS, pe->tick, pe->ev.val, Seq_Get_Vbatt());
+
+    // the system voltage is loaded by the step to sector 0 (alignment)
+    Sim_set_adc(0, pe->ev.val);
+    Sequence_Step_0();
+    replayed = -1;
+  }
+  if ((int)sector != replayed)
+  {
+    Sequence_Step( sector );
+  }
+}
+
+/*
+ * PI integrator following the step to sector 0, the low word is followed by
+ * the high word. The integrator of the replay is not known until the first
+ * event following the sync-in sectors (the back-EMF measurement of each phase
+ * is then valid), which is then only loaded.
+ */
+static void replay_pi(const replay_event_t *pe)
+{
+  int32_t integ;
+
+  if (0 == TRACE_TAG_PARAM( pe->ev.tag ))
+  {
+    Pi_integ_lo = pe->ev.val;
+    return;
+  }
+  integ = (int32_t)( ((uint32_t)pe->ev.val << 16) | Pi_integ_lo );
+
+  if ( (FALSE != Pi_loaded) && (BL_get_pi_integ() != integ) )
+  {
+    mismatch(MISS_PI, pe->tick, (unsigned int)integ, (unsigned int)BL_get_pi_integ());
+  }
+  BL_set_pi_integ(integ);
+
+  if (N_comm > (uint32_t)Sync_sectors)
+  {
+    Pi_loaded = TRUE;
+  }
+}
+
+/*
+ * Process the samples of a PWM cycle. The phases that were not traced i.e. the
+ * PWM driven phase, are sampled at the supply voltage so that the filter of
+ * the sequencer holds its state, which is loaded from the VBATT events.
+ */
+static void replay_sample(uint8_t phases)
+{
+  int ph;
+
+  for (ph = 0; ph < PLANT_N_PHASES; ph++)
+  {
+    if (0 == (phases & (1u << ph)))
+    {
+      Sim_set_adc(ph, Seq_Get_Vbatt());
+    }
+  }
+  Seq_Bemf_Sample();
+}
+
+int main(int argc, char *argv[])
+{
+  const char *fname = NULL;
+  bool pending = FALSE; // ADC samples of a PWM cycle to be processed
+  uint8_t pending_phases = 0; // phases sampled in the PWM cycle
+  uint32_t pending_tick = 0;
+  uint32_t n_miss = 0;
+  int kind;
+  int n;
+
+  for (n = 1; n < argc; n++)
+  {
+    if (0 == strcmp(argv[ n ], "-v"))
+    {
+      Verbose = 1;
+    }
+    else if ( (0 == strcmp(argv[ n ], "-s")) && (n + 1 < argc) )
+    {
+      n += 1;
+      Sync_sectors = atoi(argv[ n ]);
+    }
+    else
+    {
+      fname = argv[ n ];
+    }
+  }
+
+  if ( (NULL == fname) || (0 != load_dump(fname)) )
+  {
+    printf("usage: %s [-v] [-s sync_sectors] dump.txt\n", argv[0]);
+    return 1;
+  }
+
+  Sim_hal_reset();
+  Mparam_init();
+  BL_reset();
+  BL_set_opstate( BL_ARMING );
+  Trace_freeze(TRACE_FREEZE_DUMP); // the replay is not recorded
+
+  for (n = 0; n < N_events; n++)
+  {
+    const replay_event_t *pe = &Events[ n ];
+    uint8_t type = TRACE_TAG_TYPE( pe->ev.tag );
+
+    if ( (FALSE != pending) &&
+         ((TRACE_EV_ADC != type) || (pe->tick != pending_tick)) )
+    {
+      replay_sample(pending_phases);
+      pending = FALSE;
+      pending_phases = 0;
+    }
+
+    if (TRACE_EV_FREEZE == type)
+    {
+      printf("  tick %6u: freeze, cause 0x%02X\n",
+             pe->tick, TRACE_TAG_PARAM( pe->ev.tag ));
+      break;
+    }
+
+    switch (type)
+    {
+    case TRACE_EV_ADC:
+      Sim_set_adc(TRACE_TAG_PARAM( pe->ev.tag ), pe->ev.val);
+      pending_phases |= (uint8_t)( 1u << TRACE_TAG_PARAM( pe->ev.tag ) );
+      pending = TRUE;
+      pending_tick = pe->tick;
+      break;
+
+    case TRACE_EV_COMM:
+      replay_comm(n);
+      break;
+
+    case TRACE_EV_SECTOR:
+      replay_sector(pe);
+      break;
+
+    case TRACE_EV_PERIOD:
+      if (BL_get_timing() != pe->ev.val)
+      {
+        int32_t offs = (int32_t)BL_get_timing() - (int32_t)pe->ev.val;
+
+        mismatch(MISS_PERIOD, pe->tick, pe->ev.val, BL_get_timing());
+
+        if ( (N_comm > (uint32_t)Sync_sectors) && (FALSE != Pi_loaded) )
+        {
+          Period_offs_min = (offs < Period_offs_min) ? offs : Period_offs_min;
+          Period_offs_max = (offs > Period_offs_max) ? offs : Period_offs_max;
+        }
+        BL_set_timing( pe->ev.val );
+      }
+      break;
+
+    case TRACE_EV_CTRL:
+      BL_set_speed( pe->ev.val );
+      BL_state_control();
+      break;
+
+    case TRACE_EV_VBATT:
+      Seq_set_vbatt_filt( pe->ev.val );
+      break;
+
+    case TRACE_EV_PI:
+      replay_pi(pe);
+      break;
+
+    case TRACE_EV_OPSTATE:
+    default:
+      break;
+    }
+  }
+
+  printf("Trace replay: %s, %d events, %u sectors (%d sync-in)\n",
+         fname, N_events, N_comm, Sync_sectors);
+
+  for (kind = 0; kind < MISS_N_KINDS; kind++)
+  {
+    printf("  %-8s mismatch         %u\n", Miss_label[ kind ], Miss_count[ kind ]);
+    n_miss += Miss_count[ kind ];
+  }
+  if (Miss_count[ MISS_PERIOD ] > 0)
+  {
+    printf("  period offset            min %d max %d\n",
+           Period_offs_min, Period_offs_max);
+  }
+  if (First_miss_tick >= 0)
+  {
+    printf("  first divergence         tick %d\n", First_miss_tick);
+  }
+  else
+  {
+    printf("  first divergence         none\n");
+  }
+
+  printf("  result                     %s\n", (0 == n_miss) ? "pass" : "FAIL");
+
+  return (0 == n_miss) ? 0 : 1;
+}
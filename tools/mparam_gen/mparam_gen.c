@@ -0,0 +1,385 @@
+/**
+  ******************************************************************************
+  * @file mparam_gen.c
+  * @brief Host generator of the built-in motor profiles
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * Reads the motor constants (motors.txt) and writes the initializers of the
+  * built-in motor profiles (inc/mparam_tbl.h), replacing the Scilab script
+  * and the manual copy of its output to inc/model.h. The open-loop timing
+  * curve of each profile is computed at the nodes of the profile, and the
+  * constants are converted to the units of the firmware: PWM duty-cycles in
+  * 1/1024 of the PWM period, commutation periods in counts of the commutation
+  * timer (fMASTER / 2) per sector, times in control frames (~1 ms).
+  *
+  * The curve must decrease with the duty-cycle (reverse lookup of the
+  * resync, Mdata_get_dutycycle()), a profile that does not is rejected.
+  *
+  * Example:
+  *   ./mparam_gen motors.txt > ../../inc/mparam_tbl.h
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * the timing constants and the PWM duty-cycles of the startup are of the
+ * firmware, its headers built for the host (UNIT_TEST, see makefile)
+ */
+#include "system.h"
+#include "bldc_sm.h"
+
+/*
+ * defines, to match inc/mparam.h (checked by the generated header)
+ */
+#define MPARAM_NAME_LEN   8
+#define MPARAM_OL_N_PTS   32
+#define MPARAM_DUTY_FS    1024
+
+#define MAX_PROFILES      16
+
+// commutation timer counts per minute over 6 sectors per electrical cycle
+#define CT_RPM_K          ( 60.0 * 8000000.0 / 6 )
+
+// steps of duty-cycle of the former timing table
+#define FIT_TBL_SIZE      250
+
+typedef enum
+{
+  OL_NONE = 0,
+  OL_FIT,
+  OL_KV
+}
+ol_model_t;
+
+typedef struct
+{
+  char name[ MPARAM_NAME_LEN ];
+  int line; // of the motor key, for the messages
+  double kv;
+  int pole_pairs;
+  double vsys;
+  double align_time;
+  double align_duty;
+  double ramp_duty;
+  double ramp_start; // counts, or RPM if negative
+  double ramp_end;
+  double ct_startup;
+  double ramp_time;
+  double duty_startup;
+  double duty_shutoff;
+  double pi_kp;
+  double pi_ki;
+  double gov_rpm_fs; // 0 is kv * vsys
+  ol_model_t ol_model;
+  double ol[ 6 ];
+}
+motor_t;
+
+static motor_t Motors[ MAX_PROFILES ];
+static int N_motors;
+static const char *Fname;
+
+/*
+ * defaults of the firmware (compile-time tuning of the 1100kv motor)
+ */
+static void motor_defaults(motor_t *pm, const char *name)
+{
+  memset(pm, 0, sizeof(motor_t));
+  strncpy(pm->name, name, MPARAM_NAME_LEN - 1);
+  pm->kv = 1100;
+  pm->pole_pairs = 6;
+  pm->vsys = 12.5;
+  pm->align_time = BL_TIME_ALIGN;
+  pm->align_duty = PWM_PCNT_ALIGN;
+  pm->ramp_duty = PWM_PCNT_RAMPUP;
+  pm->ramp_start = BL_CT_RAMP_START;
+  pm->ramp_end = BL_CT_RAMP_END;
+  pm->ct_startup = BL_CT_STARTUP;
+  pm->ramp_time = BL_TIME_RAMP;
+  pm->duty_startup = PWM_PCNT_STARTUP;
+  pm->duty_shutoff = PWM_PCNT_SHUTOFF;
+  pm->pi_kp = 0.1;
+  pm->pi_ki = 0.016;
+}
+
+static void fail(int line, const char *msg, const char *arg)
+{
+  fprintf(stderr, "%s:%d: %s %s\n", Fname, line, msg, (NULL != arg) ? arg : "");
+  exit(1);
+}
+
+/*
+ * commutation period of a mechanical speed, or the period if not negative
+ */
+static double period_of(const motor_t *pm, double val)
+{
+  if (val < 0)
+  {
+    return CT_RPM_K / (-val * pm->pole_pairs);
+  }
+  return val;
+}
+
+static unsigned duty_q10(double pcnt)
+{
+  // truncated as PWM_GET_PULSE_COUNTS()
+  return (unsigned)( pcnt * MPARAM_DUTY_FS / 100.0 );
+}
+
+static unsigned to_u16(int line, double val)
+{
+  if ( (val < 0) || (val > 65534.0) )
+  {
+    fail(line, "value out of range", NULL);
+  }
+  return (unsigned)( val + 0.5 );
+}
+
+static void parse(FILE *fp)
+{
+  char buf[ 256 ];
+  int line = 0;
+  motor_t *pm = NULL;
+
+  while (NULL != fgets(buf, sizeof(buf), fp))
+  {
+    char *key;
+    char *hash = strchr(buf, '#');
+    double v[ 6 ] = { 0 };
+    int nv;
+
+    line += 1;
+
+    if (NULL != hash)
+    {
+      *hash = '\0';
+    }
+    key = strtok(buf, " \t\r\n");
+
+    if (NULL == key)
+    {
+      continue;
+    }
+
+    if (0 == strcmp(key, "motor"))
+    {
+      char *name = strtok(NULL, " \t\r\n");
+
+      if ( (NULL == name) || (strlen(name) >= MPARAM_NAME_LEN) )
+      {
+        fail(line, "motor name missing or too long", name);
+      }
+      if (N_motors >= MAX_PROFILES)
+      {
+        fail(line, "too many profiles", NULL);
+      }
+      pm = &Motors[ N_motors++ ];
+      motor_defaults(pm, name);
+      pm->line = line;
+      continue;
+    }
+
+    if (NULL == pm)
+    {
+      fail(line, "key outside of a motor profile:", key);
+    }
+
+    for (nv = 0; nv < 6; nv++)
+    {
+      char *tok = strtok(NULL, " \t\r\n");
+
+      if (NULL == tok)
+      {
+        break;
+      }
+      v[ nv ] = atof(tok);
+    }
+    if (nv < 1)
+    {
+      fail(line, "value missing:", key);
+    }
+
+    if (0 == strcmp(key, "kv")) pm->kv = v[0];
+    else if (0 == strcmp(key, "pole_pairs")) pm->pole_pairs = (int)v[0];
+    else if (0 == strcmp(key, "vsys")) pm->vsys = v[0];
+    else if (0 == strcmp(key, "align_time")) pm->align_time = v[0];
+    else if (0 == strcmp(key, "align_duty")) pm->align_duty = v[0];
+    else if (0 == strcmp(key, "ramp_duty")) pm->ramp_duty = v[0];
+    else if (0 == strcmp(key, "ramp_start")) pm->ramp_start = v[0];
+    else if (0 == strcmp(key, "ramp_end")) pm->ramp_end = v[0];
+    else if (0 == strcmp(key, "ct_startup")) pm->ct_startup = v[0];
+    else if (0 == strcmp(key, "ramp_start_rpm")) pm->ramp_start = -v[0];
+    else if (0 == strcmp(key, "ramp_end_rpm")) pm->ramp_end = -v[0];
+    else if (0 == strcmp(key, "ct_startup_rpm")) pm->ct_startup = -v[0];
+    else if (0 == strcmp(key, "ramp_time")) pm->ramp_time = v[0];
+    else if (0 == strcmp(key, "duty_startup")) pm->duty_startup = v[0];
+    else if (0 == strcmp(key, "duty_shutoff")) pm->duty_shutoff = v[0];
+    else if (0 == strcmp(key, "pi_kp")) pm->pi_kp = v[0];
+    else if (0 == strcmp(key, "pi_ki")) pm->pi_ki = v[0];
+    else if (0 == strcmp(key, "gov_rpm_fs")) pm->gov_rpm_fs = v[0];
+    else if ( (0 == strcmp(key, "ol_fit")) && (6 == nv) )
+    {
+      pm->ol_model = OL_FIT;
+      memcpy(pm->ol, v, sizeof(v));
+    }
+    else if ( (0 == strcmp(key, "ol_kv")) && (3 == nv) )
+    {
+      pm->ol_model = OL_KV;
+      memcpy(pm->ol, v, sizeof(v));
+    }
+    else
+    {
+      fail(line, "unknown key or wrong number of values:", key);
+    }
+
+    if (pm->pole_pairs < 1)
+    {
+      fail(line, "invalid pole pairs", NULL);
+    }
+  }
+}
+
+/*
+ * commutation period at the duty-cycle fraction, 0 if beyond the curve
+ */
+static double ol_period(const motor_t *pm, double duty)
+{
+  if (OL_FIT == pm->ol_model)
+  {
+    double x = duty * FIT_TBL_SIZE;
+    double y;
+
+    if (x > pm->ol[ 5 ])
+    {
+      return 0;
+    }
+    if (x < pm->ol[ 2 ])
+    {
+      y = pm->ol[ 0 ] * exp( -x / pm->ol[ 1 ] );
+    }
+    else
+    {
+      y = pm->ol[ 4 ] - pm->ol[ 3 ] * x;
+    }
+    return y * CTIME_SCALAR;
+  }
+  else
+  {
+    double pcnt = duty * 100.0;
+    double slowest = period_of(pm, pm->ramp_start);
+    double rpm;
+
+    if (pcnt > pm->ol[ 2 ])
+    {
+      return 0;
+    }
+    rpm = pm->kv * pm->vsys * pm->ol[ 0 ] * (pcnt - pm->ol[ 1 ]) / 100.0;
+
+    if ( (rpm <= 0) || ((CT_RPM_K / (rpm * pm->pole_pairs)) > slowest) )
+    {
+      return slowest;
+    }
+    return CT_RPM_K / (rpm * pm->pole_pairs);
+  }
+}
+
+static void write_profile(const motor_t *pm)
+{
+  int line = pm->line;
+  unsigned ol[ MPARAM_OL_N_PTS ];
+  unsigned gov_rpm_fs;
+  int n;
+
+  if (OL_NONE == pm->ol_model)
+  {
+    fail(line, "no timing curve (ol_fit or ol_kv) of motor", pm->name);
+  }
+
+  for (n = 0; n < MPARAM_OL_N_PTS; n++)
+  {
+    ol[ n ] = to_u16(line, ol_period(pm, (double)n / MPARAM_OL_N_PTS));
+
+    // the curve ends at the first node beyond its range (0)
+    if ( (n > 0) && (0 != ol[ n ]) && ((0 == ol[ n - 1 ]) || (ol[ n ] > ol[ n - 1 ])) )
+    {
+      fail(line, "timing curve does not decrease with duty-cycle, motor", pm->name);
+    }
+  }
+
+  gov_rpm_fs = to_u16(line, (pm->gov_rpm_fs > 0) ? pm->gov_rpm_fs : pm->kv * pm->vsys);
+
+  printf("\n// %s: %.0f kv, %d pole-pairs @ %.1f v", pm->name, pm->kv, pm->pole_pairs, pm->vsys);
+  if (OL_FIT == pm->ol_model)
+  {
+    printf(", curve fit A=%g TAU=%g [%g:%g] %g - %g x\n",
+           pm->ol[0], pm->ol[1], pm->ol[2], pm->ol[5], pm->ol[4], pm->ol[3]);
+  }
+  else
+  {
+    printf(", load %g above %g%% to %g%%\n", pm->ol[0], pm->ol[1], pm->ol[2]);
+  }
+  printf("#define MPARAM_PROFILE_%s \\\n{ \\\n", pm->name);
+  printf("  \"%s\", %u, \\\n", pm->name, to_u16(line, pm->kv));
+  printf("  { %u, %u, %u, %u, %u, %u }, \\\n",
+         to_u16(line, pm->align_time), duty_q10(pm->align_duty), duty_q10(pm->ramp_duty),
+         to_u16(line, period_of(pm, pm->ramp_start)), to_u16(line, period_of(pm, pm->ramp_end)),
+         to_u16(line, pm->ramp_time));
+  printf("  { %u, %u, %u, %u, %d, %u, %u }, \\\n",
+         gov_rpm_fs, to_u16(line, period_of(pm, pm->ct_startup)),
+         duty_q10(pm->duty_startup), duty_q10(pm->duty_shutoff), pm->pole_pairs,
+         to_u16(line, pm->pi_kp * 256), to_u16(line, pm->pi_ki * 256));
+  printf("  { \\\n");
+  for (n = 0; n < MPARAM_OL_N_PTS; n += 8)
+  {
+    printf("    %5u, %5u, %5u, %5u, %5u, %5u, %5u, %5u, \\\n",
+           ol[n], ol[n + 1], ol[n + 2], ol[n + 3], ol[n + 4], ol[n + 5], ol[n + 6], ol[n + 7]);
+  }
+  printf("  } \\\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *fp;
+  int n;
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s motors.txt > mparam_tbl.h\n", argv[0]);
+    return 1;
+  }
+  Fname = argv[1];
+  fp = fopen(Fname, "r");
+
+  if (NULL == fp)
+  {
+    perror(Fname);
+    return 1;
+  }
+  parse(fp);
+  fclose(fp);
+
+  printf("/*\n");
+  printf(" * Built-in motor profiles (mparam_t initializers, see mparam.h)\n");
+  printf(" * Generated by tools/mparam_gen from tools/mparam_gen/motors.txt, do not edit:\n");
+  printf(" *   make -C SDCC_STM8 tables\n");
+  printf(" */\n");
+  printf("#ifndef MPARAM_TBL_H\n#define MPARAM_TBL_H\n\n");
+  printf("#if ( MPARAM_OL_N_PTS != %d ) || ( MPARAM_DUTY_FS != %d ) || ( MPARAM_NAME_LEN != %d )\n",
+         MPARAM_OL_N_PTS, MPARAM_DUTY_FS, MPARAM_NAME_LEN);
+  printf("  #error \"mparam_tbl.h does not match mparam.h, regenerate\"\n#endif\n");
+
+  for (n = 0; n < N_motors; n++)
+  {
+    write_profile(&Motors[ n ]);
+  }
+  printf("\n#endif // MPARAM_TBL_H\n");
+
+  return 0;
+}
@@ -0,0 +1,193 @@
+/**
+  ******************************************************************************
+  * @file telem_dec.c
+  * @brief Host decoder for the binary telemetry stream
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  *
+  * Reads the raw serial stream (file or stdin) and prints one line of comma
+  * separated values per valid frame. Text output from the terminal UI
+  * interleaved in the stream is skipped by re-synchronizing on the sync byte
+  * and CRC. Gaps in the frame sequence counter are counted as lost frames,
+  * for each node of a multi-ESC bus.
+  * Fault log frames (TELEM_SYNC_FLOG) are printed to stderr.
+  *
+  * Example:
+  *   stty -F /dev/ttyUSB0 115200 raw
+  *   ./telem_dec /dev/ttyUSB0 > log.csv
+  */
+#include <stdio.h>
+#include <stdint.h>
+
+#define TELEM_HOST
+#include "telem.h"
+
+
+static uint8_t crc8(const uint8_t *buf, int len)
+{
+  uint8_t crc = 0;
+  int n;
+
+  while (len-- > 0)
+  {
+    crc ^= *buf++;
+    for (n = 0; n < 8; n++)
+    {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ TELEM_CRC_POLY) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static unsigned get_u16(const uint8_t *frame, int ofs)
+{
+  return ((unsigned)frame[ofs] << 8) | frame[ofs + 1];
+}
+
+/*
+ * frame size by the sync byte, 0 if not a sync byte
+ */
+static int frame_size(uint8_t sync)
+{
+  if (TELEM_SYNC == sync)
+  {
+    return TELEM_FRAME_SZ;
+  }
+  if (TELEM_SYNC_FLOG == sync)
+  {
+    return TELEM_FLOG_FRAME_SZ;
+  }
+  return 0;
+}
+
+static void print_flog(const uint8_t *frame)
+{
+  uint8_t event = frame[TELEM_FLOG_OFS_EVENT];
+
+  if (0 == frame[TELEM_FLOG_OFS_COUNT])
+  {
+    fprintf(stderr, "fault log empty\n");
+    return;
+  }
+  fprintf(stderr, "fault log %u/%u: tick %u fault %u %s opstate %u duty %u period %u vsys %u\n",
+          frame[TELEM_FLOG_OFS_INDEX] + 1u,
+          frame[TELEM_FLOG_OFS_COUNT],
+          get_u16(frame, TELEM_FLOG_OFS_TICK),
+          event & 0x7Fu, (event & 0x80u) ? "clr" : "set",
+          frame[TELEM_FLOG_OFS_OPSTATE],
+          get_u16(frame, TELEM_FLOG_OFS_DUTY),
+          get_u16(frame, TELEM_FLOG_OFS_PERIOD),
+          get_u16(frame, TELEM_FLOG_OFS_VSYS));
+}
+
+int main(int argc, char *argv[])
+{
+  uint8_t frame[TELEM_FRAME_SZ];
+  FILE *fp = stdin;
+  unsigned long n_frames = 0;
+  unsigned long n_lost = 0;
+  unsigned long n_bad = 0;
+  int seq_prev[ 256 ]; // of each node
+  int node;
+  int len = 0;
+  int size = 0;
+  int c;
+
+  for (node = 0; node < 256; node++)
+  {
+    seq_prev[ node ] = -1;
+  }
+
+  if (argc > 1)
+  {
+    fp = fopen(argv[1], "rb");
+    if (NULL == fp)
+    {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+
+  printf("node,seq,opstate,fault,vsys,speed,period,duty,tm_err,bemf_r,bemf_f,rpm,load\n");
+
+  while (EOF != (c = fgetc(fp)))
+  {
+    if (0 == len)
+    {
+      size = frame_size((uint8_t)c);
+      if (0 == size)
+      {
+        continue; // hunt for sync
+      }
+    }
+    frame[len++] = (uint8_t)c;
+
+    if (len < size)
+    {
+      continue;
+    }
+    len = 0;
+
+    // the CRC is the last byte of both frame types
+    if (crc8(frame, size - 1) != frame[size - 1])
+    {
+      int n;
+      n_bad += 1;
+      // false sync: re-scan the buffered bytes for the next sync byte
+      for (n = 1; n < size; n++)
+      {
+        if (0 != frame_size(frame[n]))
+        {
+          int k;
+          int end = size;
+          size = frame_size(frame[n]);
+          for (k = n; k < end; k++)
+          {
+            frame[len++] = frame[k];
+          }
+          break;
+        }
+      }
+      continue;
+    }
+
+    if (TELEM_SYNC_FLOG == frame[0])
+    {
+      print_flog(frame);
+      continue;
+    }
+
+    node = frame[TELEM_OFS_NODE];
+    if (seq_prev[ node ] >= 0)
+    {
+      n_lost += (uint8_t)(frame[TELEM_OFS_SEQ] - seq_prev[ node ] - 1);
+    }
+    seq_prev[ node ] = frame[TELEM_OFS_SEQ];
+    n_frames += 1;
+
+    printf("%d,%u,%u,0x%02X,%u,%u,%u,%u,%d,%u,%u,%u,%u\n",
+           node,
+           frame[TELEM_OFS_SEQ],
+           frame[TELEM_OFS_OPSTATE],
+           frame[TELEM_OFS_FAULT],
+           get_u16(frame, TELEM_OFS_VSYS),
+           get_u16(frame, TELEM_OFS_SPEED),
+           get_u16(frame, TELEM_OFS_PERIOD),
+           get_u16(frame, TELEM_OFS_DUTY),
+           (int16_t)get_u16(frame, TELEM_OFS_TM_ERR),
+           get_u16(frame, TELEM_OFS_BEMF_R),
+           get_u16(frame, TELEM_OFS_BEMF_F),
+           get_u16(frame, TELEM_OFS_RPM),
+           frame[TELEM_OFS_LOAD]);
+  }
+
+  fprintf(stderr, "frames %lu  lost %lu  crc errors %lu\n", n_frames, n_lost, n_bad);
+
+  if (stdin != fp)
+  {
+    fclose(fp);
+  }
+  return 0;
+}